@@ -24,6 +24,26 @@
 #include "base_structure_io.h"
 
 
+// Converts a category designator from a rules file, aka the 'D' in "D3",
+// into a PcfgType
+//
+// Returns -1 if the designator is not a known type
+//
+int designator_to_type(char *designator) {
+    
+    // All of the designators are currently a single character
+    if ((designator[0] == '\0') || (designator[1] != '\0')) {
+        return -1;
+    }
+    
+    char *found = strchr(PCFG_TYPE_DESIGNATORS, designator[0]);
+    if (found == NULL) {
+        return -1;
+    }
+    return found - PCFG_TYPE_DESIGNATORS;
+}
+
+
 // Splits up a base structure string, and allocates an array of BaseReplace
 //
 // Aka turns A4D3 into C(4)->A(4)->D(3)
@@ -92,12 +112,20 @@ int split_base(char* input, BaseReplace **base, int *list_size) {
             start_pos = i;
             
             // Check to make the sure the category is supported
+            int type = designator_to_type(temp_holder);
             
-            // Markov currently isn't supported, but is valid for a rules file
-            if (strncmp(temp_holder,"M", MAX_CONFIG_LINE) == 0) {
+            // Markov doesn't have an id, so this isn't supported
+            if (type == PCFG_MARKOV) {
                 return 1;
             }
-            else if (strncmp(temp_holder,"A", MAX_CONFIG_LINE) == 0) {
+            // Unknown value was found, error out
+            //
+            // Note, currently not handling "C" for capitalization masks
+            // since they aren't in the base_structures, but are added later
+            else if ((type == -1) || (type == PCFG_CAPITALIZATION)) {
+                return 2;
+            }
+            else if (type == PCFG_ALPHA) {
                 // Need to add an extra item for the capitalization masks.
                 //
                 // Aka, you'll have an A->cat->ULL->Cat, with ULL being
@@ -107,23 +135,6 @@ int split_base(char* input, BaseReplace **base, int *list_size) {
                 // making them flat for faster processing
                 num_items++;
             }
-            else if (strncmp(temp_holder,"D", MAX_CONFIG_LINE) == 0) {
-            }
-            else if (strncmp(temp_holder,"Y", MAX_CONFIG_LINE) == 0) {
-            }
-            else if (strncmp(temp_holder,"O", MAX_CONFIG_LINE) == 0) {
-            }
-            else if (strncmp(temp_holder,"K", MAX_CONFIG_LINE) == 0) {
-            }
-            else if (strncmp(temp_holder,"X", MAX_CONFIG_LINE) == 0) {
-            }
-            // Unknown value was found, error out
-            //
-            // Note, currently not handling "C" for capitalization masks
-            // since they aren't in the base_structures, but are added later
-            else {
-                return 2;
-            }
              
             // Start processing a new item pair 
             process_category = 0; 
@@ -177,14 +188,24 @@ int split_base(char* input, BaseReplace **base, int *list_size) {
         num_items++;
     }
     
-    // Only should end with no id for Markov which isn't currently supported
+    // Only should end with no id for Markov
     else {
         // Markov is only one character so check that
         if (start_pos < (MAX_CONFIG_LINE -2)) {
             if (input[start_pos+1] == '\0') {
-                if (input[start_pos] == 'M') {
-                    return 1;
+                // Markov is always the only item in the base structure since
+                // the model generates the whole guess
+                if ((input[start_pos] == 'M') && (start_pos == 0)) {
+                    (*base) = malloc(sizeof(BaseReplace));
+                    if ((*base) == NULL) {
+                        return 2;
+                    }
+                    (*base)[0].type = PCFG_MARKOV;
+                    (*base)[0].id = 0;
+                    (*list_size) = 1;
+                    return 0;
                 }
+                return 1;
             }
             // Value is greater than one character
             else {
@@ -222,9 +243,9 @@ int split_base(char* input, BaseReplace **base, int *list_size) {
         if ((process_category == 1) && (isalpha(input[i]) == 0)) {
             
             // Save the current selection
-            (*base)[num_items].type = malloc( ((i - start_pos) + 1) * sizeof(char));
-            strncpy((*base)[num_items].type, input + start_pos, i - start_pos);
-            (*base)[num_items].type[i-start_pos] = '\0';
+            strncpy(temp_holder, input + start_pos, i - start_pos);
+            temp_holder[i-start_pos] = '\0';
+            (*base)[num_items].type = designator_to_type(temp_holder);
             
             // Start a new item to processr
             start_pos = i;
@@ -242,10 +263,9 @@ int split_base(char* input, BaseReplace **base, int *list_size) {
             (*base)[num_items].id = atoi(temp_holder);
             
             // Check if we need to insert a capitalization mask as well
-            if (strncmp((*base)[num_items].type, "A", MAX_CONFIG_LINE) == 0) {
+            if ((*base)[num_items].type == PCFG_ALPHA) {
                 num_items++;
-                (*base)[num_items].type = malloc( 2 * sizeof(char));
-                strncpy((*base)[num_items].type, "C", 2);
+                (*base)[num_items].type = PCFG_CAPITALIZATION;
                 (*base)[num_items].id = (*base)[num_items-1].id;
             }
             
@@ -265,22 +285,23 @@ int split_base(char* input, BaseReplace **base, int *list_size) {
     (*base)[num_items].id = atoi(temp_holder);
     
     // Check if we need to insert a capitalization mask as well
-    if (strncmp((*base)[num_items].type, "A", MAX_CONFIG_LINE) == 0) {
+    if ((*base)[num_items].type == PCFG_ALPHA) {
         num_items++;
-        (*base)[num_items].type = malloc( 2 * sizeof(char));
-        strncpy((*base)[num_items].type, "C", 2);
+        (*base)[num_items].type = PCFG_CAPITALIZATION;
         (*base)[num_items].id = (*base)[num_items-1].id;
     }
  
     return 0;
 }
 
-// Loads the grammar for base structures
+// Gets the filename of the base structure file in a ruleset
+//
+// filename needs to be allocated by the calling function and be PATH_MAX long
 //
 // Function returns a non-zero value if an error occurs
-//     1 = problem opening the file or malformed ruleset
+//     1 = problem reading the config file or malformed ruleset
 //
-int load_base_structures(char *config_filename, char *base_directory, PcfgBase **base_structures) {
+int get_base_filename(char *config_filename, char *base_directory, char *filename) {
     
     // Get the folder where the files will be saved
     char section_folder[MAX_CONFIG_LINE];
@@ -304,9 +325,110 @@ int load_base_structures(char *config_filename, char *base_directory, PcfgBase *
     }
     
     // create the filename
-    char filename[PATH_MAX];
     snprintf(filename, PATH_MAX, "%s%s%c%s", base_directory,section_folder,SLASH,result[0]);
     
+    return 0;
+}
+
+
+// Estimates how much memory the base structures will take up once loaded
+//
+// Doesn't take pruning into account so this is the worst case
+//
+// Function returns a non-zero value if an error occurs
+//     1 = problem opening the file or malformed ruleset
+//
+int estimate_base_memory(char *config_filename, char *base_directory, size_t *memory) {
+    
+    char filename[PATH_MAX];
+    if (get_base_filename(config_filename, base_directory, filename) != 0) {
+        return 1;
+    }
+    
+    FILE *fp = fopen(filename,"r");
+    if (fp == NULL) {
+        fprintf(stderr, "Error. Could not read the file: %s\n",filename);
+        return 1;
+    }
+    
+    (*memory) = 0;
+    
+    // Holds the current line in the config file
+    char buff[MAX_CONFIG_LINE];
+    
+    while (fgets(buff, MAX_CONFIG_LINE , (FILE*)fp)) {
+        
+        // Every replacement has one category letter, and alpha replacements
+        // get an extra capitalization mask
+        int num_items = 0;
+        for (int i = 0; (buff[i] != '\t') && (buff[i] != '\0'); i++) {
+            if (isalpha(buff[i])) {
+                num_items++;
+                if (buff[i] == 'A') {
+                    num_items++;
+                }
+            }
+        }
+        (*memory) += sizeof(PcfgBase) + (num_items * sizeof(BaseReplace));
+    }
+    
+    fclose(fp);
+    return 0;
+}
+
+
+// Checks if a base structure should be pruned
+//
+// Base structures are pruned if they use a terminal that isn't in the grammar,
+// (for example if every group for it was pruned), or if the most probable
+// guess they could create is below options->min_base_prob
+//
+// Returns 1 if the base structure should be pruned, 0 if it should be kept
+//
+int prune_base(PcfgGrammar *pcfg, BaseReplace *base_items, int size, double prob, PcfgLoadOptions *options) {
+    
+    // The most probable guess is made with the first group of every terminal
+    double max_prob = prob;
+    
+    for (int i = 0; i < size; i++) {
+        PcfgReplacements *terminal = pcfg->terminals[base_items[i].type][base_items[i].id];
+        if (terminal == NULL) {
+            return 1;
+        }
+        max_prob *= terminal->prob;
+    }
+    
+    if (max_prob < options->min_base_prob) {
+        return 1;
+    }
+    
+    // See if it still fits in the memory budget
+    if (options->max_memory != 0) {
+        if (options->memory_used + sizeof(PcfgBase) + (size * sizeof(BaseReplace)) > options->max_memory) {
+            return 1;
+        }
+    }
+    
+    return 0;
+}
+
+
+// Loads the grammar for base structures
+//
+// The terminals need to be loaded first so base structures that use pruned
+// terminals can be pruned as well
+//
+// Function returns a non-zero value if an error occurs
+//     1 = problem opening the file or malformed ruleset
+//
+int load_base_structures(char *config_filename, char *base_directory, PcfgGrammar *pcfg, PcfgLoadOptions *options) {
+    
+    // create the filename
+    char filename[PATH_MAX];
+    if (get_base_filename(config_filename, base_directory, filename) != 0) {
+        return 1;
+    }
+    
     // Open the file to read in the base structures
     // Pointer to the open terminal file
     FILE *fp;
@@ -324,11 +446,11 @@ int load_base_structures(char *config_filename, char *base_directory, PcfgBase *
     int started = 0;
     
     // The base structure we are currently working on
-    (*base_structures) = malloc(sizeof(PcfgBase));
-    if ((*base_structures) == NULL) {
+    pcfg->base_structures = malloc(sizeof(PcfgBase));
+    if (pcfg->base_structures == NULL) {
         return 1;
     }
-    PcfgBase *cur_pointer = (*base_structures);
+    PcfgBase *cur_pointer = pcfg->base_structures;
     cur_pointer->prev = NULL; 
     cur_pointer->next = NULL;
     
@@ -357,6 +479,14 @@ int load_base_structures(char *config_filename, char *base_directory, PcfgBase *
     
         switch (split_base(value, &base_items, &size)) {
             case 0:
+                // Skip it if it should be pruned
+                if (prune_base(pcfg, base_items, size, prob, options) != 0) {
+                    options->pruned_bases++;
+                    free(base_items);
+                    break;
+                }
+                options->memory_used += sizeof(PcfgBase) + (size * sizeof(BaseReplace));
+                
                 // First base_structure
                 if (started == 0) {
                    started = 1;
@@ -384,8 +514,13 @@ int load_base_structures(char *config_filename, char *base_directory, PcfgBase *
     
     }
     
+    fclose(fp);
+    
     // Make sure at least one base_structure was processed
     if (started == 0) {
+        if (options->pruned_bases != 0) {
+            fprintf(stderr, "Every base structure was pruned\n");
+        }
         return 1;
     }
     
@@ -34,6 +34,11 @@
 #include "helper_io.h"
 
 
+// Converts a category designator, aka the 'D' in "D3", into a PcfgType
+// Returns -1 if the designator is not a known type
+extern int designator_to_type(char *designator);
+
+
 // Splits up a base structure string, and allocates an array of BaseReplace
 //
 // Aka turns A4D3 into C(4)->A(4)->D(3)
@@ -45,8 +50,18 @@
 extern int split_base(char* input, BaseReplace **base, int *list_size);
 
 
-// Loads the grammar for base structures
-extern int load_base_structures(char *config_filename, char *base_directory, PcfgBase **base_structures); 
+// Finds the filename of the base structure file in a ruleset
+extern int get_base_filename(char *config_filename, char *base_directory, char *filename);
+
+
+// Estimates how much memory the base structures will take up once loaded
+extern int estimate_base_memory(char *config_filename, char *base_directory, size_t *memory);
+
+
+// Loads the grammar for base structures, pruning them based on the options
+//
+// Note: The terminals need to be loaded first
+extern int load_base_structures(char *config_filename, char *base_directory, PcfgGrammar *pcfg, PcfgLoadOptions *options); 
 
 
 #endif
\ No newline at end of file
@@ -30,16 +30,130 @@
 const char *argp_program_version = VERSION;
 
 
+// Keys for the options that don't have a short version
+enum {
+    OPT_PRUNE_TERMINALS = 256,
+    OPT_PRUNE_BASE,
+    OPT_MAX_MEMORY,
+    OPT_SHARED_GRAMMAR,
+    OPT_MERGE_EPSILON,
+    OPT_RENDER_CACHE,
+    OPT_THREADS,
+    OPT_SKIP,
+    OPT_LIMIT,
+    OPT_SAVE_INDEX,
+    OPT_LOAD_INDEX,
+    OPT_COVERAGE,
+    OPT_ESTIMATE,
+    OPT_SCORE,
+    OPT_MIN_LENGTH,
+    OPT_MAX_LENGTH,
+    OPT_REQUIRE,
+    OPT_LENGTH,
+    OPT_LENGTH_OUTPUT,
+    OPT_DEDUPE,
+    OPT_DEDUPE_FP_RATE,
+    OPT_EXCLUDE,
+    OPT_BUILD_EXCLUDE,
+    OPT_CRACK,
+    OPT_HASH_TYPE,
+    OPT_EVALUATE,
+    OPT_EVALUATE_HITS,
+    OPT_RULES,
+    OPT_RULE_ORDER,
+    OPT_MASKS,
+    OPT_MASK_MIN,
+    OPT_PT_STREAM,
+    OPT_EXPAND,
+    OPT_EXPAND_PART,
+    OPT_COORDINATE,
+    OPT_CONNECT,
+    OPT_LEASE_SIZE,
+    OPT_LEASE_TIMEOUT,
+    OPT_PROGRESS,
+    OPT_SERVE,
+    OPT_CLIENT,
+    OPT_RING,
+    OPT_RING_SIZE,
+};
+
+
 //   OPTIONS.  Field 1 in ARGP.
 //   Order of fields: {NAME, KEY, ARG, FLAGS, DOC}.
 static struct argp_option options[] =
 {
     {"rule_name",  'r', "OUTFILE", 0, "The ruleset to use. Default is: 'Default'"},
-    {"debug", 'd', 0, 0, "Prints out debugging info vs guesses."},
+    {"debug", 'd', 0, 0, "Prints out the pre-terminals as text vs guesses. Each line is the probability, the number of guesses, and the items as type, id and group, (aka D4:12)"},
+    {"prune_terminals", OPT_PRUNE_TERMINALS, "PROB", 0, "Don't load terminal groups with a probability below PROB"},
+    {"prune_base", OPT_PRUNE_BASE, "PROB", 0, "Don't load base structures whose most probable guess is below PROB"},
+    {"max_memory", OPT_MAX_MEMORY, "MB", 0, "Drop the least probable parts of the grammar so it fits in MB megabytes"},
+    {"shared_grammar", OPT_SHARED_GRAMMAR, 0, 0, "Share the loaded grammar with other pcfg_guessers through " SHARED_GRAMMAR_DIR ". Delete the pcfg_* file there to free it"},
+    {"merge_epsilon", OPT_MERGE_EPSILON, "EPS", 0, "Merge neighboring terminal groups whose probabilities are within EPS of each other, (relative). Makes fewer, bigger pre-terminals at the cost of slightly changing the guess order"},
+    {"render_cache", OPT_RENDER_CACHE, "MB", 0, "Memory to use caching alpha words with their capitalization masks applied. Set to 0 to disable"},
+    {"threads", OPT_THREADS, "N", 0, "Split pre-terminals that make a lot of guesses between N threads. The guesses still come out in the same order"},
+    {"skip", OPT_SKIP, "N", 0, "Skip the first N guesses without generating them. Use to resume a session"},
+    {"limit", OPT_LIMIT, "M", 0, "Stop after M guesses"},
+    {"save_index", OPT_SAVE_INDEX, "FILE", 0, "Save how many guesses have been made to FILE every 1024 pre-terminals"},
+    {"load_index", OPT_LOAD_INDEX, "FILE", 0, "Use an index from --save_index to find where to start from with --skip. The index has to be made with the same ruleset and the same pruning, merging and length options"},
+    {"coverage", OPT_COVERAGE, "FILE", 0, "Don't make any guesses. Instead write how much probability is covered after how many guesses to FILE. Use with --limit to stop early"},
+    {"estimate", OPT_ESTIMATE, "N", 0, "Don't make any guesses. Instead take N random samples from the grammar, then read probabilities from stdin, one per line, and write the estimated number of guesses it takes to reach each one. Uses --threads"},
+    {"score", OPT_SCORE, 0, 0, "Don't make any guesses. Instead read passwords from stdin, one per line, and write the probability of each one and the base structure that makes it. With --estimate, the estimated guess number is added too. Uses --threads"},
+    {"min_length", OPT_MIN_LENGTH, "N", 0, "Only make guesses that are at least N characters long"},
+    {"max_length", OPT_MAX_LENGTH, "N", 0, "Only make guesses that are at most N characters long"},
+    {"require", OPT_REQUIRE, "CLASSES", 0, "Only make guesses that have every character class in CLASSES. l=lowercase, u=uppercase, d=digit, s=symbol. Aka --require lds"},
+    {"length", OPT_LENGTH, "LENGTHS", 0, "Only make guesses of these lengths in characters. Aka --length 8 or --length 8,10-12. Only base structures that can make one of the lengths are queued"},
+    {"length_output", OPT_LENGTH_OUTPUT, "PREFIX", 0, "Use with --length. Runs a separate session for each length and writes its guesses to PREFIX.<length> instead of stdout"},
+    {"dedupe", OPT_DEDUPE, "MB", 0, "Drop duplicate guesses using a Bloom filter of MB megabytes. If it fills up it is cleared, so duplicates far apart can still get through. A false positive also drops a guess that isn't a duplicate, at the --dedupe_fp_rate"},
+    {"dedupe_fp_rate", OPT_DEDUPE_FP_RATE, "RATE", 0, "Chance that --dedupe drops a guess that isn't a duplicate. Default is 0.0001"},
+    {"exclude", OPT_EXCLUDE, "FILE", 0, "Don't output guesses that are in FILE. Make FILE with --build_exclude"},
+    {"build_exclude", OPT_BUILD_EXCLUDE, "FILE", 0, "Don't make any guesses. Instead read words from stdin, one per line, and save them to FILE for use with --exclude"},
+    {"crack", OPT_CRACK, "FILE", 0, "Hash each guess and check it against the hex hashes in FILE. Only cracked hashes are output, as hash:password"},
+    {"hash_type", OPT_HASH_TYPE, "TYPE", 0, "Type of the hashes for --crack: md5, ntlm or sha1. Default is md5"},
+    {"evaluate", OPT_EVALUATE, "FILE", 0, "Check each guess against the plaintext test set in FILE, and output the cracked versus guesses curve instead of guesses"},
+    {"evaluate_hits", OPT_EVALUATE_HITS, "FILE", 0, "With --evaluate, also save each test password and the guess number it was cracked at to FILE"},
+    {"rules", OPT_RULES, "FILE", 0, "Apply every hashcat style rule in FILE to each guess. --skip and --limit count guesses before the rules are applied"},
+    {"rule_order", OPT_RULE_ORDER, "ORDER", 0, "Order of the guesses from --rules. 'guess' applies every rule to a guess before the next guess, 'rule' applies each rule to a batch of guesses before the next rule. Default is guess"},
+    {"masks", OPT_MASKS, "FILE", 0, "Write the end of each pre-terminal that can be a mask to FILE as hashcat masks, (-a 3), with what comes before it as a literal prefix. Other guesses are output as normal"},
+    {"mask_min", OPT_MASK_MIN, "NUM", 0, "With --masks, only use a mask if it makes at least NUM guesses. Default is 10000"},
+    {"pt_stream", OPT_PT_STREAM, "FILE", 0, "Write the pre-terminals to FILE as a binary stream, in the order they come off the queue, instead of making guesses. Use - for stdout"},
+    {"expand", OPT_EXPAND, "FILE", 0, "Make the guesses for the pre-terminals in a stream from --pt_stream instead of running the queue. Use - for stdin. Needs the same ruleset and pruning options the stream was made with"},
+    {"expand_part", OPT_EXPAND_PART, "K/N", 0, "With --expand, only expand every N'th pre-terminal starting with the K'th, so N processes can share one stream. Default is 1/1"},
+    {"coordinate", OPT_COORDINATE, "ADDRESS", 0, "Run the queue and hand out leases on ranges of pre-terminals to workers started with --connect, instead of making guesses. ADDRESS is a Unix socket path, or host:port for TCP"},
+    {"connect", OPT_CONNECT, "ADDRESS", 0, "Make the guesses for leases from a coordinator at ADDRESS. Needs the same ruleset and pruning options as the coordinator"},
+    {"lease_size", OPT_LEASE_SIZE, "NUM", 0, "With --coordinate, the number of guesses in each lease. Default is 100000000"},
+    {"lease_timeout", OPT_LEASE_TIMEOUT, "SECONDS", 0, "With --coordinate, give a lease to another worker if it isn't finished in this many seconds. Default is 600"},
+    {"progress", OPT_PROGRESS, "FILE", 0, "With --coordinate, save the finished leases to FILE, and skip the ones already in it"},
+    {"serve", OPT_SERVE, "ADDRESS", 0, "Send the guesses in batches to clients started with --client instead of to stdout. Each guess goes to one client. Guesses already sent to a client that drops are lost, so each guess is delivered at most once. ADDRESS is a Unix socket path, or host:port for TCP"},
+    {"client", OPT_CLIENT, "ADDRESS", 0, "Write the guesses from a server started with --serve at ADDRESS to stdout. Doesn't need a ruleset"},
+    {"ring", OPT_RING, "FILE", 0, "Write the guesses to a shared memory ring at FILE instead of stdout, for one process to read with pcfg_ring.h, (see pcfg_ring_consumer). FILE should be on a memory backed filesystem like /dev/shm"},
+    {"ring_size", OPT_RING_SIZE, "MB", 0, "Size of the --ring. Default is 64"},
     {0}
 };
 
 
+// Parses a number of guesses. Large numbers can be written in scientific
+// notation, aka 4.2e12
+//
+// Returns 0 if it worked ok, 1 if arg isn't a valid number
+//
+int parse_guess_count(char *arg, unsigned long long *result) {
+    
+    char *end_pos;
+    errno = 0;
+    (*result) = strtoull(arg, &end_pos, 10);
+    if ((end_pos != arg) && (*end_pos == '\0') && (errno == 0) && (arg[0] != '-')) {
+        return 0;
+    }
+    
+    double value = strtod(arg, &end_pos);
+    if ((end_pos == arg) || (*end_pos != '\0') || (value < 0.0) || (value >= 18446744073709551615.0)) {
+        return 1;
+    }
+    (*result) = (unsigned long long) value;
+    return 0;
+}
+
+
 //   PARSER. Field 2 in ARGP.
 //   Order of parameters: KEY, ARG, STATE.
 static error_t parse_opt (int key, char *arg, struct argp_state *state){
@@ -52,6 +166,199 @@ static error_t parse_opt (int key, char *arg, struct argp_state *state){
         case 'r':
             program_info->rule_name = arg;
             break;
+        case OPT_PRUNE_TERMINALS:
+            program_info->min_term_prob = atof(arg);
+            if ((program_info->min_term_prob < 0.0) || (program_info->min_term_prob > 1.0)) {
+                argp_error(state, "--prune_terminals must be between 0 and 1");
+            }
+            break;
+        case OPT_PRUNE_BASE:
+            program_info->min_base_prob = atof(arg);
+            if ((program_info->min_base_prob < 0.0) || (program_info->min_base_prob > 1.0)) {
+                argp_error(state, "--prune_base must be between 0 and 1");
+            }
+            break;
+        case OPT_MAX_MEMORY:
+            if (atol(arg) <= 0) {
+                argp_error(state, "--max_memory must be greater than 0");
+            }
+            program_info->max_memory = (size_t) atol(arg) * 1024 * 1024;
+            break;
+        case OPT_SHARED_GRAMMAR:
+            program_info->shared_grammar = 1;
+            break;
+        case OPT_MERGE_EPSILON:
+            program_info->merge_epsilon = atof(arg);
+            if ((program_info->merge_epsilon < 0.0) || (program_info->merge_epsilon >= 1.0)) {
+                argp_error(state, "--merge_epsilon must be at least 0 and less than 1");
+            }
+            break;
+        case OPT_RENDER_CACHE:
+            if (atol(arg) < 0) {
+                argp_error(state, "--render_cache can't be negative");
+            }
+            program_info->render_cache = (size_t) atol(arg) * 1024 * 1024;
+            break;
+        case OPT_THREADS:
+            program_info->threads = atoi(arg);
+            if ((program_info->threads < 1) || (program_info->threads > MAX_THREADS)) {
+                argp_error(state, "--threads must be between 1 and %d", MAX_THREADS);
+            }
+            break;
+        case OPT_SKIP:
+            if (parse_guess_count(arg, &program_info->skip) != 0) {
+                argp_error(state, "--skip must be a number of guesses");
+            }
+            break;
+        case OPT_LIMIT:
+            if ((parse_guess_count(arg, &program_info->limit) != 0) || (program_info->limit == 0)) {
+                argp_error(state, "--limit must be a number of guesses greater than 0");
+            }
+            break;
+        case OPT_SAVE_INDEX:
+            program_info->save_index = arg;
+            break;
+        case OPT_LOAD_INDEX:
+            program_info->load_index = arg;
+            break;
+        case OPT_COVERAGE:
+            program_info->coverage = arg;
+            break;
+        case OPT_SCORE:
+            program_info->score = 1;
+            break;
+        case OPT_MIN_LENGTH:
+            program_info->min_length = atoi(arg);
+            if ((program_info->min_length < 0) || (program_info->min_length >= MAX_GUESS_SIZE)) {
+                argp_error(state, "--min_length must be between 0 and %d", MAX_GUESS_SIZE - 1);
+            }
+            break;
+        case OPT_MAX_LENGTH:
+            program_info->max_length = atoi(arg);
+            if ((program_info->max_length < 1) || (program_info->max_length >= MAX_GUESS_SIZE)) {
+                argp_error(state, "--max_length must be between 1 and %d", MAX_GUESS_SIZE - 1);
+            }
+            break;
+        case OPT_REQUIRE:
+            if (parse_policy_classes(arg, &program_info->require) != 0) {
+                argp_error(state, "--require can only contain the classes '%s'", POLICY_CLASS_NAMES);
+            }
+            break;
+        case OPT_LENGTH:
+            if (parse_length_set(arg, program_info->lengths) != 0) {
+                argp_error(state, "--length must be a list of lengths between 1 and %d, aka 8,10-12", MAX_GUESS_SIZE - 1);
+            }
+            program_info->use_lengths = 1;
+            break;
+        case OPT_LENGTH_OUTPUT:
+            program_info->length_output = arg;
+            break;
+        case OPT_DEDUPE:
+            program_info->dedupe = (size_t) atol(arg) * 1024 * 1024;
+            if (program_info->dedupe == 0) {
+                argp_error(state, "--dedupe must be at least 1 MB");
+            }
+            break;
+        case OPT_DEDUPE_FP_RATE:
+            program_info->dedupe_fp_rate = atof(arg);
+            if ((program_info->dedupe_fp_rate <= 0.0) || (program_info->dedupe_fp_rate >= 1.0)) {
+                argp_error(state, "--dedupe_fp_rate must be between 0 and 1");
+            }
+            break;
+        case OPT_EXCLUDE:
+            program_info->exclude = arg;
+            break;
+        case OPT_BUILD_EXCLUDE:
+            program_info->build_exclude = arg;
+            break;
+        case OPT_CRACK:
+            program_info->crack = arg;
+            break;
+        case OPT_HASH_TYPE:
+            program_info->hash_type = parse_hash_type(arg);
+            if (program_info->hash_type == 0) {
+                argp_error(state, "--hash_type must be md5, ntlm or sha1");
+            }
+            break;
+        case OPT_EVALUATE:
+            program_info->evaluate = arg;
+            break;
+        case OPT_EVALUATE_HITS:
+            program_info->evaluate_hits = arg;
+            break;
+        case OPT_RULES:
+            program_info->rules = arg;
+            break;
+        case OPT_RULE_ORDER:
+            if (strcmp(arg, "guess") == 0) {
+                program_info->rule_order = RULE_ORDER_GUESS;
+            }
+            else if (strcmp(arg, "rule") == 0) {
+                program_info->rule_order = RULE_ORDER_RULE;
+            }
+            else {
+                argp_error(state, "--rule_order must be guess or rule");
+            }
+            break;
+        case OPT_MASKS:
+            program_info->masks = arg;
+            break;
+        case OPT_PT_STREAM:
+            program_info->pt_stream = arg;
+            break;
+        case OPT_EXPAND:
+            program_info->expand = arg;
+            break;
+        case OPT_EXPAND_PART:
+            if ((sscanf(arg, "%d/%d", &program_info->expand_part, &program_info->expand_parts) != 2) || (program_info->expand_parts < 1) || (program_info->expand_part < 1) || (program_info->expand_part > program_info->expand_parts)) {
+                argp_error(state, "--expand_part must be K/N, with K between 1 and N");
+            }
+            break;
+        case OPT_COORDINATE:
+            program_info->coordinate = arg;
+            break;
+        case OPT_CONNECT:
+            program_info->connect = arg;
+            break;
+        case OPT_LEASE_SIZE:
+            if ((parse_guess_count(arg, &program_info->lease_size) != 0) || (program_info->lease_size == 0)) {
+                argp_error(state, "--lease_size must be a number of guesses greater than 0");
+            }
+            break;
+        case OPT_LEASE_TIMEOUT:
+            program_info->lease_timeout = atoi(arg);
+            if (program_info->lease_timeout < 1) {
+                argp_error(state, "--lease_timeout must be at least 1 second");
+            }
+            break;
+        case OPT_PROGRESS:
+            program_info->progress = arg;
+            break;
+        case OPT_SERVE:
+            program_info->serve = arg;
+            break;
+        case OPT_CLIENT:
+            program_info->client = arg;
+            break;
+        case OPT_RING:
+            program_info->ring = arg;
+            break;
+        case OPT_RING_SIZE:
+            program_info->ring_size = (unsigned long) atol(arg);
+            if (program_info->ring_size == 0) {
+                argp_error(state, "--ring_size must be at least 1 MB");
+            }
+            break;
+        case OPT_MASK_MIN:
+            if ((parse_guess_count(arg, &program_info->mask_min) != 0) || (program_info->mask_min == 0)) {
+                argp_error(state, "--mask_min must be a number of guesses greater than 0");
+            }
+            break;
+        case OPT_ESTIMATE:
+            if ((parse_guess_count(arg, &program_info->estimate) != 0) || (program_info->estimate == 0)) {
+                argp_error(state, "--estimate must be a number of samples greater than 0");
+            }
+            break;
         default:
             return ARGP_ERR_UNKNOWN;
     }
@@ -81,6 +388,50 @@ int parse_command_line(int argc, char **argv, struct program_info *program_info)
     program_info->debug = 0;
     program_info->version = VERSION;
     program_info->min_supported_version = MIN_SUPPORTED_VERSION;
+    program_info->min_term_prob = 0.0;
+    program_info->min_base_prob = 0.0;
+    program_info->max_memory = 0;
+    program_info->shared_grammar = 0;
+    program_info->merge_epsilon = 0.0;
+    program_info->render_cache = (size_t) DEFAULT_RENDER_CACHE * 1024 * 1024;
+    program_info->threads = 1;
+    program_info->skip = 0;
+    program_info->limit = 0;
+    program_info->save_index = NULL;
+    program_info->load_index = NULL;
+    program_info->coverage = NULL;
+    program_info->estimate = 0;
+    program_info->score = 0;
+    program_info->min_length = 0;
+    program_info->max_length = 0;
+    program_info->require = 0;
+    program_info->use_lengths = 0;
+    program_info->length_output = NULL;
+    program_info->dedupe = 0;
+    program_info->dedupe_fp_rate = DEFAULT_DEDUPE_FP_RATE;
+    program_info->exclude = NULL;
+    program_info->build_exclude = NULL;
+    program_info->crack = NULL;
+    program_info->hash_type = CRACK_MD5;
+    program_info->evaluate = NULL;
+    program_info->evaluate_hits = NULL;
+    program_info->rules = NULL;
+    program_info->rule_order = RULE_ORDER_GUESS;
+    program_info->masks = NULL;
+    program_info->mask_min = DEFAULT_MASK_MIN_KEYSPACE;
+    program_info->pt_stream = NULL;
+    program_info->expand = NULL;
+    program_info->expand_part = 1;
+    program_info->expand_parts = 1;
+    program_info->coordinate = NULL;
+    program_info->connect = NULL;
+    program_info->lease_size = DEFAULT_LEASE_SIZE;
+    program_info->lease_timeout = DEFAULT_LEASE_TIMEOUT;
+    program_info->progress = NULL;
+    program_info->serve = NULL;
+    program_info->client = NULL;
+    program_info->ring = NULL;
+    program_info->ring_size = DEFAULT_RING_SIZE;
     
     argp_parse(&argp, argc, argv, 0, 0, program_info);
     
@@ -29,7 +29,16 @@
 
 
 #include <argp.h>
+#include <stdlib.h>
+#include <errno.h>
 #include "global_def.h"
+#include "policy.h"
+#include "dedupe.h"
+#include "crack.h"
+#include "rules.h"
+#include "masks.h"
+#include "coordinator.h"
+#include "guess_ring.h"
 
 
 // Contains results of parsing the command line
@@ -38,6 +47,51 @@ struct program_info {
     char *rule_name;          // The rule name, -r
     char *version;
     char *min_supported_version; // The oldedst supported ruleset
+    double min_term_prob;     // Prune terminal groups below this, --prune_terminals
+    double min_base_prob;     // Prune base structures below this, --prune_base
+    size_t max_memory;        // Memory budget for the grammar in bytes, --max_memory
+    int shared_grammar;       // Share the grammar with other processes, --shared_grammar
+    double merge_epsilon;     // Merge groups within this relative distance, --merge_epsilon
+    size_t render_cache;      // Memory for cached alpha/capitalization renders in bytes, --render_cache
+    int threads;              // Number of threads to split big pre-terminals between, --threads
+    unsigned long long skip;  // Number of guesses to skip, --skip
+    unsigned long long limit; // Maximum number of guesses to make. 0 is no limit, --limit
+    char *save_index;         // File to save the guess index to, --save_index
+    char *load_index;         // Index file to use to speed up --skip, --load_index
+    char *coverage;           // File to write the coverage curve to instead of guessing, --coverage
+    unsigned long long estimate; // Number of samples for estimating guess numbers. 0 is off, --estimate
+    int score;                // Score passwords from stdin instead of guessing, --score
+    int min_length;           // Shortest guess to make in characters, --min_length
+    int max_length;           // Longest guess to make in characters. 0 is no limit, --max_length
+    int require;              // Character classes every guess needs. POLICY_* bits, --require
+    int use_lengths;          // Only make guesses with lengths in lengths, --length
+    unsigned char lengths[MAX_GUESS_SIZE];
+    char *length_output;      // Prefix of the per-length output files, --length_output
+    size_t dedupe;            // Memory for the duplicate filter in bytes. 0 is off, --dedupe
+    double dedupe_fp_rate;    // False positive rate of the duplicate filter, --dedupe_fp_rate
+    char *exclude;            // Fingerprint file of guesses not to output, --exclude
+    char *build_exclude;      // Fingerprint file to build from stdin, --build_exclude
+    char *crack;              // Hash list to crack instead of outputting guesses, --crack
+    int hash_type;            // CRACK_* type of the hashes in the list, --hash_type
+    char *evaluate;           // Test set to check guesses against instead of outputting them, --evaluate
+    char *evaluate_hits;      // File to save each test password's guess number to, --evaluate_hits
+    char *rules;              // Rule file to apply to every guess, --rules
+    int rule_order;           // RULE_ORDER_GUESS or RULE_ORDER_RULE, --rule_order
+    char *masks;              // File to write hashcat masks to, --masks
+    unsigned long long mask_min; // Smallest mask to write, --mask_min
+    char *pt_stream;          // File to write the pre-terminal stream to, --pt_stream
+    char *expand;             // Pre-terminal stream to make guesses from, --expand
+    int expand_part;          // Which part of the stream to expand, (K of N), --expand_part
+    int expand_parts;
+    char *coordinate;         // Address to hand out leases on, --coordinate
+    char *connect;            // Address of the coordinator to get leases from, --connect
+    unsigned long long lease_size; // Guesses in each lease, --lease_size
+    int lease_timeout;        // Seconds before a lease is given out again, --lease_timeout
+    char *progress;           // File of the finished leases, --progress
+    char *serve;              // Address to send batches of guesses to clients on, --serve
+    char *client;             // Address of the server to read guesses from, --client
+    char *ring;               // Shared memory ring to write guesses to, --ring
+    unsigned long ring_size;  // Size of the ring in MB, --ring_size
 };
 
 
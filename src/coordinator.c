@@ -0,0 +1,561 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Pretty Cool Fuzzy Guesser (PCFG)
+//  --Probabilistic Context Free Grammar (PCFG) Password Guessing Program
+//
+//  Written by Matt Weir
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//
+
+
+
+#include "coordinator.h"
+
+
+// Sorts lease ids in ascending order
+//
+static int compare_ids(const void *a, const void *b) {
+    uint64_t id_a = *(const uint64_t *) a;
+    uint64_t id_b = *(const uint64_t *) b;
+    return (id_a > id_b) - (id_a < id_b);
+}
+
+
+// Loads the ids of the leases finished in an earlier run, and opens the
+// progress file to add to it
+//
+// The progress file is only valid for the same ruleset and lease size, and
+// the same pruning, policy and --skip/--limit options, since those decide
+// what is in each lease. The options are checked with order_hash
+//
+// Function returns 0 if it worked ok, 1 if an error occured
+//
+static int load_progress(Coordinator *coord, char *filename, char *rule_name, uint64_t order_hash) {
+    
+    char expected[512];
+    snprintf(expected, sizeof(expected), "%s\t%s\t%llu\t%016llx\n", COORD_PROGRESS_HEADER, rule_name, coord->lease_size, (unsigned long long) order_hash);
+    
+    FILE *fp = fopen(filename, "r");
+    if (fp != NULL) {
+        char buff[512];
+        if ((fgets(buff, sizeof(buff), fp) == NULL) || (strcmp(buff, expected) != 0)) {
+            fprintf(stderr, "Error. The progress file wasn't made with this ruleset, lease size and options: %s\n", filename);
+            fclose(fp);
+            return 1;
+        }
+        size_t size = 0;
+        unsigned long long id;
+        while (fscanf(fp, "%llu", &id) == 1) {
+            if (coord->num_finished == size) {
+                size = (size == 0) ? 1024 : size * 2;
+                uint64_t *resized = realloc(coord->finished, size * sizeof(uint64_t));
+                if (resized == NULL) {
+                    fclose(fp);
+                    return 1;
+                }
+                coord->finished = resized;
+            }
+            coord->finished[coord->num_finished++] = id;
+        }
+        fclose(fp);
+        qsort(coord->finished, coord->num_finished, sizeof(uint64_t), compare_ids);
+        fprintf(stderr, "Resuming with %zu leases already finished\n", coord->num_finished);
+    }
+    
+    coord->progress_fp = fopen(filename, "a");
+    if (coord->progress_fp == NULL) {
+        fprintf(stderr, "Error. Could not open the progress file: %s\n", filename);
+        return 1;
+    }
+    if (fp == NULL) {
+        fputs(expected, coord->progress_fp);
+        fflush(coord->progress_fp);
+    }
+    return 0;
+}
+
+
+// Starts building a new lease
+//
+// Function returns 0 if it worked ok, 1 if memory couldn't be allocated
+//
+static int start_lease(Coordinator *coord) {
+    coord->lease_buf = NULL;
+    coord->lease_len = 0;
+    coord->lease_records = 0;
+    coord->lease_guesses = 0;
+    coord->lease_fp = open_memstream(&coord->lease_buf, &coord->lease_len);
+    coord->stream->fp = coord->lease_fp;
+    return (coord->lease_fp == NULL);
+}
+
+
+// Starts listening for workers on address
+//
+// If progress isn't NULL, the id of each finished lease is saved to it, and
+// leases that are already in it are skipped. order_hash identifies the
+// options that change what is in each lease
+//
+// Returns NULL if an error occured
+//
+Coordinator *create_coordinator(char *address, PcfgGrammar *pcfg, char *rule_name, uint64_t order_hash, unsigned long long lease_size, int timeout, char *progress) {
+    
+    Coordinator *coord = calloc(1, sizeof(Coordinator));
+    if (coord == NULL) {
+        fprintf(stderr, "Error allocating memory for the coordinator\n");
+        return NULL;
+    }
+    coord->listen_fd = -1;
+    coord->lease_size = lease_size;
+    coord->timeout = timeout;
+    for (int i = 0; i < COORD_MAX_WORKERS; i++) {
+        coord->workers[i].fd = -1;
+    }
+    
+    if ((progress != NULL) && (load_progress(coord, progress, rule_name, order_hash) != 0)) {
+        free_coordinator(coord);
+        return NULL;
+    }
+    
+    // Every worker gets the stream header first
+    FILE *header_fp = open_memstream(&coord->header, &coord->header_len);
+    if (header_fp == NULL) {
+        free_coordinator(coord);
+        return NULL;
+    }
+    coord->stream = create_pt_stream(header_fp, pcfg, rule_name, 0);
+    fclose(header_fp);
+    if ((coord->stream == NULL) || (start_lease(coord) != 0)) {
+        free_coordinator(coord);
+        return NULL;
+    }
+    
+    int is_unix;
+    coord->listen_fd = socket_listen(address, &is_unix);
+    if (coord->listen_fd == -1) {
+        free_coordinator(coord);
+        return NULL;
+    }
+    if (is_unix == 1) {
+        coord->unix_path = address;
+    }
+    return coord;
+}
+
+
+// Returns 1 if the lease was finished in an earlier run
+//
+static int lease_finished(Coordinator *coord, uint64_t id) {
+    return (bsearch(&id, coord->finished, coord->num_finished, sizeof(uint64_t), compare_ids) != NULL);
+}
+
+
+// Stops talking to a worker. Its lease is given to the next worker that
+// asks for one
+//
+static void drop_worker(Coordinator *coord, int worker) {
+    CoordWorker *cur = &coord->workers[worker];
+    close(cur->fd);
+    free(cur->out);
+    memset(cur, 0, sizeof(CoordWorker));
+    cur->fd = -1;
+    for (int i = 0; i < coord->num_leases; i++) {
+        if (coord->leases[i]->worker == worker) {
+            coord->leases[i]->worker = -1;
+            coord->reissued++;
+        }
+    }
+}
+
+
+// Adds data to what is waiting to be sent to a worker
+//
+// Function returns 0 if it worked ok, 1 if memory couldn't be allocated
+//
+static int queue_send(CoordWorker *cur, const void *data, size_t len) {
+    
+    // Start over at the beginning of the buffer once it has all been sent
+    if (cur->out_sent == cur->out_len) {
+        cur->out_sent = 0;
+        cur->out_len = 0;
+    }
+    if (cur->out_len + len > cur->out_size) {
+        size_t new_size = (cur->out_size == 0) ? 4096 : cur->out_size;
+        while (new_size < cur->out_len + len) {
+            new_size *= 2;
+        }
+        char *resized = realloc(cur->out, new_size);
+        if (resized == NULL) {
+            return 1;
+        }
+        cur->out = resized;
+        cur->out_size = new_size;
+    }
+    memcpy(cur->out + cur->out_len, data, len);
+    cur->out_len += len;
+    return 0;
+}
+
+
+// Sends as much of what is waiting for a worker as its socket has room for
+//
+// Workers that were told to exit are closed once everything is sent
+//
+static void flush_worker(Coordinator *coord, int worker) {
+    CoordWorker *cur = &coord->workers[worker];
+    if (send_some(cur->fd, cur->out, cur->out_len, &cur->out_sent) != 0) {
+        drop_worker(coord, worker);
+        return;
+    }
+    if ((cur->closing == 1) && (cur->out_sent == cur->out_len)) {
+        drop_worker(coord, worker);
+    }
+}
+
+
+// Gives a worker the oldest lease nobody is working on
+//
+// If there isn't one, the worker waits for the next lease, or is told to
+// exit if all of the work is done
+//
+static void give_lease(Coordinator *coord, int worker) {
+    
+    CoordWorker *cur = &coord->workers[worker];
+    cur->waiting = 0;
+    
+    for (int i = 0; i < coord->num_leases; i++) {
+        Lease *lease = coord->leases[i];
+        if (lease->worker != -1) {
+            continue;
+        }
+        LeaseHeader header = {lease->id, lease->num_records, 0};
+        if ((queue_send(cur, &header, sizeof(header)) != 0) || (queue_send(cur, lease->records, lease->len) != 0)) {
+            drop_worker(coord, worker);
+            return;
+        }
+        lease->worker = worker;
+        lease->expires = time(NULL) + coord->timeout;
+        coord->issued++;
+        flush_worker(coord, worker);
+        return;
+    }
+    
+    if ((coord->finishing == 1) && (coord->num_leases == 0)) {
+        LeaseHeader header = {0, 0, LEASE_FLAG_DONE};
+        if (queue_send(cur, &header, sizeof(header)) != 0) {
+            drop_worker(coord, worker);
+            return;
+        }
+        cur->closing = 1;
+        flush_worker(coord, worker);
+        return;
+    }
+    cur->waiting = 1;
+}
+
+
+// Gives leases to the workers that are waiting for one
+//
+static void give_waiting(Coordinator *coord) {
+    for (int i = 0; i < COORD_MAX_WORKERS; i++) {
+        if ((coord->workers[i].fd != -1) && (coord->workers[i].waiting == 1)) {
+            give_lease(coord, i);
+        }
+    }
+}
+
+
+// Removes a finished lease and saves it to the progress file
+//
+// Leases that were given out again after timing out can be finished more
+// than once. Only the first one counts
+//
+static void finish_lease(Coordinator *coord, uint64_t id) {
+    for (int i = 0; i < coord->num_leases; i++) {
+        Lease *lease = coord->leases[i];
+        if (lease->id != id) {
+            continue;
+        }
+        free(lease->records);
+        free(lease);
+        memmove(coord->leases + i, coord->leases + i + 1, (coord->num_leases - i - 1) * sizeof(Lease *));
+        coord->num_leases--;
+        coord->completed++;
+        if (coord->progress_fp != NULL) {
+            fprintf(coord->progress_fp, "%llu\n", (unsigned long long) id);
+            fflush(coord->progress_fp);
+        }
+        return;
+    }
+}
+
+
+// Accepts new workers, answers lease requests, and takes back leases that
+// have timed out. Waits up to wait_ms for something to happen
+//
+static void serve_workers(Coordinator *coord, int wait_ms) {
+    
+    struct pollfd fds[COORD_MAX_WORKERS + 1];
+    int slots[COORD_MAX_WORKERS + 1];
+    int num_fds = 1;
+    fds[0].fd = coord->listen_fd;
+    fds[0].events = POLLIN;
+    for (int i = 0; i < COORD_MAX_WORKERS; i++) {
+        if (coord->workers[i].fd != -1) {
+            fds[num_fds].fd = coord->workers[i].fd;
+            fds[num_fds].events = POLLIN;
+            if (coord->workers[i].out_sent != coord->workers[i].out_len) {
+                fds[num_fds].events |= POLLOUT;
+            }
+            slots[num_fds] = i;
+            num_fds++;
+        }
+    }
+    
+    int ready = poll(fds, num_fds, wait_ms);
+    
+    for (int i = 1; (ready > 0) && (i < num_fds); i++) {
+        if (fds[i].revents == 0) {
+            continue;
+        }
+        int worker = slots[i];
+        CoordWorker *cur = &coord->workers[worker];
+        if (cur->out_sent != cur->out_len) {
+            flush_worker(coord, worker);
+            if (cur->fd == -1) {
+                continue;
+            }
+        }
+        if ((fds[i].revents & (POLLIN | POLLHUP | POLLERR)) == 0) {
+            continue;
+        }
+        
+        // Requests can come in pieces. Only act on a whole one
+        if (recv_some(cur->fd, &cur->request, sizeof(LeaseRequest), &cur->request_len) != 0) {
+            drop_worker(coord, worker);
+            continue;
+        }
+        if (cur->request_len < sizeof(LeaseRequest)) {
+            continue;
+        }
+        cur->request_len = 0;
+        if (cur->request.done != 0) {
+            finish_lease(coord, cur->request.done - 1);
+        }
+        give_lease(coord, worker);
+    }
+    
+    if ((ready > 0) && (fds[0].revents & POLLIN)) {
+        int fd = accept(coord->listen_fd, NULL, NULL);
+        int slot = 0;
+        while ((slot < COORD_MAX_WORKERS) && (coord->workers[slot].fd != -1)) {
+            slot++;
+        }
+        if ((fd != -1) && ((slot == COORD_MAX_WORKERS) || (socket_nonblocking(fd) != 0))) {
+            close(fd);
+        }
+        else if (fd != -1) {
+            coord->workers[slot].fd = fd;
+            if (queue_send(&coord->workers[slot], coord->header, coord->header_len) != 0) {
+                drop_worker(coord, slot);
+            }
+            else {
+                flush_worker(coord, slot);
+            }
+        }
+    }
+    
+    // Take back leases from workers that are taking too long. If the worker
+    // finishes it later that's fine, the lease just gets done twice
+    time_t now = time(NULL);
+    for (int i = 0; i < coord->num_leases; i++) {
+        if ((coord->leases[i]->worker != -1) && (coord->leases[i]->expires <= now)) {
+            coord->leases[i]->worker = -1;
+            coord->reissued++;
+        }
+    }
+    give_waiting(coord);
+}
+
+
+// Finishes the lease being built, and makes it available to the workers
+//
+// Function returns 0 if it worked ok, 1 if memory couldn't be allocated
+//
+static int close_lease(Coordinator *coord) {
+    
+    if (fclose(coord->lease_fp) != 0) {
+        return 1;
+    }
+    coord->lease_fp = NULL;
+    if (coord->lease_records == 0) {
+        free(coord->lease_buf);
+        return 0;
+    }
+    
+    uint64_t id = coord->next_id++;
+    if (lease_finished(coord, id)) {
+        free(coord->lease_buf);
+        coord->skipped++;
+        return 0;
+    }
+    
+    Lease *lease = malloc(sizeof(Lease));
+    if (lease == NULL) {
+        free(coord->lease_buf);
+        return 1;
+    }
+    lease->id = id;
+    lease->records = coord->lease_buf;
+    lease->len = coord->lease_len;
+    lease->num_records = coord->lease_records;
+    lease->worker = -1;
+    coord->leases[coord->num_leases++] = lease;
+    
+    give_waiting(coord);
+    return 0;
+}
+
+
+// Adds a pre-terminal, (or part of one), to the lease being built
+//
+// Once the lease is full, it is handed out. If there are already
+// COORD_MAX_LEASES leases that haven't been finished, this waits for
+// workers to finish some of them first
+//
+// If can_split is 1, big pre-terminals are split between leases.
+// Otherwise they are kept whole, since every worker given part of one
+// would have to walk all of it
+//
+// Function returns 0 if it worked ok, 1 if an error occured
+//
+int coordinator_add_pt(Coordinator *coord, PQItem *pq_item, unsigned long long count, unsigned long long first, unsigned long long last, int can_split) {
+    
+    while (first < last) {
+        
+        unsigned long long end = last;
+        if ((can_split == 1) && (last - first > coord->lease_size - coord->lease_guesses)) {
+            end = first + (coord->lease_size - coord->lease_guesses);
+        }
+        if (write_pt_record(coord->stream, pq_item, count, first, end) != 0) {
+            return 1;
+        }
+        coord->lease_records++;
+        coord->lease_guesses += end - first;
+        first = end;
+        
+        if (coord->lease_guesses < coord->lease_size) {
+            continue;
+        }
+        if ((close_lease(coord) != 0) || (start_lease(coord) != 0)) {
+            fprintf(stderr, "Error allocating memory for a lease\n");
+            return 1;
+        }
+        serve_workers(coord, 0);
+        while (coord->num_leases >= COORD_MAX_LEASES) {
+            serve_workers(coord, 1000);
+        }
+    }
+    return 0;
+}
+
+
+// Hands out the rest of the leases and waits for them to finish
+//
+// Workers are told to exit as they ask for more work. Workers still busy
+// with a lease someone else finished get up to --lease_timeout seconds to
+// ask
+//
+// Function returns 0 if it worked ok, 1 if an error occured
+//
+int coordinator_finish(Coordinator *coord) {
+    
+    if (close_lease(coord) != 0) {
+        fprintf(stderr, "Error allocating memory for a lease\n");
+        return 1;
+    }
+    coord->finishing = 1;
+    give_waiting(coord);
+    
+    while (coord->num_leases > 0) {
+        serve_workers(coord, 1000);
+    }
+    
+    time_t deadline = time(NULL) + coord->timeout;
+    int connected = 1;
+    while ((connected == 1) && (time(NULL) < deadline)) {
+        serve_workers(coord, 1000);
+        connected = 0;
+        for (int i = 0; i < COORD_MAX_WORKERS; i++) {
+            if (coord->workers[i].fd != -1) {
+                connected = 1;
+            }
+        }
+    }
+    return 0;
+}
+
+
+// Closes every connection and frees the coordinator
+//
+void free_coordinator(Coordinator *coord) {
+    
+    for (int i = 0; i < COORD_MAX_WORKERS; i++) {
+        if (coord->workers[i].fd != -1) {
+            close(coord->workers[i].fd);
+        }
+        free(coord->workers[i].out);
+    }
+    if (coord->listen_fd != -1) {
+        close(coord->listen_fd);
+    }
+    if (coord->unix_path != NULL) {
+        unlink(coord->unix_path);
+    }
+    for (int i = 0; i < coord->num_leases; i++) {
+        free(coord->leases[i]->records);
+        free(coord->leases[i]);
+    }
+    if (coord->lease_fp != NULL) {
+        fclose(coord->lease_fp);
+        free(coord->lease_buf);
+    }
+    if (coord->progress_fp != NULL) {
+        fclose(coord->progress_fp);
+    }
+    free_pt_stream(coord->stream);
+    free(coord->header);
+    free(coord->finished);
+    free(coord);
+}
+
+
+// Tells the coordinator the last lease is done, and asks for the next one
+//
+// The lease's records follow the header in fp, which reads from the same
+// socket as fd
+//
+// Function returns 0 if it worked ok, 1 if the connection was lost
+//
+int request_lease(int fd, FILE *fp, uint64_t done, LeaseHeader *header) {
+    LeaseRequest request = {done};
+    if ((send_all(fd, &request, sizeof(request)) != 0) || (fread(header, sizeof(LeaseHeader), 1, fp) != 1)) {
+        fprintf(stderr, "Error, lost the connection to the coordinator\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,197 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Pretty Cool Fuzzy Guesser (PCFG)
+//  --Probabilistic Context Free Grammar (PCFG) Password Guessing Program
+//
+//  Written by Matt Weir
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//
+
+
+
+#ifndef _COORDINATOR_H
+#define _COORDINATOR_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+
+#include "grammar.h"
+#include "pcfg_pqueue.h"
+#include "pt_stream.h"
+#include "socket_io.h"
+
+
+// Default for --lease_size, the number of guesses in each lease
+#define DEFAULT_LEASE_SIZE 100000000ULL
+
+// Default for --lease_timeout in seconds. A lease that isn't finished by
+// then is given to another worker
+#define DEFAULT_LEASE_TIMEOUT 600
+
+// The most leases the coordinator will have made but not seen finished.
+// The queue is paused until one finishes
+#define COORD_MAX_LEASES 64
+
+// The most workers that can be connected at once
+#define COORD_MAX_WORKERS 256
+
+// The first line of a progress file. Followed by the name of the ruleset,
+// the lease size and the hash of the options that change what is in each
+// lease, and then the id of each finished lease on its own line
+#define COORD_PROGRESS_HEADER "#pcfg_guesser progress"
+
+// Set in a lease's flags when there is no more work, and the worker should
+// exit
+#define LEASE_FLAG_DONE 1
+
+
+// Sent by a worker to ask for a lease. done is the id of the lease it just
+// finished plus 1, or 0 for none
+typedef struct LeaseRequest {
+    uint64_t done;
+} LeaseRequest;
+
+
+// Sent by the coordinator in reply to a LeaseRequest, followed by
+// num_records pre-terminal stream records
+typedef struct LeaseHeader {
+    uint64_t id;
+    uint32_t num_records;
+    uint32_t flags;
+} LeaseHeader;
+
+
+// A connected worker
+//
+// Worker sockets are non-blocking, so one slow or stuck worker can't hold
+// up the queue or the other workers. Requests are read, and leases are
+// sent, a piece at a time as the socket is ready
+//
+typedef struct CoordWorker {
+    
+    // -1 if the slot isn't used
+    int fd;
+    
+    // 1 if the worker asked for a lease and there wasn't one to give it
+    int waiting;
+    
+    // 1 if the worker was told there is no more work. It is closed once
+    // that has been sent
+    int closing;
+    
+    // The part of the next request that has been read
+    LeaseRequest request;
+    size_t request_len;
+    
+    // Data waiting to be sent, (the stream header and the leases), and how
+    // much of it has been sent
+    char *out;
+    size_t out_len;
+    size_t out_sent;
+    size_t out_size;
+    
+}CoordWorker;
+
+
+// A range of pre-terminals from the queue, saved as stream records
+typedef struct Lease {
+    
+    uint64_t id;
+    char *records;
+    size_t len;
+    uint32_t num_records;
+    
+    // Worker it was given to, or -1 if it is waiting to be given out
+    int worker;
+    time_t expires;
+    
+}Lease;
+
+
+// Hands out leases on ranges of pre-terminals to workers
+//
+// The queue is run as normal, but each pre-terminal is written to the
+// lease being built instead of being generated. Once a lease has
+// lease_size guesses it is given to the next worker that asks for one.
+// Every worker gets the stream header when it connects so it can check it
+// has loaded the same grammar
+//
+typedef struct Coordinator {
+    
+    int listen_fd;
+    char *unix_path;
+    
+    CoordWorker workers[COORD_MAX_WORKERS];
+    
+    // Leases that haven't been finished, in id order
+    Lease *leases[COORD_MAX_LEASES];
+    int num_leases;
+    
+    // The lease being built
+    PtStream *stream;
+    FILE *lease_fp;
+    char *lease_buf;
+    size_t lease_len;
+    uint32_t lease_records;
+    unsigned long long lease_guesses;
+    unsigned long long lease_size;
+    uint64_t next_id;
+    
+    // Sent to each worker when it connects
+    char *header;
+    size_t header_len;
+    
+    int timeout;
+    
+    // Set once the queue is done and the last lease has been made
+    int finishing;
+    
+    // Ids of the leases finished in an earlier run, in ascending order
+    uint64_t *finished;
+    size_t num_finished;
+    FILE *progress_fp;
+    
+    // Stats
+    unsigned long long issued;
+    unsigned long long reissued;
+    unsigned long long completed;
+    unsigned long long skipped;
+    
+}Coordinator;
+
+
+// Starts listening for workers
+extern Coordinator *create_coordinator(char *address, PcfgGrammar *pcfg, char *rule_name, uint64_t order_hash, unsigned long long lease_size, int timeout, char *progress);
+
+// Adds a pre-terminal, (or part of one), to the lease being built
+extern int coordinator_add_pt(Coordinator *coord, PQItem *pq_item, unsigned long long count, unsigned long long first, unsigned long long last, int can_split);
+
+// Hands out the rest of the leases and waits for them to finish
+extern int coordinator_finish(Coordinator *coord);
+
+// Closes every connection and frees the coordinator
+extern void free_coordinator(Coordinator *coord);
+
+// Asks the coordinator for a lease and reads its header
+extern int request_lease(int fd, FILE *fp, uint64_t done, LeaseHeader *header);
+
+#endif
@@ -0,0 +1,114 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Pretty Cool Fuzzy Guesser (PCFG)
+//  --Probabilistic Context Free Grammar (PCFG) Password Guessing Program
+//
+//  Written by Matt Weir
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//
+
+
+
+#include "coverage.h"
+
+
+// Returns the number of seconds since start
+//
+double elapsed_seconds(struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double) (now.tv_sec - start->tv_sec) + ((double) (now.tv_nsec - start->tv_nsec) / 1e9);
+}
+
+
+// Runs the priority queue without generating any guesses and writes out how
+// much probability is covered by how many guesses
+//
+// Every pre-terminal is popped in order, and its guesses are counted by
+// multiplying the sizes of its groups. Every guess from a pre-terminal has
+// the pre-terminal's probability, so the probability it covers is that times
+// the number of guesses. The curve is written as tab separated
+// guesses, cumulative probability, and elapsed seconds. Points are spaced out
+// logarithmically, and the last point is always written
+//
+// If policy isn't NULL, pre-terminals that can't meet it are skipped. Ones
+// that only partly meet it are still counted in full
+//
+// Stops when the queue is empty, or once limit guesses have been counted
+// if limit is not 0
+//
+// Function returns 0 if it worked ok, 1 if an error occured
+//
+int coverage_curve(priority_queue_t *pq, PcfgGrammar *pcfg, PolicyIndex *policy, unsigned long long limit, FILE *fp) {
+    
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    
+    unsigned long long num_guesses = 0;
+    double coverage = 0.0;
+    
+    // The number of guesses at which the next point is written
+    double next_point = 1.0;
+    
+    // The number of guesses at the last point written
+    unsigned long long last_point = 0;
+    
+    fprintf(fp, "guesses\tprobability\tseconds\n");
+    
+    while (!priority_queue_empty(pq)) {
+        
+        PQItem* pq_item = pcfg_pq_pop(pq);
+        if (pq_item == NULL) {
+            fprintf(stderr, "Memory allocation error when popping item from pqueue\n");
+            return 1;
+        }
+        
+        if ((policy != NULL) && (check_pt_policy(policy, pq_item) == POLICY_FAIL)) {
+            free(pq_item->pt);
+            free(pq_item);
+            continue;
+        }
+        
+        unsigned long long count = pt_guess_count(pcfg, pq_item);
+        if ((limit != 0) && (count > limit - num_guesses)) {
+            count = limit - num_guesses;
+        }
+        coverage += pq_item->prob * (double) count;
+        num_guesses = (count > ULLONG_MAX - num_guesses) ? ULLONG_MAX : num_guesses + count;
+        
+        free(pq_item->pt);
+        free(pq_item);
+        
+        if ((limit != 0) && (num_guesses >= limit)) {
+            break;
+        }
+        
+        if ((double) num_guesses >= next_point) {
+            fprintf(fp, "%llu\t%.10g\t%.3f\n", num_guesses, coverage, elapsed_seconds(&start));
+            last_point = num_guesses;
+            while (next_point <= (double) num_guesses) {
+                next_point *= COVERAGE_STEP;
+            }
+        }
+    }
+    
+    // Finish with the last guess, unless it was already written
+    if ((num_guesses != last_point) || (num_guesses == 0)) {
+        fprintf(fp, "%llu\t%.10g\t%.3f\n", num_guesses, coverage, elapsed_seconds(&start));
+    }
+    return 0;
+}
@@ -0,0 +1,49 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Pretty Cool Fuzzy Guesser (PCFG)
+//  --Probabilistic Context Free Grammar (PCFG) Password Guessing Program
+//
+//  Written by Matt Weir
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//
+
+
+
+#ifndef _COVERAGE_H
+#define _COVERAGE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <time.h>
+
+#include "grammar.h"
+#include "pqueue.h"
+#include "pcfg_pqueue.h"
+#include "policy.h"
+
+
+// How far apart the points on the curve are. A point is written every time
+// the number of guesses goes up by this factor, (20 points per decade)
+#define COVERAGE_STEP 1.122018454
+
+
+// Runs the priority queue without generating any guesses and writes out how
+// much probability is covered by how many guesses
+extern int coverage_curve(priority_queue_t *pq, PcfgGrammar *pcfg, PolicyIndex *policy, unsigned long long limit, FILE *fp);
+
+#endif
@@ -0,0 +1,730 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Pretty Cool Fuzzy Guesser (PCFG)
+//  --Probabilistic Context Free Grammar (PCFG) Password Guessing Program
+//
+//  Written by Matt Weir
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//
+
+
+
+#include "crack.h"
+
+
+// One 32 bit word of a message block or hash state for each lane
+//
+// This uses the GCC vector extension, so the compiler picks the widest
+// SIMD registers the target has, and splits or emulates them otherwise
+//
+typedef uint32_t LaneWord __attribute__((vector_size(CRACK_LANES * sizeof(uint32_t))));
+
+#define LANE_ROTL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+#define HASH_F(b, c, d) (((b) & (c)) | (~(b) & (d)))
+#define HASH_G(b, c, d) (((b) & (c)) | ((b) & (d)) | ((c) & (d)))
+#define HASH_H(b, c, d) ((b) ^ (c) ^ (d))
+#define HASH_MD5_G(b, c, d) (((b) & (d)) | ((c) & ~(d)))
+#define HASH_I(b, c, d) ((c) ^ ((b) | ~(d)))
+
+
+// MD5 constants for each of the 64 steps
+static const uint32_t md5_k[64] = {
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+    0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+    0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+    0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+    0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+    0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391,
+};
+
+static const unsigned char md5_s[64] = {
+    7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+    5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20,
+    4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+    6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21,
+};
+
+// Which word of the block each step uses
+static const unsigned char md5_g[64] = {
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+    1, 6, 11, 0, 5, 10, 15, 4, 9, 14, 3, 8, 13, 2, 7, 12,
+    5, 8, 11, 14, 1, 4, 7, 10, 13, 0, 3, 6, 9, 12, 15, 2,
+    0, 7, 14, 5, 12, 3, 10, 1, 8, 15, 6, 13, 4, 11, 2, 9,
+};
+
+
+// MD4 constants for each of the 48 steps
+static const uint32_t md4_k[3] = {0x00000000, 0x5a827999, 0x6ed9eba1};
+
+static const unsigned char md4_s[48] = {
+    3, 7, 11, 19, 3, 7, 11, 19, 3, 7, 11, 19, 3, 7, 11, 19,
+    3, 5, 9, 13, 3, 5, 9, 13, 3, 5, 9, 13, 3, 5, 9, 13,
+    3, 9, 11, 15, 3, 9, 11, 15, 3, 9, 11, 15, 3, 9, 11, 15,
+};
+
+static const unsigned char md4_g[48] = {
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+    0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15,
+    0, 8, 4, 12, 2, 10, 6, 14, 1, 9, 5, 13, 3, 11, 7, 15,
+};
+
+
+// Starting hash states. MD5 and MD4 use the first four words
+static const uint32_t hash_init[5] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0};
+
+
+// One step of MD5 or MD4 for every lane. The callers rotate the roles of
+// a, b, c and d between steps instead of moving the values
+#define MD5_STEP(f, a, b, c, d, i) \
+    a += f(b, c, d) + md5_k[i] + block[md5_g[i]]; \
+    a = b + LANE_ROTL(a, md5_s[i]);
+
+#define MD4_STEP(f, a, b, c, d, i) \
+    a += f(b, c, d) + md4_k[(i) / 16] + block[md4_g[i]]; \
+    a = LANE_ROTL(a, md4_s[i]);
+
+#define SHA1_STEP(f, k, a, b, c, d, e, t) \
+    e += LANE_ROTL(a, 5) + f(b, c, d) + k + w[t]; \
+    b = LANE_ROTL(b, 30);
+
+
+// Runs one block of MD5 on every lane
+//
+void md5_lanes(LaneWord *state, LaneWord *block) {
+    
+    LaneWord a = state[0];
+    LaneWord b = state[1];
+    LaneWord c = state[2];
+    LaneWord d = state[3];
+    
+    for (int i = 0; i < 16; i += 4) {
+        MD5_STEP(HASH_F, a, b, c, d, i);
+        MD5_STEP(HASH_F, d, a, b, c, i + 1);
+        MD5_STEP(HASH_F, c, d, a, b, i + 2);
+        MD5_STEP(HASH_F, b, c, d, a, i + 3);
+    }
+    for (int i = 16; i < 32; i += 4) {
+        MD5_STEP(HASH_MD5_G, a, b, c, d, i);
+        MD5_STEP(HASH_MD5_G, d, a, b, c, i + 1);
+        MD5_STEP(HASH_MD5_G, c, d, a, b, i + 2);
+        MD5_STEP(HASH_MD5_G, b, c, d, a, i + 3);
+    }
+    for (int i = 32; i < 48; i += 4) {
+        MD5_STEP(HASH_H, a, b, c, d, i);
+        MD5_STEP(HASH_H, d, a, b, c, i + 1);
+        MD5_STEP(HASH_H, c, d, a, b, i + 2);
+        MD5_STEP(HASH_H, b, c, d, a, i + 3);
+    }
+    for (int i = 48; i < 64; i += 4) {
+        MD5_STEP(HASH_I, a, b, c, d, i);
+        MD5_STEP(HASH_I, d, a, b, c, i + 1);
+        MD5_STEP(HASH_I, c, d, a, b, i + 2);
+        MD5_STEP(HASH_I, b, c, d, a, i + 3);
+    }
+    
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+}
+
+
+// Runs one block of MD4 on every lane
+//
+void md4_lanes(LaneWord *state, LaneWord *block) {
+    
+    LaneWord a = state[0];
+    LaneWord b = state[1];
+    LaneWord c = state[2];
+    LaneWord d = state[3];
+    
+    for (int i = 0; i < 16; i += 4) {
+        MD4_STEP(HASH_F, a, b, c, d, i);
+        MD4_STEP(HASH_F, d, a, b, c, i + 1);
+        MD4_STEP(HASH_F, c, d, a, b, i + 2);
+        MD4_STEP(HASH_F, b, c, d, a, i + 3);
+    }
+    for (int i = 16; i < 32; i += 4) {
+        MD4_STEP(HASH_G, a, b, c, d, i);
+        MD4_STEP(HASH_G, d, a, b, c, i + 1);
+        MD4_STEP(HASH_G, c, d, a, b, i + 2);
+        MD4_STEP(HASH_G, b, c, d, a, i + 3);
+    }
+    for (int i = 32; i < 48; i += 4) {
+        MD4_STEP(HASH_H, a, b, c, d, i);
+        MD4_STEP(HASH_H, d, a, b, c, i + 1);
+        MD4_STEP(HASH_H, c, d, a, b, i + 2);
+        MD4_STEP(HASH_H, b, c, d, a, i + 3);
+    }
+    
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+}
+
+
+// Runs one block of SHA1 on every lane
+//
+void sha1_lanes(LaneWord *state, LaneWord *block) {
+    
+    LaneWord w[80];
+    memcpy(w, block, 16 * sizeof(LaneWord));
+    for (int t = 16; t < 80; t++) {
+        LaneWord x = w[t - 3] ^ w[t - 8] ^ w[t - 14] ^ w[t - 16];
+        w[t] = LANE_ROTL(x, 1);
+    }
+    
+    LaneWord a = state[0];
+    LaneWord b = state[1];
+    LaneWord c = state[2];
+    LaneWord d = state[3];
+    LaneWord e = state[4];
+    
+    for (int t = 0; t < 20; t += 5) {
+        SHA1_STEP(HASH_F, 0x5a827999, a, b, c, d, e, t);
+        SHA1_STEP(HASH_F, 0x5a827999, e, a, b, c, d, t + 1);
+        SHA1_STEP(HASH_F, 0x5a827999, d, e, a, b, c, t + 2);
+        SHA1_STEP(HASH_F, 0x5a827999, c, d, e, a, b, t + 3);
+        SHA1_STEP(HASH_F, 0x5a827999, b, c, d, e, a, t + 4);
+    }
+    for (int t = 20; t < 40; t += 5) {
+        SHA1_STEP(HASH_H, 0x6ed9eba1, a, b, c, d, e, t);
+        SHA1_STEP(HASH_H, 0x6ed9eba1, e, a, b, c, d, t + 1);
+        SHA1_STEP(HASH_H, 0x6ed9eba1, d, e, a, b, c, t + 2);
+        SHA1_STEP(HASH_H, 0x6ed9eba1, c, d, e, a, b, t + 3);
+        SHA1_STEP(HASH_H, 0x6ed9eba1, b, c, d, e, a, t + 4);
+    }
+    for (int t = 40; t < 60; t += 5) {
+        SHA1_STEP(HASH_G, 0x8f1bbcdc, a, b, c, d, e, t);
+        SHA1_STEP(HASH_G, 0x8f1bbcdc, e, a, b, c, d, t + 1);
+        SHA1_STEP(HASH_G, 0x8f1bbcdc, d, e, a, b, c, t + 2);
+        SHA1_STEP(HASH_G, 0x8f1bbcdc, c, d, e, a, b, t + 3);
+        SHA1_STEP(HASH_G, 0x8f1bbcdc, b, c, d, e, a, t + 4);
+    }
+    for (int t = 60; t < 80; t += 5) {
+        SHA1_STEP(HASH_H, 0xca62c1d6, a, b, c, d, e, t);
+        SHA1_STEP(HASH_H, 0xca62c1d6, e, a, b, c, d, t + 1);
+        SHA1_STEP(HASH_H, 0xca62c1d6, d, e, a, b, c, t + 2);
+        SHA1_STEP(HASH_H, 0xca62c1d6, c, d, e, a, b, t + 3);
+        SHA1_STEP(HASH_H, 0xca62c1d6, b, c, d, e, a, t + 4);
+    }
+    
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+}
+
+
+// Runs one block of the hash type on every lane
+//
+void hash_lanes(int type, LaneWord *state, LaneWord *block) {
+    if (type == CRACK_MD5) {
+        md5_lanes(state, block);
+    }
+    else if (type == CRACK_NTLM) {
+        md4_lanes(state, block);
+    }
+    else {
+        sha1_lanes(state, block);
+    }
+}
+
+
+// Sets every lane to the starting state of the hash type
+//
+void init_lanes(int type, LaneWord *state) {
+    int num_words = (type == CRACK_SHA1) ? 5 : 4;
+    for (int w = 0; w < num_words; w++) {
+        state[w] = (LaneWord) {0} + hash_init[w];
+    }
+}
+
+
+// Reads the n'th 32 bit word of a block. SHA1 reads the words big endian,
+// MD5 and MD4 read them little endian
+//
+static inline uint32_t block_word(int type, const unsigned char *bytes, int n) {
+    uint32_t x;
+    memcpy(&x, bytes + n * 4, sizeof(x));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    return (type == CRACK_SHA1) ? x : __builtin_bswap32(x);
+#else
+    return (type == CRACK_SHA1) ? __builtin_bswap32(x) : x;
+#endif
+}
+
+
+// Loads a 64 byte block for each lane
+//
+// Each word is gathered across the lanes in a plain array first, so it
+// goes into the vector with one load instead of one insert per lane
+//
+void load_lanes(int type, LaneWord *block, unsigned char bytes[][64]) {
+    for (int w = 0; w < 16; w++) {
+        uint32_t words[CRACK_LANES];
+        for (int l = 0; l < CRACK_LANES; l++) {
+            words[l] = block_word(type, bytes[l], w);
+        }
+        memcpy(&block[w], words, sizeof(LaneWord));
+    }
+}
+
+
+// Writes out the digest of each lane
+//
+void lane_digests(int type, LaneWord *state, unsigned char digests[][CRACK_MAX_DIGEST]) {
+    int num_words = (type == CRACK_SHA1) ? 5 : 4;
+    for (int w = 0; w < num_words; w++) {
+        uint32_t words[CRACK_LANES];
+        memcpy(words, &state[w], sizeof(LaneWord));
+        for (int l = 0; l < CRACK_LANES; l++) {
+            uint32_t x = words[l];
+            unsigned char *p = digests[l] + w * 4;
+            if (type == CRACK_SHA1) {
+                p[0] = x >> 24;
+                p[1] = x >> 16;
+                p[2] = x >> 8;
+                p[3] = x;
+            }
+            else {
+                p[0] = x;
+                p[1] = x >> 8;
+                p[2] = x >> 16;
+                p[3] = x >> 24;
+            }
+        }
+    }
+}
+
+
+// Converts a guess to the bytes that are actually hashed
+//
+// NTLM hashes the UTF-16LE encoding of the password, so UTF-8 sequences are
+// decoded first. Bytes that aren't valid UTF-8 are taken as Latin-1, which
+// is what a guess made from a Latin-1 training set means. The other types
+// hash the guess as is
+//
+// Returns the number of bytes in message. message needs room for 2 * len
+// bytes
+//
+int hash_message(int type, const char *guess, int len, unsigned char *message) {
+    
+    if (type != CRACK_NTLM) {
+        memcpy(message, guess, len);
+        return len;
+    }
+    
+    const unsigned char *s = (const unsigned char *) guess;
+    int size = 0;
+    for (int i = 0; i < len; ) {
+        uint32_t code = s[i];
+        int extra = 0;
+        if ((s[i] >= 0xc2) && (s[i] <= 0xdf)) {
+            code = s[i] & 0x1f;
+            extra = 1;
+        }
+        else if ((s[i] >= 0xe0) && (s[i] <= 0xef)) {
+            code = s[i] & 0x0f;
+            extra = 2;
+        }
+        else if ((s[i] >= 0xf0) && (s[i] <= 0xf4)) {
+            code = s[i] & 0x07;
+            extra = 3;
+        }
+        
+        int valid = (i + extra < len);
+        for (int j = 1; (j <= extra) && valid; j++) {
+            valid = ((s[i + j] & 0xc0) == 0x80);
+            code = (code << 6) | (s[i + j] & 0x3f);
+        }
+        if ((extra == 0) || (valid == 0) || (code > 0x10ffff) || ((code >= 0xd800) && (code <= 0xdfff)) || ((extra == 2) && (code < 0x800)) || ((extra == 3) && (code < 0x10000))) {
+            code = s[i];
+            extra = 0;
+        }
+        i += extra + 1;
+        
+        if (code >= 0x10000) {
+            code -= 0x10000;
+            uint32_t high = 0xd800 + (code >> 10);
+            uint32_t low = 0xdc00 + (code & 0x3ff);
+            message[size++] = high;
+            message[size++] = high >> 8;
+            message[size++] = low;
+            message[size++] = low >> 8;
+        }
+        else {
+            message[size++] = code;
+            message[size++] = code >> 8;
+        }
+    }
+    return size;
+}
+
+
+// Pads a message out to a whole number of 64 byte blocks
+//
+// Returns the number of blocks. padded needs room for len + 72 bytes
+//
+int pad_message(int type, const unsigned char *message, int len, unsigned char *padded) {
+    
+    int num_blocks = (len + 8) / 64 + 1;
+    memcpy(padded, message, len);
+    memset(padded + len, 0, num_blocks * 64 - len);
+    padded[len] = 0x80;
+    
+    uint64_t bits = (uint64_t) len * 8;
+    unsigned char *end = padded + num_blocks * 64 - 8;
+    for (int i = 0; i < 8; i++) {
+        if (type == CRACK_SHA1) {
+            end[7 - i] = bits >> (i * 8);
+        }
+        else {
+            end[i] = bits >> (i * 8);
+        }
+    }
+    return num_blocks;
+}
+
+
+// Pads a message that fits in one block. The rest of the block must already
+// be zero
+//
+void pad_block(int type, unsigned char *block, int len) {
+    block[len] = 0x80;
+    uint64_t bits = (uint64_t) len * 8;
+    for (int i = 0; i < 8; i++) {
+        if (type == CRACK_SHA1) {
+            block[63 - i] = bits >> (i * 8);
+        }
+        else {
+            block[56 + i] = bits >> (i * 8);
+        }
+    }
+}
+
+
+// Hashes a guess with the hash type, one guess at a time
+//
+// This is used for guesses too long to fit in a single block. The batches
+// hash everything else
+//
+void crack_hash(int type, const char *guess, int len, unsigned char *digest) {
+    
+    unsigned char message[MAX_GUESS_SIZE * 2];
+    unsigned char padded[MAX_GUESS_SIZE * 2 + 72];
+    int message_len = hash_message(type, guess, len, message);
+    int num_blocks = pad_message(type, message, message_len, padded);
+    
+    LaneWord state[5];
+    LaneWord block[16];
+    unsigned char bytes[CRACK_LANES][64];
+    unsigned char digests[CRACK_LANES][CRACK_MAX_DIGEST];
+    memset(bytes, 0, sizeof(bytes));
+    init_lanes(type, state);
+    for (int b = 0; b < num_blocks; b++) {
+        memcpy(bytes[0], padded + b * 64, 64);
+        load_lanes(type, block, bytes);
+        hash_lanes(type, state, block);
+    }
+    lane_digests(type, state, digests);
+    memcpy(digest, digests[0], (type == CRACK_SHA1) ? 20 : 16);
+}
+
+
+// Parses the name of a hash type for --hash_type
+//
+// Returns the CRACK_* type, or 0 if the name isn't known
+//
+int parse_hash_type(char *arg) {
+    const char *names[] = CRACK_TYPE_NAMES;
+    for (int type = CRACK_MD5; type <= CRACK_SHA1; type++) {
+        if (strcasecmp(arg, names[type]) == 0) {
+            return type;
+        }
+    }
+    return 0;
+}
+
+
+// Returns the table slot a digest goes in, or the empty slot where it
+// would go if it isn't in the table
+//
+static inline uint64_t find_slot(CrackSet *set, const unsigned char *digest) {
+    
+    uint64_t prefix;
+    memcpy(&prefix, digest, sizeof(prefix));
+    
+    uint64_t pos = prefix & set->mask;
+    while (set->slots[pos].index != 0) {
+        if ((set->slots[pos].prefix == prefix) && (memcmp(set->digests + (size_t) (set->slots[pos].index - 1) * set->digest_len, digest, set->digest_len) == 0)) {
+            break;
+        }
+        pos = (pos + 1) & set->mask;
+    }
+    return pos;
+}
+
+
+// Converts a hex digit to its value. Returns -1 if it isn't one
+//
+static int hex_value(char c) {
+    if ((c >= '0') && (c <= '9')) {
+        return c - '0';
+    }
+    c = tolower(c);
+    if ((c >= 'a') && (c <= 'f')) {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+
+// Loads a list of hex digests to crack, one per line
+//
+// Lines that aren't a digest of the right length are skipped, and the
+// number of them is printed. Repeated digests are only stored once.
+// Cracked hashes are written to out
+//
+// Returns NULL if the file can't be read or memory couldn't be allocated
+//
+CrackSet *load_crack_set(char *filename, int type, FILE *out) {
+    
+    FILE *fp = fopen(filename, "r");
+    if (fp == NULL) {
+        fprintf(stderr, "Error opening the hash list %s\n", filename);
+        return NULL;
+    }
+    
+    CrackSet *set = calloc(1, sizeof(CrackSet));
+    if (set == NULL) {
+        fprintf(stderr, "Error allocating memory for the hash list\n");
+        fclose(fp);
+        return NULL;
+    }
+    set->type = type;
+    set->digest_len = (type == CRACK_SHA1) ? 20 : 16;
+    set->out = out;
+    pthread_mutex_init(&set->lock, NULL);
+    
+    // Count the lines first so the table can be sized once
+    size_t num_lines = 0;
+    char *line = NULL;
+    size_t line_size = 0;
+    while (getline(&line, &line_size, fp) != -1) {
+        num_lines++;
+    }
+    rewind(fp);
+    
+    uint64_t table_size = 16;
+    while (table_size < num_lines * 2) {
+        table_size *= 2;
+    }
+    set->mask = table_size - 1;
+    set->slots = calloc(table_size, sizeof(CrackSlot));
+    set->digests = malloc(num_lines * set->digest_len + 1);
+    set->cracked = calloc(num_lines + 1, 1);
+    if ((set->slots == NULL) || (set->digests == NULL) || (set->cracked == NULL)) {
+        fprintf(stderr, "Error allocating memory for the hash list\n");
+        free(line);
+        fclose(fp);
+        free_crack_set(set);
+        return NULL;
+    }
+    
+    size_t num_skipped = 0;
+    ssize_t line_len;
+    while ((line_len = getline(&line, &line_size, fp)) != -1) {
+        while ((line_len > 0) && isspace((unsigned char) line[line_len - 1])) {
+            line_len--;
+        }
+        
+        unsigned char *digest = set->digests + (size_t) set->count * set->digest_len;
+        int valid = (line_len == set->digest_len * 2);
+        for (int i = 0; (i < set->digest_len) && valid; i++) {
+            int high = hex_value(line[i * 2]);
+            int low = hex_value(line[i * 2 + 1]);
+            valid = ((high != -1) && (low != -1));
+            digest[i] = (high << 4) | low;
+        }
+        if (valid == 0) {
+            if (line_len != 0) {
+                num_skipped++;
+            }
+            continue;
+        }
+        
+        uint64_t pos = find_slot(set, digest);
+        if (set->slots[pos].index == 0) {
+            memcpy(&set->slots[pos].prefix, digest, sizeof(uint64_t));
+            set->count++;
+            set->slots[pos].index = set->count;
+        }
+    }
+    free(line);
+    fclose(fp);
+    
+    if (num_skipped != 0) {
+        fprintf(stderr, "Skipped %zu lines in %s that aren't a valid hash\n", num_skipped, filename);
+    }
+    if (set->count == 0) {
+        fprintf(stderr, "Error, %s doesn't have any hashes to crack\n", filename);
+        free_crack_set(set);
+        return NULL;
+    }
+    return set;
+}
+
+
+// Adds a guess to a batch. guess_len includes the trailing newline
+//
+// Returns 1 if the batch is now full and should be run
+//
+int crack_batch_add(CrackBatch *batch, char *guess, int guess_len) {
+    int i = batch->count++;
+    memcpy(batch->guesses[i], guess, guess_len - 1);
+    batch->lens[i] = guess_len - 1;
+    return (batch->count == CRACK_BATCH_SIZE);
+}
+
+
+// Writes out a cracked hash, unless an earlier guess already cracked it
+//
+static void report_crack(CrackSet *set, uint32_t index, char *guess, int len) {
+    
+    pthread_mutex_lock(&set->lock);
+    if (set->cracked[index] == 0) {
+        set->cracked[index] = 1;
+        __atomic_add_fetch(&set->num_cracked, 1, __ATOMIC_RELAXED);
+        
+        const unsigned char *digest = set->digests + (size_t) index * set->digest_len;
+        for (int i = 0; i < set->digest_len; i++) {
+            fprintf(set->out, "%02x", digest[i]);
+        }
+        fputc(':', set->out);
+        fwrite(guess, 1, len, set->out);
+        fputc('\n', set->out);
+        fflush(set->out);
+    }
+    pthread_mutex_unlock(&set->lock);
+}
+
+
+// Hashes every guess in a batch and writes out the ones that crack a hash
+//
+// Guesses that fit in one block are hashed CRACK_LANES at a time. Then the
+// table slots for the whole batch are prefetched before any of them are
+// looked up, so the cache misses overlap
+//
+// The session only checks if everything is cracked between pre-terminals,
+// so once it is, batches from the rest of a big pre-terminal are dropped
+// here without hashing them
+//
+void crack_batch_run(CrackSet *set, CrackBatch *batch) {
+    
+    if (crack_done(set)) {
+        batch->count = 0;
+        return;
+    }
+    
+    unsigned char digests[CRACK_BATCH_SIZE][CRACK_MAX_DIGEST];
+    unsigned char bytes[CRACK_LANES][64];
+    LaneWord state[5];
+    LaneWord block[16];
+    
+    for (int first = 0; first < batch->count; first += CRACK_LANES) {
+        
+        int num_lanes = (batch->count - first < CRACK_LANES) ? batch->count - first : CRACK_LANES;
+        unsigned char single[CRACK_LANES];
+        memset(bytes, 0, sizeof(bytes));
+        for (int l = 0; l < num_lanes; l++) {
+            int i = first + l;
+            single[l] = (batch->lens[i] * ((set->type == CRACK_NTLM) ? 2 : 1) <= 55);
+            if (single[l] == 1) {
+                int message_len = hash_message(set->type, batch->guesses[i], batch->lens[i], bytes[l]);
+                pad_block(set->type, bytes[l], message_len);
+            }
+            else {
+                crack_hash(set->type, batch->guesses[i], batch->lens[i], digests[i]);
+            }
+        }
+        
+        init_lanes(set->type, state);
+        load_lanes(set->type, block, bytes);
+        hash_lanes(set->type, state, block);
+        
+        // Guesses that were hashed one at a time keep their digests
+        unsigned char lane_digest[CRACK_LANES][CRACK_MAX_DIGEST];
+        lane_digests(set->type, state, lane_digest);
+        for (int l = 0; l < num_lanes; l++) {
+            if (single[l] == 1) {
+                memcpy(digests[first + l], lane_digest[l], set->digest_len);
+            }
+        }
+    }
+    
+    for (int i = 0; i < batch->count; i++) {
+        uint64_t prefix;
+        memcpy(&prefix, digests[i], sizeof(prefix));
+        __builtin_prefetch(&set->slots[prefix & set->mask]);
+    }
+    
+    for (int i = 0; i < batch->count; i++) {
+        uint64_t pos = find_slot(set, digests[i]);
+        if (set->slots[pos].index != 0) {
+            report_crack(set, set->slots[pos].index - 1, batch->guesses[i], batch->lens[i]);
+        }
+    }
+    
+    __atomic_fetch_add(&set->hashed, batch->count, __ATOMIC_RELAXED);
+    batch->count = 0;
+}
+
+
+// Returns 1 if every hash in the set has been cracked
+//
+int crack_done(CrackSet *set) {
+    return (__atomic_load_n(&set->num_cracked, __ATOMIC_RELAXED) == set->count);
+}
+
+
+// Prints how many hashes have been cracked so far to stderr
+//
+void print_crack_status(CrackSet *set) {
+    uint32_t num_cracked = __atomic_load_n(&set->num_cracked, __ATOMIC_RELAXED);
+    unsigned long long hashed = __atomic_load_n(&set->hashed, __ATOMIC_RELAXED);
+    fprintf(stderr, "Cracked %u of %u hashes (%.2f%%), %llu guesses hashed\n", num_cracked, set->count, 100.0 * num_cracked / set->count, hashed);
+}
+
+
+// Frees the set
+//
+void free_crack_set(CrackSet *set) {
+    if (set == NULL) {
+        return;
+    }
+    pthread_mutex_destroy(&set->lock);
+    free(set->slots);
+    free(set->digests);
+    free(set->cracked);
+    free(set);
+}
@@ -0,0 +1,131 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Pretty Cool Fuzzy Guesser (PCFG)
+//  --Probabilistic Context Free Grammar (PCFG) Password Guessing Program
+//
+//  Written by Matt Weir
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//
+
+
+
+#ifndef _CRACK_H
+#define _CRACK_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <strings.h>
+#include <pthread.h>
+
+#include "global_def.h"
+
+
+// The hash types that --crack supports
+#define CRACK_MD5 1
+#define CRACK_NTLM 2
+#define CRACK_SHA1 3
+
+// Names for --hash_type, indexed by the CRACK_* type
+#define CRACK_TYPE_NAMES {NULL, "md5", "ntlm", "sha1"}
+
+// Longest digest of any of the supported types
+#define CRACK_MAX_DIGEST 20
+
+// Number of guesses hashed side by side, one per SIMD lane
+#define CRACK_LANES 8
+
+// The number of guesses that are hashed before any of them are looked up
+#define CRACK_BATCH_SIZE 64
+
+// Seconds between status lines while cracking
+#define CRACK_STATUS_INTERVAL 10
+
+
+// A slot in the open addressed hash table. index is the position of the
+// digest in the hash list plus one, so 0 is an empty slot
+typedef struct CrackSlot {
+    uint64_t prefix;
+    uint32_t index;
+}CrackSlot;
+
+
+// The hash list being cracked
+//
+// The digests are evenly spread out already, so the first 8 bytes of a
+// digest are used to place it in the table
+//
+typedef struct CrackSet {
+    
+    int type;
+    int digest_len;
+    
+    // The unique digests from the hash list
+    unsigned char *digests;
+    unsigned char *cracked;
+    uint32_t count;
+    
+    // Linear probing table of the digests
+    CrackSlot *slots;
+    uint64_t mask;
+    
+    // Where cracked hashes are written, "hash:password"
+    FILE *out;
+    pthread_mutex_t lock;
+    
+    // Stats. num_cracked is only changed while holding lock
+    uint32_t num_cracked;
+    unsigned long long hashed;
+    
+}CrackSet;
+
+
+// Guesses waiting to be hashed
+typedef struct CrackBatch {
+    int count;
+    int lens[CRACK_BATCH_SIZE];
+    char guesses[CRACK_BATCH_SIZE][MAX_GUESS_SIZE + 1];
+}CrackBatch;
+
+
+// Parses the name of a hash type. Returns the CRACK_* type or 0
+extern int parse_hash_type(char *arg);
+
+// Loads a list of hex digests to crack
+extern CrackSet *load_crack_set(char *filename, int type, FILE *out);
+
+// Hashes a guess with the set's hash type
+extern void crack_hash(int type, const char *guess, int len, unsigned char *digest);
+
+// Adds a guess to a batch. Returns 1 if the batch is now full
+extern int crack_batch_add(CrackBatch *batch, char *guess, int guess_len);
+
+// Hashes every guess in a batch and writes out the ones that crack a hash
+extern void crack_batch_run(CrackSet *set, CrackBatch *batch);
+
+// Returns 1 if every hash in the set has been cracked
+extern int crack_done(CrackSet *set);
+
+// Prints how many hashes have been cracked so far
+extern void print_crack_status(CrackSet *set);
+
+// Frees the set
+extern void free_crack_set(CrackSet *set);
+
+#endif
@@ -0,0 +1,143 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Pretty Cool Fuzzy Guesser (PCFG)
+//  --Probabilistic Context Free Grammar (PCFG) Password Guessing Program
+//
+//  Written by Matt Weir
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//
+
+
+
+#include "dedupe.h"
+
+
+// Creates a filter that uses bytes of memory
+//
+// The number of bits set per guess and the number of guesses the filter can
+// hold are picked to keep the false positive rate at fp_rate
+//
+// Returns NULL if the memory couldn't be allocated
+//
+DedupeFilter *dedupe_create(size_t bytes, double fp_rate) {
+    
+    DedupeFilter *filter = malloc(sizeof(DedupeFilter));
+    if (filter == NULL) {
+        return NULL;
+    }
+    
+    filter->num_blocks = bytes / (DEDUPE_BLOCK_WORDS * sizeof(uint64_t));
+    if (filter->num_blocks == 0) {
+        filter->num_blocks = 1;
+    }
+    if (posix_memalign((void **) &filter->blocks, 64, filter->num_blocks * DEDUPE_BLOCK_WORDS * sizeof(uint64_t)) != 0) {
+        free(filter);
+        return NULL;
+    }
+    memset(filter->blocks, 0, filter->num_blocks * DEDUPE_BLOCK_WORDS * sizeof(uint64_t));
+    
+    // The standard Bloom filter sizing. Blocking makes the bits a little
+    // less evenly spread, so hold back some of the capacity for that
+    filter->num_hashes = (int) round(-log2(fp_rate));
+    if (filter->num_hashes < DEDUPE_MIN_HASHES) {
+        filter->num_hashes = DEDUPE_MIN_HASHES;
+    }
+    if (filter->num_hashes > DEDUPE_MAX_HASHES) {
+        filter->num_hashes = DEDUPE_MAX_HASHES;
+    }
+    double total_bits = (double) filter->num_blocks * DEDUPE_BLOCK_BITS;
+    filter->capacity = (unsigned long long) (0.8 * total_bits * M_LN2 * M_LN2 / -log(fp_rate));
+    if (filter->capacity == 0) {
+        filter->capacity = 1;
+    }
+    
+    filter->added = 0;
+    filter->suppressed = 0;
+    filter->resets = 0;
+    return filter;
+}
+
+
+// Returns 1 if the guess has already been seen, otherwise adds it and
+// returns 0
+//
+// A false positive returns 1 for a guess that hasn't been seen, so about
+// fp_rate of the unique guesses are dropped as well
+//
+// Safe to call from multiple threads at once without locking. The worst a
+// race can do is let a duplicate through. The thread that fills the filter
+// up clears it. Clearing only ever unsets bits, so guesses being checked at
+// the same time can't be dropped because of it
+//
+int dedupe_check(DedupeFilter *filter, const char *guess, int guess_len) {
+    
+    uint64_t hash = guess_hash(guess, guess_len);
+    
+    // The high bits pick the block. The bits in the block are picked 9 bits
+    // at a time from the hash, mixing it again whenever it runs out. Double
+    // hashing is not used since in a block this small it makes guesses pick
+    // overlapping bits far more often
+    uint64_t *block = filter->blocks + (((hash >> 32) * filter->num_blocks) >> 32) * DEDUPE_BLOCK_WORDS;
+    uint64_t masks[DEDUPE_BLOCK_WORDS] = {0};
+    uint64_t bit_hash = 0;
+    for (int i = 0; i < filter->num_hashes; i++) {
+        if (i % 7 == 0) {
+            bit_hash = hash + (i * 0x9E3779B97F4A7C15ULL);
+            bit_hash = (bit_hash ^ (bit_hash >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            bit_hash = (bit_hash ^ (bit_hash >> 27)) * 0x94D049BB133111EBULL;
+            bit_hash ^= bit_hash >> 31;
+        }
+        uint32_t bit = bit_hash % DEDUPE_BLOCK_BITS;
+        bit_hash >>= 9;
+        masks[bit / 64] |= 1ULL << (bit % 64);
+    }
+    
+    // Only words that are missing bits are written. This is a load and a
+    // store rather than a locked OR, so two threads writing the same word
+    // at once can lose one of their bits. That can only let a duplicate
+    // through, it doesn't add any false positives
+    int seen = 1;
+    for (int i = 0; i < DEDUPE_BLOCK_WORDS; i++) {
+        uint64_t word = __atomic_load_n(&block[i], __ATOMIC_RELAXED);
+        if ((word & masks[i]) != masks[i]) {
+            __atomic_store_n(&block[i], word | masks[i], __ATOMIC_RELAXED);
+            seen = 0;
+        }
+    }
+    
+    if (seen == 1) {
+        __atomic_fetch_add(&filter->suppressed, 1, __ATOMIC_RELAXED);
+        return 1;
+    }
+    
+    if (__atomic_add_fetch(&filter->added, 1, __ATOMIC_RELAXED) == filter->capacity) {
+        memset(filter->blocks, 0, filter->num_blocks * DEDUPE_BLOCK_WORDS * sizeof(uint64_t));
+        __atomic_store_n(&filter->added, 0, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&filter->resets, 1, __ATOMIC_RELAXED);
+    }
+    return 0;
+}
+
+
+// Frees the filter
+//
+void dedupe_free(DedupeFilter *filter) {
+    if (filter != NULL) {
+        free(filter->blocks);
+        free(filter);
+    }
+}
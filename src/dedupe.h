@@ -0,0 +1,109 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Pretty Cool Fuzzy Guesser (PCFG)
+//  --Probabilistic Context Free Grammar (PCFG) Password Guessing Program
+//
+//  Written by Matt Weir
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//
+
+
+
+#ifndef _DEDUPE_H
+#define _DEDUPE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+
+// Each block of the filter is one 64 byte cache line, so checking a guess
+// only touches one line of memory
+#define DEDUPE_BLOCK_WORDS 8
+#define DEDUPE_BLOCK_BITS (DEDUPE_BLOCK_WORDS * 64)
+
+// Limits on the number of bits set per guess
+#define DEDUPE_MIN_HASHES 1
+#define DEDUPE_MAX_HASHES 16
+
+// Default false positive rate for --dedupe
+#define DEFAULT_DEDUPE_FP_RATE 0.0001
+
+
+// Blocked Bloom filter of the guesses that have been output
+//
+// Duplicates are found by checking if every bit for the guess is already set.
+// A false positive drops a guess that wasn't a duplicate, so once the filter
+// has as many guesses in it as it can hold at the target false positive
+// rate, it is cleared and starts over. That keeps the memory and the false
+// positive rate fixed, at the cost of missing duplicates that are far apart
+//
+typedef struct DedupeFilter {
+    
+    uint64_t *blocks;
+    size_t num_blocks;
+    
+    // The number of bits set for each guess
+    int num_hashes;
+    
+    // How many guesses can be added before the filter is cleared, and how
+    // many have been added since it was last cleared
+    unsigned long long capacity;
+    unsigned long long added;
+    
+    // Stats
+    unsigned long long suppressed;
+    unsigned long long resets;
+    
+}DedupeFilter;
+
+
+// Hashes a guess. Also used for the fingerprints in --exclude files, so
+// changing it means those need to be rebuilt
+//
+static inline uint64_t guess_hash(const char *guess, int guess_len) {
+    
+    uint64_t hash = 0x9E3779B97F4A7C15ULL ^ (uint64_t) guess_len;
+    int pos = 0;
+    for (; pos + 8 <= guess_len; pos += 8) {
+        uint64_t word;
+        memcpy(&word, guess + pos, 8);
+        hash = (hash ^ word) * 0xBF58476D1CE4E5B9ULL;
+        hash ^= hash >> 31;
+    }
+    uint64_t last = 0;
+    memcpy(&last, guess + pos, guess_len - pos);
+    hash = (hash ^ last) * 0x94D049BB133111EBULL;
+    hash ^= hash >> 29;
+    hash *= 0xBF58476D1CE4E5B9ULL;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+
+// Creates a filter that uses bytes of memory
+extern DedupeFilter *dedupe_create(size_t bytes, double fp_rate);
+
+// Returns 1 if the guess has already been seen, otherwise adds it and returns 0
+extern int dedupe_check(DedupeFilter *filter, const char *guess, int guess_len);
+
+// Frees the filter
+extern void dedupe_free(DedupeFilter *filter);
+
+#endif
@@ -0,0 +1,285 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Pretty Cool Fuzzy Guesser (PCFG)
+//  --Probabilistic Context Free Grammar (PCFG) Password Guessing Program
+//
+//  Written by Matt Weir
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//
+
+
+
+#include "evaluate.h"
+
+
+// Returns the table slot a password goes in, or the empty slot where it
+// would go if it isn't in the table
+//
+static inline uint64_t find_eval_slot(EvalSet *set, uint64_t hash, const char *password, int len) {
+    uint64_t pos = hash & set->mask;
+    while (set->slots[pos].index != 0) {
+        if (set->slots[pos].hash == hash) {
+            EvalEntry *entry = &set->entries[set->slots[pos].index - 1];
+            if ((entry->len == len) && (memcmp(set->text + entry->offset, password, len) == 0)) {
+                break;
+            }
+        }
+        pos = (pos + 1) & set->mask;
+    }
+    return pos;
+}
+
+
+// Loads a test set of plaintext passwords, one per line
+//
+// Line endings, (\n or \r\n), are not part of the password. Repeated
+// passwords are stored once, with the number of times they were seen, so
+// the curve counts every account in the test set
+//
+// Returns NULL if the file can't be read or memory couldn't be allocated
+//
+EvalSet *load_eval_set(char *filename) {
+    
+    FILE *fp = fopen(filename, "r");
+    if (fp == NULL) {
+        fprintf(stderr, "Error opening the test set %s\n", filename);
+        return NULL;
+    }
+    
+    EvalSet *set = calloc(1, sizeof(EvalSet));
+    if (set == NULL) {
+        fprintf(stderr, "Error allocating memory for the test set\n");
+        fclose(fp);
+        return NULL;
+    }
+    
+    // Count the lines first so the table can be sized once
+    size_t num_lines = 0;
+    size_t text_size = 0;
+    char *line = NULL;
+    size_t line_size = 0;
+    ssize_t line_len;
+    while ((line_len = getline(&line, &line_size, fp)) != -1) {
+        num_lines++;
+        text_size += line_len;
+    }
+    rewind(fp);
+    
+    uint64_t table_size = 16;
+    while (table_size < num_lines * 2) {
+        table_size *= 2;
+    }
+    set->mask = table_size - 1;
+    set->slots = calloc(table_size, sizeof(EvalSlot));
+    set->entries = malloc((num_lines + 1) * sizeof(EvalEntry));
+    set->text = malloc(text_size + 1);
+    if ((set->slots == NULL) || (set->entries == NULL) || (set->text == NULL)) {
+        fprintf(stderr, "Error allocating memory for the test set\n");
+        free(line);
+        fclose(fp);
+        free_eval_set(set);
+        return NULL;
+    }
+    
+    size_t text_len = 0;
+    while ((line_len = getline(&line, &line_size, fp)) != -1) {
+        while ((line_len > 0) && ((line[line_len - 1] == '\n') || (line[line_len - 1] == '\r'))) {
+            line_len--;
+        }
+        if (line_len == 0) {
+            continue;
+        }
+        set->total++;
+        
+        uint64_t hash = guess_hash(line, line_len);
+        uint64_t pos = find_eval_slot(set, hash, line, line_len);
+        if (set->slots[pos].index != 0) {
+            set->entries[set->slots[pos].index - 1].multiplicity++;
+            continue;
+        }
+        
+        EvalEntry *entry = &set->entries[set->count];
+        entry->offset = text_len;
+        entry->len = line_len;
+        entry->multiplicity = 1;
+        entry->found_at = 0;
+        memcpy(set->text + text_len, line, line_len);
+        text_len += line_len;
+        
+        set->count++;
+        set->slots[pos].hash = hash;
+        set->slots[pos].index = set->count;
+    }
+    free(line);
+    fclose(fp);
+    
+    if (set->count == 0) {
+        fprintf(stderr, "Error, the test set %s is empty\n", filename);
+        free_eval_set(set);
+        return NULL;
+    }
+    return set;
+}
+
+
+// Checks a guess against the test set. guess_len includes the trailing
+// newline
+//
+// This only reads the set, so threads can check guesses at the same time.
+// A hit on a password that hasn't been found yet is recorded in hits, and
+// is given its guess number later by eval_resolve()
+//
+// Function returns 0 if it worked ok, 1 if memory couldn't be allocated
+//
+int eval_check(EvalSet *set, EvalHits *hits, char *guess, int guess_len) {
+    
+    hits->guesses++;
+    
+    uint64_t pos = find_eval_slot(set, guess_hash(guess, guess_len - 1), guess, guess_len - 1);
+    uint32_t index = set->slots[pos].index;
+    if ((index == 0) || (set->entries[index - 1].found_at != 0)) {
+        return 0;
+    }
+    
+    if (hits->count == hits->size) {
+        size_t new_size = (hits->size == 0) ? 256 : hits->size * 2;
+        EvalHit *resized = realloc(hits->hits, new_size * sizeof(EvalHit));
+        if (resized == NULL) {
+            fprintf(stderr, "Error allocating memory for test set hits\n");
+            return 1;
+        }
+        hits->hits = resized;
+        hits->size = new_size;
+    }
+    hits->hits[hits->count].entry = index - 1;
+    hits->hits[hits->count].ordinal = hits->guesses;
+    hits->count++;
+    return 0;
+}
+
+
+// Gives the recorded hits their guess numbers and adds the guesses they
+// were checked against to the session's total
+//
+// Threads have to be resolved one at a time in the order their guesses
+// come in, so the guess numbers match a single threaded run
+//
+void eval_resolve(EvalSet *set, EvalHits *hits) {
+    
+    for (size_t i = 0; i < hits->count; i++) {
+        EvalEntry *entry = &set->entries[hits->hits[i].entry];
+        if (entry->found_at == 0) {
+            entry->found_at = set->guesses + hits->hits[i].ordinal;
+            set->num_found++;
+            set->num_cracked += entry->multiplicity;
+        }
+    }
+    set->guesses += hits->guesses;
+    hits->guesses = 0;
+    hits->count = 0;
+}
+
+
+// Returns 1 if every password in the test set has been found
+//
+int eval_done(EvalSet *set) {
+    return (set->num_found == set->count);
+}
+
+
+// Sorts found entries by the guess number they were found at
+//
+int compare_found_at(const void *a, const void *b) {
+    unsigned long long found_a = (*(EvalEntry * const *) a)->found_at;
+    unsigned long long found_b = (*(EvalEntry * const *) b)->found_at;
+    return (found_a > found_b) - (found_a < found_b);
+}
+
+
+// Writes out the cracked versus guesses curve
+//
+// The curve is tab separated guesses, passwords cracked, and the percent of
+// the test set that is. Like the coverage curve, points are spaced out
+// logarithmically, and the last point is always written
+//
+void eval_write_curve(EvalSet *set, FILE *fp) {
+    
+    fprintf(fp, "guesses\tcracked\tpercent\n");
+    
+    EvalEntry **found = malloc((set->num_found + 1) * sizeof(EvalEntry *));
+    if (found == NULL) {
+        fprintf(stderr, "Error allocating memory to sort the test set\n");
+        return;
+    }
+    uint32_t num_found = 0;
+    for (uint32_t i = 0; i < set->count; i++) {
+        if (set->entries[i].found_at != 0) {
+            found[num_found++] = &set->entries[i];
+        }
+    }
+    qsort(found, num_found, sizeof(EvalEntry *), compare_found_at);
+    
+    unsigned long long cracked = 0;
+    double next_point = 1.0;
+    unsigned long long last_point = 0;
+    for (uint32_t i = 0; i < num_found; i++) {
+        cracked += found[i]->multiplicity;
+        if ((double) found[i]->found_at >= next_point) {
+            fprintf(fp, "%llu\t%llu\t%.4f\n", found[i]->found_at, cracked, 100.0 * cracked / set->total);
+            last_point = found[i]->found_at;
+            while (next_point <= (double) found[i]->found_at) {
+                next_point *= COVERAGE_STEP;
+            }
+        }
+    }
+    
+    // Don't write the last point twice if the session ended on a hit
+    if ((set->guesses != last_point) || (last_point == 0)) {
+        fprintf(fp, "%llu\t%llu\t%.4f\n", set->guesses, cracked, 100.0 * cracked / set->total);
+    }
+    free(found);
+}
+
+
+// Writes out each unique test password with the guess number it was found
+// at, or "-" if it wasn't, in the order of the test set
+//
+void eval_write_hits(EvalSet *set, FILE *fp) {
+    for (uint32_t i = 0; i < set->count; i++) {
+        EvalEntry *entry = &set->entries[i];
+        fwrite(set->text + entry->offset, 1, entry->len, fp);
+        if (entry->found_at != 0) {
+            fprintf(fp, "\t%llu\n", entry->found_at);
+        }
+        else {
+            fprintf(fp, "\t-\n");
+        }
+    }
+}
+
+
+// Frees the set
+//
+void free_eval_set(EvalSet *set) {
+    if (set == NULL) {
+        return;
+    }
+    free(set->text);
+    free(set->entries);
+    free(set->slots);
+    free(set);
+}
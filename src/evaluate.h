@@ -0,0 +1,133 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Pretty Cool Fuzzy Guesser (PCFG)
+//  --Probabilistic Context Free Grammar (PCFG) Password Guessing Program
+//
+//  Written by Matt Weir
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//
+
+
+
+#ifndef _EVALUATE_H
+#define _EVALUATE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "global_def.h"
+#include "dedupe.h"
+#include "coverage.h"
+
+
+// A slot in the test set's open addressed table. index is the position of
+// the password in the test set plus one, so 0 is an empty slot
+typedef struct EvalSlot {
+    uint64_t hash;
+    uint32_t index;
+}EvalSlot;
+
+
+// A unique password from the test set
+typedef struct EvalEntry {
+    
+    // Offset of the password in EvalSet.text, and its length
+    size_t offset;
+    int len;
+    
+    // Number of times it is in the test set
+    unsigned long long multiplicity;
+    
+    // Guess number it was first made at. 0 if it hasn't been made yet
+    unsigned long long found_at;
+    
+}EvalEntry;
+
+
+// The test set being evaluated against
+typedef struct EvalSet {
+    
+    // All of the unique passwords, back to back
+    char *text;
+    
+    EvalEntry *entries;
+    uint32_t count;
+    
+    // Number of passwords in the test set, counting repeats
+    unsigned long long total;
+    
+    // Linear probing table of the passwords, keyed by guess_hash()
+    EvalSlot *slots;
+    uint64_t mask;
+    
+    // Number of guesses made so far that have been accounted for with
+    // eval_resolve()
+    unsigned long long guesses;
+    
+    // Unique passwords found, and the same counting repeats
+    uint32_t num_found;
+    unsigned long long num_cracked;
+    
+    // Set if a hit couldn't be recorded, so the results are incomplete
+    int failed;
+    
+}EvalSet;
+
+
+// A guess that hit a test password. ordinal is the number of the guess
+// counting from the last time the hits were resolved
+typedef struct EvalHit {
+    uint32_t entry;
+    unsigned long long ordinal;
+}EvalHit;
+
+
+// Hits recorded by one thread that haven't been given guess numbers yet
+typedef struct EvalHits {
+    EvalHit *hits;
+    size_t count;
+    size_t size;
+    
+    // Guesses checked since the last eval_resolve()
+    unsigned long long guesses;
+}EvalHits;
+
+
+// Loads a test set of plaintext passwords
+extern EvalSet *load_eval_set(char *filename);
+
+// Checks a guess against the test set, and records it if it is a new hit
+extern int eval_check(EvalSet *set, EvalHits *hits, char *guess, int guess_len);
+
+// Gives the recorded hits their guess numbers
+extern void eval_resolve(EvalSet *set, EvalHits *hits);
+
+// Returns 1 if every password in the test set has been found
+extern int eval_done(EvalSet *set);
+
+// Writes out the cracked versus guesses curve
+extern void eval_write_curve(EvalSet *set, FILE *fp);
+
+// Writes out each test password with the guess number it was found at
+extern void eval_write_hits(EvalSet *set, FILE *fp);
+
+// Frees the set
+extern void free_eval_set(EvalSet *set);
+
+#endif
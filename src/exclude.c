@@ -0,0 +1,259 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Pretty Cool Fuzzy Guesser (PCFG)
+//  --Probabilistic Context Free Grammar (PCFG) Password Guessing Program
+//
+//  Written by Matt Weir
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//
+
+
+
+#include "exclude.h"
+
+
+// Sorts fingerprints in ascending order
+//
+int compare_fingerprints(const void *a, const void *b) {
+    uint64_t fp_a = *(const uint64_t *) a;
+    uint64_t fp_b = *(const uint64_t *) b;
+    return (fp_a > fp_b) - (fp_a < fp_b);
+}
+
+
+// Reads guesses from fp, one per line, and writes out an exclude file with
+// their fingerprints
+//
+// Line endings, (\n or \r\n), are not part of the guess
+//
+// Function returns 0 if it worked ok, 1 if an error occured
+//
+int build_exclude_file(FILE *fp, char *filename) {
+    
+    size_t count = 0;
+    size_t size = 1 << 20;
+    uint64_t *fingerprints = malloc(size * sizeof(uint64_t));
+    if (fingerprints == NULL) {
+        fprintf(stderr, "Error allocating memory for the fingerprints\n");
+        return 1;
+    }
+    
+    char *line = NULL;
+    size_t line_size = 0;
+    ssize_t line_len;
+    while ((line_len = getline(&line, &line_size, fp)) != -1) {
+        while ((line_len > 0) && ((line[line_len - 1] == '\n') || (line[line_len - 1] == '\r'))) {
+            line_len--;
+        }
+        if (count == size) {
+            size *= 2;
+            uint64_t *resized = realloc(fingerprints, size * sizeof(uint64_t));
+            if (resized == NULL) {
+                fprintf(stderr, "Error allocating memory for the fingerprints\n");
+                free(fingerprints);
+                free(line);
+                return 1;
+            }
+            fingerprints = resized;
+        }
+        fingerprints[count++] = guess_hash(line, line_len);
+    }
+    free(line);
+    
+    qsort(fingerprints, count, sizeof(uint64_t), compare_fingerprints);
+    
+    size_t unique = 0;
+    for (size_t i = 0; i < count; i++) {
+        if ((unique == 0) || (fingerprints[i] != fingerprints[unique - 1])) {
+            fingerprints[unique++] = fingerprints[i];
+        }
+    }
+    
+    FILE *out = fopen(filename, "wb");
+    if (out == NULL) {
+        fprintf(stderr, "Error opening %s\n", filename);
+        free(fingerprints);
+        return 1;
+    }
+    uint64_t header_count = unique;
+    int ret = 0;
+    if ((fwrite(EXCLUDE_MAGIC, 1, 8, out) != 8) ||
+        (fwrite(&header_count, sizeof(uint64_t), 1, out) != 1) ||
+        (fwrite(fingerprints, sizeof(uint64_t), unique, out) != unique)) {
+        fprintf(stderr, "Error writing %s\n", filename);
+        ret = 1;
+    }
+    if (fclose(out) != 0) {
+        ret = 1;
+    }
+    
+    fprintf(stderr, "Saved %zu fingerprints from %zu lines to %s\n", unique, count, filename);
+    free(fingerprints);
+    return ret;
+}
+
+
+// Maps an exclude file into memory and builds its bucket directory
+//
+// Returns NULL if the file couldn't be loaded
+//
+ExcludeSet *load_exclude_set(char *filename) {
+    
+    ExcludeSet *set = calloc(1, sizeof(ExcludeSet));
+    if (set == NULL) {
+        fprintf(stderr, "Error allocating memory for the exclude set\n");
+        return NULL;
+    }
+    
+    set->fd = open(filename, O_RDONLY);
+    if (set->fd == -1) {
+        fprintf(stderr, "Error opening the exclude file %s\n", filename);
+        free(set);
+        return NULL;
+    }
+    struct stat file_stat;
+    if ((fstat(set->fd, &file_stat) != 0) || (file_stat.st_size < 16)) {
+        fprintf(stderr, "Error, %s isn't an exclude file\n", filename);
+        close(set->fd);
+        free(set);
+        return NULL;
+    }
+    set->map_size = file_stat.st_size;
+    set->map = mmap(NULL, set->map_size, PROT_READ, MAP_SHARED, set->fd, 0);
+    if (set->map == MAP_FAILED) {
+        fprintf(stderr, "Error mapping the exclude file %s\n", filename);
+        close(set->fd);
+        free(set);
+        return NULL;
+    }
+    
+    uint64_t header_count;
+    memcpy(&header_count, (char *) set->map + 8, sizeof(uint64_t));
+    if ((memcmp(set->map, EXCLUDE_MAGIC, 8) != 0) || (header_count != (set->map_size - 16) / sizeof(uint64_t)) || ((set->map_size - 16) % sizeof(uint64_t) != 0)) {
+        fprintf(stderr, "Error, %s isn't an exclude file or is damaged\n", filename);
+        free_exclude_set(set);
+        return NULL;
+    }
+    set->fingerprints = (const uint64_t *) ((char *) set->map + 16);
+    set->count = header_count;
+    
+    // The directory is built by walking the whole file once, which also
+    // pulls it into the page cache
+    set->bucket_bits = 1;
+    while ((set->bucket_bits < 32) && (((size_t) 1 << set->bucket_bits) * EXCLUDE_BUCKET_SIZE < set->count)) {
+        set->bucket_bits++;
+    }
+    size_t num_buckets = (size_t) 1 << set->bucket_bits;
+    set->buckets = malloc((num_buckets + 1) * sizeof(size_t));
+    if (set->buckets == NULL) {
+        fprintf(stderr, "Error allocating memory for the exclude set\n");
+        free_exclude_set(set);
+        return NULL;
+    }
+    
+    size_t pos = 0;
+    for (size_t b = 0; b < num_buckets; b++) {
+        set->buckets[b] = pos;
+        while ((pos < set->count) && ((set->fingerprints[pos] >> (64 - set->bucket_bits)) == b)) {
+            if ((pos > 0) && (set->fingerprints[pos] <= set->fingerprints[pos - 1])) {
+                fprintf(stderr, "Error, the fingerprints in %s aren't sorted\n", filename);
+                free_exclude_set(set);
+                return NULL;
+            }
+            pos++;
+        }
+    }
+    set->buckets[num_buckets] = pos;
+    
+    return set;
+}
+
+
+// Returns 1 if the fingerprint is in the set, 0 if it isn't
+//
+// The bucket is scanned without branching on each item so the compiler can
+// compare several fingerprints at once
+//
+int exclude_contains(ExcludeSet *set, uint64_t hash) {
+    
+    size_t bucket = hash >> (64 - set->bucket_bits);
+    const uint64_t *fingerprints = set->fingerprints;
+    size_t end = set->buckets[bucket + 1];
+    
+    uint64_t found = 0;
+    for (size_t i = set->buckets[bucket]; i < end; i++) {
+        found |= (fingerprints[i] == hash);
+    }
+    return (found != 0);
+}
+
+
+// Adds a guess to a batch
+//
+// The guess is hashed now and the directory entry for its bucket is
+// prefetched, so it is in cache by the time the batch is checked
+//
+// Returns 1 if the batch is now full and should be checked
+//
+int exclude_batch_add(ExcludeSet *set, ExcludeBatch *batch, char *guess, int guess_len) {
+    int i = batch->count++;
+    memcpy(batch->guesses[i], guess, guess_len);
+    batch->lens[i] = guess_len;
+    batch->hashes[i] = guess_hash(guess, guess_len - 1);
+    __builtin_prefetch(&set->buckets[batch->hashes[i] >> (64 - set->bucket_bits)]);
+    return (batch->count == EXCLUDE_BATCH_SIZE);
+}
+
+
+// Checks every guess in a batch against the set
+//
+// The fingerprints for every guess are prefetched first, and then they are
+// all looked up, so the cache misses for the whole batch overlap instead of
+// each lookup waiting on its own. excluded[i] is set to 1 if the i'th guess
+// is in the set
+//
+// Note: guess lengths in the batch include the trailing newline, which
+// isn't part of the fingerprint
+//
+void exclude_batch_check(ExcludeSet *set, ExcludeBatch *batch, unsigned char *excluded) {
+    
+    for (int i = 0; i < batch->count; i++) {
+        __builtin_prefetch(set->fingerprints + set->buckets[batch->hashes[i] >> (64 - set->bucket_bits)]);
+    }
+    
+    unsigned long long num_excluded = 0;
+    for (int i = 0; i < batch->count; i++) {
+        excluded[i] = exclude_contains(set, batch->hashes[i]);
+        num_excluded += excluded[i];
+    }
+    __atomic_fetch_add(&set->excluded, num_excluded, __ATOMIC_RELAXED);
+}
+
+
+// Unmaps the set and frees it
+//
+void free_exclude_set(ExcludeSet *set) {
+    if (set == NULL) {
+        return;
+    }
+    if ((set->map != NULL) && (set->map != MAP_FAILED)) {
+        munmap(set->map, set->map_size);
+    }
+    close(set->fd);
+    free(set->buckets);
+    free(set);
+}
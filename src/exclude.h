@@ -0,0 +1,109 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Pretty Cool Fuzzy Guesser (PCFG)
+//  --Probabilistic Context Free Grammar (PCFG) Password Guessing Program
+//
+//  Written by Matt Weir
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//
+
+
+
+#ifndef _EXCLUDE_H
+#define _EXCLUDE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "global_def.h"
+#include "dedupe.h"
+
+
+// First 8 bytes of an exclude file. Followed by the number of fingerprints
+// and then the fingerprints, all as 64 bit little endian numbers
+#define EXCLUDE_MAGIC "PCFGEX01"
+
+// Aim for about this many fingerprints per bucket in the directory
+#define EXCLUDE_BUCKET_SIZE 4
+
+// The number of guesses that are hashed and prefetched before any of them
+// are looked up
+#define EXCLUDE_BATCH_SIZE 64
+
+
+// A memory mapped, sorted set of guess fingerprints
+//
+// The fingerprints are guess_hash() of each guess. Since they are evenly
+// spread out, the top bits of a fingerprint say about where in the file it
+// is, so a directory of where each bucket of top bits starts is built when
+// the file is loaded. A lookup is then one short scan of a bucket
+//
+typedef struct ExcludeSet {
+    
+    // The mapped file
+    int fd;
+    void *map;
+    size_t map_size;
+    
+    // The sorted fingerprints
+    const uint64_t *fingerprints;
+    size_t count;
+    
+    // Bucket b is fingerprints[buckets[b]] up to fingerprints[buckets[b + 1]]
+    size_t *buckets;
+    int bucket_bits;
+    
+    // Number of guesses excluded
+    unsigned long long excluded;
+    
+}ExcludeSet;
+
+
+// Guesses waiting to be checked against an exclude set
+typedef struct ExcludeBatch {
+    int count;
+    uint64_t hashes[EXCLUDE_BATCH_SIZE];
+    int lens[EXCLUDE_BATCH_SIZE];
+    char guesses[EXCLUDE_BATCH_SIZE][MAX_GUESS_SIZE + 1];
+}ExcludeBatch;
+
+
+// Reads guesses from fp and writes out an exclude file with their fingerprints
+extern int build_exclude_file(FILE *fp, char *filename);
+
+// Maps an exclude file into memory
+extern ExcludeSet *load_exclude_set(char *filename);
+
+// Returns 1 if the fingerprint is in the set, 0 if it isn't
+extern int exclude_contains(ExcludeSet *set, uint64_t hash);
+
+// Adds a guess to a batch. Returns 1 if the batch is now full
+extern int exclude_batch_add(ExcludeSet *set, ExcludeBatch *batch, char *guess, int guess_len);
+
+// Checks every guess in a batch against the set
+extern void exclude_batch_check(ExcludeSet *set, ExcludeBatch *batch, unsigned char *excluded);
+
+// Unmaps the set and frees it
+extern void free_exclude_set(ExcludeSet *set);
+
+#endif
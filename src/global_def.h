@@ -7,4 +7,10 @@
 
 #define MAX_GUESS_SIZE 100 //Maximum size of a generated guess (minus 1)
 
+#define DEFAULT_RENDER_CACHE 64 //Default memory in MB for caching alpha words with their capitalization applied
+
+#define MAX_THREADS 256 //Maximum number of threads that can be used to generate guesses
+
+#define SHARED_GRAMMAR_DIR "/dev/shm" //Where shared grammars are saved. Should be memory backed
+
 #endif
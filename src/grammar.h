@@ -27,13 +27,67 @@
 #ifndef _GRAMMAR_H
 #define _GRAMMAR_H
 
+#include <stddef.h>
+
+#include "global_def.h"
+
 
 // The maximum length of a terminal. Aka D32
 #define MAX_TERM_LENGTH 32
 
 
+// The different types of replacements
+//
+// These are used as indexes into the lookup/dispatch tables, (for example
+// PcfgGrammar.terminals), so PCFG_NUM_TYPES needs to stay last
+//
+typedef enum PcfgType {
+    PCFG_ALPHA = 0,           // A
+    PCFG_CAPITALIZATION,      // C
+    PCFG_DIGITS,              // D
+    PCFG_YEARS,               // Y
+    PCFG_OTHER,               // O
+    PCFG_KEYBOARD,            // K
+    PCFG_CONTEXT,             // X
+    PCFG_MARKOV,              // M
+    PCFG_NUM_TYPES
+} PcfgType;
+
+
+// The single character designator used in the rules files for each type.
+// Index it by PcfgType, aka PCFG_TYPE_DESIGNATORS[PCFG_DIGITS] == 'D'
+#define PCFG_TYPE_DESIGNATORS "ACDYOKXM"
+
+
+// A group of numbers that is generated instead of being stored
+//
+// Digit and year groups are often almost every number in a range, (aka every
+// 6 digit number). Rather than storing all of them, the group is stored as
+// every number from start to end, minus the exceptions. The numbers are
+// zero padded to width digits
+//
+typedef struct PcfgRange {
+    
+    unsigned long long start;
+    unsigned long long end;
+    int width;
+    
+    // The numbers between start and end that are not in the group, in
+    // ascending order
+    int num_exceptions;
+    unsigned long long exceptions[];
+    
+}PcfgRange;
+
+
 // Contains the replacements that all have the same probabability
 //
+// All of the groups loaded from the same terminal file, (aka A8), share
+// one arena for their values, and one arena for their offsets. Each group
+// points to its own slice of those arenas. This keeps the values for a
+// group next to each other in memory so generating guesses walks through
+// them linearly vs. chasing a pointer per value.
+//
 typedef struct PcfgReplacements {
     
     // The number of items for this group
@@ -48,21 +102,63 @@ typedef struct PcfgReplacements {
     // The child of this replacement group
     struct PcfgReplacements *child;
     
-    // The values for this terminal
-    char **value;
+    // The values for this terminal, packed back to back with no null
+    // terminators. Use pcfg_value() and pcfg_value_len() to access them
+    char *values;
+    
+    // Start position of each value in values. Has size + 1 items so the
+    // length of value i is offsets[i+1] - offsets[i]
+    //
+    // Is NULL if every value in the group is the same length, (digits,
+    // years, capitalization masks, etc), in which case stride is used
+    unsigned int *offsets;
+    
+    // The length of every value if they are all the same length. Value i
+    // then starts at values + (i * stride). Set to 0 if offsets is used
+    int stride;
+    
+    // If not NULL, the values are generated from this range instead of being
+    // stored in values. They are generated in ascending order. stride still
+    // holds the length of each value
+    PcfgRange *range;
     
     // These are used for quick guess generation and debugging
     // (type/id)
     
-    // The type of structure this is
-    char *type;
+    // The type of structure this is. Holds a PcfgType
+    unsigned char type;
     
     // The id for this structure
-    long id;
+    int id;
         
 }PcfgReplacements;
 
 
+// Returns a pointer to the i'th value of a replacement group
+//
+// Note: The value is not null terminated. Use pcfg_value_len() to get
+// its length
+//
+// Note: Don't call this on range groups since their values aren't stored
+//
+static inline char *pcfg_value(const PcfgReplacements *group, int i) {
+    if (group->offsets == NULL) {
+        return group->values + ((size_t) i * group->stride);
+    }
+    return group->values + group->offsets[i];
+}
+
+
+// Returns the length in bytes of the i'th value of a replacement group
+//
+static inline int pcfg_value_len(const PcfgReplacements *group, int i) {
+    if (group->offsets == NULL) {
+        return group->stride;
+    }
+    return group->offsets[i+1] - group->offsets[i];
+}
+
+
 // Contains info for a base structure on the individual replacement type. 
 //
 // Not using pointers here since I want to eventually add support for
@@ -71,10 +167,8 @@ typedef struct PcfgReplacements {
 //
 typedef struct BaseReplace{
          
-    // The type of replacement
-    // Could get away with just a simple char since all the designators are
-    // currently 1 char long, but want to future proof this a little bit
-    char *type;
+    // The type of replacement. Holds a PcfgType
+    unsigned char type;
     
     // The id for this replacent. Aka the '3' in "D3"
     int id;
@@ -104,20 +198,120 @@ typedef struct PcfgBase {
 }PcfgBase;
 
 
+// The maximum number of characters in the Markov alphabet
+#define MAX_MARKOV_ALPHABET 256
+
+// The maximum level of a Markov guess. Levels are stored as an unsigned char
+// and MARKOV_UNSEEN is used to mark ngrams that are not in the model
+#define MAX_MARKOV_LEVEL 254
+#define MARKOV_UNSEEN 255
+
+
+// The Markov, (OMEN), model that was trained on the passwords
+//
+// Every ngram is given a level, with lower levels being more probable. The
+// level of a guess is the level of its length plus the level of its first
+// (ngram - 1) characters plus the level of every ngram after that. All of the
+// guesses with the same level are treated as equally probable, so each level
+// becomes one replacement group in the Markov terminal.
+//
+typedef struct MarkovGrammar {
+    
+    // The size of the ngrams, aka 4 for 4-grams
+    int ngram;
+    
+    // The number of characters in the alphabet
+    int alphabet_size;
+    
+    // The characters in the alphabet. These are UTF-8 so can be up to 4 bytes
+    char alphabet[MAX_MARKOV_ALPHABET][4];
+    unsigned char alphabet_len[MAX_MARKOV_ALPHABET];
+    
+    // The highest level of any ngram in the model
+    int max_level;
+    
+    // The level of each guess length. -1 if that length isn't in the model
+    int ln_level[MAX_GUESS_SIZE];
+    
+    // The number of guesses at each level
+    unsigned long long keyspace[MAX_MARKOV_LEVEL + 1];
+    
+    // The level of each group in the Markov terminal, in the order they are
+    // in the terminal. Aka group_level[0] is the level of the first group
+    int group_level[MAX_MARKOV_LEVEL + 1];
+    
+    // The level of each starting (ngram - 1) characters. Indexed by treating
+    // the characters as a number in base alphabet_size
+    unsigned char *ip_level;
+    
+    // The level of each ngram. Indexed the same way as ip_level, so the level
+    // for adding character c after the prefix p is cp_level[p * alphabet_size + c]
+    unsigned char *cp_level;
+    
+}MarkovGrammar;
+
+
 // Top level structure that contains the PCFG
+//
+// The terminals are indexed by [PcfgType][id], so the A8 replacements are
+// at terminals[PCFG_ALPHA][8]. Unused slots are NULL
+//
+// The Markov terminal is at terminals[PCFG_MARKOV][0] and its groups don't
+// have values. Instead they are generated from the model in markov
+//
 typedef struct PcfgGrammar {
    
-    PcfgReplacements *alpha[MAX_TERM_LENGTH + 1];
-    PcfgReplacements *digits[MAX_TERM_LENGTH + 1];
-    PcfgReplacements *other[MAX_TERM_LENGTH + 1 ];
-    PcfgReplacements *keyboard[MAX_TERM_LENGTH + 1];
-    PcfgReplacements *x[MAX_TERM_LENGTH + 1];
-    PcfgReplacements *years[MAX_TERM_LENGTH + 1];
-    PcfgReplacements *capitalization[MAX_TERM_LENGTH + 1];
-    PcfgReplacements *markov[MAX_TERM_LENGTH + 1];
+    PcfgReplacements *terminals[PCFG_NUM_TYPES][MAX_TERM_LENGTH + 1];
     PcfgBase *base_structures;
     
+    // NULL if the ruleset doesn't have a Markov model
+    MarkovGrammar *markov;
+    
 }PcfgGrammar;
 
 
+// Options that control what is kept when loading a grammar, along with
+// stats on what was actually loaded
+//
+// Used to prune parts of the grammar that a time-boxed session could never
+// reach so they don't take up memory.
+//
+typedef struct PcfgLoadOptions {
+    
+    // Terminal groups with a probability below this are not loaded
+    // Set to 0.0 to load all of them
+    double min_term_prob;
+    
+    // Base structures whose most probable guess is below this are not loaded
+    // Set to 0.0 to load all of them
+    double min_base_prob;
+    
+    // The maximum amount of memory (in bytes) the grammar should use. The
+    // lowest probability terminal groups are dropped to fit in the budget.
+    // Set to 0 for no limit
+    size_t max_memory;
+    
+    // If not 0.0, neighboring groups in a terminal whose probabilities are
+    // within this relative distance of each other are merged into one group.
+    // This results in fewer, bigger pre-terminals at the cost of slightly
+    // changing the order guesses are made in
+    double merge_epsilon;
+    
+    // Extra cutoff for each terminal file, set by find_memory_cutoff() to
+    // fit the memory budget. 0.0 if there isn't one
+    double term_cutoff[PCFG_NUM_TYPES][MAX_TERM_LENGTH + 1];
+    
+    // Stats on what was loaded
+    long pruned_groups;
+    long pruned_bases;
+    size_t memory_used;
+    
+    // The number of groups that were created by merging other groups, and
+    // the largest relative change in probability that caused for any value
+    long merged_groups;
+    double max_drift;
+    
+} PcfgLoadOptions;
+
+
 #endif
\ No newline at end of file
@@ -26,13 +26,334 @@
 #include "grammar_io.h"
 
 
+// Lookup table of the config sections to load each terminal type from
+//
+// Note: Markov isn't in here since it is a model rather than a list of
+// values. It is loaded by load_markov()
+//
+static const struct {
+    char *section;
+    PcfgType type;
+} terminal_sections[] = {
+    {"BASE_A", PCFG_ALPHA},
+    {"CAPITALIZATION", PCFG_CAPITALIZATION},
+    {"BASE_D", PCFG_DIGITS},
+    {"BASE_Y", PCFG_YEARS},
+    {"BASE_O", PCFG_OTHER},
+    {"BASE_X", PCFG_CONTEXT},
+    {"BASE_K", PCFG_KEYBOARD},
+};
+
+#define NUM_TERMINAL_SECTIONS ((int) (sizeof(terminal_sections) / sizeof(terminal_sections[0])))
+
+
+// Holds the information about a replacement group that is collected during
+// the first pass through a terminal file
+typedef struct GroupInfo {
+    
+    // The probability of the group
+    double prob;
+    
+    // The highest and lowest probability of the values in the group. These
+    // are only different if groups were merged
+    double max_prob;
+    double min_prob;
+    
+    // The sum of the probabilities of all the values in the group
+    double mass;
+    
+    // The number of values in the group
+    int size;
+    
+    // The total number of bytes needed to store all the values
+    size_t bytes;
+    
+    // The shortest and longest value, (in bytes), in the group
+    int min_len;
+    int max_len;
+    
+    // Set to 1 if every value is a number, along with the smallest and
+    // largest of them
+    int numeric;
+    unsigned long long min_num;
+    unsigned long long max_num;
+    
+    // Set to 1 if the group will be generated from a range instead of
+    // storing its values
+    int is_range;
+    
+} GroupInfo;
+
+
+// Checks if a group can be stored as a range, and if that takes less memory
+// than storing its values
+//
+// Returns 1 if it should be a range, 0 if not
+//
+int use_range(GroupInfo *group) {
+    
+    if ((group->numeric == 0) || (group->min_len != group->max_len) || (group->size < MIN_RANGE_SIZE)) {
+        return 0;
+    }
+    
+    unsigned long long span = group->max_num - group->min_num + 1;
+    if ((span > MAX_RANGE_SPAN) || (span < (unsigned long long) group->size)) {
+        return 0;
+    }
+    
+    // Every number in the range that isn't in the group has to be stored
+    unsigned long long num_exceptions = span - group->size;
+    return ((num_exceptions * sizeof(unsigned long long)) < group->bytes);
+}
+
+
+// Reads through a terminal file and collects the info for each group
+//
+// Groups with a probability below min_prob are pruned. Since the files are
+// sorted by probability that just cuts off the tail of the chain. The
+// number of groups that were pruned is added to pruned_groups
+//
+// If epsilon is not 0.0, neighboring groups are merged as long as their
+// probabilities are within epsilon of the first group that was merged,
+// (relative to its probability). The merged group gets the average
+// probability of its values so the total probability doesn't change
+//
+// Digit and year groups, (based on type), are marked to be stored as ranges
+// if use_range() says they should be
+//
+// The groups array is allocated by this function and needs to be freed by
+// the calling function. Note: num_groups can be 0 if everything was pruned
+//
+// Function returns 0 if it worked ok
+//
+// Returns 1 if the file was empty or malformed
+//
+int scan_groups(FILE *fp, PcfgType type, double min_prob, double epsilon, GroupInfo **groups, int *num_groups, long *pruned_groups) {
+    
+    // Holds the current line in the config file
+    char buff[MAX_CONFIG_LINE];
+    
+    // The probability of the current item;
+    double prob;
+    
+    // A temp holder for the string value in the file
+    char value[MAX_CONFIG_LINE];
+    
+    int max_groups = 16;
+    (*num_groups) = 0;
+    (*groups) = malloc(max_groups * sizeof(GroupInfo));
+    if ((*groups) == NULL) {
+        return 1;
+    }
+    
+    // Number of lines that were read in, (to catch empty files)
+    int num_lines = 0;
+    
+    // The probability of the last group that was pruned. Set to -1 if
+    // nothing has been pruned yet
+    double prob_of_pruned = -1.0;
+    
+    // The probability of the previous line
+    double prev_prob = -1.0;
+    
+    // Loop through the file and gather the sizes of each group
+    while (fgets(buff, MAX_CONFIG_LINE , (FILE*)fp)) {
+        
+        if (split_value(buff, value, &prob) != 0) {
+            free(*groups);
+            return 1;
+        }
+        num_lines++;
+        
+        // Once one group is pruned, everything after it is less probable
+        // so is pruned too. Only need to count them
+        if (prob_of_pruned != -1.0) {
+            if (prob != prob_of_pruned) {
+                (*pruned_groups)++;
+                prob_of_pruned = prob;
+            }
+            continue;
+        }
+        
+        int value_len = strnlen(value, MAX_CONFIG_LINE);
+        
+        // Start a new group if the probability changed
+        if (prob != prev_prob) {
+            prev_prob = prob;
+            
+            // Prune this group
+            if (prob < min_prob) {
+                (*pruned_groups)++;
+                prob_of_pruned = prob;
+                continue;
+            }
+        }
+        
+        // Check if this needs to go into a new group, or can be merged into
+        // the current one
+        GroupInfo *cur_group = NULL;
+        if ((*num_groups) != 0) {
+            cur_group = &(*groups)[(*num_groups) - 1];
+            if ((prob > cur_group->max_prob) || ((cur_group->max_prob - prob) > (epsilon * cur_group->max_prob))) {
+                cur_group = NULL;
+            }
+        }
+        
+        if (cur_group == NULL) {
+            
+            if ((*num_groups) == max_groups) {
+                max_groups *= 2;
+                GroupInfo *resized = realloc((*groups), max_groups * sizeof(GroupInfo));
+                if (resized == NULL) {
+                    free(*groups);
+                    return 1;
+                }
+                (*groups) = resized;
+            }
+            
+            cur_group = &(*groups)[(*num_groups)];
+            cur_group->prob = prob;
+            cur_group->max_prob = prob;
+            cur_group->min_prob = prob;
+            cur_group->mass = 0.0;
+            cur_group->size = 0;
+            cur_group->bytes = 0;
+            cur_group->min_len = value_len;
+            cur_group->max_len = value_len;
+            cur_group->numeric = 1;
+            cur_group->min_num = ULLONG_MAX;
+            cur_group->max_num = 0;
+            cur_group->is_range = 0;
+            (*num_groups)++;
+        }
+        
+        if (prob < cur_group->min_prob) {
+            cur_group->min_prob = prob;
+        }
+        cur_group->mass += prob;
+        cur_group->size++;
+        cur_group->bytes += value_len;
+        if (value_len < cur_group->min_len) {
+            cur_group->min_len = value_len;
+        }
+        if (value_len > cur_group->max_len) {
+            cur_group->max_len = value_len;
+        }
+        
+        if (cur_group->numeric == 1) {
+            char *end_pos;
+            unsigned long long number = strtoull(value, &end_pos, 10);
+            if ((value_len == 0) || (value_len > MAX_RANGE_WIDTH) || (end_pos != value + value_len) || (isdigit(value[0]) == 0)) {
+                cur_group->numeric = 0;
+            }
+            else {
+                if (number < cur_group->min_num) {
+                    cur_group->min_num = number;
+                }
+                if (number > cur_group->max_num) {
+                    cur_group->max_num = number;
+                }
+            }
+        }
+    }
+    
+    // The file should have at least one line in it
+    if (num_lines == 0) {
+        free(*groups);
+        return 1;
+    }
+    
+    // Merged groups get the average probability of their values
+    for (int i = 0; i < (*num_groups); i++) {
+        if ((*groups)[i].min_prob != (*groups)[i].max_prob) {
+            (*groups)[i].prob = (*groups)[i].mass / (*groups)[i].size;
+        }
+        if ((type == PCFG_DIGITS) || (type == PCFG_YEARS)) {
+            (*groups)[i].is_range = use_range(&(*groups)[i]);
+        }
+    }
+    
+    return 0;
+}
+
+
+// Returns how much memory a group will take up once it is loaded
+//
+size_t group_memory(GroupInfo *group) {
+    
+    // Ranges only store the numbers that are missing from them
+    if (group->is_range == 1) {
+        unsigned long long num_exceptions = group->max_num - group->min_num + 1 - group->size;
+        return sizeof(PcfgReplacements) + sizeof(PcfgRange) + (num_exceptions * sizeof(unsigned long long));
+    }
+    
+    size_t memory = sizeof(PcfgReplacements) + group->bytes;
+    
+    // Groups where every value is the same length don't need offsets
+    if (group->min_len != group->max_len) {
+        memory += (group->size + 1) * sizeof(unsigned int);
+    }
+    return memory;
+}
+
+
+// Creates the range for a group once all of its numbers have been read in
+//
+// bitmap has a bit set for every number in the group, relative to the start
+// of the range. Any numbers that don't have their bit set become exceptions.
+// The group's size is updated to the number of values in the range, which
+// only changes if the rules file had duplicates
+//
+// Function returns 0 if it worked ok, 1 if memory couldn't be allocated
+//
+int create_range(PcfgReplacements *group, GroupInfo *info, unsigned char *bitmap) {
+    
+    unsigned long long span = info->max_num - info->min_num + 1;
+    
+    unsigned long long num_values = 0;
+    for (unsigned long long i = 0; i < span; i++) {
+        if ((bitmap[i >> 3] & (1 << (i & 7))) != 0) {
+            num_values++;
+        }
+    }
+    unsigned long long num_exceptions = span - num_values;
+    
+    PcfgRange *range = malloc(sizeof(PcfgRange) + (num_exceptions * sizeof(unsigned long long)));
+    if (range == NULL) {
+        return 1;
+    }
+    range->start = info->min_num;
+    range->end = info->max_num;
+    range->width = info->min_len;
+    range->num_exceptions = num_exceptions;
+    
+    int cur_exception = 0;
+    for (unsigned long long i = 0; i < span; i++) {
+        if ((bitmap[i >> 3] & (1 << (i & 7))) == 0) {
+            range->exceptions[cur_exception] = info->min_num + i;
+            cur_exception++;
+        }
+    }
+    
+    group->range = range;
+    group->size = num_values;
+    return 0;
+}
+
+
 // Opens a file and actually loads the grammar for a particular terminal
 //
-// Function returns a a PcfgReplacements structure
-// 
-// Returns NULL if problems occur opening the file or malformed ruleset
+// The loaded replacements are saved in result. Groups with a probability
+// below options->min_term_prob are pruned. If every group is pruned then
+// result is set to NULL
+//
+// Function returns 0 if it worked ok
 //
-PcfgReplacements* load_term_from_file(char *filename, char *type, long id) {
+// Returns 1 if problems occur opening the file or malformed ruleset
+//
+int load_term_from_file(char *filename, PcfgType type, int id, PcfgLoadOptions *options, PcfgReplacements **result) {
+    
+    (*result) = NULL;
     
     // Pointer to the open terminal file
     FILE *fp;
@@ -45,154 +366,242 @@ PcfgReplacements* load_term_from_file(char *filename, char *type, long id) {
         
         //Could not open the file. Print error and return an error
         fprintf(stderr, "Error. Could not read the file: %s\n",filename);
-        return NULL;
+        return 1;
     }
     
     // Note: There will be two passes through the file
-    //   1) First pass gets count info since I want to allocate memory without
-    //      being wasteful, and I want to use arrays to hopefully make
-    //      generating guesses faster
+    //   1) First pass gets the number of groups, and how many items and bytes
+    //      are in each of them. That way all of the memory for this file
+    //      can be allocated up front as a few contiguous arenas vs. doing
+    //      a malloc for every value
     //
-    //   2) Actually load the terminals to the pcfgreplacement struct
+    //   2) Actually load the terminals into those arenas. Groups that are
+    //      stored as ranges don't use the arenas. Instead the numbers in
+    //      them are marked in a bitmap to find which ones are missing
     //
     
     // Holds the current line in the config file
     char buff[MAX_CONFIG_LINE];
     
-    // Initalize things and get the first line of the file
-    if (!fgets(buff, MAX_CONFIG_LINE , (FILE*)fp)) {
-        // The file should have at least one line in it
-        return NULL;
-    }
-    
-    // This contains the number of items at the current probability
-    int num_term = 1;
-    
-    // The previous probability we saw
-    double previous_prob;
-    
     // The probability of the current item;
     double prob;
     
     // A temp holder for the string value in the file
     char value[MAX_CONFIG_LINE];
     
-    // Break up the first line. Using previous_prob since this will be the
-    // inital value for it when comparing against other items.
-    if (split_value(buff, value, &previous_prob) != 0) {
-        return NULL;
+    // Info on all of the groups found in the file
+    GroupInfo *groups;
+    int num_groups;
+    
+    double min_prob = options->min_term_prob;
+    if (options->term_cutoff[type][id] > min_prob) {
+        min_prob = options->term_cutoff[type][id];
     }
     
-    // Initalize the first PcfgReplacement
-    PcfgReplacements *terminal_pointer = (PcfgReplacements *)malloc(sizeof(struct PcfgReplacements));
-    if (terminal_pointer == NULL) {
-        return NULL;
+    if (scan_groups(fp, type, min_prob, options->merge_epsilon, &groups, &num_groups, &options->pruned_groups) != 0) {
+        fprintf(stderr, "Error. Malformed rules file: %s\n",filename);
+        fclose(fp);
+        return 1;
     }
-    terminal_pointer->parent = NULL;
-    terminal_pointer->child = NULL;
-    terminal_pointer->prob = previous_prob;
-    terminal_pointer->id = id;
     
-    // Allocate memory to store the type
-    int type_len = strnlen(type,50);
-    type_len += 1;
-    terminal_pointer->type = (char *)malloc(type_len * sizeof(char *));
-    if (terminal_pointer->type == NULL) {
-        return NULL;
+    // Everything was pruned
+    if (num_groups == 0) {
+        fclose(fp);
+        free(groups);
+        return 0;
     }
-    strncpy(terminal_pointer->type, type, type_len);
     
-    PcfgReplacements *cur_pointer = terminal_pointer;
+    // Figure out how big the arenas need to be. Groups where every value is
+    // the same length don't need any offsets
+    size_t total_bytes = 0;
+    size_t total_offsets = 0;
+    for (int i = 0; i < num_groups; i++) {
+        if (groups[i].is_range == 1) {
+            continue;
+        }
+        total_bytes += groups[i].bytes;
+        if (groups[i].min_len != groups[i].max_len) {
+            total_offsets += groups[i].size + 1;
+        }
+    }
+    
+    // Allocate the groups themselves and the arenas they point into
+    PcfgReplacements *terminal_pointer = malloc(num_groups * sizeof(PcfgReplacements));
+    
+    // Adding 1 so an empty value, (which shouldn't happen), doesn't
+    // cause a zero sized malloc
+    char *value_arena = malloc(total_bytes + 1);
+    
+    unsigned int *offset_arena = NULL;
+    if (total_offsets != 0) {
+        offset_arena = malloc(total_offsets * sizeof(unsigned int));
+    }
+    
+    if ((terminal_pointer == NULL) || (value_arena == NULL) ||
+        ((total_offsets != 0) && (offset_arena == NULL))) {
+        fclose(fp);
+        free(groups);
+        free(terminal_pointer);
+        free(value_arena);
+        free(offset_arena);
+        return 1;
+    }
+    
+    for (int i = 0; i < num_groups; i++) {
+        options->memory_used += group_memory(&groups[i]);
+    }
+    
+    // Initialize the groups and carve up the arenas between them
+    size_t value_pos = 0;
+    size_t offset_pos = 0;
+    for (int i = 0; i < num_groups; i++) {
+        PcfgReplacements *cur_pointer = &terminal_pointer[i];
         
-    // Loop through the config file
-    while (fgets(buff, MAX_CONFIG_LINE , (FILE*)fp)) {
+        cur_pointer->size = groups[i].size;
+        cur_pointer->prob = groups[i].prob;
+        cur_pointer->parent = (i == 0) ? NULL : &terminal_pointer[i - 1];
+        cur_pointer->child = (i == num_groups - 1) ? NULL : &terminal_pointer[i + 1];
+        cur_pointer->type = type;
+        cur_pointer->id = id;
+        cur_pointer->values = value_arena + value_pos;
+        cur_pointer->range = NULL;
         
-        if (split_value(buff, value, &prob) != 0) {
-            return NULL;
+        if (groups[i].is_range == 1) {
+            cur_pointer->offsets = NULL;
+            cur_pointer->stride = groups[i].min_len;
+            continue;
         }
         
-        if (prob == previous_prob) {
-            num_term++;
+        if (groups[i].min_len == groups[i].max_len) {
+            cur_pointer->offsets = NULL;
+            cur_pointer->stride = groups[i].min_len;
         }
         else {
-            // Finalize this structure
-            cur_pointer->size = num_term;
-            if ((cur_pointer->value = (char **) malloc(num_term * sizeof(char *))) == NULL) {
-                return NULL;
+            cur_pointer->offsets = offset_arena + offset_pos;
+            cur_pointer->offsets[groups[i].size] = groups[i].bytes;
+            cur_pointer->stride = 0;
+            offset_pos += groups[i].size + 1;
+        }
+        value_pos += groups[i].bytes;
+        
+        // Keep track of how much merging groups changed the probabilities
+        if (groups[i].min_prob != groups[i].max_prob) {
+            options->merged_groups++;
+            double drift = (groups[i].max_prob - groups[i].prob) / groups[i].max_prob;
+            if (drift > options->max_drift) {
+                options->max_drift = drift;
             }
-
-            // intialize the next, and make it current
-            previous_prob = prob;
-            num_term = 1;
-            
-            cur_pointer->child = (PcfgReplacements *)malloc(sizeof(struct PcfgReplacements));
-            if (cur_pointer->child == NULL) {
-                return NULL;
+            drift = (groups[i].prob - groups[i].min_prob) / groups[i].min_prob;
+            if (drift > options->max_drift) {
+                options->max_drift = drift;
             }
-            
-            cur_pointer->child->parent = cur_pointer;
-            cur_pointer = cur_pointer->child;
-            cur_pointer->child = NULL;
-            cur_pointer->prob = prob;
-            cur_pointer->id = id;
-    
-            // Allocate memory to store the type
-            cur_pointer->type = (char *)malloc(type_len * sizeof(char *));
-            if (cur_pointer->type == NULL) {
-                return NULL;
-            }
-            strncpy(cur_pointer->type, type, type_len);
         }
     }
     
-    //Save the size of the last items
-    cur_pointer->size = num_term;
-    if ((cur_pointer->value = (char **) malloc(num_term * sizeof(char *))) == NULL) {
-        return NULL;
-    }
-    
     // Now on to the second loop where we will save all of the items
     
     // Reset the file pointer to the start of the file
     if (fseek(fp, 0, SEEK_SET) != 0) {
         fprintf(stderr, "Error. Could not seek in: %s\n",filename);
-        return NULL;
+        fclose(fp);
+        free(groups);
+        return 1;
     }
-    cur_pointer = terminal_pointer;
-    num_term = 0;
+    PcfgReplacements *cur_pointer = terminal_pointer;
+    GroupInfo *cur_group = groups;
+    int num_term = 0;
+    
+    // Where the next value will be written in the current group
+    unsigned int cur_pos = 0;
+    
+    // The numbers seen so far if the current group is a range
+    unsigned char *bitmap = NULL;
     
     while (fgets(buff, MAX_CONFIG_LINE , (FILE*)fp)) {
         
         // Advance to the next container if needed
         if (num_term == cur_pointer->size) {
+            
+            if (bitmap != NULL) {
+                int ret_value = create_range(cur_pointer, cur_group, bitmap);
+                free(bitmap);
+                bitmap = NULL;
+                if (ret_value != 0) {
+                    fclose(fp);
+                    free(groups);
+                    return 1;
+                }
+            }
+            
+            // The rest of the file was pruned
+            if (cur_pointer->child == NULL) {
+                break;
+            }
             cur_pointer = cur_pointer->child;
+            cur_group++;
             num_term = 0;
+            cur_pos = 0;
+        }
+        
+        if ((cur_group->is_range == 1) && (bitmap == NULL)) {
+            bitmap = calloc(((cur_group->max_num - cur_group->min_num) / 8) + 1, 1);
+            if (bitmap == NULL) {
+                fclose(fp);
+                free(groups);
+                return 1;
+            }
         }
         
         if (split_value(buff, value, &prob) != 0) {
             fprintf(stderr, "Error. Could not split value in rules file\n");
-            return NULL;
+            fclose(fp);
+            free(groups);
+            return 1;
         }
-        // Sanity checking
-        if (prob != cur_pointer->prob) {
+        // Sanity checking. If groups were merged, the probability can be
+        // anything within the range of the merged groups
+        if ((prob > cur_group->max_prob) || (prob < cur_group->min_prob)) {
             fprintf(stderr, "Error. Probability mismatch in rules file\n");
-            return NULL;
+            fclose(fp);
+            free(groups);
+            return 1;
         }
         
         // Save the actual value
         int value_len = strnlen(value, MAX_CONFIG_LINE);
-
-        cur_pointer->value[num_term] = malloc((value_len +1) * sizeof(char *));
-        if (cur_pointer->value[num_term] == NULL) {
-            return NULL;
+        
+        if (bitmap != NULL) {
+            unsigned long long bit = strtoull(value, NULL, 10) - cur_group->min_num;
+            bitmap[bit >> 3] |= (1 << (bit & 7));
+            num_term++;
+            continue;
+        }
+        
+        if (cur_pointer->offsets != NULL) {
+            cur_pointer->offsets[num_term] = cur_pos;
         }
-        strncpy(cur_pointer->value[num_term], value, value_len +1);
+        memcpy(cur_pointer->values + cur_pos, value, value_len);
+        cur_pos += value_len;
         
         num_term++;
         
     }
     
-    return terminal_pointer;
+    // The last group was a range
+    if (bitmap != NULL) {
+        int ret_value = create_range(cur_pointer, cur_group, bitmap);
+        free(bitmap);
+        if (ret_value != 0) {
+            fclose(fp);
+            free(groups);
+            return 1;
+        }
+    }
+    
+    fclose(fp);
+    free(groups);
+    (*result) = terminal_pointer;
+    return 0;
 }
 
 
@@ -202,7 +611,7 @@ PcfgReplacements* load_term_from_file(char *filename, char *type, long id) {
 //
 // If an error occurs function returns 1
 //
-int load_terminal(char *config_filename, char *base_directory, char *structure, char *type, PcfgReplacements *grammar_item[]) {
+int load_terminal(char *config_filename, char *base_directory, char *structure, PcfgType type, PcfgReplacements *grammar_item[], PcfgLoadOptions *options) {
     
     // Get the folder where the files will be saved
     char section_folder[MAX_CONFIG_LINE];
@@ -231,6 +640,7 @@ int load_terminal(char *config_filename, char *base_directory, char *structure,
             return 1;
         }
         
+        errno = 0;
         long id = strtol(result[i],&end_pos, 10);
         
         // Check to make sure it was a number
@@ -254,9 +664,7 @@ int load_terminal(char *config_filename, char *base_directory, char *structure,
         char filename[PATH_MAX];
         snprintf(filename, PATH_MAX, "%s%s%c%s", base_directory,section_folder,SLASH,result[i]);
         
-        grammar_item[id] = load_term_from_file(filename, type, id);
-        
-        if (grammar_item[id] == NULL) {
+        if (load_term_from_file(filename, type, id, options, &grammar_item[id]) != 0) {
             return 1;
         }
 
@@ -266,6 +674,254 @@ int load_terminal(char *config_filename, char *base_directory, char *structure,
 }
 
 
+// A terminal group that is competing for room in the memory budget
+typedef struct RankedGroup {
+    
+    // The group's probability times the probability of the most likely
+    // base structure that uses its file
+    double rank;
+    
+    size_t memory;
+    PcfgType type;
+    int id;
+    
+    // 1 for the most probable group in its file
+    int is_top;
+} RankedGroup;
+
+
+// Compares two groups so qsort puts the most important first. The top
+// group of every file comes before all of the others
+//
+int compare_group_rank(const void *a, const void *b) {
+    const RankedGroup *group1 = a;
+    const RankedGroup *group2 = b;
+    if (group1->is_top != group2->is_top)
+        return group2->is_top - group1->is_top;
+    if (group1->rank > group2->rank)
+        return -1;
+    if (group1->rank < group2->rank)
+        return 1;
+    
+    return 0;
+}
+
+
+// Finds the probability of the most likely base structure that uses each
+// terminal file. Files that no base structure uses are left at 0.0
+//
+// Function returns 0 if it worked ok, 1 if the file couldn't be read
+//
+int find_best_bases(char *config_filename, char *base_directory, double best_base[PCFG_NUM_TYPES][MAX_TERM_LENGTH + 1]) {
+    
+    char filename[PATH_MAX];
+    if (get_base_filename(config_filename, base_directory, filename) != 0) {
+        return 1;
+    }
+    
+    FILE *fp = fopen(filename,"r");
+    if (fp == NULL) {
+        fprintf(stderr, "Error. Could not read the file: %s\n",filename);
+        return 1;
+    }
+    
+    char buff[MAX_CONFIG_LINE];
+    char value[MAX_CONFIG_LINE];
+    double prob;
+    while (fgets(buff, MAX_CONFIG_LINE , (FILE*)fp)) {
+        
+        // Base structures that can't be loaded are skipped here, and
+        // load_base_structures() deals with them
+        BaseReplace *base_items;
+        int size;
+        if ((split_value(buff, value, &prob) != 0) || (split_base(value, &base_items, &size) != 0)) {
+            continue;
+        }
+        for (int i = 0; i < size; i++) {
+            int id = base_items[i].id;
+            if ((id > 0) && (id <= MAX_TERM_LENGTH) && (prob > best_base[base_items[i].type][id])) {
+                best_base[base_items[i].type][id] = prob;
+            }
+        }
+        free(base_items);
+    }
+    
+    fclose(fp);
+    return 0;
+}
+
+
+// Finds the terminal probability cutoffs needed to fit the terminals into a
+// memory budget
+//
+// A group's probability only means something next to the other groups in
+// the same file, so groups are ranked by their probability times the
+// probability of the best base structure that uses their file. The highest
+// ranked groups are kept, (across all of the files), until the budget is
+// used up. Each file then gets the cutoff that prunes its groups ranked
+// below the first group that didn't fit
+//
+// The most probable group of every file goes ahead of all the others, so
+// a file is only pruned to nothing, (which drops every base structure
+// using it), if the budget can't fit one group from every file. Files that
+// no base structure uses are always pruned. The cutoffs are saved in
+// options->term_cutoff
+//
+// Function returns 0 if it worked ok
+//
+// If an error occurs function returns 1
+//
+int find_memory_cutoff(char *config_filename, char *base_directory, size_t budget, PcfgLoadOptions *options) {
+    
+    double best_base[PCFG_NUM_TYPES][MAX_TERM_LENGTH + 1] = {{0.0}};
+    if (find_best_bases(config_filename, base_directory, best_base) != 0) {
+        return 1;
+    }
+    
+    // The probability of the top group in each file
+    double top_prob[PCFG_NUM_TYPES][MAX_TERM_LENGTH + 1] = {{0.0}};
+    
+    // All of the groups in the ruleset
+    RankedGroup *all_groups = NULL;
+    int num_all = 0;
+    
+    for (int i = 0; i < NUM_TERMINAL_SECTIONS; i++) {
+        
+        PcfgType type = terminal_sections[i].type;
+        
+        // Get the folder and the filenames for this section
+        char section_folder[MAX_CONFIG_LINE];
+        if (get_key(config_filename, terminal_sections[i].section, "directory", section_folder) != 0) {
+            fprintf(stderr, "Could not get folder name for section. Exiting\n");
+            free(all_groups);
+            return 1;
+        }
+        
+        char result[256][MAX_CONFIG_ITEM];
+        int list_size;
+        if (config_get_list(config_filename, terminal_sections[i].section, "filenames", result, &list_size, 256) != 0) {
+            fprintf(stderr, "Error reading the config for a rules file. Exiting\n");
+            free(all_groups);
+            return 1;
+        }
+        
+        for (int y = 0; y < list_size; y++) {
+            
+            // Skip the same files that load_terminal() would skip
+            long id = strtol(result[y], NULL, 10);
+            if ((id <= 0) || (id > MAX_TERM_LENGTH)) {
+                continue;
+            }
+            
+            char filename[PATH_MAX];
+            snprintf(filename, PATH_MAX, "%s%s%c%s", base_directory,section_folder,SLASH,result[y]);
+            
+            FILE *fp = fopen(filename,"r");
+            if (fp == NULL) {
+                fprintf(stderr, "Error. Could not read the file: %s\n",filename);
+                free(all_groups);
+                return 1;
+            }
+            
+            GroupInfo *groups;
+            int num_groups;
+            long pruned = 0;
+            if (scan_groups(fp, type, 0.0, options->merge_epsilon, &groups, &num_groups, &pruned) != 0) {
+                fprintf(stderr, "Error. Malformed rules file: %s\n",filename);
+                fclose(fp);
+                free(all_groups);
+                return 1;
+            }
+            fclose(fp);
+            
+            // Files that no base structure uses are pruned completely, so
+            // they don't take up room in the budget
+            if ((num_groups == 0) || (best_base[type][id] == 0.0)) {
+                if (num_groups != 0) {
+                    options->term_cutoff[type][id] = groups[0].max_prob + (groups[0].max_prob * DBL_EPSILON * 4);
+                }
+                free(groups);
+                continue;
+            }
+            top_prob[type][id] = groups[0].max_prob;
+            
+            // Add them to the list of all the groups
+            RankedGroup *resized = realloc(all_groups, (num_all + num_groups) * sizeof(RankedGroup));
+            if (resized == NULL) {
+                free(groups);
+                free(all_groups);
+                return 1;
+            }
+            all_groups = resized;
+            for (int x = 0; x < num_groups; x++) {
+                all_groups[num_all].rank = groups[x].prob * best_base[type][id];
+                all_groups[num_all].memory = group_memory(&groups[x]);
+                all_groups[num_all].type = type;
+                all_groups[num_all].id = id;
+                all_groups[num_all].is_top = (x == 0);
+                num_all++;
+            }
+            free(groups);
+        }
+    }
+    
+    // Keep the highest ranked groups until the budget runs out. If the top
+    // groups don't all fit, fall back to ranking every group together
+    double cutoff_rank = -1.0;
+    int tops_fit = 1;
+    for (int pass = 0; pass < 2; pass++) {
+        qsort(all_groups, num_all, sizeof(RankedGroup), compare_group_rank);
+        
+        size_t memory_used = 0;
+        int cutoff_top = 0;
+        for (int i = 0; i < num_all; i++) {
+            memory_used += all_groups[i].memory;
+            if (memory_used > budget) {
+                cutoff_rank = all_groups[i].rank;
+                cutoff_top = all_groups[i].is_top;
+                break;
+            }
+        }
+        if (cutoff_top == 0) {
+            break;
+        }
+        tops_fit = 0;
+        
+        fprintf(stderr, "Warning. The memory budget can't fit a group from every terminal file, so some files are pruned completely\n");
+        for (int i = 0; i < num_all; i++) {
+            all_groups[i].is_top = 0;
+        }
+    }
+    free(all_groups);
+    
+    // Everything fit
+    if (cutoff_rank < 0.0) {
+        return 0;
+    }
+    
+    for (int type = 0; type < PCFG_NUM_TYPES; type++) {
+        for (int id = 1; id <= MAX_TERM_LENGTH; id++) {
+            if (top_prob[type][id] == 0.0) {
+                continue;
+            }
+            
+            // Prune everything in the file ranked the same or below the
+            // first group that didn't fit. Nudge the cutoff up a tiny bit so
+            // groups ranked the same are pruned as well
+            double cutoff = cutoff_rank / best_base[type][id];
+            cutoff += cutoff * DBL_EPSILON * 4;
+            
+            // Unless the top groups didn't fit, always keep them
+            if ((tops_fit == 1) && (cutoff > top_prob[type][id])) {
+                cutoff = top_prob[type][id];
+            }
+            options->term_cutoff[type][id] = cutoff;
+        }
+    }
+    return 0;
+}
+
+
 // Loads a ruleset/grammar from disk
 //
 // Function returns a non-zero value if an error occurs
@@ -275,6 +931,20 @@ int load_terminal(char *config_filename, char *base_directory, char *structure,
 //
 int load_grammar(char *arg_exec, struct program_info program_info, PcfgGrammar *pcfg) {
     
+    // What to prune from the grammar as it is loaded
+    PcfgLoadOptions options;
+    options.min_term_prob = program_info.min_term_prob;
+    options.min_base_prob = program_info.min_base_prob;
+    options.max_memory = program_info.max_memory;
+    options.pruned_groups = 0;
+    options.pruned_bases = 0;
+    options.memory_used = 0;
+    options.merge_epsilon = program_info.merge_epsilon;
+    options.merged_groups = 0;
+    options.max_drift = 0.0;
+    memset(options.term_cutoff, 0, sizeof(options.term_cutoff));
+
+    
     // Directory the executable is running in
     // Adding in a plus 1 to PATH_MAX to deal with a potential edge case
     // when formatting this to represent the directory. Should never happen
@@ -288,6 +958,10 @@ int load_grammar(char *arg_exec, struct program_info program_info, PcfgGrammar *
     // Holds the return value of function calls
     int ret_value;
     
+    // Start with an empty grammar so any terminals that aren't in the
+    // ruleset are NULL
+    memset(pcfg, 0, sizeof(PcfgGrammar));
+    
     // Using the current directory
     if (tail_slash == NULL) {
         snprintf(exec_directory, PATH_MAX, ".%c", SLASH);
@@ -317,53 +991,130 @@ int load_grammar(char *arg_exec, struct program_info program_info, PcfgGrammar *
         return ret_value;
     }
     
-    // Read in the alpha terminals
-    if (load_terminal(config_filename, base_directory, "BASE_A", "A", pcfg->alpha) != 0) {
-        fprintf(stderr, "Error reading the rules file. Exiting\n");
-        return 1;
-	}
-
-    // Read in the capitalization masks
-    if (load_terminal(config_filename, base_directory, "CAPITALIZATION", "C", pcfg->capitalization) != 0) {
-        fprintf(stderr, "Error reading the rules file. Exiting\n");
-        return 1;
-	}
-    // Read in the digit terminals 
-    if (load_terminal(config_filename, base_directory, "BASE_D", "D", pcfg->digits) != 0) {
-        fprintf(stderr, "Error reading the rules file. Exiting\n");
-        return 1;
-	}
+    // See if another pcfg_guesser already loaded this grammar and shared it.
+    // If so, just attach to it instead of loading it again
+    char shared_filename[PATH_MAX];
+    if (program_info.shared_grammar == 1) {
+        shared_grammar_name(base_directory, &options, shared_filename);
+        if (attach_shared_grammar(shared_filename, pcfg) == 0) {
+            fprintf(stderr, "Attached to shared grammar:%s\n", shared_filename);
+            return 0;
+        }
+    }
     
-    // Read in the years terminals 
-    if (load_terminal(config_filename, base_directory, "BASE_Y", "Y", pcfg->years) != 0) {
-        fprintf(stderr, "Error reading the rules file. Exiting\n");
-        return 1;
-	}
-    // Read in the "other" terminals 
-    if (load_terminal(config_filename, base_directory, "BASE_O", "O", pcfg->other) != 0) {
-        fprintf(stderr, "Error reading the rules file. Exiting\n");
-        return 1;
-	}
+    // If there is a memory budget, figure out how much of the terminals will
+    // fit. Set aside room for the base structures first, but don't let them
+    // take up more than half the budget. If they need more than that they
+    // will be pruned as they are loaded
+    if (options.max_memory != 0) {
+        size_t base_memory;
+        if (estimate_base_memory(config_filename, base_directory, &base_memory) != 0) {
+            fprintf(stderr, "Error reading the base_structure file in the rules. Exiting\n");
+            return 1;
+        }
+        if (base_memory > options.max_memory / 2) {
+            base_memory = options.max_memory / 2;
+        }
+        if (find_memory_cutoff(config_filename, base_directory, options.max_memory - base_memory, &options) != 0) {
+            fprintf(stderr, "Error reading the rules file. Exiting\n");
+            return 1;
+        }
+    }
     
-    // Read in the conteXt sensitive terminals
-    if (load_terminal(config_filename, base_directory, "BASE_X", "X", pcfg->x) != 0) {
-        fprintf(stderr, "Error reading the rules file. Exiting\n");
-        return 1;
-	}
+    // Read in all of the terminals
+    for (int i = 0; i < NUM_TERMINAL_SECTIONS; i++) {
+        PcfgType type = terminal_sections[i].type;
+        if (load_terminal(config_filename, base_directory, terminal_sections[i].section, type, pcfg->terminals[type], &options) != 0) {
+            fprintf(stderr, "Error reading the rules file. Exiting\n");
+            return 1;
+        }
+    }
     
-    // Read in the keyboard combo terminals
-    if (load_terminal(config_filename, base_directory, "BASE_K", "K", pcfg->keyboard) != 0) {
-        fprintf(stderr, "Error reading the rules file. Exiting\n");
+    // Read in the Markov model if the ruleset has one
+    if (load_markov(config_filename, base_directory, pcfg, &options) != 0) {
+        fprintf(stderr, "Error reading the Markov model in the rules. Exiting\n");
         return 1;
-	}
+    }
     
     // Now read in the base structures. Note, this doesn't need to be done last
     // but depending on what enhancements are done in the future it's good
     // practice to process these at the end.
-    if (load_base_structures(config_filename, base_directory, &pcfg->base_structures) != 0) {
+    if (load_base_structures(config_filename, base_directory, pcfg, &options) != 0) {
         fprintf(stderr, "Error reading the base_structure file in the rules. Exiting\n");
         return 1;
 	}
     
+    if ((options.min_term_prob != 0.0) || (options.min_base_prob != 0.0) || (options.max_memory != 0)) {
+        fprintf(stderr, "Pruned %li terminal groups and %li base structures\n", options.pruned_groups, options.pruned_bases);
+        fprintf(stderr, "Grammar memory used: %zu bytes\n", options.memory_used);
+    }
+    
+    // Let the user know how much merging groups changed the guess order
+    if (options.merge_epsilon != 0.0) {
+        fprintf(stderr, "Merged near-equal groups into %li groups\n", options.merged_groups);
+        fprintf(stderr, "Largest probability change from merging: %.4f%%\n", options.max_drift * 100.0);
+    }
+    
+    // Share the grammar with other pcfg_guessers, and then swap our private
+    // copy for the shared one so this process isn't holding two copies of it
+    if (program_info.shared_grammar == 1) {
+        if (save_shared_grammar(shared_filename, pcfg) != 0) {
+            fprintf(stderr, "Warning. Could not share the grammar. Continuing with a private copy\n");
+            return 0;
+        }
+        
+        PcfgGrammar shared;
+        if (attach_shared_grammar(shared_filename, &shared) == 0) {
+            free_grammar(pcfg);
+            (*pcfg) = shared;
+            fprintf(stderr, "Saved shared grammar:%s\n", shared_filename);
+        }
+    }
+    
     return 0;
+}
+
+
+// Frees a grammar that was loaded by load_grammar()
+//
+// Note: This relies on how load_term_from_file() lays out the arenas. The
+// first group of a terminal points to the start of the value arena, and the
+// first variable length group points to the start of the offset arena.
+//
+// Don't call this on a grammar that was attached with attach_shared_grammar()
+//
+void free_grammar(PcfgGrammar *pcfg) {
+    
+    for (int type = 0; type < PCFG_NUM_TYPES; type++) {
+        for (int id = 0; id <= MAX_TERM_LENGTH; id++) {
+            PcfgReplacements *first = pcfg->terminals[type][id];
+            if (first == NULL) {
+                continue;
+            }
+            
+            free(first->values);
+            for (PcfgReplacements *group = first; group != NULL; group = group->child) {
+                if (group->offsets != NULL) {
+                    free(group->offsets);
+                    break;
+                }
+            }
+            for (PcfgReplacements *group = first; group != NULL; group = group->child) {
+                free(group->range);
+            }
+            free(first);
+        }
+    }
+    
+    PcfgBase *cur_base = pcfg->base_structures;
+    while (cur_base != NULL) {
+        PcfgBase *next = cur_base->next;
+        free(cur_base->value);
+        free(cur_base);
+        cur_base = next;
+    }
+    
+    free_markov(pcfg->markov);
+    
+    memset(pcfg, 0, sizeof(PcfgGrammar));
 }
\ No newline at end of file
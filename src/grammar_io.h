@@ -28,15 +28,31 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <float.h>
+#include <limits.h>
+#include <ctype.h>
 
 #include "config_parser.h"
 #include "command_line.h"
 #include "helper_io.h"
 #include "base_structure_io.h"
+#include "grammar_shm.h"
+#include "markov_io.h"
 #include "grammar.h"
 
+// Digit and year groups are stored as a range if they have at least this many
+// values, and it takes less memory than storing them
+#define MIN_RANGE_SIZE 64
+
+// The longest number, (and the largest range), that will be stored as a range
+#define MAX_RANGE_WIDTH 18
+#define MAX_RANGE_SPAN (1ULL << 30)
+
 // Loads a grammar ruleset
 extern int load_grammar(char *arg_exec, struct program_info program_info, PcfgGrammar *pcfg);
 
+// Frees a grammar that was loaded by load_grammar()
+extern void free_grammar(PcfgGrammar *pcfg);
+
 
 #endif
\ No newline at end of file
@@ -0,0 +1,680 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Pretty Cool Fuzzy Guesser (PCFG)
+//  --Probabilistic Context Free Grammar (PCFG) Password Guessing Program
+//
+//  Written by Matt Weir
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//
+
+#include "grammar_shm.h"
+
+
+// Identifies a shared grammar file, and the version of its layout. Bump the
+// version whenever the layout changes so old files are ignored
+#define SHM_MAGIC "PCFGSHM"
+#define SHM_VERSION 3
+
+
+// The shared grammar is one file laid out as:
+//
+//   ShmHeader
+//   ShmTerminal[num_terminals]  - One for every loaded terminal, aka A8
+//   ShmGroup[num_groups]        - The groups of all the terminals, in order
+//   ShmBase[num_bases]          - The base structures, in order
+//   BaseReplace[]               - The replacements for the base structures
+//   PcfgRange[]                 - The ranges, each followed by its exceptions
+//   offsets                     - Offsets of all the variable length groups
+//   values                      - The packed values of every group
+//   MarkovGrammar               - Only if the ruleset has a Markov model,
+//                                 followed by its ip_level and cp_level
+//
+// Everything points to other parts of the file by its position from the start
+// of the file, so it can be mapped at any address. Attaching to it only has
+// to allocate the small PcfgReplacements and PcfgBase headers and point them
+// into the mapping. The values themselves are shared by every process.
+//
+typedef struct ShmHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t num_terminals;
+    uint64_t num_groups;
+    uint64_t num_bases;
+    
+    // Set to 0 if there isn't a Markov model
+    uint64_t markov_pos;
+    
+    uint64_t file_size;
+} ShmHeader;
+
+typedef struct ShmTerminal {
+    uint32_t type;
+    uint32_t id;
+    uint64_t num_groups;
+} ShmTerminal;
+
+typedef struct ShmGroup {
+    double prob;
+    int32_t size;
+    int32_t stride;
+    uint64_t values_pos;
+    
+    // Set to 0 if the group is fixed length and doesn't have offsets
+    uint64_t offsets_pos;
+    
+    // Set to 0 if the group isn't a range
+    uint64_t range_pos;
+} ShmGroup;
+
+typedef struct ShmBase {
+    double prob;
+    int64_t size;
+    uint64_t items_pos;
+} ShmBase;
+
+
+// Returns the number of bytes used by the values of a group
+//
+size_t group_bytes(PcfgReplacements *group) {
+    if (group->range != NULL) {
+        return 0;
+    }
+    if (group->offsets == NULL) {
+        return (size_t) group->size * group->stride;
+    }
+    return group->offsets[group->size];
+}
+
+
+// Returns the number of bytes used by a range and its exceptions
+//
+size_t range_size(PcfgRange *range) {
+    return sizeof(PcfgRange) + (range->num_exceptions * sizeof(unsigned long long));
+}
+
+
+// Adds a byte string to an FNV-1a hash
+//
+uint64_t shm_hash(uint64_t hash, const void *data, size_t len) {
+    const unsigned char *bytes = data;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+
+// Adds the name, size, and modification time of every file in a ruleset
+// directory to hash
+//
+// Subdirectories are walked as well so that editing any of the terminal
+// files, not just config.ini, changes the hash. The files are combined by
+// adding their hashes so the order readdir returns them in doesn't matter
+//
+void hash_ruleset_files(char *directory, int depth, uint64_t *hash) {
+    
+    // Rulesets are only a couple of directories deep. This just stops a
+    // symlink loop from recursing forever
+    if (depth > 8) {
+        return;
+    }
+    
+    DIR *dir = opendir(directory);
+    if (dir == NULL) {
+        return;
+    }
+    
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if ((strcmp(entry->d_name, ".") == 0) || (strcmp(entry->d_name, "..") == 0)) {
+            continue;
+        }
+        
+        char path[PATH_MAX];
+        size_t dir_len = strlen(directory);
+        if ((dir_len != 0) && (directory[dir_len - 1] == SLASH)) {
+            snprintf(path, PATH_MAX, "%s%s", directory, entry->d_name);
+        }
+        else {
+            snprintf(path, PATH_MAX, "%s%c%s", directory, SLASH, entry->d_name);
+        }
+        
+        struct stat file_stat;
+        if (stat(path, &file_stat) != 0) {
+            continue;
+        }
+        if (S_ISDIR(file_stat.st_mode)) {
+            hash_ruleset_files(path, depth + 1, hash);
+            continue;
+        }
+        
+        int64_t info[3] = {(int64_t) file_stat.st_size, (int64_t) file_stat.st_mtim.tv_sec, (int64_t) file_stat.st_mtim.tv_nsec};
+        uint64_t file_hash = shm_hash(14695981039346656037ULL, path, strlen(path));
+        file_hash = shm_hash(file_hash, info, sizeof(info));
+        (*hash) += file_hash;
+    }
+    
+    closedir(dir);
+}
+
+
+// Creates the filename of the shared grammar for a ruleset
+//
+// The name is a hash of the ruleset's location, the size and modification
+// time of every file in it, and the load options. That way processes using
+// a different ruleset, an edited ruleset, or different pruning settings
+// won't attach to each other's grammars
+//
+// result needs to be allocated by the calling function and be PATH_MAX long
+//
+void shared_grammar_name(char *base_directory, PcfgLoadOptions *options, char *result) {
+    
+    // Use the full path so it doesn't matter where the guesser was run from
+    char full_path[PATH_MAX];
+    if (realpath(base_directory, full_path) == NULL) {
+        strncpy(full_path, base_directory, PATH_MAX - 1);
+        full_path[PATH_MAX - 1] = '\0';
+    }
+    
+    uint64_t files_hash = 0;
+    hash_ruleset_files(full_path, 0, &files_hash);
+    
+    char key[PATH_MAX + 256];
+    snprintf(key, sizeof(key), "%s|%016llx|%d|%.17g|%.17g|%zu|%.17g", full_path, (unsigned long long) files_hash, SHM_VERSION,
+        options->min_term_prob, options->min_base_prob, options->max_memory, options->merge_epsilon);
+    
+    uint64_t hash = shm_hash(14695981039346656037ULL, key, strlen(key));
+    
+    snprintf(result, PATH_MAX, "%s%cpcfg_%016llx", SHARED_GRAMMAR_DIR, SLASH, (unsigned long long) hash);
+}
+
+
+// Saves a loaded grammar to a file that other processes can attach to
+//
+// The grammar is written to a temporary file which is then renamed, so other
+// processes never see a partially written grammar. Only the user that saved
+// it can read it
+//
+// Function returns 0 if it worked ok
+//
+// Returns 1 if an error occured
+//
+int save_shared_grammar(char *filename, PcfgGrammar *pcfg) {
+    
+    // First figure out how big everything is so the positions are known
+    ShmHeader header;
+    memset(&header, 0, sizeof(ShmHeader));
+    strncpy(header.magic, SHM_MAGIC, sizeof(header.magic));
+    header.version = SHM_VERSION;
+    
+    uint64_t num_items = 0;
+    uint64_t num_offsets = 0;
+    uint64_t values_bytes = 0;
+    uint64_t range_bytes = 0;
+    
+    for (int type = 0; type < PCFG_NUM_TYPES; type++) {
+        for (int id = 0; id <= MAX_TERM_LENGTH; id++) {
+            if (pcfg->terminals[type][id] == NULL) {
+                continue;
+            }
+            header.num_terminals++;
+            for (PcfgReplacements *group = pcfg->terminals[type][id]; group != NULL; group = group->child) {
+                header.num_groups++;
+                values_bytes += group_bytes(group);
+                if (group->offsets != NULL) {
+                    num_offsets += group->size + 1;
+                }
+                if (group->range != NULL) {
+                    range_bytes += range_size(group->range);
+                }
+            }
+        }
+    }
+    
+    for (PcfgBase *base = pcfg->base_structures; base != NULL; base = base->next) {
+        header.num_bases++;
+        num_items += base->size;
+    }
+    
+    uint64_t items_pos = sizeof(ShmHeader) + (header.num_terminals * sizeof(ShmTerminal)) +
+        (header.num_groups * sizeof(ShmGroup)) + (header.num_bases * sizeof(ShmBase));
+    uint64_t ranges_pos = items_pos + (num_items * sizeof(BaseReplace));
+    uint64_t offsets_pos = ranges_pos + range_bytes;
+    uint64_t values_pos = offsets_pos + (num_offsets * sizeof(unsigned int));
+    header.file_size = values_pos + values_bytes;
+    
+    // The Markov model goes at the end. Its level tables are the bulk of it
+    size_t ip_size = 0;
+    size_t cp_size = 0;
+    if (pcfg->markov != NULL) {
+        ip_size = 1;
+        for (int i = 0; i < pcfg->markov->ngram - 1; i++) {
+            ip_size *= pcfg->markov->alphabet_size;
+        }
+        cp_size = ip_size * pcfg->markov->alphabet_size;
+        header.markov_pos = header.file_size;
+        header.file_size += sizeof(MarkovGrammar) + ip_size + cp_size;
+    }
+    
+    // mkstemp creates the file with O_EXCL and only lets this user read it,
+    // so nobody else can swap in their own grammar before it's renamed
+    char temp_filename[PATH_MAX + 32];
+    snprintf(temp_filename, sizeof(temp_filename), "%s.XXXXXX", filename);
+    
+    int fd = mkstemp(temp_filename);
+    if (fd == -1) {
+        fprintf(stderr, "Error. Could not create the shared grammar: %s\n", temp_filename);
+        return 1;
+    }
+    FILE *fp = fdopen(fd, "wb");
+    if (fp == NULL) {
+        fprintf(stderr, "Error. Could not create the shared grammar: %s\n", temp_filename);
+        close(fd);
+        unlink(temp_filename);
+        return 1;
+    }
+    
+    fwrite(&header, sizeof(ShmHeader), 1, fp);
+    
+    // The terminals
+    for (int type = 0; type < PCFG_NUM_TYPES; type++) {
+        for (int id = 0; id <= MAX_TERM_LENGTH; id++) {
+            if (pcfg->terminals[type][id] == NULL) {
+                continue;
+            }
+            ShmTerminal terminal;
+            terminal.type = type;
+            terminal.id = id;
+            terminal.num_groups = 0;
+            for (PcfgReplacements *group = pcfg->terminals[type][id]; group != NULL; group = group->child) {
+                terminal.num_groups++;
+            }
+            fwrite(&terminal, sizeof(ShmTerminal), 1, fp);
+        }
+    }
+    
+    // The groups. Need to be written in the same order as the terminals
+    uint64_t cur_offsets = offsets_pos;
+    uint64_t cur_values = values_pos;
+    uint64_t cur_range = ranges_pos;
+    for (int type = 0; type < PCFG_NUM_TYPES; type++) {
+        for (int id = 0; id <= MAX_TERM_LENGTH; id++) {
+            for (PcfgReplacements *group = pcfg->terminals[type][id]; group != NULL; group = group->child) {
+                ShmGroup shm_group;
+                memset(&shm_group, 0, sizeof(ShmGroup));
+                shm_group.prob = group->prob;
+                shm_group.size = group->size;
+                shm_group.stride = group->stride;
+                shm_group.values_pos = cur_values;
+                cur_values += group_bytes(group);
+                if (group->offsets != NULL) {
+                    shm_group.offsets_pos = cur_offsets;
+                    cur_offsets += (group->size + 1) * sizeof(unsigned int);
+                }
+                if (group->range != NULL) {
+                    shm_group.range_pos = cur_range;
+                    cur_range += range_size(group->range);
+                }
+                fwrite(&shm_group, sizeof(ShmGroup), 1, fp);
+            }
+        }
+    }
+    
+    // The base structures
+    uint64_t cur_items = items_pos;
+    for (PcfgBase *base = pcfg->base_structures; base != NULL; base = base->next) {
+        ShmBase shm_base;
+        memset(&shm_base, 0, sizeof(ShmBase));
+        shm_base.prob = base->prob;
+        shm_base.size = base->size;
+        shm_base.items_pos = cur_items;
+        cur_items += base->size * sizeof(BaseReplace);
+        fwrite(&shm_base, sizeof(ShmBase), 1, fp);
+    }
+    for (PcfgBase *base = pcfg->base_structures; base != NULL; base = base->next) {
+        fwrite(base->value, sizeof(BaseReplace), base->size, fp);
+    }
+    
+    // The ranges, then the offsets and then the values
+    for (int type = 0; type < PCFG_NUM_TYPES; type++) {
+        for (int id = 0; id <= MAX_TERM_LENGTH; id++) {
+            for (PcfgReplacements *group = pcfg->terminals[type][id]; group != NULL; group = group->child) {
+                if (group->range != NULL) {
+                    fwrite(group->range, 1, range_size(group->range), fp);
+                }
+            }
+        }
+    }
+    for (int type = 0; type < PCFG_NUM_TYPES; type++) {
+        for (int id = 0; id <= MAX_TERM_LENGTH; id++) {
+            for (PcfgReplacements *group = pcfg->terminals[type][id]; group != NULL; group = group->child) {
+                if (group->offsets != NULL) {
+                    fwrite(group->offsets, sizeof(unsigned int), group->size + 1, fp);
+                }
+            }
+        }
+    }
+    for (int type = 0; type < PCFG_NUM_TYPES; type++) {
+        for (int id = 0; id <= MAX_TERM_LENGTH; id++) {
+            for (PcfgReplacements *group = pcfg->terminals[type][id]; group != NULL; group = group->child) {
+                fwrite(group->values, 1, group_bytes(group), fp);
+            }
+        }
+    }
+    
+    // The Markov model. The pointers in it are replaced when attaching
+    if (pcfg->markov != NULL) {
+        fwrite(pcfg->markov, sizeof(MarkovGrammar), 1, fp);
+        fwrite(pcfg->markov->ip_level, 1, ip_size, fp);
+        fwrite(pcfg->markov->cp_level, 1, cp_size, fp);
+    }
+    
+    int write_error = ferror(fp);
+    if ((fclose(fp) != 0) || (write_error != 0)) {
+        fprintf(stderr, "Error. Could not write the shared grammar: %s\n", temp_filename);
+        unlink(temp_filename);
+        return 1;
+    }
+    
+    if (rename(temp_filename, filename) != 0) {
+        fprintf(stderr, "Error. Could not create the shared grammar: %s\n", filename);
+        unlink(temp_filename);
+        return 1;
+    }
+    
+    return 0;
+}
+
+
+// Checks that count items of item_size bytes starting at pos are inside a
+// file of file_size bytes, without overflowing
+//
+// Returns 1 if they fit, 0 if they don't
+//
+int shm_fits(uint64_t pos, uint64_t count, uint64_t item_size, uint64_t file_size) {
+    if (pos > file_size) {
+        return 0;
+    }
+    if ((item_size != 0) && (count > (file_size - pos) / item_size)) {
+        return 0;
+    }
+    return 1;
+}
+
+
+// Checks that everything in a shared grammar points inside the file
+//
+// The file might have been truncated, corrupted, or written by a different
+// build, so nothing in it is used until this has checked every count and
+// position against the size of the file
+//
+// Function returns 0 if the grammar is valid, 1 if it isn't
+//
+int check_shared_grammar(char *map, uint64_t file_size) {
+    
+    ShmHeader *header = (ShmHeader *) map;
+    
+    // The tables at the start of the file
+    uint64_t terminals_pos = sizeof(ShmHeader);
+    if (shm_fits(terminals_pos, header->num_terminals, sizeof(ShmTerminal), file_size) == 0) {
+        return 1;
+    }
+    uint64_t groups_pos = terminals_pos + (header->num_terminals * sizeof(ShmTerminal));
+    if (shm_fits(groups_pos, header->num_groups, sizeof(ShmGroup), file_size) == 0) {
+        return 1;
+    }
+    uint64_t bases_pos = groups_pos + (header->num_groups * sizeof(ShmGroup));
+    if (shm_fits(bases_pos, header->num_bases, sizeof(ShmBase), file_size) == 0) {
+        return 1;
+    }
+    
+    ShmTerminal *terminals = (ShmTerminal *) (map + terminals_pos);
+    ShmGroup *groups = (ShmGroup *) (map + groups_pos);
+    ShmBase *bases = (ShmBase *) (map + bases_pos);
+    
+    // Which terminals exist, so the base structures can be checked
+    int loaded[PCFG_NUM_TYPES][MAX_TERM_LENGTH + 1] = {{0}};
+    
+    uint64_t cur_group = 0;
+    for (uint32_t i = 0; i < header->num_terminals; i++) {
+        if ((terminals[i].type >= PCFG_NUM_TYPES) || (terminals[i].id > MAX_TERM_LENGTH) ||
+            (terminals[i].num_groups == 0) || (terminals[i].num_groups > header->num_groups - cur_group)) {
+            return 1;
+        }
+        
+        // The Markov groups are generated from the model, and there is one
+        // for each level in it
+        if ((terminals[i].type == PCFG_MARKOV) &&
+            ((header->markov_pos == 0) || (terminals[i].num_groups > MAX_MARKOV_LEVEL + 1))) {
+            return 1;
+        }
+        loaded[terminals[i].type][terminals[i].id] = 1;
+        cur_group += terminals[i].num_groups;
+    }
+    if (cur_group != header->num_groups) {
+        return 1;
+    }
+    
+    for (uint64_t i = 0; i < header->num_groups; i++) {
+        ShmGroup *group = &groups[i];
+        if ((group->size <= 0) || (group->stride < 0)) {
+            return 1;
+        }
+        
+        if (group->range_pos != 0) {
+            if ((group->range_pos % sizeof(unsigned long long) != 0) ||
+                (shm_fits(group->range_pos, 1, sizeof(PcfgRange), file_size) == 0)) {
+                return 1;
+            }
+            PcfgRange *range = (PcfgRange *) (map + group->range_pos);
+            if ((range->num_exceptions < 0) || (range->width < 0) || (range->width > MAX_GUESS_SIZE) ||
+                (shm_fits(group->range_pos + sizeof(PcfgRange), range->num_exceptions, sizeof(unsigned long long), file_size) == 0)) {
+                return 1;
+            }
+            continue;
+        }
+        
+        // Fixed length values
+        if (group->offsets_pos == 0) {
+            if (shm_fits(group->values_pos, group->size, group->stride, file_size) == 0) {
+                return 1;
+            }
+            continue;
+        }
+        
+        // Variable length values. The offsets have to go up so every value
+        // ends up inside the file
+        if ((group->offsets_pos % sizeof(unsigned int) != 0) ||
+            (shm_fits(group->offsets_pos, (uint64_t) group->size + 1, sizeof(unsigned int), file_size) == 0)) {
+            return 1;
+        }
+        unsigned int *offsets = (unsigned int *) (map + group->offsets_pos);
+        for (int32_t y = 0; y < group->size; y++) {
+            if (offsets[y] > offsets[y + 1]) {
+                return 1;
+            }
+        }
+        if (shm_fits(group->values_pos, offsets[group->size], 1, file_size) == 0) {
+            return 1;
+        }
+    }
+    
+    for (uint64_t i = 0; i < header->num_bases; i++) {
+        if ((bases[i].size <= 0) || (bases[i].size > MAX_GUESS_SIZE) ||
+            (bases[i].items_pos % sizeof(int) != 0) ||
+            (shm_fits(bases[i].items_pos, bases[i].size, sizeof(BaseReplace), file_size) == 0)) {
+            return 1;
+        }
+        BaseReplace *items = (BaseReplace *) (map + bases[i].items_pos);
+        for (int64_t y = 0; y < bases[i].size; y++) {
+            if ((items[y].type >= PCFG_NUM_TYPES) || (items[y].id < 0) || (items[y].id > MAX_TERM_LENGTH) ||
+                (loaded[items[y].type][items[y].id] == 0)) {
+                return 1;
+            }
+        }
+    }
+    
+    // The Markov model, followed by its level tables
+    if (header->markov_pos != 0) {
+        if (shm_fits(header->markov_pos, 1, sizeof(MarkovGrammar), file_size) == 0) {
+            return 1;
+        }
+        MarkovGrammar markov;
+        memcpy(&markov, map + header->markov_pos, sizeof(MarkovGrammar));
+        if ((markov.ngram < 1) || (markov.ngram > MAX_GUESS_SIZE) ||
+            (markov.alphabet_size < 1) || (markov.alphabet_size > MAX_MARKOV_ALPHABET) ||
+            (markov.max_level < 0) || (markov.max_level > MAX_MARKOV_LEVEL)) {
+            return 1;
+        }
+        for (int i = 0; i < markov.alphabet_size; i++) {
+            if ((markov.alphabet_len[i] == 0) || (markov.alphabet_len[i] > sizeof(markov.alphabet[i]))) {
+                return 1;
+            }
+        }
+        uint64_t tables_pos = header->markov_pos + sizeof(MarkovGrammar);
+        uint64_t ip_size = 1;
+        for (int i = 0; i < markov.ngram - 1; i++) {
+            if (shm_fits(tables_pos, ip_size, markov.alphabet_size, file_size) == 0) {
+                return 1;
+            }
+            ip_size *= markov.alphabet_size;
+        }
+        if ((shm_fits(tables_pos, ip_size, 1, file_size) == 0) ||
+            (shm_fits(tables_pos + ip_size, ip_size, markov.alphabet_size, file_size) == 0)) {
+            return 1;
+        }
+    }
+    
+    return 0;
+}
+
+
+// Attaches to a grammar that was saved by save_shared_grammar()
+//
+// The grammar is mapped read only. Only the PcfgReplacements and PcfgBase
+// headers are allocated by this process. Grammars owned by another user
+// are ignored, since they could have been planted to change the guesses
+//
+// Function returns a non-zero value if an error occurs
+//     1 = The shared grammar doesn't exist
+//     2 = The shared grammar is invalid, or couldn't be mapped
+//
+int attach_shared_grammar(char *filename, PcfgGrammar *pcfg) {
+    
+    int fd = open(filename, O_RDONLY | O_NOFOLLOW);
+    if (fd == -1) {
+        return 1;
+    }
+    
+    struct stat file_stat;
+    if ((fstat(fd, &file_stat) != 0) || (!S_ISREG(file_stat.st_mode)) ||
+        (file_stat.st_uid != geteuid()) || (file_stat.st_size < (off_t) sizeof(ShmHeader))) {
+        close(fd);
+        return 2;
+    }
+    
+    char *map = mmap(NULL, file_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return 2;
+    }
+    
+    // Sanity check the header, and then everything it points to
+    ShmHeader *header = (ShmHeader *) map;
+    if ((strncmp(header->magic, SHM_MAGIC, sizeof(header->magic)) != 0) ||
+        (header->version != SHM_VERSION) ||
+        (header->file_size != (uint64_t) file_stat.st_size) ||
+        (check_shared_grammar(map, header->file_size) != 0)) {
+        munmap(map, file_stat.st_size);
+        return 2;
+    }
+    
+    ShmTerminal *terminals = (ShmTerminal *) (map + sizeof(ShmHeader));
+    ShmGroup *groups = (ShmGroup *) (terminals + header->num_terminals);
+    ShmBase *bases = (ShmBase *) (groups + header->num_groups);
+    
+    // Allocate all the headers at once
+    PcfgReplacements *replacements = malloc(header->num_groups * sizeof(PcfgReplacements));
+    PcfgBase *base_structures = malloc(header->num_bases * sizeof(PcfgBase));
+    MarkovGrammar *markov = NULL;
+    if (header->markov_pos != 0) {
+        markov = malloc(sizeof(MarkovGrammar));
+    }
+    if ((replacements == NULL) || (base_structures == NULL) || ((header->markov_pos != 0) && (markov == NULL))) {
+        free(replacements);
+        free(base_structures);
+        free(markov);
+        munmap(map, file_stat.st_size);
+        return 2;
+    }
+    
+    memset(pcfg, 0, sizeof(PcfgGrammar));
+    
+    uint64_t cur_group = 0;
+    for (uint32_t i = 0; i < header->num_terminals; i++) {
+        
+        for (uint64_t y = 0; y < terminals[i].num_groups; y++) {
+            PcfgReplacements *group = &replacements[cur_group + y];
+            ShmGroup *shm_group = &groups[cur_group + y];
+            
+            group->size = shm_group->size;
+            group->prob = shm_group->prob;
+            group->parent = (y == 0) ? NULL : group - 1;
+            group->child = (y == terminals[i].num_groups - 1) ? NULL : group + 1;
+            group->values = map + shm_group->values_pos;
+            group->offsets = NULL;
+            if (shm_group->offsets_pos != 0) {
+                group->offsets = (unsigned int *) (map + shm_group->offsets_pos);
+            }
+            group->stride = shm_group->stride;
+            group->range = NULL;
+            if (shm_group->range_pos != 0) {
+                group->range = (PcfgRange *) (map + shm_group->range_pos);
+            }
+            group->type = terminals[i].type;
+            group->id = terminals[i].id;
+        }
+        pcfg->terminals[terminals[i].type][terminals[i].id] = &replacements[cur_group];
+        cur_group += terminals[i].num_groups;
+    }
+    
+    for (uint64_t i = 0; i < header->num_bases; i++) {
+        base_structures[i].size = bases[i].size;
+        base_structures[i].prob = bases[i].prob;
+        base_structures[i].prev = (i == 0) ? NULL : &base_structures[i - 1];
+        base_structures[i].next = (i == header->num_bases - 1) ? NULL : &base_structures[i + 1];
+        base_structures[i].value = (BaseReplace *) (map + bases[i].items_pos);
+    }
+    if (header->num_bases != 0) {
+        pcfg->base_structures = base_structures;
+    }
+    
+    // The level tables follow the model in the file
+    if (markov != NULL) {
+        memcpy(markov, map + header->markov_pos, sizeof(MarkovGrammar));
+        size_t ip_size = 1;
+        for (int i = 0; i < markov->ngram - 1; i++) {
+            ip_size *= markov->alphabet_size;
+        }
+        markov->ip_level = (unsigned char *) (map + header->markov_pos + sizeof(MarkovGrammar));
+        markov->cp_level = markov->ip_level + ip_size;
+        pcfg->markov = markov;
+    }
+    
+    return 0;
+}
@@ -0,0 +1,56 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Pretty Cool Fuzzy Guesser (PCFG)
+//  --Probabilistic Context Free Grammar (PCFG) Password Guessing Program
+//
+//  Written by Matt Weir
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//
+
+
+#ifndef _GRAMMAR_SHM_H
+#define _GRAMMAR_SHM_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "global_def.h"
+#include "helper_io.h"
+#include "grammar.h"
+
+
+// Creates the filename of the shared grammar for a ruleset
+//
+// The name depends on the ruleset's files and the load options, so processes
+// using an edited ruleset or different pruning settings won't attach to each
+// other's grammars
+extern void shared_grammar_name(char *base_directory, PcfgLoadOptions *options, char *result);
+
+// Saves a loaded grammar to a file that other processes can attach to
+extern int save_shared_grammar(char *filename, PcfgGrammar *pcfg);
+
+// Attaches to a grammar that was saved by save_shared_grammar()
+extern int attach_shared_grammar(char *filename, PcfgGrammar *pcfg);
+
+#endif
@@ -0,0 +1,440 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Pretty Cool Fuzzy Guesser (PCFG)
+//  --Probabilistic Context Free Grammar (PCFG) Password Guessing Program
+//
+//  Written by Matt Weir
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//
+
+
+
+#include "guess_estimate.h"
+
+
+// Builds an alias table from a list of weights, using Vose's method
+//
+// Items with a weight of 0 are never picked. If every weight is 0 the table
+// is left empty, (size 0)
+//
+// Function returns 0 if it worked ok, 1 if there was a memory allocation error
+//
+int create_alias_table(double *weights, int size, AliasTable *table) {
+    
+    table->size = 0;
+    table->keep = NULL;
+    table->alias = NULL;
+    table->pick_prob = NULL;
+    
+    double total = 0.0;
+    for (int i = 0; i < size; i++) {
+        total += weights[i];
+    }
+    if ((size == 0) || (total <= 0.0)) {
+        return 0;
+    }
+    
+    table->keep = malloc(size * sizeof(double));
+    table->alias = malloc(size * sizeof(int));
+    table->pick_prob = malloc(size * sizeof(double));
+    int *small = malloc(size * sizeof(int));
+    int *large = malloc(size * sizeof(int));
+    if ((table->keep == NULL) || (table->alias == NULL) || (table->pick_prob == NULL) || (small == NULL) || (large == NULL)) {
+        free(small);
+        free(large);
+        return 1;
+    }
+    table->size = size;
+    
+    // Scale so the average slot is 1.0, and sort the slots into the ones
+    // that are under full and the ones that have extra to give away
+    int num_small = 0;
+    int num_large = 0;
+    for (int i = 0; i < size; i++) {
+        table->pick_prob[i] = weights[i] / total;
+        table->keep[i] = table->pick_prob[i] * size;
+        table->alias[i] = i;
+        if (table->keep[i] < 1.0) {
+            small[num_small++] = i;
+        }
+        else {
+            large[num_large++] = i;
+        }
+    }
+    
+    // Fill up each under full slot from one of the large ones
+    while ((num_small > 0) && (num_large > 0)) {
+        int s = small[--num_small];
+        int l = large[num_large - 1];
+        table->alias[s] = l;
+        table->keep[l] -= 1.0 - table->keep[s];
+        if (table->keep[l] < 1.0) {
+            num_large--;
+            small[num_small++] = l;
+        }
+    }
+    
+    // Whatever is left over is only off from 1.0 due to rounding
+    while (num_large > 0) {
+        table->keep[large[--num_large]] = 1.0;
+    }
+    while (num_small > 0) {
+        table->keep[small[--num_small]] = 1.0;
+    }
+    
+    free(small);
+    free(large);
+    return 0;
+}
+
+
+// Frees an alias table
+//
+void free_alias_table(AliasTable *table) {
+    free(table->keep);
+    free(table->alias);
+    free(table->pick_prob);
+    table->size = 0;
+}
+
+
+// Returns the next random number from a splitmix64 generator
+//
+static inline uint64_t next_random(uint64_t *state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+
+// Picks an item from an alias table
+//
+static inline int alias_pick(AliasTable *table, uint64_t *state) {
+    uint64_t r = next_random(state);
+    
+    // The top 32 bits pick the slot and the bottom 32 decide between the
+    // slot and its alias
+    int slot = (int) (((r >> 32) * (uint64_t) table->size) >> 32);
+    double coin = (double) (r & 0xFFFFFFFFULL) / 4294967296.0;
+    if (coin < table->keep[slot]) {
+        return slot;
+    }
+    return table->alias[slot];
+}
+
+
+// Work for one sampling thread
+typedef struct EstimateWorker {
+    pthread_t thread;
+    GuessEstimator *estimator;
+    unsigned long long first;
+    unsigned long long last;
+    uint64_t seed;
+}EstimateWorker;
+
+
+// Fills in the samples from first to last
+//
+// A base structure is picked, then a group for each of its replacements,
+// and then a value in each group. Since every value in a group has the same
+// probability only the group needs to be picked. The probability of making
+// that pick is kept so each sample can be weighted by how likely it was to
+// be sampled
+//
+void *estimate_worker(void *arg) {
+    
+    EstimateWorker *worker = arg;
+    GuessEstimator *estimator = worker->estimator;
+    uint64_t state = worker->seed;
+    
+    for (unsigned long long i = worker->first; i < worker->last; i++) {
+        
+        int b = alias_pick(&estimator->base_table, &state);
+        PcfgBase *base = estimator->bases[b];
+        double prob = base->prob;
+        double sample_prob = estimator->base_table.pick_prob[b];
+        
+        for (int j = 0; j < base->size; j++) {
+            int type = base->value[j].type;
+            int id = base->value[j].id;
+            AliasTable *table = &estimator->group_table[type][id];
+            
+            int g = alias_pick(table, &state);
+            PcfgReplacements *group = estimator->groups[type][id][g];
+            prob *= group->prob;
+            sample_prob *= estimator->value_prob[type][id][g];
+        }
+        
+        estimator->samples[i].prob = prob;
+        estimator->samples[i].weight = 1.0 / ((double) estimator->num_samples * sample_prob);
+    }
+    return NULL;
+}
+
+
+// Sorts samples from most to least probable
+//
+int compare_samples(const void *a, const void *b) {
+    double prob_a = ((const EstimateSample *) a)->prob;
+    double prob_b = ((const EstimateSample *) b)->prob;
+    if (prob_a > prob_b) {
+        return -1;
+    }
+    if (prob_a < prob_b) {
+        return 1;
+    }
+    return 0;
+}
+
+
+// Builds the alias table for one terminal
+//
+// Function returns 0 if it worked ok, 1 if there was a memory allocation error
+//
+int create_group_table(GuessEstimator *estimator, int type, int id) {
+    
+    int num_groups = 0;
+    for (PcfgReplacements *cur = estimator->pcfg->terminals[type][id]; cur != NULL; cur = cur->child) {
+        num_groups++;
+    }
+    if (num_groups == 0) {
+        return 0;
+    }
+    
+    PcfgReplacements **groups = malloc(num_groups * sizeof(PcfgReplacements *));
+    double *weights = malloc(num_groups * sizeof(double));
+    if ((groups == NULL) || (weights == NULL)) {
+        free(groups);
+        free(weights);
+        return 1;
+    }
+    
+    int i = 0;
+    for (PcfgReplacements *cur = estimator->pcfg->terminals[type][id]; cur != NULL; cur = cur->child) {
+        groups[i] = cur;
+        weights[i] = cur->prob * (double) group_guess_count(estimator->pcfg, cur);
+        i++;
+    }
+    estimator->groups[type][id] = groups;
+    
+    AliasTable *table = &estimator->group_table[type][id];
+    int ret = create_alias_table(weights, num_groups, table);
+    free(weights);
+    if ((ret != 0) || (table->size == 0)) {
+        return ret;
+    }
+    
+    estimator->value_prob[type][id] = malloc(num_groups * sizeof(double));
+    if (estimator->value_prob[type][id] == NULL) {
+        return 1;
+    }
+    for (i = 0; i < num_groups; i++) {
+        estimator->value_prob[type][id][i] = table->pick_prob[i] / (double) group_guess_count(estimator->pcfg, groups[i]);
+    }
+    return 0;
+}
+
+
+// Samples the grammar and sets up the estimator
+//
+// Follows Dell'Amico and Filippone. num_samples guesses are sampled from the
+// grammar, and the number of guesses more probable than p is estimated as
+// the sum of 1 / (num_samples * q) over the samples more probable than p,
+// where q is the chance of that sample being picked. Base structures whose
+// terminals were pruned, (or are missing), can't be sampled and are left out
+//
+// The sampling is split between threads
+//
+// Function returns 0 if it worked ok, 1 if an error occured
+//
+int create_estimator(PcfgGrammar *pcfg, unsigned long long num_samples, int threads, GuessEstimator *estimator) {
+    
+    memset(estimator, 0, sizeof(GuessEstimator));
+    estimator->pcfg = pcfg;
+    
+    if ((num_samples == 0) || (num_samples > MAX_ESTIMATE_SAMPLES)) {
+        fprintf(stderr, "Error, the number of samples must be between 1 and %llu\n", MAX_ESTIMATE_SAMPLES);
+        return 1;
+    }
+    
+    for (int type = 0; type < PCFG_NUM_TYPES; type++) {
+        for (int id = 0; id <= MAX_TERM_LENGTH; id++) {
+            if (create_group_table(estimator, type, id) != 0) {
+                fprintf(stderr, "Error allocating memory for the estimator\n");
+                return 1;
+            }
+        }
+    }
+    
+    for (PcfgBase *cur = pcfg->base_structures; cur != NULL; cur = cur->next) {
+        estimator->num_bases++;
+    }
+    if (estimator->num_bases == 0) {
+        fprintf(stderr, "Error, there are no base structures to sample from\n");
+        return 1;
+    }
+    estimator->bases = malloc(estimator->num_bases * sizeof(PcfgBase *));
+    double *weights = malloc(estimator->num_bases * sizeof(double));
+    if ((estimator->bases == NULL) || (weights == NULL)) {
+        free(weights);
+        fprintf(stderr, "Error allocating memory for the estimator\n");
+        return 1;
+    }
+    
+    int i = 0;
+    for (PcfgBase *cur = pcfg->base_structures; cur != NULL; cur = cur->next) {
+        estimator->bases[i] = cur;
+        weights[i] = cur->prob;
+        for (int j = 0; j < cur->size; j++) {
+            int type = cur->value[j].type;
+            int id = cur->value[j].id;
+            if ((type >= PCFG_NUM_TYPES) || (id < 0) || (id > MAX_TERM_LENGTH) || (estimator->group_table[type][id].size == 0)) {
+                weights[i] = 0.0;
+                break;
+            }
+        }
+        i++;
+    }
+    int ret = create_alias_table(weights, estimator->num_bases, &estimator->base_table);
+    free(weights);
+    if (ret != 0) {
+        fprintf(stderr, "Error allocating memory for the estimator\n");
+        return 1;
+    }
+    if (estimator->base_table.size == 0) {
+        fprintf(stderr, "Error, there are no base structures to sample from\n");
+        return 1;
+    }
+    
+    estimator->num_samples = num_samples;
+    estimator->samples = malloc(num_samples * sizeof(EstimateSample));
+    estimator->guess_number = malloc((num_samples + 1) * sizeof(double));
+    EstimateWorker *workers = malloc(threads * sizeof(EstimateWorker));
+    if ((estimator->samples == NULL) || (estimator->guess_number == NULL) || (workers == NULL)) {
+        free(workers);
+        fprintf(stderr, "Error allocating memory for %llu samples\n", num_samples);
+        return 1;
+    }
+    
+    // Every thread gets its own generator. The seeds are fixed so the same
+    // grammar always gives the same estimates
+    unsigned long long per_thread = (num_samples + threads - 1) / threads;
+    for (int t = 0; t < threads; t++) {
+        workers[t].estimator = estimator;
+        workers[t].first = (unsigned long long) t * per_thread;
+        workers[t].last = workers[t].first + per_thread;
+        if (workers[t].first > num_samples) {
+            workers[t].first = num_samples;
+        }
+        if (workers[t].last > num_samples) {
+            workers[t].last = num_samples;
+        }
+        workers[t].seed = 0x5EED0000ULL + t;
+        
+        // If a thread can't be started, do the work here instead
+        if ((t == threads - 1) || (pthread_create(&workers[t].thread, NULL, estimate_worker, &workers[t]) != 0)) {
+            estimate_worker(&workers[t]);
+            workers[t].thread = pthread_self();
+        }
+    }
+    for (int t = 0; t < threads; t++) {
+        if (!pthread_equal(workers[t].thread, pthread_self())) {
+            pthread_join(workers[t].thread, NULL);
+        }
+    }
+    free(workers);
+    
+    qsort(estimator->samples, num_samples, sizeof(EstimateSample), compare_samples);
+    
+    estimator->guess_number[0] = 0.0;
+    for (unsigned long long j = 0; j < num_samples; j++) {
+        estimator->guess_number[j + 1] = estimator->guess_number[j] + estimator->samples[j].weight;
+    }
+    
+    return 0;
+}
+
+
+// Returns the estimated number of guesses made before one with probability prob
+//
+// This is the estimated number of guesses that are more probable than prob.
+// Guesses with the same probability are not counted
+//
+double estimate_guess_number(GuessEstimator *estimator, double prob) {
+    
+    // Find the first sample that isn't more probable than prob
+    unsigned long long low = 0;
+    unsigned long long high = estimator->num_samples;
+    while (low < high) {
+        unsigned long long mid = low + (high - low) / 2;
+        if (estimator->samples[mid].prob > prob) {
+            low = mid + 1;
+        }
+        else {
+            high = mid;
+        }
+    }
+    return estimator->guess_number[low];
+}
+
+
+// Reads probabilities from fp, one per line, and writes out their estimated
+// guess numbers
+//
+// Each line of output is the probability and the guess number, tab separated.
+// Lines that aren't a probability are reported and skipped
+//
+// Function returns 0 if it worked ok, 1 if an error occured
+//
+int estimate_from_file(GuessEstimator *estimator, FILE *fp) {
+    
+    char buff[256];
+    while (fgets(buff, sizeof(buff), fp) != NULL) {
+        
+        char *end;
+        double prob = strtod(buff, &end);
+        if (end == buff) {
+            fprintf(stderr, "Skipping line that isn't a probability: %s", buff);
+            continue;
+        }
+        printf("%.10g\t%.0f\n", prob, estimate_guess_number(estimator, prob));
+    }
+    if (ferror(fp)) {
+        fprintf(stderr, "Error reading the probabilities\n");
+        return 1;
+    }
+    return 0;
+}
+
+
+// Frees everything the estimator allocated
+//
+void free_estimator(GuessEstimator *estimator) {
+    
+    for (int type = 0; type < PCFG_NUM_TYPES; type++) {
+        for (int id = 0; id <= MAX_TERM_LENGTH; id++) {
+            free(estimator->groups[type][id]);
+            free(estimator->value_prob[type][id]);
+            free_alias_table(&estimator->group_table[type][id]);
+        }
+    }
+    free(estimator->bases);
+    free_alias_table(&estimator->base_table);
+    free(estimator->samples);
+    free(estimator->guess_number);
+}
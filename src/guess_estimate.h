@@ -0,0 +1,117 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Pretty Cool Fuzzy Guesser (PCFG)
+//  --Probabilistic Context Free Grammar (PCFG) Password Guessing Program
+//
+//  Written by Matt Weir
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//
+
+
+
+#ifndef _GUESS_ESTIMATE_H
+#define _GUESS_ESTIMATE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "grammar.h"
+#include "markov_guess.h"
+#include "pcfg_pqueue.h"
+
+
+// The most samples that can be taken. Each one takes 16 bytes
+#define MAX_ESTIMATE_SAMPLES 1000000000ULL
+
+
+// Walker's alias table for picking one of size items in constant time
+//
+// Item i is picked by choosing a slot uniformly and then keeping i with
+// probability keep[i], or taking alias[i] instead
+//
+typedef struct AliasTable {
+    
+    int size;
+    double *keep;
+    int *alias;
+    
+    // The normalized probability of picking each item
+    double *pick_prob;
+    
+}AliasTable;
+
+
+// One sampled guess
+typedef struct EstimateSample {
+    
+    // The probability the grammar gives to the guess
+    double prob;
+    
+    // 1 / (number of samples * probability the guess was sampled with)
+    double weight;
+    
+}EstimateSample;
+
+
+// Estimates how many guesses will be made before a guess of a given
+// probability, by sampling from the grammar. See Dell'Amico and Filippone,
+// "Monte Carlo Strength Evaluation", CCS 2015
+//
+typedef struct GuessEstimator {
+    
+    PcfgGrammar *pcfg;
+    
+    // The base structures, and an alias table for picking one
+    int num_bases;
+    PcfgBase **bases;
+    AliasTable base_table;
+    
+    // An alias table for picking a group from each terminal. Indexed the
+    // same way as PcfgGrammar.terminals. Groups are weighted by how much
+    // probability they cover, (prob * number of values)
+    PcfgReplacements **groups[PCFG_NUM_TYPES][MAX_TERM_LENGTH + 1];
+    AliasTable group_table[PCFG_NUM_TYPES][MAX_TERM_LENGTH + 1];
+    
+    // The chance of sampling each value of each group, (the chance of
+    // picking the group divided by the number of values in it)
+    double *value_prob[PCFG_NUM_TYPES][MAX_TERM_LENGTH + 1];
+    
+    // The samples, most probable first. guess_number[i] is the estimated
+    // number of guesses that are more probable than samples[i]
+    unsigned long long num_samples;
+    EstimateSample *samples;
+    double *guess_number;
+    
+}GuessEstimator;
+
+
+// Samples the grammar and sets up the estimator
+extern int create_estimator(PcfgGrammar *pcfg, unsigned long long num_samples, int threads, GuessEstimator *estimator);
+
+// Returns the estimated number of guesses made before one with probability prob
+extern double estimate_guess_number(GuessEstimator *estimator, double prob);
+
+// Reads probabilities from fp and writes out their estimated guess numbers
+extern int estimate_from_file(GuessEstimator *estimator, FILE *fp);
+
+// Frees everything the estimator allocated
+extern void free_estimator(GuessEstimator *estimator);
+
+#endif
@@ -0,0 +1,168 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Pretty Cool Fuzzy Guesser (PCFG)
+//  --Probabilistic Context Free Grammar (PCFG) Password Guessing Program
+//
+//  Written by Matt Weir
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//
+
+
+
+#include "guess_index.h"
+
+
+// Starts a new index file
+//
+// The index is only valid for the ruleset and options it was made with, so
+// the ruleset's name and order_hash, (see guess_order_hash()), are saved in
+// the header
+//
+// Returns NULL if the file couldn't be created
+//
+FILE *create_guess_index(char *filename, char *rule_name, uint64_t order_hash) {
+    
+    FILE *fp = fopen(filename, "w");
+    if (fp == NULL) {
+        fprintf(stderr, "Error. Could not create the index file: %s\n", filename);
+        return NULL;
+    }
+    fprintf(fp, "%s\t%s\t%016llx\n", GUESS_INDEX_HEADER, rule_name, (unsigned long long) order_hash);
+    return fp;
+}
+
+
+// Saves a record to an index file
+//
+void save_index_record(FILE *fp, unsigned long long pops, unsigned long long guesses) {
+    fprintf(fp, "%llu\t%llu\n", pops, guesses);
+}
+
+
+// Loads an index file
+//
+// Function returns 0 if it worked ok
+//
+// Returns 1 if the file couldn't be read, was made with a different ruleset
+// or options, or is malformed
+//
+int load_guess_index(char *filename, char *rule_name, uint64_t order_hash, GuessIndex *index) {
+    
+    index->size = 0;
+    index->pops = NULL;
+    index->guesses = NULL;
+    
+    FILE *fp = fopen(filename, "r");
+    if (fp == NULL) {
+        fprintf(stderr, "Error. Could not read the index file: %s\n", filename);
+        return 1;
+    }
+    
+    // Check that it was made with the same ruleset and options
+    char buff[512];
+    char expected[512];
+    snprintf(expected, sizeof(expected), "%s\t%s\t%016llx\n", GUESS_INDEX_HEADER, rule_name, (unsigned long long) order_hash);
+    if ((fgets(buff, sizeof(buff), fp) == NULL) || (strcmp(buff, expected) != 0)) {
+        fprintf(stderr, "Error. The index file wasn't made with this ruleset and these options: %s\n", filename);
+        fclose(fp);
+        return 1;
+    }
+    
+    size_t max_size = 0;
+    while (fgets(buff, sizeof(buff), fp)) {
+        
+        unsigned long long pops;
+        unsigned long long guesses;
+        if (sscanf(buff, "%llu\t%llu", &pops, &guesses) != 2) {
+            fprintf(stderr, "Error. Malformed index file: %s\n", filename);
+            fclose(fp);
+            free_guess_index(index);
+            return 1;
+        }
+        
+        // Records have to be in order for the binary search to work
+        if ((index->size != 0) && ((pops <= index->pops[index->size - 1]) || (guesses < index->guesses[index->size - 1]))) {
+            fprintf(stderr, "Error. Malformed index file: %s\n", filename);
+            fclose(fp);
+            free_guess_index(index);
+            return 1;
+        }
+        
+        if (index->size == max_size) {
+            max_size = (max_size == 0) ? 1024 : max_size * 2;
+            unsigned long long *new_pops = realloc(index->pops, max_size * sizeof(unsigned long long));
+            if (new_pops != NULL) {
+                index->pops = new_pops;
+            }
+            unsigned long long *new_guesses = realloc(index->guesses, max_size * sizeof(unsigned long long));
+            if (new_guesses != NULL) {
+                index->guesses = new_guesses;
+            }
+            if ((new_pops == NULL) || (new_guesses == NULL)) {
+                fclose(fp);
+                free_guess_index(index);
+                return 1;
+            }
+        }
+        index->pops[index->size] = pops;
+        index->guesses[index->size] = guesses;
+        index->size++;
+    }
+    
+    fclose(fp);
+    return 0;
+}
+
+
+// Finds the last record at or before a guess number
+//
+// pops and guesses are set to 0 if there isn't one
+//
+void find_index_record(GuessIndex *index, unsigned long long guess_num, unsigned long long *pops, unsigned long long *guesses) {
+    
+    // Find the first record past guess_num
+    size_t low = 0;
+    size_t high = index->size;
+    while (low < high) {
+        size_t mid = low + ((high - low) / 2);
+        if (index->guesses[mid] <= guess_num) {
+            low = mid + 1;
+        }
+        else {
+            high = mid;
+        }
+    }
+    
+    if (low == 0) {
+        (*pops) = 0;
+        (*guesses) = 0;
+        return;
+    }
+    (*pops) = index->pops[low - 1];
+    (*guesses) = index->guesses[low - 1];
+}
+
+
+// Frees an index loaded by load_guess_index()
+//
+void free_guess_index(GuessIndex *index) {
+    free(index->pops);
+    free(index->guesses);
+    index->pops = NULL;
+    index->guesses = NULL;
+    index->size = 0;
+}
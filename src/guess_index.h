@@ -0,0 +1,70 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Pretty Cool Fuzzy Guesser (PCFG)
+//  --Probabilistic Context Free Grammar (PCFG) Password Guessing Program
+//
+//  Written by Matt Weir
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//
+
+
+
+#ifndef _GUESS_INDEX_H
+#define _GUESS_INDEX_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+
+// A record is saved every time this many pre-terminals have been popped
+#define GUESS_INDEX_INTERVAL 1024
+
+// The first line of an index file. Followed by the name of the ruleset and
+// the hash of the options that change the guess order
+#define GUESS_INDEX_HEADER "#pcfg_guesser index"
+
+
+// Cumulative guess counts at pre-terminal boundaries
+//
+// After pops[i] pre-terminals have been popped off the priority queue,
+// guesses[i] guesses have been made. Both are in ascending order
+//
+typedef struct GuessIndex {
+    size_t size;
+    unsigned long long *pops;
+    unsigned long long *guesses;
+} GuessIndex;
+
+
+// Starts a new index file
+extern FILE *create_guess_index(char *filename, char *rule_name, uint64_t order_hash);
+
+// Saves a record to an index file
+extern void save_index_record(FILE *fp, unsigned long long pops, unsigned long long guesses);
+
+// Loads an index file
+extern int load_guess_index(char *filename, char *rule_name, uint64_t order_hash, GuessIndex *index);
+
+// Finds the last record at or before a guess number
+extern void find_index_record(GuessIndex *index, unsigned long long guess_num, unsigned long long *pops, unsigned long long *guesses);
+
+// Frees an index loaded by load_guess_index()
+extern void free_guess_index(GuessIndex *index);
+
+#endif
@@ -0,0 +1,240 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Pretty Cool Fuzzy Guesser (PCFG)
+//  --Probabilistic Context Free Grammar (PCFG) Password Guessing Program
+//
+//  Written by Matt Weir
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//
+
+
+
+#include "guess_ring.h"
+
+
+// Creates the ring at path with size MB of room for guesses
+//
+// The ring is built under a temporary name and then renamed, so a consumer
+// that is waiting for path never sees it half set up
+//
+// Returns NULL if an error occured
+//
+GuessRing *create_guess_ring(char *path, unsigned long size) {
+    
+    GuessRing *ring = calloc(1, sizeof(GuessRing));
+    if (ring == NULL) {
+        fprintf(stderr, "Error allocating memory for the ring\n");
+        return NULL;
+    }
+    ring->path = path;
+    ring->size = (uint64_t) size * 1024 * 1024;
+    ring->map_size = sizeof(PcfgRingHeader) + ring->size;
+    
+    // mkstemp makes a new file in the same directory with O_EXCL, so it
+    // never opens, (or truncates), a file someone else put there
+    char temp_path[PATH_MAX + 8];
+    snprintf(temp_path, sizeof(temp_path), "%s.XXXXXX", path);
+    int fd = mkstemp(temp_path);
+    if (fd == -1) {
+        fprintf(stderr, "Error creating the ring %s: %s\n", temp_path, strerror(errno));
+        free(ring);
+        return NULL;
+    }
+    if (ftruncate(fd, ring->map_size) != 0) {
+        fprintf(stderr, "Error sizing the ring %s: %s\n", temp_path, strerror(errno));
+        close(fd);
+        unlink(temp_path);
+        free(ring);
+        return NULL;
+    }
+    void *map = mmap(NULL, ring->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Error mapping the ring %s: %s\n", temp_path, strerror(errno));
+        unlink(temp_path);
+        free(ring);
+        return NULL;
+    }
+    
+    ring->header = map;
+    ring->data = (char *) map + sizeof(PcfgRingHeader);
+    memcpy(ring->header->magic, PCFG_RING_MAGIC, 8);
+    ring->header->size = ring->size;
+    ring->header->producer_pid = (uint32_t) getpid();
+    
+    if (rename(temp_path, path) != 0) {
+        fprintf(stderr, "Error creating the ring %s: %s\n", path, strerror(errno));
+        munmap(map, ring->map_size);
+        unlink(temp_path);
+        free(ring);
+        return NULL;
+    }
+    return ring;
+}
+
+
+// Waits until the consumer has read enough that there are needed bytes free
+// after head
+//
+// Function returns 0 if it worked ok, 1 if the consumer went away
+//
+static int wait_for_room(GuessRing *ring, uint64_t needed) {
+    
+    PcfgRingHeader *header = ring->header;
+    while (ring->size - (ring->head - __atomic_load_n(&header->tail, __ATOMIC_ACQUIRE)) < needed) {
+        
+        // Same as the consumer in pcfg_ring_next()
+        __atomic_store_n(&header->producer_waiting, 1, __ATOMIC_SEQ_CST);
+        uint32_t seq = __atomic_load_n(&header->tail_seq, __ATOMIC_SEQ_CST);
+        if (ring->size - (ring->head - __atomic_load_n(&header->tail, __ATOMIC_SEQ_CST)) < needed) {
+            if (!pcfg_ring_alive(__atomic_load_n(&header->consumer_pid, __ATOMIC_ACQUIRE))) {
+                __atomic_store_n(&header->producer_waiting, 0, __ATOMIC_SEQ_CST);
+                fprintf(stderr, "Error, the consumer of the ring %s went away\n", ring->path);
+                ring->failed = 1;
+                return 1;
+            }
+            ring->waits++;
+            pcfg_ring_wait(&header->tail_seq, seq);
+        }
+        __atomic_store_n(&header->producer_waiting, 0, __ATOMIC_SEQ_CST);
+    }
+    return 0;
+}
+
+
+// Starts a new batch after head, wrapping around to the start of the data
+// if a full batch wouldn't fit before the end
+//
+// Function returns 0 if it worked ok, 1 if the consumer went away
+//
+static int open_batch(GuessRing *ring) {
+    
+    uint64_t offset = ring->head % ring->size;
+    uint64_t skip = 0;
+    if (ring->size - offset < sizeof(PcfgRingBatch) + PCFG_RING_BATCH_SIZE) {
+        skip = ring->size - offset;
+    }
+    if (wait_for_room(ring, skip + sizeof(PcfgRingBatch) + PCFG_RING_BATCH_SIZE) != 0) {
+        return 1;
+    }
+    if (skip != 0) {
+        ((PcfgRingBatch *) (ring->data + offset))->len = PCFG_RING_WRAP;
+    }
+    
+    ring->batch = ring->head + skip;
+    ring->len = 0;
+    ring->num_guesses = 0;
+    ring->open = 1;
+    return 0;
+}
+
+
+// Hands the open batch to the consumer, waking it up if it is waiting
+//
+static void publish_batch(GuessRing *ring) {
+    
+    PcfgRingHeader *header = ring->header;
+    PcfgRingBatch *batch = (PcfgRingBatch *) (ring->data + (ring->batch % ring->size));
+    batch->len = ring->len;
+    batch->num_guesses = ring->num_guesses;
+    
+    ring->head = ring->batch + sizeof(PcfgRingBatch) + ((ring->len + 7) & ~7u);
+    __atomic_store_n(&header->head, ring->head, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&header->head_seq, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&header->consumer_waiting, __ATOMIC_SEQ_CST) == 1) {
+        pcfg_ring_wake(&header->head_seq);
+    }
+    
+    ring->batches_sent++;
+    ring->guesses_sent += ring->num_guesses;
+    ring->open = 0;
+}
+
+
+// Copies whole guesses, (each ending in a newline), into the ring
+//
+// Function returns 0 if it worked ok, 1 if the consumer went away
+//
+int ring_guesses(GuessRing *ring, const char *guesses, size_t len) {
+    
+    if (ring->failed) {
+        return 1;
+    }
+    
+    while (len > 0) {
+        
+        if ((ring->open == 0) && (open_batch(ring) != 0)) {
+            return 1;
+        }
+        
+        // Only copy up to the last guess that fits
+        size_t room = PCFG_RING_BATCH_SIZE - ring->len;
+        size_t take = len;
+        if (take > room) {
+            take = room;
+            while ((take > 0) && (guesses[take - 1] != '\n')) {
+                take--;
+            }
+        }
+        
+        char *dest = ring->data + (ring->batch % ring->size) + sizeof(PcfgRingBatch) + ring->len;
+        memcpy(dest, guesses, take);
+        ring->len += take;
+        for (const char *pos = guesses; (pos = memchr(pos, '\n', (guesses + take) - pos)) != NULL; pos++) {
+            ring->num_guesses++;
+        }
+        guesses += take;
+        len -= take;
+        
+        if (len > 0) {
+            publish_batch(ring);
+        }
+    }
+    return 0;
+}
+
+
+// Hands over the last batch, then waits for the consumer to read everything
+// so the ring can be deleted
+//
+// Function returns 0 if it worked ok, 1 if the consumer went away
+//
+int finish_guess_ring(GuessRing *ring) {
+    
+    if (ring->failed) {
+        return 1;
+    }
+    if ((ring->open == 1) && (ring->len != 0)) {
+        publish_batch(ring);
+    }
+    
+    PcfgRingHeader *header = ring->header;
+    __atomic_store_n(&header->done, 1, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&header->head_seq, 1, __ATOMIC_SEQ_CST);
+    pcfg_ring_wake(&header->head_seq);
+    
+    return wait_for_room(ring, ring->size);
+}
+
+
+// Unmaps and deletes the ring
+//
+void free_guess_ring(GuessRing *ring) {
+    munmap(ring->header, ring->map_size);
+    unlink(ring->path);
+    free(ring);
+}
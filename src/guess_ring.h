@@ -0,0 +1,91 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Pretty Cool Fuzzy Guesser (PCFG)
+//  --Probabilistic Context Free Grammar (PCFG) Password Guessing Program
+//
+//  Written by Matt Weir
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//
+
+
+
+#ifndef _GUESS_RING_H
+#define _GUESS_RING_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "global_def.h"
+#include "helper_io.h"
+#include "pcfg_ring.h"
+
+
+// Default size of the ring in MB, --ring_size
+#define DEFAULT_RING_SIZE 64
+
+
+// Writes guesses into a shared memory ring, (see pcfg_ring.h), for another
+// process to read
+//
+// Guesses are copied straight into the next batch in the ring, and the
+// batch is handed to the consumer once it is full. The only system calls
+// are futex waits and wakeups when the ring is full or the consumer is
+// waiting on an empty ring
+//
+typedef struct GuessRing {
+    
+    char *path;
+    PcfgRingHeader *header;
+    char *data;
+    size_t map_size;
+    uint64_t size;
+    
+    // The end of the last batch handed to the consumer
+    uint64_t head;
+    
+    // The batch being filled, if open is 1
+    int open;
+    uint64_t batch;
+    uint32_t len;
+    uint32_t num_guesses;
+    
+    // Set if the consumer went away. Later guesses are dropped
+    int failed;
+    
+    // Stats
+    unsigned long long batches_sent;
+    unsigned long long guesses_sent;
+    unsigned long long waits;
+    
+}GuessRing;
+
+
+// Creates the ring at path with size MB of room for guesses
+extern GuessRing *create_guess_ring(char *path, unsigned long size);
+
+// Copies whole guesses into the ring, waiting for room if needed
+extern int ring_guesses(GuessRing *ring, const char *guesses, size_t len);
+
+// Hands over the last batch and waits for the consumer to read everything
+extern int finish_guess_ring(GuessRing *ring);
+
+// Unmaps and deletes the ring
+extern void free_guess_ring(GuessRing *ring);
+
+#endif
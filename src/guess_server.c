@@ -0,0 +1,296 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Pretty Cool Fuzzy Guesser (PCFG)
+//  --Probabilistic Context Free Grammar (PCFG) Password Guessing Program
+//
+//  Written by Matt Weir
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//
+
+
+
+#include "guess_server.h"
+
+
+// Starts listening for clients on address
+//
+// Returns NULL if an error occured
+//
+GuessServer *create_guess_server(char *address) {
+    
+    GuessServer *server = calloc(1, sizeof(GuessServer));
+    if (server == NULL) {
+        fprintf(stderr, "Error allocating memory for the guess server\n");
+        return NULL;
+    }
+    for (int i = 0; i < SERVE_MAX_CLIENTS; i++) {
+        server->clients[i] = -1;
+    }
+    
+    int is_unix;
+    server->listen_fd = socket_listen(address, &is_unix);
+    if (server->listen_fd == -1) {
+        free(server);
+        return NULL;
+    }
+    if (is_unix == 1) {
+        server->unix_path = address;
+    }
+    return server;
+}
+
+
+// Stops sending to a client
+//
+static void drop_client(GuessServer *server, int client) {
+    close(server->clients[client]);
+    server->clients[client] = -1;
+    server->credits[client] = 0;
+    server->partial_len[client] = 0;
+}
+
+
+// Accepts new clients and reads how many more batches each client is ready
+// for. Waits up to wait_ms for something to happen
+//
+static void poll_clients(GuessServer *server, int wait_ms) {
+    
+    struct pollfd fds[SERVE_MAX_CLIENTS + 1];
+    int slots[SERVE_MAX_CLIENTS + 1];
+    int num_fds = 1;
+    fds[0].fd = server->listen_fd;
+    fds[0].events = POLLIN;
+    for (int i = 0; i < SERVE_MAX_CLIENTS; i++) {
+        if (server->clients[i] != -1) {
+            fds[num_fds].fd = server->clients[i];
+            fds[num_fds].events = POLLIN;
+            slots[num_fds] = i;
+            num_fds++;
+        }
+    }
+    
+    if (poll(fds, num_fds, wait_ms) <= 0) {
+        return;
+    }
+    
+    for (int i = 1; i < num_fds; i++) {
+        if (fds[i].revents == 0) {
+            continue;
+        }
+        
+        // Read every credit that has come in, keeping any part of one
+        int client = slots[i];
+        while (1) {
+            if (recv_some(server->clients[client], &server->partial[client], sizeof(ServeCredit), &server->partial_len[client]) != 0) {
+                drop_client(server, client);
+                break;
+            }
+            if (server->partial_len[client] < sizeof(ServeCredit)) {
+                break;
+            }
+            server->credits[client] += server->partial[client].batches;
+            server->partial_len[client] = 0;
+        }
+    }
+    
+    if (fds[0].revents & POLLIN) {
+        int fd = accept(server->listen_fd, NULL, NULL);
+        int slot = 0;
+        while ((slot < SERVE_MAX_CLIENTS) && (server->clients[slot] != -1)) {
+            slot++;
+        }
+        if ((fd != -1) && (slot == SERVE_MAX_CLIENTS)) {
+            close(fd);
+        }
+        else if (fd != -1) {
+            server->clients[slot] = fd;
+            server->credits[slot] = 0;
+            server->partial_len[slot] = 0;
+            server->num_clients++;
+        }
+    }
+}
+
+
+// Sends the batch to the next client that is ready for one, waiting for
+// one to be ready if needed
+//
+// If sending fails the client is dropped and the batch goes to another
+// client. Batches already sent to a client that drops are lost
+//
+static void send_batch(GuessServer *server) {
+    
+    ServeFrame frame = {server->len, server->num_guesses};
+    poll_clients(server, 0);
+    
+    while (1) {
+        for (int i = 0; i < SERVE_MAX_CLIENTS; i++) {
+            int client = (server->next_client + i) % SERVE_MAX_CLIENTS;
+            if ((server->clients[client] == -1) || (server->credits[client] == 0)) {
+                continue;
+            }
+            if ((send_all(server->clients[client], &frame, sizeof(frame)) != 0) || (send_all(server->clients[client], server->batch, server->len) != 0)) {
+                drop_client(server, client);
+                continue;
+            }
+            server->credits[client]--;
+            server->next_client = client + 1;
+            server->batches_sent++;
+            server->guesses_sent += server->num_guesses;
+            server->len = 0;
+            server->num_guesses = 0;
+            return;
+        }
+        poll_clients(server, 1000);
+    }
+}
+
+
+// Adds whole guesses, (each ending in a newline), to the batch
+//
+// Full batches are sent as they fill up, so this waits if no client is
+// ready for more guesses
+//
+// Function returns 0 if it worked ok
+//
+int serve_guesses(GuessServer *server, const char *guesses, size_t len) {
+    
+    while (len > 0) {
+        
+        // Only copy up to the last guess that fits
+        size_t room = SERVE_BATCH_SIZE - server->len;
+        size_t take = len;
+        if (take > room) {
+            take = room;
+            while ((take > 0) && (guesses[take - 1] != '\n')) {
+                take--;
+            }
+        }
+        
+        memcpy(server->batch + server->len, guesses, take);
+        server->len += take;
+        for (const char *pos = guesses; (pos = memchr(pos, '\n', (guesses + take) - pos)) != NULL; pos++) {
+            server->num_guesses++;
+        }
+        guesses += take;
+        len -= take;
+        
+        if (len > 0) {
+            send_batch(server);
+        }
+    }
+    return 0;
+}
+
+
+// Sends the last batch and tells every client there are no more guesses
+//
+// Function returns 0 if it worked ok
+//
+int finish_guess_server(GuessServer *server) {
+    
+    if (server->len != 0) {
+        send_batch(server);
+    }
+    
+    ServeFrame frame = {0, 0};
+    for (int i = 0; i < SERVE_MAX_CLIENTS; i++) {
+        if (server->clients[i] != -1) {
+            send_all(server->clients[i], &frame, sizeof(frame));
+            shutdown(server->clients[i], SHUT_WR);
+        }
+    }
+    
+    // Wait for the clients to hang up. Closing with their credits still
+    // unread can reset the connection and throw away batches they haven't
+    // read yet
+    ServeCredit credit;
+    for (int i = 0; i < SERVE_MAX_CLIENTS; i++) {
+        if (server->clients[i] != -1) {
+            while (recv_all(server->clients[i], &credit, sizeof(credit)) == 0);
+            drop_client(server, i);
+        }
+    }
+    return 0;
+}
+
+
+// Closes every connection and frees the server
+//
+void free_guess_server(GuessServer *server) {
+    for (int i = 0; i < SERVE_MAX_CLIENTS; i++) {
+        if (server->clients[i] != -1) {
+            close(server->clients[i]);
+        }
+    }
+    close(server->listen_fd);
+    if (server->unix_path != NULL) {
+        unlink(server->unix_path);
+    }
+    free(server);
+}
+
+
+// Reads guesses from a server started with --serve and writes them to fp
+//
+// More batches are only asked for once the earlier ones have been written,
+// so if whatever is reading fp falls behind, the server sends the guesses
+// to other clients instead
+//
+// Function returns 0 if it worked ok, 1 if the connection was lost
+//
+int read_guess_server(char *address, FILE *fp) {
+    
+    int fd = socket_connect(address);
+    if (fd == -1) {
+        return 1;
+    }
+    
+    char *batch = malloc(SERVE_BATCH_SIZE);
+    ServeCredit credit = {SERVE_CLIENT_CREDITS};
+    if ((batch == NULL) || (send_all(fd, &credit, sizeof(credit)) != 0)) {
+        free(batch);
+        close(fd);
+        return 1;
+    }
+    
+    int ret = 1;
+    ServeFrame frame;
+    credit.batches = 1;
+    while (recv_all(fd, &frame, sizeof(frame)) == 0) {
+        if (frame.len == 0) {
+            ret = 0;
+            break;
+        }
+        if ((frame.len > SERVE_BATCH_SIZE) || (recv_all(fd, batch, frame.len) != 0)) {
+            break;
+        }
+        if ((fwrite(batch, 1, frame.len, fp) != frame.len) || (fflush(fp) != 0)) {
+            break;
+        }
+        if (send_all(fd, &credit, sizeof(credit)) != 0) {
+            break;
+        }
+    }
+    if (ret != 0) {
+        fprintf(stderr, "Error, lost the connection to the guess server\n");
+    }
+    
+    free(batch);
+    close(fd);
+    return ret;
+}
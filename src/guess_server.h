@@ -0,0 +1,120 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Pretty Cool Fuzzy Guesser (PCFG)
+//  --Probabilistic Context Free Grammar (PCFG) Password Guessing Program
+//
+//  Written by Matt Weir
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//
+
+
+
+#ifndef _GUESS_SERVER_H
+#define _GUESS_SERVER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <poll.h>
+
+#include "global_def.h"
+#include "socket_io.h"
+
+
+// Guesses are sent in batches of about this many bytes. A batch only ever
+// holds whole guesses
+#define SERVE_BATCH_SIZE 65536
+
+// The most clients that can be connected at once
+#define SERVE_MAX_CLIENTS 256
+
+// The number of batches --client asks for up front. It asks for one more
+// every time it has written one out, so a slow client is never sent more
+// than this many batches ahead
+#define SERVE_CLIENT_CREDITS 4
+
+
+// Sent by the server before each batch of guesses. The guesses follow, one
+// per line. A frame with a len of 0 means there are no more guesses
+typedef struct ServeFrame {
+    uint32_t len;
+    uint32_t num_guesses;
+} ServeFrame;
+
+
+// Sent by a client to ask for more batches
+typedef struct ServeCredit {
+    uint32_t batches;
+} ServeCredit;
+
+
+// Hands out batches of guesses, in order, to the clients that ask for them
+//
+// Each client says how many batches it is ready for. A batch goes to the
+// next client, (round robin), that still has room for one. If no client has
+// room, generating guesses waits until one does. Every guess is sent to
+// one client. Batches a client was sent but hadn't read when it dropped
+// are lost, so each guess is delivered at most once
+//
+typedef struct GuessServer {
+    
+    int listen_fd;
+    char *unix_path;
+    
+    // Connected clients, -1 for unused slots, and how many more batches
+    // each one is ready for
+    int clients[SERVE_MAX_CLIENTS];
+    uint32_t credits[SERVE_MAX_CLIENTS];
+    int next_client;
+    
+    // The part of each client's next ServeCredit that has been read.
+    // Credits are read without waiting, so a client that only sent part
+    // of one can't hold up the others
+    ServeCredit partial[SERVE_MAX_CLIENTS];
+    size_t partial_len[SERVE_MAX_CLIENTS];
+    
+    // The batch being filled
+    char batch[SERVE_BATCH_SIZE];
+    size_t len;
+    uint32_t num_guesses;
+    
+    // Stats
+    unsigned long long batches_sent;
+    unsigned long long guesses_sent;
+    unsigned long long num_clients;
+    
+}GuessServer;
+
+
+// Starts listening for clients
+extern GuessServer *create_guess_server(char *address);
+
+// Adds whole guesses to the batch, sending batches as they fill up
+extern int serve_guesses(GuessServer *server, const char *guesses, size_t len);
+
+// Sends the last batch and tells every client there are no more guesses
+extern int finish_guess_server(GuessServer *server);
+
+// Closes every connection and frees the server
+extern void free_guess_server(GuessServer *server);
+
+// Reads guesses from a server and writes them to fp
+extern int read_guess_server(char *address, FILE *fp);
+
+#endif
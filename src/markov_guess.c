@@ -0,0 +1,225 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Pretty Cool Fuzzy Guesser (PCFG)
+//  --Probabilistic Context Free Grammar (PCFG) Password Guessing Program
+//
+//  Written by Matt Weir
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//
+
+
+
+#include "markov_guess.h"
+
+
+// Holds everything that doesn't change while walking the Markov model to
+// generate a guess of a particular length
+typedef struct MarkovWalk {
+    MarkovGrammar *markov;
+    
+    // The number of (ngram - 1) character prefixes
+    size_t ip_size;
+    
+    // The number of characters in the guesses being generated
+    int length;
+    
+    char *cur_guess;
+    MarkovCallback callback;
+    void *context;
+} MarkovWalk;
+
+
+// Adds characters to a guess until it is the target length, only following
+// ngrams that exactly use up the remaining level
+//
+// state is the index of the last (ngram - 1) characters of the guess
+//
+void markov_walk(MarkovWalk *walk, int pos, size_t state, int remaining, int guess_len) {
+    
+    MarkovGrammar *markov = walk->markov;
+    
+    if (pos == walk->length) {
+        if (remaining == 0) {
+            walk->callback(walk->context, walk->cur_guess, guess_len);
+        }
+        return;
+    }
+    
+    // Even picking the least likely ngram for every character left won't
+    // use up the remaining level
+    if (remaining > (walk->length - pos) * markov->max_level) {
+        return;
+    }
+    
+    unsigned char *levels = markov->cp_level + (state * markov->alphabet_size);
+    
+    for (int c = 0; c < markov->alphabet_size; c++) {
+        
+        // Unseen ngrams are MARKOV_UNSEEN, which is always skipped here
+        if (levels[c] > remaining) {
+            continue;
+        }
+        
+        int char_len = markov->alphabet_len[c];
+        
+        // Need to leave room for the newline
+        if (guess_len + char_len >= MAX_GUESS_SIZE - 1) {
+            continue;
+        }
+        memcpy(walk->cur_guess + guess_len, markov->alphabet[c], char_len);
+        
+        size_t next_state = ((state * markov->alphabet_size) + c) % walk->ip_size;
+        markov_walk(walk, pos + 1, next_state, remaining - levels[c], guess_len + char_len);
+    }
+}
+
+
+// Generates every guess at a level of the Markov model
+//
+// The guesses are generated one length at a time, starting with every
+// (ngram - 1) character prefix whose level fits, and then walking the ngrams
+// from there. Each guess is appended to cur_guess starting at start_point and
+// then passed to callback.
+//
+// Note: Guesses shorter than (ngram - 1) characters can't be made by the model
+//
+void markov_generate(MarkovGrammar *markov, int level, char *cur_guess, int start_point, MarkovCallback callback, void *context) {
+    
+    MarkovWalk walk;
+    walk.markov = markov;
+    walk.cur_guess = cur_guess;
+    walk.callback = callback;
+    walk.context = context;
+    walk.ip_size = 1;
+    for (int i = 0; i < markov->ngram - 1; i++) {
+        walk.ip_size *= markov->alphabet_size;
+    }
+    
+    int prefix_len = markov->ngram - 1;
+    int letters[MAX_GUESS_SIZE];
+    
+    for (int length = prefix_len; length < MAX_GUESS_SIZE; length++) {
+        
+        if ((markov->ln_level[length] < 0) || (markov->ln_level[length] > level)) {
+            continue;
+        }
+        walk.length = length;
+        int length_remaining = level - markov->ln_level[length];
+        
+        for (size_t prefix = 0; prefix < walk.ip_size; prefix++) {
+            
+            if (markov->ip_level[prefix] > length_remaining) {
+                continue;
+            }
+            
+            // Turn the index back into the characters of the prefix
+            size_t index = prefix;
+            for (int i = prefix_len - 1; i >= 0; i--) {
+                letters[i] = index % markov->alphabet_size;
+                index = index / markov->alphabet_size;
+            }
+            
+            int guess_len = start_point;
+            int fits = 1;
+            for (int i = 0; i < prefix_len; i++) {
+                int char_len = markov->alphabet_len[letters[i]];
+                if (guess_len + char_len >= MAX_GUESS_SIZE - 1) {
+                    fits = 0;
+                    break;
+                }
+                memcpy(cur_guess + guess_len, markov->alphabet[letters[i]], char_len);
+                guess_len += char_len;
+            }
+            if (fits == 0) {
+                continue;
+            }
+            
+            markov_walk(&walk, prefix_len, prefix, length_remaining - markov->ip_level[prefix], guess_len);
+        }
+    }
+}
+
+
+// Returns the Markov level of a group in the Markov terminal
+//
+// The groups are allocated together in order, so the position of the group
+// is its index into group_level
+//
+int markov_group_level(PcfgGrammar *pcfg, PcfgReplacements *group) {
+    return pcfg->markov->group_level[group - pcfg->terminals[PCFG_MARKOV][0]];
+}
+
+
+// Returns the Markov level of a guess, aka the level of its length plus the
+// level of its first (ngram - 1) characters plus the level of every ngram
+// after that
+//
+// Returns -1 if the model can't make the guess, (a character isn't in the
+// alphabet, an ngram wasn't seen, or the length isn't in the model)
+//
+int markov_level(MarkovGrammar *markov, char *guess, int guess_len) {
+    
+    size_t ip_size = 1;
+    for (int i = 0; i < markov->ngram - 1; i++) {
+        ip_size *= markov->alphabet_size;
+    }
+    
+    int level = 0;
+    int num_chars = 0;
+    size_t state = 0;
+    
+    for (int pos = 0; pos < guess_len; ) {
+        
+        int letter = -1;
+        for (int c = 0; c < markov->alphabet_size; c++) {
+            int char_len = markov->alphabet_len[c];
+            if ((pos + char_len <= guess_len) && (memcmp(markov->alphabet[c], guess + pos, char_len) == 0)) {
+                letter = c;
+                break;
+            }
+        }
+        if (letter == -1) {
+            return -1;
+        }
+        
+        if (num_chars < markov->ngram - 1) {
+            state = (state * markov->alphabet_size) + letter;
+            if (num_chars == markov->ngram - 2) {
+                if (markov->ip_level[state] == MARKOV_UNSEEN) {
+                    return -1;
+                }
+                level += markov->ip_level[state];
+            }
+        }
+        else {
+            unsigned char cp_level = markov->cp_level[(state * markov->alphabet_size) + letter];
+            if (cp_level == MARKOV_UNSEEN) {
+                return -1;
+            }
+            level += cp_level;
+            state = ((state * markov->alphabet_size) + letter) % ip_size;
+        }
+        
+        num_chars++;
+        pos += markov->alphabet_len[letter];
+    }
+    
+    if ((num_chars < markov->ngram - 1) || (num_chars >= MAX_GUESS_SIZE) || (markov->ln_level[num_chars] < 0)) {
+        return -1;
+    }
+    return level + markov->ln_level[num_chars];
+}
@@ -0,0 +1,50 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Pretty Cool Fuzzy Guesser (PCFG)
+//  --Probabilistic Context Free Grammar (PCFG) Password Guessing Program
+//
+//  Written by Matt Weir
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//
+
+
+
+#ifndef _MARKOV_GUESS_H
+#define _MARKOV_GUESS_H
+
+#include <stdio.h>
+#include <string.h>
+
+#include "global_def.h"
+#include "grammar.h"
+
+
+// Called for every guess the Markov model generates. cur_guess holds the
+// guess and guess_len is its length
+typedef void (*MarkovCallback)(void *context, char *cur_guess, int guess_len);
+
+// Generates every guess at a level of the Markov model, appending them to
+// cur_guess starting at start_point
+extern void markov_generate(MarkovGrammar *markov, int level, char *cur_guess, int start_point, MarkovCallback callback, void *context);
+
+// Returns the Markov level of a group in the Markov terminal
+extern int markov_group_level(PcfgGrammar *pcfg, PcfgReplacements *group);
+
+// Returns the Markov level of a guess, or -1 if the model can't make it
+extern int markov_level(MarkovGrammar *markov, char *guess, int guess_len);
+
+#endif
@@ -0,0 +1,502 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Pretty Cool Fuzzy Guesser (PCFG)
+//  --Probabilistic Context Free Grammar (PCFG) Password Guessing Program
+//
+//  Written by Matt Weir
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//
+
+
+
+#include "markov_io.h"
+
+
+// Returns the number of bytes in the UTF-8 character that starts with c
+//
+int utf8_char_len(unsigned char c) {
+    if (c < 0x80) {
+        return 1;
+    }
+    if ((c & 0xE0) == 0xC0) {
+        return 2;
+    }
+    if ((c & 0xF0) == 0xE0) {
+        return 3;
+    }
+    if ((c & 0xF8) == 0xF0) {
+        return 4;
+    }
+    // Not a valid start of a character so treat it as a single byte
+    return 1;
+}
+
+
+// Splits a line from one of the Markov files into its level and the text
+// after it
+//
+// The lines are formatted as "level\ttext". The trailing newline is removed
+// from text. For the length file there is no text, so text will be empty
+//
+// Function returns 0 if it worked ok
+//
+// Returns 1 if the line is invalid
+//
+int split_markov_line(char *input, int *level, char **text) {
+    
+    char *split_point;
+    long value = strtol(input, &split_point, 10);
+    
+    if ((split_point == input) || (value < 0) || (value > MAX_MARKOV_LEVEL)) {
+        return 1;
+    }
+    (*level) = value;
+    
+    if (split_point[0] == '\t') {
+        split_point++;
+    }
+    
+    // Remove the newline. Rulesets can be created on Windows so check for \r
+    int text_len = strnlen(split_point, MAX_CONFIG_LINE);
+    while ((text_len > 0) && ((split_point[text_len - 1] == '\n') || (split_point[text_len - 1] == '\r'))) {
+        text_len--;
+    }
+    split_point[text_len] = '\0';
+    (*text) = split_point;
+    
+    return 0;
+}
+
+
+// Converts the characters of an ngram into its index in the level tables
+//
+// The characters are treated as a number in base alphabet_size, with the
+// first character being the most significant digit. byte_index is a lookup
+// table from single byte characters to their position in the alphabet so
+// the common case doesn't have to search the alphabet.
+//
+// If add is 1, characters that aren't in the alphabet are added to it. The
+// index isn't valid in that case since the alphabet size is still changing
+//
+// Function returns the number of characters in the ngram
+//
+// Returns -1 if the ngram has a character that isn't in the alphabet, or
+// the alphabet is full
+//
+int markov_ngram_index(MarkovGrammar *markov, int *byte_index, char *text, int add, size_t *index) {
+    
+    (*index) = 0;
+    int num_chars = 0;
+    
+    for (int pos = 0; text[pos] != '\0'; ) {
+        
+        int char_len = utf8_char_len(text[pos]);
+        for (int i = 1; i < char_len; i++) {
+            if (text[pos + i] == '\0') {
+                return -1;
+            }
+        }
+        
+        int letter = -1;
+        if (char_len == 1) {
+            letter = byte_index[(unsigned char) text[pos]];
+        }
+        else {
+            for (int i = 0; i < markov->alphabet_size; i++) {
+                if ((markov->alphabet_len[i] == char_len) && (memcmp(markov->alphabet[i], text + pos, char_len) == 0)) {
+                    letter = i;
+                    break;
+                }
+            }
+        }
+        
+        if (letter == -1) {
+            if ((add == 0) || (markov->alphabet_size == MAX_MARKOV_ALPHABET)) {
+                return -1;
+            }
+            letter = markov->alphabet_size;
+            markov->alphabet_size++;
+            memcpy(markov->alphabet[letter], text + pos, char_len);
+            markov->alphabet_len[letter] = char_len;
+            if (char_len == 1) {
+                byte_index[(unsigned char) text[pos]] = letter;
+            }
+        }
+        
+        (*index) = ((*index) * markov->alphabet_size) + letter;
+        num_chars++;
+        pos += char_len;
+    }
+    
+    return num_chars;
+}
+
+
+// Reads in one of the ngram level files, (IP.level or CP.level)
+//
+// If levels is NULL, this just builds the alphabet and finds the ngram size
+// from the file. Otherwise the level of every ngram in the file is saved in
+// levels. Ngrams that use characters outside the alphabet are skipped
+//
+// Function returns 0 if it worked ok
+//
+// Returns 1 if the file couldn't be opened
+//
+// Returns 2 if the file is invalid
+//
+int load_markov_levels(char *filename, MarkovGrammar *markov, int *byte_index, int num_chars, unsigned char *levels) {
+    
+    FILE *fp = fopen(filename, "r");
+    if (fp == NULL) {
+        return 1;
+    }
+    
+    char buff[MAX_CONFIG_LINE];
+    while (fgets(buff, MAX_CONFIG_LINE, fp)) {
+        
+        int level;
+        char *text;
+        if (split_markov_line(buff, &level, &text) != 0) {
+            fprintf(stderr, "Invalid line in Markov file: %s\n", filename);
+            fclose(fp);
+            return 2;
+        }
+        
+        // Skip blank lines
+        if (text[0] == '\0') {
+            continue;
+        }
+        
+        size_t index;
+        int ngram_len = markov_ngram_index(markov, byte_index, text, (levels == NULL), &index);
+        if (ngram_len == -1) {
+            if (levels == NULL) {
+                fprintf(stderr, "Too many characters in the Markov alphabet\n");
+                fclose(fp);
+                return 2;
+            }
+            continue;
+        }
+        
+        // The first pass through the starting ngrams sets the ngram size
+        if (num_chars == 0) {
+            num_chars = ngram_len;
+        }
+        if (ngram_len != num_chars) {
+            fprintf(stderr, "Inconsistent ngram size in Markov file: %s\n", filename);
+            fclose(fp);
+            return 2;
+        }
+        
+        if (levels != NULL) {
+            levels[index] = level;
+            if (level > markov->max_level) {
+                markov->max_level = level;
+            }
+        }
+    }
+    fclose(fp);
+    
+    if (markov->ngram == 0) {
+        markov->ngram = num_chars + 1;
+    }
+    
+    return 0;
+}
+
+
+// Reads in the level of every guess length, (LN.level)
+//
+// Line n of the file holds the level for guesses of length n
+//
+// Function returns 0 if it worked ok, 1 if an error occured
+//
+int load_markov_lengths(char *filename, MarkovGrammar *markov) {
+    
+    for (int i = 0; i < MAX_GUESS_SIZE; i++) {
+        markov->ln_level[i] = -1;
+    }
+    
+    FILE *fp = fopen(filename, "r");
+    if (fp == NULL) {
+        fprintf(stderr, "Error. Could not read the file: %s\n", filename);
+        return 1;
+    }
+    
+    char buff[MAX_CONFIG_LINE];
+    int length = 1;
+    while (fgets(buff, MAX_CONFIG_LINE, fp) && (length < MAX_GUESS_SIZE)) {
+        int level;
+        char *text;
+        if (split_markov_line(buff, &level, &text) != 0) {
+            fprintf(stderr, "Invalid line in Markov file: %s\n", filename);
+            fclose(fp);
+            return 1;
+        }
+        markov->ln_level[length] = level;
+        length++;
+    }
+    fclose(fp);
+    
+    return 0;
+}
+
+
+// Reads in the number of guesses at each level, (omen_keyspace.txt)
+//
+// Function returns 0 if it worked ok, 1 if an error occured
+//
+int load_markov_keyspace(char *filename, MarkovGrammar *markov) {
+    
+    FILE *fp = fopen(filename, "r");
+    if (fp == NULL) {
+        fprintf(stderr, "Error. Could not read the file: %s\n", filename);
+        return 1;
+    }
+    
+    char buff[MAX_CONFIG_LINE];
+    while (fgets(buff, MAX_CONFIG_LINE, fp)) {
+        int level;
+        char *text;
+        if (split_markov_line(buff, &level, &text) != 0) {
+            fprintf(stderr, "Invalid line in Markov file: %s\n", filename);
+            fclose(fp);
+            return 1;
+        }
+        markov->keyspace[level] = strtoull(text, NULL, 10);
+    }
+    fclose(fp);
+    
+    return 0;
+}
+
+
+// Holds a level and the probability of each guess in it while the Markov
+// terminal is being created
+typedef struct MarkovLevelInfo {
+    int level;
+    double prob;
+} MarkovLevelInfo;
+
+
+// Used to sort the levels so the most probable is first
+//
+int compare_level_prob(const void *a, const void *b) {
+    double prob_a = ((const MarkovLevelInfo *) a)->prob;
+    double prob_b = ((const MarkovLevelInfo *) b)->prob;
+    if (prob_a > prob_b) {
+        return -1;
+    }
+    if (prob_a < prob_b) {
+        return 1;
+    }
+    return ((const MarkovLevelInfo *) a)->level - ((const MarkovLevelInfo *) b)->level;
+}
+
+
+// Creates the Markov terminal from the probability of each level,
+// (pcfg_omen_prob.txt)
+//
+// The file holds the probability of a password being from each level. That is
+// split evenly across all the guesses in the level to get the probability of
+// each guess, the same as the values in the other terminals.
+//
+// Function returns 0 if it worked ok, 1 if an error occured
+//
+int load_markov_terminal(char *filename, PcfgGrammar *pcfg, PcfgLoadOptions *options) {
+    
+    MarkovGrammar *markov = pcfg->markov;
+    
+    FILE *fp = fopen(filename, "r");
+    if (fp == NULL) {
+        fprintf(stderr, "Error. Could not read the file: %s\n", filename);
+        return 1;
+    }
+    
+    MarkovLevelInfo levels[MAX_MARKOV_LEVEL + 1];
+    int num_levels = 0;
+    
+    char buff[MAX_CONFIG_LINE];
+    while (fgets(buff, MAX_CONFIG_LINE, fp) && (num_levels <= MAX_MARKOV_LEVEL)) {
+        int level;
+        char *text;
+        if (split_markov_line(buff, &level, &text) != 0) {
+            fprintf(stderr, "Invalid line in Markov file: %s\n", filename);
+            fclose(fp);
+            return 1;
+        }
+        double prob = strtod(text, NULL);
+        if ((prob <= 0.0) || (markov->keyspace[level] == 0)) {
+            continue;
+        }
+        prob = prob / (double) markov->keyspace[level];
+        if (prob < options->min_term_prob) {
+            options->pruned_groups++;
+            continue;
+        }
+        levels[num_levels].level = level;
+        levels[num_levels].prob = prob;
+        num_levels++;
+    }
+    fclose(fp);
+    
+    if (num_levels == 0) {
+        return 0;
+    }
+    
+    qsort(levels, num_levels, sizeof(MarkovLevelInfo), compare_level_prob);
+    
+    // Like the other terminals, all the groups are allocated together
+    PcfgReplacements *groups = malloc(num_levels * sizeof(PcfgReplacements));
+    if (groups == NULL) {
+        fprintf(stderr, "Error allocating memory for the Markov terminal\n");
+        return 1;
+    }
+    options->memory_used += num_levels * sizeof(PcfgReplacements);
+    
+    for (int i = 0; i < num_levels; i++) {
+        unsigned long long keyspace = markov->keyspace[levels[i].level];
+        groups[i].size = (keyspace > INT_MAX) ? INT_MAX : (int) keyspace;
+        groups[i].prob = levels[i].prob;
+        groups[i].parent = (i == 0) ? NULL : &groups[i - 1];
+        groups[i].child = (i == num_levels - 1) ? NULL : &groups[i + 1];
+        groups[i].values = NULL;
+        groups[i].offsets = NULL;
+        groups[i].stride = 0;
+        groups[i].range = NULL;
+        groups[i].type = PCFG_MARKOV;
+        groups[i].id = 0;
+        markov->group_level[i] = levels[i].level;
+    }
+    pcfg->terminals[PCFG_MARKOV][0] = groups;
+    
+    return 0;
+}
+
+
+// Loads the Markov model and the Markov terminal from a ruleset
+//
+// The model is the OMEN model created by the trainer. If the ruleset doesn't
+// have one, pcfg->markov is left NULL and any base structures that use it
+// will be skipped
+//
+// Function returns 0 if it worked ok
+//
+// Returns 1 if an error occured
+//
+int load_markov(char *config_filename, char *base_directory, PcfgGrammar *pcfg, PcfgLoadOptions *options) {
+    
+    // Rulesets trained without Markov don't have this section
+    char section_folder[MAX_CONFIG_LINE];
+    if (get_key(config_filename, "BASE_M", "directory", section_folder) != 0) {
+        return 0;
+    }
+    
+    MarkovGrammar *markov = calloc(1, sizeof(MarkovGrammar));
+    if (markov == NULL) {
+        fprintf(stderr, "Error allocating memory for the Markov model\n");
+        return 1;
+    }
+    
+    int byte_index[256];
+    for (int i = 0; i < 256; i++) {
+        byte_index[i] = -1;
+    }
+    
+    char filename[PATH_MAX];
+    
+    // First pass through the starting ngrams to build the alphabet. Don't
+    // treat the model being missing as an error since the trainer can be
+    // told to skip it
+    snprintf(filename, PATH_MAX, "%s%s%c%s", base_directory, section_folder, SLASH, MARKOV_IP_FILE);
+    int ret_value = load_markov_levels(filename, markov, byte_index, 0, NULL);
+    if (ret_value == 1) {
+        free(markov);
+        return 0;
+    }
+    if ((ret_value != 0) || (markov->alphabet_size == 0) || (markov->ngram < 2)) {
+        fprintf(stderr, "Invalid Markov model in the rules\n");
+        free(markov);
+        return 1;
+    }
+    
+    // Figure out how big the level tables are, and make sure they aren't
+    // unreasonably large
+    size_t ip_size = 1;
+    for (int i = 0; i < markov->ngram - 1; i++) {
+        ip_size *= markov->alphabet_size;
+        if (ip_size > ((size_t) 1 << 32) / markov->alphabet_size) {
+            fprintf(stderr, "The Markov model is too large to load\n");
+            free(markov);
+            return 1;
+        }
+    }
+    size_t cp_size = ip_size * markov->alphabet_size;
+    
+    markov->ip_level = malloc(ip_size);
+    markov->cp_level = malloc(cp_size);
+    if ((markov->ip_level == NULL) || (markov->cp_level == NULL)) {
+        fprintf(stderr, "Error allocating memory for the Markov model\n");
+        free_markov(markov);
+        return 1;
+    }
+    memset(markov->ip_level, MARKOV_UNSEEN, ip_size);
+    memset(markov->cp_level, MARKOV_UNSEEN, cp_size);
+    options->memory_used += sizeof(MarkovGrammar) + ip_size + cp_size;
+    pcfg->markov = markov;
+    
+    // Now save the levels
+    if (load_markov_levels(filename, markov, byte_index, markov->ngram - 1, markov->ip_level) != 0) {
+        fprintf(stderr, "Invalid Markov model in the rules\n");
+        return 1;
+    }
+    snprintf(filename, PATH_MAX, "%s%s%c%s", base_directory, section_folder, SLASH, MARKOV_CP_FILE);
+    if (load_markov_levels(filename, markov, byte_index, markov->ngram, markov->cp_level) != 0) {
+        fprintf(stderr, "Invalid Markov model in the rules\n");
+        return 1;
+    }
+    
+    snprintf(filename, PATH_MAX, "%s%s%c%s", base_directory, section_folder, SLASH, MARKOV_LN_FILE);
+    if (load_markov_lengths(filename, markov) != 0) {
+        return 1;
+    }
+    
+    snprintf(filename, PATH_MAX, "%s%s%c%s", base_directory, section_folder, SLASH, MARKOV_KEYSPACE_FILE);
+    if (load_markov_keyspace(filename, markov) != 0) {
+        return 1;
+    }
+    
+    snprintf(filename, PATH_MAX, "%s%s%c%s", base_directory, section_folder, SLASH, MARKOV_PROB_FILE);
+    if (load_markov_terminal(filename, pcfg, options) != 0) {
+        return 1;
+    }
+    
+    return 0;
+}
+
+
+// Frees a Markov model that was loaded by load_markov()
+//
+void free_markov(MarkovGrammar *markov) {
+    
+    if (markov == NULL) {
+        return;
+    }
+    free(markov->ip_level);
+    free(markov->cp_level);
+    free(markov);
+}
@@ -0,0 +1,55 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Pretty Cool Fuzzy Guesser (PCFG)
+//  --Probabilistic Context Free Grammar (PCFG) Password Guessing Program
+//
+//  Written by Matt Weir
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//
+
+
+
+#ifndef _MARKOV_IO_H
+#define _MARKOV_IO_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "global_def.h"
+#include "helper_io.h"
+#include "config_parser.h"
+#include "grammar.h"
+
+
+// The files that make up the Markov, (OMEN), model in a ruleset
+#define MARKOV_IP_FILE "IP.level"
+#define MARKOV_CP_FILE "CP.level"
+#define MARKOV_LN_FILE "LN.level"
+#define MARKOV_KEYSPACE_FILE "omen_keyspace.txt"
+#define MARKOV_PROB_FILE "pcfg_omen_prob.txt"
+
+
+// Loads the Markov model and the Markov terminal from a ruleset
+//
+// If the ruleset doesn't have a Markov model, pcfg->markov is left NULL
+extern int load_markov(char *config_filename, char *base_directory, PcfgGrammar *pcfg, PcfgLoadOptions *options);
+
+// Frees a Markov model that was loaded by load_markov()
+extern void free_markov(MarkovGrammar *markov);
+
+#endif
@@ -0,0 +1,414 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Pretty Cool Fuzzy Guesser (PCFG)
+//  --Probabilistic Context Free Grammar (PCFG) Password Guessing Program
+//
+//  Written by Matt Weir
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//
+
+
+
+#include "masks.h"
+
+
+// The hashcat built in charsets, and the 256 bit sets they match
+typedef struct BuiltinCharset {
+    const char *name;
+    int first;
+    int last;
+    int letters_digits;
+}BuiltinCharset;
+
+// ?s is the printable ASCII characters that aren't letters or digits, and
+// ?a is every printable ASCII character
+static const BuiltinCharset builtin_charsets[] = {
+    {"?d", '0', '9', 1},
+    {"?l", 'a', 'z', 1},
+    {"?u", 'A', 'Z', 1},
+    {"?s", ' ', '~', 0},
+    {"?a", ' ', '~', 1},
+};
+
+
+static inline void set_char(uint64_t *set, unsigned char c) {
+    set[c >> 6] |= (uint64_t) 1 << (c & 63);
+}
+
+
+static inline int has_char(const uint64_t *set, unsigned char c) {
+    return (set[c >> 6] >> (c & 63)) & 1;
+}
+
+
+static int set_size(const uint64_t *set) {
+    return __builtin_popcountll(set[0]) + __builtin_popcountll(set[1]) + __builtin_popcountll(set[2]) + __builtin_popcountll(set[3]);
+}
+
+
+// Fills in the set of characters a built in charset has
+//
+static void builtin_set(const BuiltinCharset *charset, uint64_t *set) {
+    memset(set, 0, 4 * sizeof(uint64_t));
+    for (int c = charset->first; c <= charset->last; c++) {
+        int is_letter_digit = (((c >= '0') && (c <= '9')) || ((c >= 'a') && (c <= 'z')) || ((c >= 'A') && (c <= 'Z')));
+        if ((charset->letters_digits == 1) || (is_letter_digit == 0)) {
+            set_char(set, c);
+        }
+    }
+}
+
+
+// Finds if a group's values are every combination of the characters at
+// each position
+//
+// Range groups are checked from their start and end, since a range is a
+// mask if it is some fixed digits, then one run of digits, then every digit
+// for the rest, (aka 1900-1999). Stored groups have the characters at each
+// position collected and counted
+//
+// Function returns 0 if it worked ok, 1 if memory couldn't be allocated
+//
+static int group_mask(PcfgGrammar *pcfg, PcfgReplacements *group, GroupMask *info) {
+    
+    info->maskable = 0;
+    info->len = 0;
+    info->positions = NULL;
+    
+    int len = (group->range != NULL) ? group->range->width : pcfg_value_len(group, 0);
+    if ((len <= 0) || (len > MAX_GUESS_SIZE)) {
+        return 0;
+    }
+    for (int i = 1; (group->range == NULL) && (i < group->size); i++) {
+        if (pcfg_value_len(group, i) != len) {
+            return 0;
+        }
+    }
+    
+    info->positions = calloc(len, sizeof(*info->positions));
+    if (info->positions == NULL) {
+        return 1;
+    }
+    info->len = len;
+    
+    if (group->range != NULL) {
+        PcfgRange *range = group->range;
+        if (range->num_exceptions != 0) {
+            return 0;
+        }
+        char start[MAX_GUESS_SIZE + 1];
+        char end[MAX_GUESS_SIZE + 1];
+        snprintf(start, sizeof(start), "%0*llu", len, range->start);
+        snprintf(end, sizeof(end), "%0*llu", len, range->end);
+        
+        int pos = 0;
+        while ((pos < len) && (start[pos] == end[pos])) {
+            set_char(info->positions[pos], start[pos]);
+            pos++;
+        }
+        if (pos < len) {
+            for (char c = start[pos]; c <= end[pos]; c++) {
+                set_char(info->positions[pos], c);
+            }
+            for (pos++; pos < len; pos++) {
+                if ((start[pos] != '0') || (end[pos] != '9')) {
+                    return 0;
+                }
+                for (char c = '0'; c <= '9'; c++) {
+                    set_char(info->positions[pos], c);
+                }
+            }
+        }
+        info->maskable = 1;
+        return 0;
+    }
+    
+    for (int i = 0; i < group->size; i++) {
+        const unsigned char *value = (const unsigned char *) pcfg_value(group, i);
+        for (int pos = 0; pos < len; pos++) {
+            set_char(info->positions[pos], value[pos]);
+        }
+    }
+    
+    // The values are unique, so if there are as many of them as there are
+    // combinations, they are all of the combinations
+    unsigned long long combinations = 1;
+    unsigned long long size = group_guess_count(pcfg, group);
+    for (int pos = 0; (pos < len) && (combinations <= size); pos++) {
+        combinations *= set_size(info->positions[pos]);
+    }
+    info->maskable = (combinations == size);
+    return 0;
+}
+
+
+// Finds which groups in the grammar can be written as masks
+//
+// Only digits, years, other, keyboard and context groups are checked.
+// Alpha words always have a capitalization mask applied after them, and
+// Markov groups aren't a fixed set of values
+//
+// Function returns 0 if it worked ok, 1 if memory couldn't be allocated
+//
+int create_mask_index(PcfgGrammar *pcfg, unsigned long long min_keyspace, MaskIndex *index) {
+    
+    memset(index, 0, sizeof(MaskIndex));
+    index->pcfg = pcfg;
+    index->min_keyspace = min_keyspace;
+    
+    const int mask_types[] = {PCFG_DIGITS, PCFG_YEARS, PCFG_OTHER, PCFG_KEYBOARD, PCFG_CONTEXT};
+    for (size_t t = 0; t < sizeof(mask_types) / sizeof(int); t++) {
+        int type = mask_types[t];
+        for (int id = 0; id <= MAX_TERM_LENGTH; id++) {
+            
+            int num_groups = 0;
+            for (PcfgReplacements *cur = pcfg->terminals[type][id]; cur != NULL; cur = cur->child) {
+                num_groups++;
+            }
+            if (num_groups == 0) {
+                continue;
+            }
+            index->groups[type][id] = calloc(num_groups, sizeof(GroupMask));
+            if (index->groups[type][id] == NULL) {
+                return 1;
+            }
+            
+            int i = 0;
+            for (PcfgReplacements *cur = pcfg->terminals[type][id]; cur != NULL; cur = cur->child) {
+                if (group_mask(pcfg, cur, &index->groups[type][id][i]) != 0) {
+                    return 1;
+                }
+                i++;
+            }
+        }
+    }
+    return 0;
+}
+
+
+// Returns the mask info for a group, or NULL if it can't be a mask
+//
+static GroupMask *find_group_mask(MaskIndex *index, PcfgReplacements *group) {
+    GroupMask *groups = index->groups[group->type][group->id];
+    if (groups == NULL) {
+        return NULL;
+    }
+    GroupMask *info = &groups[group - index->pcfg->terminals[group->type][group->id]];
+    return (info->maskable == 1) ? info : NULL;
+}
+
+
+// Finds the custom charset that matches a set, adding it if there is room
+//
+// Returns the number of the charset, (1 to MASK_MAX_CHARSETS), 0 if the set
+// doesn't need a custom charset, or -1 if there isn't room for another one
+//
+static int custom_charset(const uint64_t *set, uint64_t (*charsets)[4], int *num_charsets) {
+    
+    if (set_size(set) == 1) {
+        return 0;
+    }
+    for (size_t i = 0; i < sizeof(builtin_charsets) / sizeof(BuiltinCharset); i++) {
+        uint64_t builtin[4];
+        builtin_set(&builtin_charsets[i], builtin);
+        if (memcmp(builtin, set, sizeof(builtin)) == 0) {
+            return 0;
+        }
+    }
+    for (int i = 0; i < *num_charsets; i++) {
+        if (memcmp(charsets[i], set, 4 * sizeof(uint64_t)) == 0) {
+            return i + 1;
+        }
+    }
+    if (*num_charsets == MASK_MAX_CHARSETS) {
+        return -1;
+    }
+    memcpy(charsets[*num_charsets], set, 4 * sizeof(uint64_t));
+    (*num_charsets)++;
+    return *num_charsets;
+}
+
+
+// Writes a character so hashcat reads it literally. Returns the number of
+// bytes written
+//
+static int escape_char(char *out, char c) {
+    if (c == '?') {
+        out[0] = '?';
+        out[1] = '?';
+        return 2;
+    }
+    if (c == ',') {
+        out[0] = '\\';
+        out[1] = ',';
+        return 2;
+    }
+    out[0] = c;
+    return 1;
+}
+
+
+// Writes the mask for one position
+//
+static int position_mask(char *out, const uint64_t *set, uint64_t (*charsets)[4], int *num_charsets) {
+    
+    if (set_size(set) == 1) {
+        for (int c = 0; c < 256; c++) {
+            if (has_char(set, c)) {
+                return escape_char(out, c);
+            }
+        }
+    }
+    for (size_t i = 0; i < sizeof(builtin_charsets) / sizeof(BuiltinCharset); i++) {
+        uint64_t builtin[4];
+        builtin_set(&builtin_charsets[i], builtin);
+        if (memcmp(builtin, set, sizeof(builtin)) == 0) {
+            memcpy(out, builtin_charsets[i].name, 2);
+            return 2;
+        }
+    }
+    int charset = custom_charset(set, charsets, num_charsets);
+    out[0] = '?';
+    out[1] = '0' + charset;
+    return 2;
+}
+
+
+// Finds the mask for the end of a pre-terminal
+//
+// As many items as possible from the end of the pre-terminal are put in the
+// mask, stopping at the first one that isn't a mask or would need more
+// custom charsets than a mask line can have. The rest of the pre-terminal is
+// the prefix, which the CPU generates
+//
+// Returns 1 if there is a mask that makes at least min_keyspace guesses,
+// 0 if the pre-terminal should just be generated
+//
+int build_pt_mask(MaskIndex *index, PQItem *pq_item, MaskLine *line) {
+    
+    uint64_t charsets[MASK_MAX_CHARSETS][4];
+    int num_charsets = 0;
+    int mask_len = 0;
+    line->num_items = 0;
+    line->keyspace = 1;
+    
+    for (int i = pq_item->size - 1; i >= 0; i--) {
+        GroupMask *info = find_group_mask(index, pq_item->pt[i]);
+        if ((info == NULL) || (mask_len + info->len > MAX_GUESS_SIZE - 1)) {
+            break;
+        }
+        
+        // Check the item fits without keeping its charsets yet
+        uint64_t new_charsets[MASK_MAX_CHARSETS][4];
+        int new_num_charsets = num_charsets;
+        memcpy(new_charsets, charsets, sizeof(charsets));
+        int fits = 1;
+        for (int pos = 0; (pos < info->len) && (fits == 1); pos++) {
+            fits = (custom_charset(info->positions[pos], new_charsets, &new_num_charsets) != -1);
+        }
+        if (fits == 0) {
+            break;
+        }
+        
+        unsigned long long count = group_guess_count(index->pcfg, pq_item->pt[i]);
+        if ((count != 0) && (line->keyspace > ULLONG_MAX / count)) {
+            break;
+        }
+        memcpy(charsets, new_charsets, sizeof(charsets));
+        num_charsets = new_num_charsets;
+        line->keyspace *= count;
+        mask_len += info->len;
+        line->num_items++;
+    }
+    
+    if ((line->num_items == 0) || (line->keyspace == 0) || (line->keyspace < index->min_keyspace)) {
+        return 0;
+    }
+    
+    // Write the mask front to back so the custom charsets are numbered in
+    // the order they are used
+    num_charsets = 0;
+    int out = 0;
+    for (int i = pq_item->size - line->num_items; i < pq_item->size; i++) {
+        GroupMask *info = find_group_mask(index, pq_item->pt[i]);
+        for (int pos = 0; pos < info->len; pos++) {
+            out += position_mask(line->mask + out, info->positions[pos], charsets, &num_charsets);
+        }
+    }
+    line->mask[out] = '\0';
+    
+    // A backslash goes first in its charset so it can't end up in front of
+    // the comma after the charset
+    out = 0;
+    for (int i = 0; i < num_charsets; i++) {
+        if (has_char(charsets[i], '\\')) {
+            line->charsets[out++] = '\\';
+        }
+        for (int c = 0; c < 256; c++) {
+            if ((c != '\\') && (has_char(charsets[i], c))) {
+                out += escape_char(line->charsets + out, c);
+            }
+        }
+        line->charsets[out++] = ',';
+    }
+    line->charsets[out] = '\0';
+    return 1;
+}
+
+
+// Writes out one mask line, with the prefix before the mask
+//
+void write_mask_line(FILE *fp, MaskLine *line, const char *prefix, int prefix_len) {
+    
+    char buf[MASK_LINE_SIZE];
+    int len = strlen(line->charsets);
+    memcpy(buf, line->charsets, len);
+    for (int i = 0; i < prefix_len; i++) {
+        len += escape_char(buf + len, prefix[i]);
+    }
+    int mask_len = strlen(line->mask);
+    memcpy(buf + len, line->mask, mask_len);
+    len += mask_len;
+    buf[len++] = '\n';
+    
+    // Lines starting with a # are comments in a hcmask file
+    if (buf[0] == '#') {
+        fputc('\\', fp);
+    }
+    fwrite(buf, 1, len, fp);
+}
+
+
+// Frees the mask index
+//
+void free_mask_index(MaskIndex *index) {
+    for (int type = 0; type < PCFG_NUM_TYPES; type++) {
+        for (int id = 0; id <= MAX_TERM_LENGTH; id++) {
+            GroupMask *groups = index->groups[type][id];
+            if (groups == NULL) {
+                continue;
+            }
+            int i = 0;
+            for (PcfgReplacements *cur = index->pcfg->terminals[type][id]; cur != NULL; cur = cur->child) {
+                free(groups[i].positions);
+                i++;
+            }
+            free(groups);
+            index->groups[type][id] = NULL;
+        }
+    }
+}
@@ -0,0 +1,119 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Pretty Cool Fuzzy Guesser (PCFG)
+//  --Probabilistic Context Free Grammar (PCFG) Password Guessing Program
+//
+//  Written by Matt Weir
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//
+
+
+
+#ifndef _MASKS_H
+#define _MASKS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+
+#include "global_def.h"
+#include "grammar.h"
+#include "pcfg_pqueue.h"
+
+
+// The most custom charsets a hashcat mask line can use
+#define MASK_MAX_CHARSETS 4
+
+// Default for --mask_min. Masks smaller than this are generated as plain
+// guesses instead, since each mask line has a startup cost on the GPU
+#define DEFAULT_MASK_MIN_KEYSPACE 10000
+
+// Room for a whole mask line. The prefix and the mask can each be almost
+// MAX_GUESS_SIZE characters, and every character can take 2 bytes once it
+// is escaped
+#define MASK_LINE_SIZE ((MAX_GUESS_SIZE * 4) + (MASK_MAX_CHARSETS * 512) + 16)
+
+
+// Which characters each position of a group's values can be
+//
+// A group can be written as a mask if its values are every combination of
+// the characters at each position, (aka every 4 digit number)
+//
+typedef struct GroupMask {
+    
+    // 1 if the group can be written as a mask
+    int maskable;
+    
+    // Number of positions, and a 256 bit set of characters for each
+    int len;
+    uint64_t (*positions)[4];
+    
+}GroupMask;
+
+
+// The mask info for every group in the grammar that could be a mask
+typedef struct MaskIndex {
+    
+    PcfgGrammar *pcfg;
+    
+    // Indexed the same way as PcfgGrammar.terminals and then by the group's
+    // position in the terminal. NULL for types that are never masks
+    GroupMask *groups[PCFG_NUM_TYPES][MAX_TERM_LENGTH + 1];
+    
+    // Only mask the end of a pre-terminal if it makes at least this many
+    // guesses
+    unsigned long long min_keyspace;
+    
+    // Stats
+    unsigned long long mask_pts;
+    unsigned long long mask_lines;
+    unsigned long long mask_guesses;
+    
+}MaskIndex;
+
+
+// The mask for the end of a pre-terminal
+//
+// Each mask line is the charsets, then the escaped prefix the CPU made,
+// then the mask
+//
+typedef struct MaskLine {
+    char charsets[MASK_MAX_CHARSETS * 512 + 8];
+    char mask[MAX_GUESS_SIZE * 2 + 1];
+    
+    // Number of items at the end of the pre-terminal that are in the mask,
+    // and how many guesses the mask makes
+    int num_items;
+    unsigned long long keyspace;
+}MaskLine;
+
+
+// Finds which groups in the grammar can be written as masks
+extern int create_mask_index(PcfgGrammar *pcfg, unsigned long long min_keyspace, MaskIndex *index);
+
+// Finds the mask for the end of a pre-terminal. Returns 1 if there is one
+extern int build_pt_mask(MaskIndex *index, PQItem *pq_item, MaskLine *line);
+
+// Writes out one mask line with a prefix
+extern void write_mask_line(FILE *fp, MaskLine *line, const char *prefix, int prefix_len);
+
+// Frees the mask index
+extern void free_mask_index(MaskIndex *index);
+
+#endif
@@ -0,0 +1,594 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Pretty Cool Fuzzy Guesser (PCFG)
+//  --Probabilistic Context Free Grammar (PCFG) Password Guessing Program
+//
+//  Written by Matt Weir
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//
+
+
+
+#include "password_score.h"
+
+
+// Hashes a terminal value along with the terminal it is from
+//
+// Never returns 0 since that marks an empty slot in the index
+//
+static inline uint64_t score_hash(int type, int id, const char *value, int value_len) {
+    uint64_t hash = 14695981039346656037ULL;
+    hash = (hash ^ (uint64_t) type) * 1099511628211ULL;
+    hash = (hash ^ (uint64_t) id) * 1099511628211ULL;
+    for (int i = 0; i < value_len; i++) {
+        hash = (hash ^ (unsigned char) value[i]) * 1099511628211ULL;
+    }
+    hash ^= hash >> 29;
+    if (hash == 0) {
+        hash = 1;
+    }
+    return hash;
+}
+
+
+// Looks up a value in the index
+//
+// Returns the group it is in, or NULL if it isn't in the terminal
+//
+PcfgReplacements *find_value(ScoreIndex *index, int type, int id, const char *value, int value_len) {
+    
+    uint64_t hash = score_hash(type, id, value, value_len);
+    for (size_t slot = hash & index->mask; index->entries[slot].hash != 0; slot = (slot + 1) & index->mask) {
+        ScoreEntry *entry = &index->entries[slot];
+        if ((entry->hash == hash) && (entry->group->type == type) && (entry->group->id == id) &&
+            (pcfg_value_len(entry->group, entry->index) == value_len) &&
+            (memcmp(pcfg_value(entry->group, entry->index), value, value_len) == 0)) {
+            return entry->group;
+        }
+    }
+    return NULL;
+}
+
+
+// Returns 1 if a range group contains a number, 0 if it doesn't
+//
+int range_contains(PcfgRange *range, const char *value, int value_len) {
+    
+    if (value_len != range->width) {
+        return 0;
+    }
+    unsigned long long number = 0;
+    for (int i = 0; i < value_len; i++) {
+        if (!isdigit((unsigned char) value[i])) {
+            return 0;
+        }
+        number = (number * 10) + (value[i] - '0');
+    }
+    if ((number < range->start) || (number > range->end)) {
+        return 0;
+    }
+    
+    int low = 0;
+    int high = range->num_exceptions;
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (range->exceptions[mid] < number) {
+            low = mid + 1;
+        }
+        else {
+            high = mid;
+        }
+    }
+    if ((low < range->num_exceptions) && (range->exceptions[low] == number)) {
+        return 0;
+    }
+    return 1;
+}
+
+
+// Finds the group a section of a password is in, checking both the stored
+// values and the range groups
+//
+// Returns NULL if it isn't in the terminal
+//
+PcfgReplacements *find_group(ScoreIndex *index, int type, int id, const char *value, int value_len) {
+    
+    PcfgReplacements *group = find_value(index, type, id, value, value_len);
+    if (group != NULL) {
+        return group;
+    }
+    for (int i = 0; i < index->num_ranges[type][id]; i++) {
+        if (range_contains(index->ranges[type][id][i]->range, value, value_len)) {
+            return index->ranges[type][id][i];
+        }
+    }
+    return NULL;
+}
+
+
+// Adds a base structure to the tree of base structures
+//
+// If the same base structure is in there twice, the more probable one is used
+//
+// Function returns 0 if it worked ok, 1 if there was a memory allocation error
+//
+int add_score_base(ScoreIndex *index, PcfgBase *base) {
+    
+    ScoreNode *node = &index->root;
+    for (int i = 0; i < base->size; i++) {
+        
+        ScoreNode *child = node->child;
+        while ((child != NULL) && ((child->type != base->value[i].type) || (child->id != base->value[i].id))) {
+            child = child->sibling;
+        }
+        
+        if (child == NULL) {
+            child = malloc(sizeof(ScoreNode));
+            if (child == NULL) {
+                return 1;
+            }
+            child->type = base->value[i].type;
+            child->id = base->value[i].id;
+            child->base = NULL;
+            child->child = NULL;
+            child->sibling = node->child;
+            node->child = child;
+        }
+        node = child;
+    }
+    
+    if ((node->base == NULL) || (node->base->prob < base->prob)) {
+        node->base = base;
+    }
+    return 0;
+}
+
+
+// Builds the index for scoring passwords
+//
+// Every stored terminal value is put in one hash table, keyed by the value
+// and the terminal it is from, and pointing to its group. Since every value
+// in a group has the group's probability, that is all that is needed to
+// score it. The base structures are put in a tree so base structures that
+// start the same way are only matched once
+//
+// Function returns 0 if it worked ok, 1 if there was a memory allocation error
+//
+int create_score_index(PcfgGrammar *pcfg, ScoreIndex *index) {
+    
+    memset(index, 0, sizeof(ScoreIndex));
+    index->pcfg = pcfg;
+    
+    // First pass, size up the hash table and find the range groups
+    size_t num_values = 0;
+    for (int type = 0; type < PCFG_MARKOV; type++) {
+        for (int id = 0; id <= MAX_TERM_LENGTH; id++) {
+            for (PcfgReplacements *cur = pcfg->terminals[type][id]; cur != NULL; cur = cur->child) {
+                if (cur->range != NULL) {
+                    index->num_ranges[type][id]++;
+                }
+                else {
+                    num_values += cur->size;
+                }
+            }
+            if (index->num_ranges[type][id] != 0) {
+                index->ranges[type][id] = malloc(index->num_ranges[type][id] * sizeof(PcfgReplacements *));
+                if (index->ranges[type][id] == NULL) {
+                    return 1;
+                }
+                index->num_ranges[type][id] = 0;
+            }
+        }
+    }
+    
+    size_t table_size = 1024;
+    while (table_size < num_values * 2) {
+        table_size *= 2;
+    }
+    index->entries = calloc(table_size, sizeof(ScoreEntry));
+    if (index->entries == NULL) {
+        return 1;
+    }
+    index->mask = table_size - 1;
+    
+    // Second pass, fill it in. The groups are walked most probable first so
+    // if a value is in a terminal twice the more probable one is kept
+    for (int type = 0; type < PCFG_MARKOV; type++) {
+        for (int id = 0; id <= MAX_TERM_LENGTH; id++) {
+            for (PcfgReplacements *cur = pcfg->terminals[type][id]; cur != NULL; cur = cur->child) {
+                
+                if (cur->range != NULL) {
+                    index->ranges[type][id][index->num_ranges[type][id]++] = cur;
+                    if ((index->min_len[type][id] == 0) || (cur->stride < index->min_len[type][id])) {
+                        index->min_len[type][id] = cur->stride;
+                    }
+                    if (cur->stride > index->max_len[type][id]) {
+                        index->max_len[type][id] = cur->stride;
+                    }
+                    continue;
+                }
+                
+                for (int i = 0; i < cur->size; i++) {
+                    char *value = pcfg_value(cur, i);
+                    int value_len = pcfg_value_len(cur, i);
+                    if (value_len == 0) {
+                        continue;
+                    }
+                    if ((index->min_len[type][id] == 0) || (value_len < index->min_len[type][id])) {
+                        index->min_len[type][id] = value_len;
+                    }
+                    if (value_len > index->max_len[type][id]) {
+                        index->max_len[type][id] = value_len;
+                    }
+                    if (find_value(index, type, id, value, value_len) != NULL) {
+                        continue;
+                    }
+                    
+                    uint64_t hash = score_hash(type, id, value, value_len);
+                    size_t slot = hash & index->mask;
+                    while (index->entries[slot].hash != 0) {
+                        slot = (slot + 1) & index->mask;
+                    }
+                    index->entries[slot].hash = hash;
+                    index->entries[slot].group = cur;
+                    index->entries[slot].index = i;
+                }
+            }
+        }
+    }
+    
+    if (pcfg->markov != NULL) {
+        for (PcfgReplacements *cur = pcfg->terminals[PCFG_MARKOV][0]; cur != NULL; cur = cur->child) {
+            index->markov_groups[markov_group_level(pcfg, cur)] = cur;
+        }
+    }
+    
+    for (PcfgBase *cur = pcfg->base_structures; cur != NULL; cur = cur->next) {
+        if (add_score_base(index, cur) != 0) {
+            return 1;
+        }
+    }
+    
+    return 0;
+}
+
+
+// Holds the password being scored and the best score found so far
+typedef struct ScoreWalk {
+    ScoreIndex *index;
+    char *password;
+    int password_len;
+    PasswordScore *best;
+} ScoreWalk;
+
+
+// Tries every way to match the rest of the password from this node in the
+// base structure tree
+//
+// pos is how much of the password has been matched, prev_start is where the
+// last section started, (so capitalization masks can be checked against the
+// alpha section before them), and prob is the probability of the sections
+// matched so far
+//
+void score_walk(ScoreWalk *walk, ScoreNode *node, int pos, int prev_start, double prob) {
+    
+    ScoreIndex *index = walk->index;
+    
+    // Every probability is at most 1.0, so this can't beat the best parse
+    if (prob <= walk->best->prob) {
+        return;
+    }
+    
+    if ((pos == walk->password_len) && (node->base != NULL) && (node->base->prob * prob > walk->best->prob)) {
+        walk->best->prob = node->base->prob * prob;
+        walk->best->base = node->base;
+    }
+    
+    char section[MAX_GUESS_SIZE];
+    
+    for (ScoreNode *child = node->child; child != NULL; child = child->sibling) {
+        
+        int type = child->type;
+        int id = child->id;
+        
+        // Masks don't use up any of the password. They are checked against
+        // the alpha section before them
+        if (type == PCFG_CAPITALIZATION) {
+            int mask_len = pos - prev_start;
+            for (int i = 0; i < mask_len; i++) {
+                section[i] = isupper((unsigned char) walk->password[prev_start + i]) ? 'U' : 'L';
+            }
+            PcfgReplacements *group = find_group(index, type, id, section, mask_len);
+            if (group != NULL) {
+                score_walk(walk, child, pos, prev_start, prob * group->prob);
+            }
+            continue;
+        }
+        
+        if (type == PCFG_MARKOV) {
+            if (index->pcfg->markov == NULL) {
+                continue;
+            }
+            for (int end = pos + 1; end <= walk->password_len; end++) {
+                int level = markov_level(index->pcfg->markov, walk->password + pos, end - pos);
+                if ((level >= 0) && (level <= MAX_MARKOV_LEVEL) && (index->markov_groups[level] != NULL)) {
+                    score_walk(walk, child, end, pos, prob * index->markov_groups[level]->prob);
+                }
+            }
+            continue;
+        }
+        
+        if (index->min_len[type][id] == 0) {
+            continue;
+        }
+        for (int len = index->min_len[type][id]; (len <= index->max_len[type][id]) && (pos + len <= walk->password_len); len++) {
+            
+            // Alpha values are stored lowercase with the capitalization
+            // coming from the mask after them
+            char *value = walk->password + pos;
+            if (type == PCFG_ALPHA) {
+                for (int i = 0; i < len; i++) {
+                    section[i] = tolower((unsigned char) value[i]);
+                }
+                value = section;
+            }
+            
+            PcfgReplacements *group = find_group(index, type, id, value, len);
+            if (group != NULL) {
+                score_walk(walk, child, pos + len, pos, prob * group->prob);
+            }
+        }
+    }
+}
+
+
+// Finds the most probable way the grammar can make a password
+//
+// Every parse is tried and the most probable one is kept, since that is the
+// one the guesser will make first. If the grammar can't make the password
+// the probability is 0.0
+//
+void score_password(ScoreIndex *index, char *password, int password_len, PasswordScore *score) {
+    
+    score->prob = 0.0;
+    score->base = NULL;
+    if ((password_len == 0) || (password_len >= MAX_GUESS_SIZE)) {
+        return;
+    }
+    
+    ScoreWalk walk;
+    walk.index = index;
+    walk.password = password;
+    walk.password_len = password_len;
+    walk.best = score;
+    score_walk(&walk, &index->root, 0, 0, 1.0);
+}
+
+
+// Work for one scoring thread
+typedef struct ScoreWorker {
+    pthread_t thread;
+    ScoreIndex *index;
+    GuessEstimator *estimator;
+    
+    // The passwords to score, (null terminated), and where to write out
+    // the scores
+    char **passwords;
+    int *password_lens;
+    int first;
+    int last;
+    char *output;
+    size_t output_len;
+    size_t output_size;
+    
+    // Set if memory for the output couldn't be allocated
+    int error;
+} ScoreWorker;
+
+
+// Writes the base structure the way it is in the ruleset, aka "A4D2".
+// Capitalization masks aren't part of base structures in the ruleset so
+// they are left out
+//
+// Returns the length written
+//
+int format_base(PcfgBase *base, char *output) {
+    int len = 0;
+    for (int i = 0; i < base->size; i++) {
+        if (base->value[i].type == PCFG_CAPITALIZATION) {
+            continue;
+        }
+        output[len++] = PCFG_TYPE_DESIGNATORS[base->value[i].type];
+        if (base->value[i].type != PCFG_MARKOV) {
+            len += sprintf(output + len, "%d", base->value[i].id);
+        }
+    }
+    output[len] = '\0';
+    return len;
+}
+
+
+// Scores the passwords from first to last
+//
+void *score_worker(void *arg) {
+    
+    ScoreWorker *worker = arg;
+    
+    for (int i = worker->first; i < worker->last; i++) {
+        
+        PasswordScore score;
+        score_password(worker->index, worker->passwords[i], worker->password_lens[i], &score);
+        
+        // Make sure there is room for the longest possible line. Each item
+        // in the base structure takes at most 3 characters, (aka "A32")
+        size_t needed = worker->password_lens[i] + 64;
+        if (score.base != NULL) {
+            needed += score.base->size * 3;
+        }
+        if (worker->output_len + needed > worker->output_size) {
+            size_t new_size = (worker->output_size * 2) + needed;
+            char *new_output = realloc(worker->output, new_size);
+            if (new_output == NULL) {
+                worker->error = 1;
+                return NULL;
+            }
+            worker->output = new_output;
+            worker->output_size = new_size;
+        }
+        
+        char *line = worker->output + worker->output_len;
+        int len;
+        if (score.base == NULL) {
+            len = sprintf(line, "%s\t0\t-", worker->passwords[i]);
+            if (worker->estimator != NULL) {
+                len += sprintf(line + len, "\t-");
+            }
+        }
+        else {
+            len = sprintf(line, "%s\t%.10g\t", worker->passwords[i], score.prob);
+            len += format_base(score.base, line + len);
+            if (worker->estimator != NULL) {
+                len += sprintf(line + len, "\t%.0f", estimate_guess_number(worker->estimator, score.prob));
+            }
+        }
+        line[len++] = '\n';
+        worker->output_len += len;
+    }
+    return NULL;
+}
+
+
+// Reads passwords from fp, one per line, and writes out their scores
+//
+// Each line of output is the password, its probability and the base
+// structure that makes it, tab separated. If estimator isn't NULL the
+// estimated guess number is added at the end. Passwords the grammar can't
+// make have a probability of 0 and a '-' for the rest
+//
+// The passwords are read in batches, and each batch is split between the
+// threads. The scores are written out in the same order as the passwords
+//
+// Function returns 0 if it worked ok, 1 if an error occured
+//
+int score_from_file(ScoreIndex *index, GuessEstimator *estimator, int threads, FILE *fp) {
+    
+    // The line buffers are kept between batches so getline() can reuse them
+    char **passwords = calloc(SCORE_BATCH_SIZE, sizeof(char *));
+    size_t *password_sizes = calloc(SCORE_BATCH_SIZE, sizeof(size_t));
+    int *password_lens = malloc(SCORE_BATCH_SIZE * sizeof(int));
+    ScoreWorker *workers = calloc(threads, sizeof(ScoreWorker));
+    if ((passwords == NULL) || (password_sizes == NULL) || (password_lens == NULL) || (workers == NULL)) {
+        free(passwords);
+        free(password_sizes);
+        free(password_lens);
+        free(workers);
+        fprintf(stderr, "Error allocating memory to score passwords\n");
+        return 1;
+    }
+    
+    int ret = 0;
+    int done = 0;
+    while ((done == 0) && (ret == 0)) {
+        
+        int num_passwords = 0;
+        while (num_passwords < SCORE_BATCH_SIZE) {
+            ssize_t line_len = getline(&passwords[num_passwords], &password_sizes[num_passwords], fp);
+            if (line_len == -1) {
+                done = 1;
+                break;
+            }
+            char *line = passwords[num_passwords];
+            while ((line_len > 0) && ((line[line_len - 1] == '\n') || (line[line_len - 1] == '\r'))) {
+                line[--line_len] = '\0';
+            }
+            password_lens[num_passwords] = line_len;
+            num_passwords++;
+        }
+        
+        int per_thread = (num_passwords + threads - 1) / threads;
+        for (int t = 0; t < threads; t++) {
+            workers[t].index = index;
+            workers[t].estimator = estimator;
+            workers[t].passwords = passwords;
+            workers[t].password_lens = password_lens;
+            workers[t].first = (t * per_thread < num_passwords) ? t * per_thread : num_passwords;
+            workers[t].last = (workers[t].first + per_thread < num_passwords) ? workers[t].first + per_thread : num_passwords;
+            workers[t].output_len = 0;
+            
+            // If a thread can't be started, do the work here instead
+            if ((t == threads - 1) || (pthread_create(&workers[t].thread, NULL, score_worker, &workers[t]) != 0)) {
+                score_worker(&workers[t]);
+                workers[t].thread = pthread_self();
+            }
+        }
+        
+        for (int t = 0; t < threads; t++) {
+            if (!pthread_equal(workers[t].thread, pthread_self())) {
+                pthread_join(workers[t].thread, NULL);
+            }
+            if (workers[t].error != 0) {
+                fprintf(stderr, "Error allocating memory to score passwords\n");
+                ret = 1;
+            }
+            fwrite(workers[t].output, 1, workers[t].output_len, stdout);
+        }
+    }
+    
+    if (ferror(fp)) {
+        fprintf(stderr, "Error reading the passwords\n");
+        ret = 1;
+    }
+    
+    for (int t = 0; t < threads; t++) {
+        free(workers[t].output);
+    }
+    for (int i = 0; i < SCORE_BATCH_SIZE; i++) {
+        free(passwords[i]);
+    }
+    free(workers);
+    free(passwords);
+    free(password_sizes);
+    free(password_lens);
+    return ret;
+}
+
+
+// Frees a node in the base structure tree and everything under it
+//
+void free_score_node(ScoreNode *node) {
+    while (node != NULL) {
+        ScoreNode *sibling = node->sibling;
+        free_score_node(node->child);
+        free(node);
+        node = sibling;
+    }
+}
+
+
+// Frees everything the index allocated
+//
+void free_score_index(ScoreIndex *index) {
+    
+    free(index->entries);
+    for (int type = 0; type < PCFG_NUM_TYPES; type++) {
+        for (int id = 0; id <= MAX_TERM_LENGTH; id++) {
+            free(index->ranges[type][id]);
+        }
+    }
+    free_score_node(index->root.child);
+    index->root.child = NULL;
+}
@@ -0,0 +1,127 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Pretty Cool Fuzzy Guesser (PCFG)
+//  --Probabilistic Context Free Grammar (PCFG) Password Guessing Program
+//
+//  Written by Matt Weir
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//
+
+
+
+#ifndef _PASSWORD_SCORE_H
+#define _PASSWORD_SCORE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <pthread.h>
+
+#include "global_def.h"
+#include "grammar.h"
+#include "markov_guess.h"
+#include "guess_estimate.h"
+
+
+// The number of passwords read in at a time and split between the threads
+#define SCORE_BATCH_SIZE 65536
+
+
+// One value in the terminal index
+typedef struct ScoreEntry {
+    
+    // Hash of the type, id and value. 0 marks an empty slot
+    uint64_t hash;
+    
+    // The group the value is in, and its position in the group
+    PcfgReplacements *group;
+    int index;
+    
+}ScoreEntry;
+
+
+// A node in the tree of base structures. Base structures that start with
+// the same replacements share the same nodes
+typedef struct ScoreNode {
+    
+    // The replacement this node matches
+    unsigned char type;
+    int id;
+    
+    // The base structure that ends at this node. NULL if none do
+    PcfgBase *base;
+    
+    struct ScoreNode *child;
+    struct ScoreNode *sibling;
+    
+}ScoreNode;
+
+
+// Everything needed to look up how probable a password is
+typedef struct ScoreIndex {
+    
+    PcfgGrammar *pcfg;
+    
+    // Open addressed hash table of every stored terminal value
+    ScoreEntry *entries;
+    size_t mask;
+    
+    // The shortest and longest value in bytes in each terminal. A min_len
+    // of 0 means the terminal is empty
+    int min_len[PCFG_NUM_TYPES][MAX_TERM_LENGTH + 1];
+    int max_len[PCFG_NUM_TYPES][MAX_TERM_LENGTH + 1];
+    
+    // Range groups aren't in the hash table, so are checked one at a time
+    int num_ranges[PCFG_NUM_TYPES][MAX_TERM_LENGTH + 1];
+    PcfgReplacements **ranges[PCFG_NUM_TYPES][MAX_TERM_LENGTH + 1];
+    
+    // The Markov group for each level. NULL if the level isn't loaded
+    PcfgReplacements *markov_groups[MAX_MARKOV_LEVEL + 1];
+    
+    // The tree of base structures. The root doesn't match anything
+    ScoreNode root;
+    
+}ScoreIndex;
+
+
+// The most probable way a password can be made by the grammar
+typedef struct PasswordScore {
+    
+    // 0.0 if the grammar can't make the password
+    double prob;
+    
+    // The base structure that makes it
+    PcfgBase *base;
+    
+}PasswordScore;
+
+
+// Builds the index for scoring passwords
+extern int create_score_index(PcfgGrammar *pcfg, ScoreIndex *index);
+
+// Finds the most probable way the grammar can make a password
+extern void score_password(ScoreIndex *index, char *password, int password_len, PasswordScore *score);
+
+// Reads passwords from fp and writes out their scores
+extern int score_from_file(ScoreIndex *index, GuessEstimator *estimator, int threads, FILE *fp);
+
+// Frees everything the index allocated
+extern void free_score_index(ScoreIndex *index);
+
+#endif
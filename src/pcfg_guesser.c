@@ -26,75 +26,1320 @@
 #include "pcfg_guesser.h"
 
 
-void recursive_guess(PQItem *pq_item, int base_pos, char *cur_guess, int start_point) {
-    
-    int new_start = start_point;
-    
-    for (int i = 0; i < pq_item->pt[base_pos]->size; i++) {
-         
-        // This is a capitalization section
-        
-        if (strncmp(pq_item->pt[base_pos]->type,"C",2) == 0) {
-            // Go backward to the previous section and apply the mask
-            // Note, if someone messed with the ruleset this could cause issues, so
-            // need to do some sanity checking on the bounds
-            int mask_len = strnlen(pq_item->pt[base_pos]->value[i], MAX_TERM_LENGTH + 1);
-            //Sanity check on length
-            if (mask_len > start_point) {
-                fprintf(stderr, "Error with the capitalization masks\n");
-                return;
+// Copies a terminal value into the guess
+//
+// Returns the new length of the guess, or -1 if the value doesn't fit
+//
+int render_copy(char *cur_guess, int start_point, char *value, int value_len) {
+    
+    // Need to leave room for the newline
+    if (start_point + value_len >= MAX_GUESS_SIZE - 1) {
+        return -1;
+    }
+    memcpy(cur_guess + start_point, value, value_len);
+    return start_point + value_len;
+}
+
+
+// Applies a capitalization mask to the previous section of the guess
+//
+// Returns the length of the guess, (which doesn't change), or -1 if the
+// mask is longer than the guess
+//
+int render_mask(char *cur_guess, int start_point, char *value, int value_len) {
+    
+    // Go backward to the previous section and apply the mask
+    // Note, if someone messed with the ruleset this could cause issues, so
+    // need to do some sanity checking on the bounds
+    int mask_len = value_len;
+    //Sanity check on length
+    if (mask_len > start_point) {
+        fprintf(stderr, "Error with the capitalization masks\n");
+        return -1;
+    }
+    
+    // I'm pretty sure this isn't going to be sufficient for UTF-8
+    // characters, but that's a rabbit hole I'm going to have to dive
+    // into at a later point.
+    for (int y=0; y< mask_len; y++) {
+        //lowercase the letter
+        if (value[y] == 'L') {
+            cur_guess[start_point - mask_len + y] = tolower(cur_guess[start_point - mask_len + y]);
+        }
+        else {
+            cur_guess[start_point - mask_len + y] = toupper(cur_guess[start_point - mask_len + y]);
+        }
+    }
+    return start_point;
+}
+
+
+// Dispatch table of how to add each type of replacement to a guess
+//
+// Indexed by PcfgType. Markov is NULL since its guesses are generated from
+// the Markov model instead of being stored in the group
+//
+static const RenderFunc render_funcs[PCFG_NUM_TYPES] = {
+    [PCFG_ALPHA] = render_copy,
+    [PCFG_CAPITALIZATION] = render_mask,
+    [PCFG_DIGITS] = render_copy,
+    [PCFG_YEARS] = render_copy,
+    [PCFG_OTHER] = render_copy,
+    [PCFG_KEYBOARD] = render_copy,
+    [PCFG_CONTEXT] = render_copy,
+    [PCFG_MARKOV] = NULL,
+};
+
+
+void recursive_guess(GuessContext *context, PQItem *pq_item, int base_pos, char *cur_guess, int start_point);
+
+
+// Counts the guesses dropped since a value didn't fit. Each of the values
+// would have been combined with every guess from the items from pos on
+//
+void count_too_long(GuessContext *context, PQItem *pq_item, int pos, unsigned long long values) {
+    
+    unsigned long long count = values;
+    for (int i = pos; i < pq_item->size; i++) {
+        unsigned long long size = group_guess_count(context->pcfg, pq_item->pt[i]);
+        count = ((size != 0) && (count > ULLONG_MAX / size)) ? ULLONG_MAX : count * size;
+    }
+    context->too_long = (count > ULLONG_MAX - context->too_long) ? ULLONG_MAX : context->too_long + count;
+}
+
+
+// Writes out finished guesses, either to the output file, the clients of
+// the guess server or the shared memory ring
+//
+void write_output(GuessContext *context, char *guesses, size_t len) {
+    if (context->ring != NULL) {
+        ring_guesses(context->ring, guesses, len);
+        return;
+    }
+    if (context->server != NULL) {
+        serve_guesses(context->server, guesses, len);
+        return;
+    }
+    fwrite(guesses, 1, len, context->out);
+}
+
+
+// Writes out a guess that made it through the filters. guess_len includes
+// the trailing newline
+//
+void write_guess(GuessContext *context, char *guess, int guess_len) {
+    
+    if (context->mask_line != NULL) {
+        write_mask_line(context->out, context->mask_line, guess, guess_len - 1);
+        return;
+    }
+    
+    if ((context->dedupe != NULL) && (dedupe_check(context->dedupe, guess, guess_len - 1) == 1)) {
+        return;
+    }
+    
+    if (context->evaluate != NULL) {
+        if (eval_check(context->evaluate, context->eval_hits, guess, guess_len) != 0) {
+            __atomic_store_n(&context->evaluate->failed, 1, __ATOMIC_RELAXED);
+        }
+        return;
+    }
+    
+    if (context->crack != NULL) {
+        if (crack_batch_add(context->crack_batch, guess, guess_len) == 1) {
+            crack_batch_run(context->crack, context->crack_batch);
+        }
+        return;
+    }
+    
+    OutputBuffer *buffer = context->buffer;
+    if (buffer == NULL) {
+        write_output(context, guess, guess_len);
+        return;
+    }
+    
+    if (buffer->len + guess_len > buffer->size) {
+        size_t new_size = (buffer->size == 0) ? 65536 : buffer->size * 2;
+        char *resized = realloc(buffer->data, new_size);
+        if (resized == NULL) {
+            fprintf(stderr, "Error allocating memory for guesses\n");
+            return;
+        }
+        buffer->data = resized;
+        buffer->size = new_size;
+    }
+    memcpy(buffer->data + buffer->len, guess, guess_len);
+    buffer->len += guess_len;
+}
+
+
+// Checks the guesses waiting in the exclude batch and writes out the ones
+// that aren't excluded, in order
+//
+void flush_exclude_batch(GuessContext *context) {
+    
+    if ((context->exclude == NULL) || (context->exclude_batch->count == 0)) {
+        return;
+    }
+    
+    ExcludeBatch *batch = context->exclude_batch;
+    unsigned char excluded[EXCLUDE_BATCH_SIZE];
+    exclude_batch_check(context->exclude, batch, excluded);
+    for (int i = 0; i < batch->count; i++) {
+        if (excluded[i] == 0) {
+            write_guess(context, batch->guesses[i], batch->lens[i]);
+        }
+    }
+    batch->count = 0;
+}
+
+
+// Hashes the guesses waiting in the crack batch
+//
+void flush_crack_batch(GuessContext *context) {
+    if ((context->crack != NULL) && (context->crack_batch->count != 0)) {
+        crack_batch_run(context->crack, context->crack_batch);
+    }
+}
+
+
+// Outputs a guess after any rules have been applied to it. guess_len
+// includes the trailing newline
+//
+// This is a RuleCallback, so context is a GuessContext
+//
+void emit_guess(void *context, char *guess, int guess_len) {
+    
+    GuessContext *guess_context = context;
+    
+    if ((guess_context->policy != NULL) && (check_guess_policy(guess_context->policy, guess, guess_len - 1) == 0)) {
+        return;
+    }
+    
+    if (guess_context->exclude != NULL) {
+        if (exclude_batch_add(guess_context->exclude, guess_context->exclude_batch, guess, guess_len) == 1) {
+            flush_exclude_batch(guess_context);
+        }
+        return;
+    }
+    
+    write_guess(guess_context, guess, guess_len);
+}
+
+
+// Applies the rules to the guesses waiting in the rule batch
+//
+void flush_rule_batch(GuessContext *context) {
+    if ((context->rules != NULL) && (context->rule_batch->count != 0)) {
+        rule_batch_run(context->rules, context->rule_batch, emit_guess, context);
+    }
+}
+
+
+// Pushes every guess that is waiting in a batch through the rest of the
+// output path. Each stage can add guesses to the next one's batch, so they
+// are flushed in the order guesses go through them
+//
+void flush_batches(GuessContext *context) {
+    flush_rule_batch(context);
+    flush_exclude_batch(context);
+    flush_crack_batch(context);
+}
+
+
+// Outputs a guess. guess_len includes the trailing newline
+//
+void output_guess(GuessContext *context, char *guess, int guess_len) {
+    
+    if (context->filter_output == 1) {
+        if (context->output_skip != 0) {
+            context->output_skip--;
+            return;
+        }
+        if (context->output_left == 0) {
+            return;
+        }
+        context->output_left--;
+    }
+    
+    if (context->rules != NULL) {
+        if (rule_batch_add(context->rule_batch, guess, guess_len) == 1) {
+            flush_rule_batch(context);
+        }
+        return;
+    }
+    
+    emit_guess(context, guess, guess_len);
+}
+
+
+// Where to continue generating a guess from after the Markov model fills
+// in its part of it
+typedef struct MarkovContext {
+    GuessContext *context;
+    PQItem *pq_item;
+    int base_pos;
+} MarkovContext;
+
+
+// Called by the Markov model for each guess it generates
+//
+void markov_next(void *context, char *cur_guess, int guess_len) {
+    
+    MarkovContext *markov_context = context;
+    
+    // If this is the last item, generate a guess
+    if (markov_context->base_pos == (markov_context->pq_item->size - 1)) {
+        cur_guess[guess_len] = '\n';
+        output_guess(markov_context->context, cur_guess, guess_len + 1);
+    }
+    else {
+        recursive_guess(markov_context->context, markov_context->pq_item, markov_context->base_pos + 1, cur_guess, guess_len);
+    }
+}
+
+
+// Generates the numbers in a range group
+//
+// The numbers are treated like an odometer, so going to the next number only
+// increments the last digit and carries vs. formatting the whole number again
+//
+void range_guess(GuessContext *context, PQItem *pq_item, int base_pos, char *cur_guess, int start_point) {
+    
+    PcfgRange *range = pq_item->pt[base_pos]->range;
+    int width = range->width;
+    
+    // Need to leave room for the newline
+    if (start_point + width >= MAX_GUESS_SIZE - 1) {
+        count_too_long(context, pq_item, base_pos, 1);
+        return;
+    }
+    int new_start = start_point + width;
+    
+    // Write out the first number, zero padded
+    char *digits = cur_guess + start_point;
+    unsigned long long number = range->start;
+    for (int i = width - 1; i >= 0; i--) {
+        digits[i] = '0' + (number % 10);
+        number = number / 10;
+    }
+    
+    // If this is the last item, generate a guess
+    int is_last = (base_pos == (pq_item->size - 1));
+    
+    int cur_exception = 0;
+    for (number = range->start; ; number++) {
+        
+        // Skip the numbers that aren't in the group
+        if ((cur_exception < range->num_exceptions) && (range->exceptions[cur_exception] == number)) {
+            cur_exception++;
+        }
+        else if (is_last) {
+            cur_guess[new_start] = '\n';
+            output_guess(context, cur_guess, new_start + 1);
+        }
+        else {
+            recursive_guess(context, pq_item, base_pos + 1, cur_guess, new_start);
+        }
+        
+        if (number == range->end) {
+            break;
+        }
+        
+        for (int i = width - 1; i >= 0; i--) {
+            if (digits[i] != '9') {
+                digits[i]++;
+                break;
+            }
+            digits[i] = '0';
+        }
+    }
+}
+
+
+// Adds every value in a group to the guess, and then moves on to next_pos
+//
+// group is normally pq_item->pt[base_pos], but can also be the rendered values
+// from the cache, in which case they cover more than one item
+//
+void values_guess(GuessContext *context, PQItem *pq_item, int next_pos, PcfgReplacements *group, RenderFunc render, char *cur_guess, int start_point) {
+    
+    // If this is the last item, generate a guess
+    int is_last = (next_pos == pq_item->size);
+    
+    for (int i = 0; i < group->size; i++) {
+        
+        int new_start = render(cur_guess, start_point, pcfg_value(group, i), pcfg_value_len(group, i));
+        
+        // The value couldn't be applied to this guess
+        if (new_start == -1) {
+            count_too_long(context, pq_item, next_pos, 1);
+            continue;
+        }
+        
+        if (is_last) {
+            cur_guess[new_start] = '\n';
+            output_guess(context, cur_guess, new_start + 1);
+        }
+        // Not the last item so doing this recursivly
+        else {
+            recursive_guess(context, pq_item, next_pos, cur_guess, new_start);
+        }
+    }      
+    return;
+}
+
+
+void recursive_guess(GuessContext *context, PQItem *pq_item, int base_pos, char *cur_guess, int start_point) {
+    
+    PcfgReplacements *group = pq_item->pt[base_pos];
+    
+    // Numbers that are generated from a range instead of being stored
+    if (group->range != NULL) {
+        range_guess(context, pq_item, base_pos, cur_guess, start_point);
+        return;
+    }
+    
+    // Markov guesses are generated by walking the model
+    if (group->type == PCFG_MARKOV) {
+        if (context->pcfg->markov == NULL) {
+            fprintf(stderr, "Error, the ruleset doesn't have a Markov model\n");
+            return;
+        }
+        MarkovContext markov_context = {context, pq_item, base_pos};
+        markov_generate(context->pcfg->markov, markov_group_level(context->pcfg, group), cur_guess, start_point, markov_next, &markov_context);
+        return;
+    }
+    
+    // Look up how to handle this type once vs. for every value
+    RenderFunc render = render_funcs[group->type];
+    if (render == NULL) {
+        fprintf(stderr, "Error, unsupported replacement type\n");
+        return;
+    }
+    
+    // Alpha words are always followed by their capitalization mask. If the
+    // two have been rendered together already, copy from that instead of
+    // applying every mask to every word again
+    if ((group->type == PCFG_ALPHA) && (base_pos + 1 < pq_item->size) && (pq_item->pt[base_pos + 1]->type == PCFG_CAPITALIZATION)) {
+        RenderedBlock *block = render_cache_get(context->cache, group, pq_item->pt[base_pos + 1], render_funcs[PCFG_CAPITALIZATION]);
+        if (block != NULL) {
+            values_guess(context, pq_item, base_pos + 2, &block->rendered, render_copy, cur_guess, start_point);
+            render_cache_release(context->cache, block);
+            return;
+        }
+    }
+    
+    values_guess(context, pq_item, base_pos + 1, group, render, cur_guess, start_point);
+}
+
+
+// Generates guesses from a parse_tree
+void  generate_guesses(GuessContext *context, PQItem *pq_item) {
+    
+    // Use -d to print out the pre-terminals instead
+    char guess[MAX_GUESS_SIZE];
+    recursive_guess(context, pq_item, 0, guess, 0);
+
+}
+
+
+// Returns the index'th number in a range group
+//
+// Every exception at or below the number pushes it up by one. Since the
+// exceptions are sorted, exceptions[i] - i is the index the i'th exception
+// would have had, so a binary search finds how many are in the way
+//
+unsigned long long range_value(PcfgRange *range, unsigned long long index) {
+    
+    unsigned long long target = range->start + index;
+    int low = 0;
+    int high = range->num_exceptions;
+    while (low < high) {
+        int mid = low + ((high - low) / 2);
+        if (range->exceptions[mid] - mid <= target) {
+            low = mid + 1;
+        }
+        else {
+            high = mid;
+        }
+    }
+    return target + low;
+}
+
+
+// Adds the index'th number of a range group to the guess
+//
+// Returns the new length of the guess, or -1 if it doesn't fit
+//
+int render_number(char *cur_guess, int start_point, PcfgRange *range, unsigned long long index) {
+    
+    // Need to leave room for the newline
+    if (start_point + range->width >= MAX_GUESS_SIZE - 1) {
+        return -1;
+    }
+    unsigned long long number = range_value(range, index);
+    for (int i = range->width - 1; i >= 0; i--) {
+        cur_guess[start_point + i] = '0' + (number % 10);
+        number = number / 10;
+    }
+    return start_point + range->width;
+}
+
+
+// Generates the guesses of a pre-terminal that are in context->index_range
+//
+// Works like recursive_guess(), but since the guess number is a mixed radix
+// number, the value to start with at each position can be found directly
+// from the subtree sizes. Values whose guesses are all outside the range are
+// never rendered. offset is the number of the first guess that can be made
+// from this position with the values already in cur_guess
+//
+// Note: Markov groups can't be indexed, so check pt_can_split() first
+//
+void bounded_guess(GuessContext *context, PQItem *pq_item, int base_pos, char *cur_guess, int start_point, unsigned long long offset) {
+    
+    PcfgReplacements *group = pq_item->pt[base_pos];
+    IndexRange *index_range = context->index_range;
+    unsigned long long subtree = index_range->subtree[base_pos];
+    
+    RenderFunc render = render_funcs[group->type];
+    if ((render == NULL) && (group->range == NULL)) {
+        fprintf(stderr, "Error, unsupported replacement type\n");
+        return;
+    }
+    
+    // If this is the last item, generate a guess
+    int is_last = (base_pos == (pq_item->size - 1));
+    
+    unsigned long long first_value = 0;
+    if (index_range->first > offset) {
+        first_value = (index_range->first - offset) / subtree;
+    }
+    
+    for (unsigned long long i = first_value; i < (unsigned long long) group->size; i++) {
+        
+        unsigned long long value_offset = offset + (i * subtree);
+        if (value_offset >= index_range->last) {
+            break;
+        }
+        
+        int new_start;
+        if (group->range != NULL) {
+            new_start = render_number(cur_guess, start_point, group->range, i);
+        }
+        else {
+            new_start = render(cur_guess, start_point, pcfg_value(group, i), pcfg_value_len(group, i));
+        }
+        
+        // The value couldn't be applied to this guess. Only count the
+        // guesses it would have made that are in the range
+        if (new_start == -1) {
+            unsigned long long first = (index_range->first > value_offset) ? index_range->first : value_offset;
+            unsigned long long last = (index_range->last - value_offset > subtree) ? value_offset + subtree : index_range->last;
+            count_too_long(context, pq_item, pq_item->size, last - first);
+            continue;
+        }
+        
+        if (is_last) {
+            cur_guess[new_start] = '\n';
+            output_guess(context, cur_guess, new_start + 1);
+        }
+        else {
+            bounded_guess(context, pq_item, base_pos + 1, cur_guess, new_start, value_offset);
+        }
+    }
+}
+
+
+// Returns 1 if a pre-terminal can be split up into ranges of guesses
+//
+// The Markov model generates guesses by walking the model, so there is no
+// way to jump to the n'th guess of a Markov group
+//
+int pt_can_split(PQItem *pq_item) {
+    for (int i = 0; i < pq_item->size; i++) {
+        if (pq_item->pt[i]->type == PCFG_MARKOV) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+
+// Fills in how many guesses are made by the items after each position of a
+// pre-terminal. subtree needs to have room for pq_item->size items
+//
+void compute_subtree(PcfgGrammar *pcfg, PQItem *pq_item, unsigned long long *subtree) {
+    
+    subtree[pq_item->size - 1] = 1;
+    for (int i = pq_item->size - 2; i >= 0; i--) {
+        subtree[i] = subtree[i + 1] * group_guess_count(pcfg, pq_item->pt[i + 1]);
+    }
+}
+
+
+// A thread that generates a range of guesses from a pre-terminal
+typedef struct GuessWorker {
+    pthread_t thread;
+    PQItem *pq_item;
+    GuessContext context;
+    OutputBuffer buffer;
+    IndexRange index_range;
+    ExcludeBatch exclude_batch;
+    CrackBatch crack_batch;
+    EvalHits eval_hits;
+    RuleBatch rule_batch;
+} GuessWorker;
+
+
+void *guess_worker(void *arg) {
+    
+    GuessWorker *worker = arg;
+    char guess[MAX_GUESS_SIZE];
+    bounded_guess(&worker->context, worker->pq_item, 0, guess, 0, 0);
+    flush_batches(&worker->context);
+    return NULL;
+}
+
+
+// Generates guesses first up to last from a large pre-terminal using
+// multiple threads
+//
+// The guesses are split into chunks of THREAD_CHUNK_SIZE. Each thread
+// generates one chunk into its own buffer, and then the buffers are written
+// out in order, so the guesses come out the same as generate_guesses() would
+// make them
+//
+// Function returns 0 if it worked ok, 1 if memory couldn't be allocated
+//
+int threaded_guesses(GuessContext *context, PQItem *pq_item, unsigned long long first, unsigned long long last, int num_threads) {
+    
+    unsigned long long *subtree = malloc(pq_item->size * sizeof(unsigned long long));
+    GuessWorker *workers = calloc(num_threads, sizeof(GuessWorker));
+    if ((subtree == NULL) || (workers == NULL)) {
+        free(subtree);
+        free(workers);
+        return 1;
+    }
+    
+    compute_subtree(context->pcfg, pq_item, subtree);
+    
+    for (int i = 0; i < num_threads; i++) {
+        workers[i].pq_item = pq_item;
+        workers[i].context.pcfg = context->pcfg;
+        workers[i].context.cache = NULL;
+        workers[i].context.buffer = &workers[i].buffer;
+        workers[i].context.index_range = &workers[i].index_range;
+        workers[i].context.filter_output = 0;
+        workers[i].context.policy = context->policy;
+        workers[i].context.rules = context->rules;
+        workers[i].context.rule_batch = &workers[i].rule_batch;
+        workers[i].context.out = context->out;
+        workers[i].context.dedupe = context->dedupe;
+        workers[i].context.exclude = context->exclude;
+        workers[i].context.exclude_batch = &workers[i].exclude_batch;
+        workers[i].context.crack = context->crack;
+        workers[i].context.crack_batch = &workers[i].crack_batch;
+        workers[i].context.evaluate = context->evaluate;
+        workers[i].context.eval_hits = &workers[i].eval_hits;
+        workers[i].index_range.subtree = subtree;
+    }
+    
+    while (first < last) {
+        
+        int num_started = 0;
+        for (int i = 0; (i < num_threads) && (first < last); i++) {
+            workers[i].index_range.first = first;
+            workers[i].index_range.last = (last - first > THREAD_CHUNK_SIZE) ? first + THREAD_CHUNK_SIZE : last;
+            first = workers[i].index_range.last;
+            
+            // If a thread can't be started, do the work here instead
+            if (pthread_create(&workers[i].thread, NULL, guess_worker, &workers[i]) != 0) {
+                guess_worker(&workers[i]);
+                workers[i].thread = pthread_self();
+            }
+            num_started++;
+        }
+        
+        for (int i = 0; i < num_started; i++) {
+            if (!pthread_equal(workers[i].thread, pthread_self())) {
+                pthread_join(workers[i].thread, NULL);
+            }
+            write_output(context, workers[i].buffer.data, workers[i].buffer.len);
+            workers[i].buffer.len = 0;
+            context->too_long += workers[i].context.too_long;
+            workers[i].context.too_long = 0;
+            if (context->evaluate != NULL) {
+                eval_resolve(context->evaluate, &workers[i].eval_hits);
             }
+        }
+    }
+    
+    for (int i = 0; i < num_threads; i++) {
+        free(workers[i].buffer.data);
+        free(workers[i].eval_hits.hits);
+    }
+    free(workers);
+    free(subtree);
+    return 0;
+}
+
+
+
+// Generates guesses first up to last from a pre-terminal that makes count
+// guesses in total
+//
+// Uses the fastest way that works for the pre-terminal. Pre-terminals that
+// can't be indexed are fully generated, and the output is filtered instead
+//
+// Function returns 0 if it worked ok, 1 if memory couldn't be allocated
+//
+int generate_range(GuessContext *context, PQItem *pq_item, unsigned long long first, unsigned long long last, unsigned long long count, int num_threads) {
+    
+    int whole = ((first == 0) && (last == count));
+    
+    if ((pt_can_split(pq_item) == 0) || (count == ULLONG_MAX)) {
+        if (whole == 0) {
+            context->filter_output = 1;
+            context->output_skip = first;
+            context->output_left = last - first;
+        }
+        generate_guesses(context, pq_item);
+        context->filter_output = 0;
+        return 0;
+    }
+    
+    if ((num_threads > 1) && (last - first >= THREAD_SPLIT_SIZE)) {
+        return threaded_guesses(context, pq_item, first, last, num_threads);
+    }
+    
+    if (whole == 1) {
+        generate_guesses(context, pq_item);
+        return 0;
+    }
+    
+    unsigned long long *subtree = malloc(pq_item->size * sizeof(unsigned long long));
+    if (subtree == NULL) {
+        return 1;
+    }
+    compute_subtree(context->pcfg, pq_item, subtree);
+    
+    IndexRange index_range = {first, last, subtree};
+    context->index_range = &index_range;
+    char guess[MAX_GUESS_SIZE];
+    bounded_guess(context, pq_item, 0, guess, 0, 0);
+    context->index_range = NULL;
+    
+    free(subtree);
+    return 0;
+}
+
+
+// Writes the end of a pre-terminal as a hashcat mask, with a mask line for
+// every guess the rest of the pre-terminal makes
+//
+// Function returns 1 if the pre-terminal was written as masks, 0 if it
+// should be generated normally
+//
+int generate_masks(GuessContext *context, PQItem *pq_item) {
+    
+    MaskLine line;
+    if (build_pt_mask(context->masks, pq_item, &line) == 0) {
+        return 0;
+    }
+    
+    // The prefix is generated like any other pre-terminal, but into a
+    // context that turns each guess into a mask line
+    PQItem prefix = *pq_item;
+    prefix.size = pq_item->size - line.num_items;
+    
+    GuessContext mask_context;
+    memset(&mask_context, 0, sizeof(GuessContext));
+    mask_context.pcfg = context->pcfg;
+    mask_context.cache = context->cache;
+    mask_context.out = context->mask_out;
+    mask_context.mask_line = &line;
+    
+    unsigned long long num_lines = 1;
+    if (prefix.size == 0) {
+        write_mask_line(context->mask_out, &line, "", 0);
+    }
+    else {
+        generate_guesses(&mask_context, &prefix);
+        num_lines = pt_guess_count(context->pcfg, &prefix);
+    }
+    
+    MaskIndex *masks = context->masks;
+    masks->mask_pts++;
+    masks->mask_lines += num_lines;
+    masks->mask_guesses += (num_lines > ULLONG_MAX / line.keyspace) ? ULLONG_MAX : num_lines * line.keyspace;
+    return 1;
+}
+
+
+// Returns 1 if the session should stop since there is nothing left to
+// crack, and prints the crack status every CRACK_STATUS_INTERVAL seconds
+//
+int session_done(GuessContext *context, time_t *next_status) {
+    
+    if ((context->ring != NULL) && (context->ring->failed)) {
+        return 1;
+    }
+    if ((context->evaluate != NULL) && ((eval_done(context->evaluate)) || (context->evaluate->failed))) {
+        return 1;
+    }
+    if (context->crack != NULL) {
+        if (crack_done(context->crack)) {
+            return 1;
+        }
+        if (time(NULL) >= (*next_status)) {
+            print_crack_status(context->crack);
+            (*next_status) = time(NULL) + CRACK_STATUS_INTERVAL;
+        }
+    }
+    return 0;
+}
+
+
+// Checks a pre-terminal against the password policy
+//
+// Pre-terminals that can't make a guess that meets the policy are skipped,
+// and don't count towards the guess numbers. If only some of their guesses
+// meet it, each guess is checked
+//
+// Returns 1 if the pre-terminal should be skipped
+//
+int skip_pt_policy(GuessContext *context, PolicyIndex *policy_index, PQItem *pq_item) {
+    
+    if (policy_index == NULL) {
+        return 0;
+    }
+    int result = check_pt_policy(policy_index, pq_item);
+    if (result == POLICY_FAIL) {
+        policy_index->skipped_pts++;
+        return 1;
+    }
+    context->policy = (result == POLICY_CHECK) ? &policy_index->policy : NULL;
+    return 0;
+}
+
+
+// Generates guesses first up to last from a pre-terminal that makes count
+// guesses in total
+//
+// If there is a coordinator or a pre-terminal stream, the pre-terminal is
+// written to it instead. If masks are on, the pre-terminal may be written
+// as masks
+//
+// Function returns 0 if it worked ok, 1 if an error occured
+//
+int generate_pt(GuessContext *context, PQItem *pq_item, unsigned long long first, unsigned long long last, unsigned long long count, int num_threads) {
+    
+    if (context->coordinator != NULL) {
+        int can_split = ((pt_can_split(pq_item) == 1) && (count != ULLONG_MAX));
+        return coordinator_add_pt(context->coordinator, pq_item, count, first, last, can_split);
+    }
+    if (context->pt_stream != NULL) {
+        return write_pt_record(context->pt_stream, pq_item, count, first, last);
+    }
+    
+    // Masks can only cover a whole pre-terminal where every guess meets the
+    // policy
+    int masked = ((context->masks != NULL) && (first == 0) && (last == count) && (context->policy == NULL) && (generate_masks(context, pq_item) == 1));
+    if ((masked == 0) && (generate_range(context, pq_item, first, last, count, num_threads) != 0)) {
+        fprintf(stderr, "Error allocating memory to generate guesses. Exiting\n");
+        return 1;
+    }
+    flush_batches(context);
+    if (context->evaluate != NULL) {
+        eval_resolve(context->evaluate, context->eval_hits);
+    }
+    return 0;
+}
+
+
+// Pops pre-terminals off the queue and generates their guesses until the
+// queue is empty or --limit is reached
+//
+// num_pops and num_guesses are how far into the session the queue already
+// is, (non-zero when resuming from an index). If index_fp isn't NULL, an
+// index record is saved every GUESS_INDEX_INTERVAL pops
+//
+// Function returns 0 if it worked ok, 1 if an error occured
+//
+int generate_session(GuessContext *context, priority_queue_t *pq, struct program_info *program_info, PolicyIndex *policy_index, FILE *index_fp, unsigned long long num_pops, unsigned long long num_guesses) {
+    
+    unsigned long long end_guess = ULLONG_MAX;
+    if ((program_info->limit != 0) && (program_info->limit < ULLONG_MAX - program_info->skip)) {
+        end_guess = program_info->skip + program_info->limit;
+    }
+    
+    time_t next_status = time(NULL) + CRACK_STATUS_INTERVAL;
+    
+    while ((!priority_queue_empty(pq)) && (num_guesses < end_guess)) {
+        
+        // Stop once there is nothing left to crack
+        if (session_done(context, &next_status) == 1) {
+            break;
+        }
+        
+        if ((index_fp != NULL) && (num_pops % GUESS_INDEX_INTERVAL == 0)) {
+            save_index_record(index_fp, num_pops, num_guesses);
+        }
+        
+        PQItem* pq_item = pcfg_pq_pop(pq);
+        if (pq_item == NULL) {
+            printf("Memory allocation error when popping item from pqueue\n");
+            return 1;
+        }
+        num_pops++;
+        
+        if (skip_pt_policy(context, policy_index, pq_item) == 1) {
+            free(pq_item->pt);
+            free(pq_item);
+            continue;
+        }
+        
+        unsigned long long count = pt_guess_count(context->pcfg, pq_item);
+        unsigned long long next_guesses = (count > ULLONG_MAX - num_guesses) ? ULLONG_MAX : num_guesses + count;
+        
+        // Only generate the part of the pre-terminal that is between --skip
+        // and --limit
+        if (next_guesses > program_info->skip) {
+            unsigned long long first = (program_info->skip > num_guesses) ? program_info->skip - num_guesses : 0;
+            unsigned long long last = (end_guess - num_guesses < count) ? end_guess - num_guesses : count;
             
-            // I'm pretty sure this isn't going to be sufficient for UTF-8
-            // characters, but that's a rabbit hole I'm going to have to dive
-            // into at a later point.
-            for (int y=0; y< mask_len; y++) {
-                //lowercase the letter
-                if (pq_item->pt[base_pos]->value[i][y] == 'L') {
-                    cur_guess[start_point - mask_len + y] = tolower(cur_guess[start_point - mask_len + y]);
-                }
-                else {
-                    cur_guess[start_point - mask_len + y] = toupper(cur_guess[start_point - mask_len + y]);
-                }
+            if (generate_pt(context, pq_item, first, last, count, program_info->threads) != 0) {
+                return 1;
             }
-            
         }
-        else {
-            strncpy(cur_guess + start_point, pq_item->pt[base_pos]->value[i], MAX_GUESS_SIZE - start_point);
-            new_start = strnlen(cur_guess, MAX_GUESS_SIZE);
+        num_guesses = next_guesses;
+        
+        free(pq_item->pt);
+        free(pq_item);
+    }
+    
+    
+    return 0;
+}
+
+
+// Generates the guesses for the pre-terminals in a stream made with
+// --pt_stream, in the order they are in the stream
+//
+// With --expand_part K/N only every N'th record, starting from the K'th, is
+// expanded, so N processes can share one stream
+//
+// Function returns 0 if it worked ok, 1 if an error occured
+//
+int expand_session(GuessContext *context, PtStream *stream, struct program_info *program_info, PolicyIndex *policy_index) {
+    
+    time_t next_status = time(NULL) + CRACK_STATUS_INTERVAL;
+    unsigned long long record = 0;
+    
+    PQItem pq_item;
+    unsigned long long count;
+    unsigned long long first;
+    unsigned long long last;
+    int ret;
+    while ((ret = read_pt_record(stream, &pq_item, &count, &first, &last)) == PT_STREAM_OK) {
+        
+        if (session_done(context, &next_status) == 1) {
+            return 0;
         }
         
-        // If this is the last item, generate a guess
-        if (base_pos == (pq_item->size - 1)) {
-            printf("%s\n",cur_guess);
+        record++;
+        if ((record - 1) % program_info->expand_parts != (unsigned long long) program_info->expand_part - 1) {
+            continue;
         }
-        // Not the last item so doing this recursivly
-        else {
-            recursive_guess(pq_item, base_pos +1, cur_guess, new_start);
+        
+        if (skip_pt_policy(context, policy_index, &pq_item) == 1) {
+            continue;
         }
-    }      
-    return;
+        
+        if (generate_pt(context, &pq_item, first, last, count, program_info->threads) != 0) {
+            return 1;
+        }
+    }
+    
+    return (ret == PT_STREAM_END) ? 0 : 1;
 }
 
 
-// Generates guesses from a parse_tree
-void  generate_guesses(PQItem *pq_item) {
-       
-    //Used for debugging
-    //int i;
-    //for (i=0; i < pq_item->size; i++) {
-    //    printf("%s%li ",pq_item->pt[i]->type, pq_item->pt[i]->id);
-    //}
-    //printf("\n");
+// Generates the guesses for each length in --length separately, writing
+// them to PREFIX.<length>
+//
+// Each length gets its own queue, seeded with only the base structures that
+// can make guesses of that length, so each file comes out in probability
+// order. --limit applies to each length
+//
+// Function returns 0 if it worked ok, 1 if an error occured
+//
+int generate_by_length(GuessContext *context, struct program_info *program_info, PolicyIndex *policy_index) {
     
-    char guess[MAX_GUESS_SIZE];
-    recursive_guess(pq_item, 0, guess, 0);
+    PcfgGrammar *pcfg = context->pcfg;
+    
+    // Save the base structures so the list can be put back together for
+    // each length
+    int num_bases = 0;
+    for (PcfgBase *cur = pcfg->base_structures; cur != NULL; cur = cur->next) {
+        num_bases++;
+    }
+    PcfgBase **bases = malloc((num_bases + 1) * sizeof(PcfgBase *));
+    if (bases == NULL) {
+        fprintf(stderr, "Error allocating memory to split the base structures by length\n");
+        return 1;
+    }
+    num_bases = 0;
+    for (PcfgBase *cur = pcfg->base_structures; cur != NULL; cur = cur->next) {
+        bases[num_bases++] = cur;
+    }
+    
+    PasswordPolicy policy = policy_index->policy;
+    int ret = 0;
+    
+    for (int length = 1; (length < MAX_GUESS_SIZE) && (ret == 0); length++) {
+        
+        if (policy.lengths[length] == 0) {
+            continue;
+        }
+        
+        pcfg->base_structures = (num_bases > 0) ? bases[0] : NULL;
+        for (int i = 0; i < num_bases; i++) {
+            bases[i]->prev = (i > 0) ? bases[i - 1] : NULL;
+            bases[i]->next = (i + 1 < num_bases) ? bases[i + 1] : NULL;
+        }
+        
+        memset(policy_index->policy.lengths, 0, MAX_GUESS_SIZE);
+        policy_index->policy.lengths[length] = 1;
+        policy_index->removed_bases = 0;
+        apply_base_policy(policy_index);
+        
+        char filename[PATH_MAX];
+        snprintf(filename, PATH_MAX, "%s.%d", program_info->length_output, length);
+        FILE *fp = fopen(filename, "w");
+        if (fp == NULL) {
+            fprintf(stderr, "Error opening %s\n", filename);
+            ret = 1;
+            break;
+        }
+        fprintf(stderr, "Writing guesses of length %d to %s\n", length, filename);
+        
+        if (pcfg->base_structures != NULL) {
+            priority_queue_t *pq;
+            if (initialize_pcfg_pqueue(&pq, pcfg) != 0) {
+                fprintf(stderr, "Error initializing the Priority Queue\n");
+                fclose(fp);
+                ret = 1;
+                break;
+            }
+            
+            context->out = fp;
+            ret = generate_session(context, pq, program_info, policy_index, NULL, 0, 0);
+            context->out = stdout;
+            
+            while (!priority_queue_empty(pq)) {
+                PQItem *pq_item = priority_queue_pop(pq);
+                free(pq_item->pt);
+                free(pq_item);
+            }
+            priority_queue_free(pq);
+        }
+        fclose(fp);
+        if (ret != 0) {
+            break;
+        }
+    }
+    
+    // Put everything back the way it was
+    policy_index->policy = policy;
+    pcfg->base_structures = (num_bases > 0) ? bases[0] : NULL;
+    for (int i = 0; i < num_bases; i++) {
+        bases[i]->prev = (i > 0) ? bases[i - 1] : NULL;
+        bases[i]->next = (i + 1 < num_bases) ? bases[i + 1] : NULL;
+    }
+    free(bases);
+    return ret;
+}
+
+
+// Lets the user know if any guesses were too long to make
+//
+void print_too_long(GuessContext *context) {
+    if (context->too_long != 0) {
+        fprintf(stderr, "Dropped %llu guesses that were longer than %d characters\n", context->too_long, MAX_GUESS_SIZE - 2);
+    }
+}
+
+
+// Adds a byte string to an FNV-1a hash
+//
+uint64_t hash_bytes(uint64_t hash, const void *data, size_t len) {
+    const unsigned char *bytes = data;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+
+// Hashes everything that changes which pre-terminals come off the queue, and
+// how many guesses each one makes
+//
+// That is the grammar that was loaded, (which covers the ruleset along with
+// --prune_terminals, --prune_base, --max_memory, and --merge_epsilon), and
+// the policy options that skip pre-terminals. Files that save positions in
+// the guess order, (--save_index and --progress), store this so they aren't
+// used with a session that numbers its guesses differently
+//
+uint64_t guess_order_hash(PcfgGrammar *pcfg, struct program_info *program_info) {
+    
+    uint64_t hash = hash_bytes(14695981039346656037ULL, program_info->rule_name, strlen(program_info->rule_name));
+    
+    for (int type = 0; type < PCFG_NUM_TYPES; type++) {
+        for (int id = 0; id <= MAX_TERM_LENGTH; id++) {
+            int32_t num_groups = 0;
+            for (PcfgReplacements *group = pcfg->terminals[type][id]; group != NULL; group = group->child) {
+                hash = hash_bytes(hash, &group->prob, sizeof(group->prob));
+                hash = hash_bytes(hash, &group->size, sizeof(group->size));
+                num_groups++;
+            }
+            hash = hash_bytes(hash, &num_groups, sizeof(num_groups));
+        }
+    }
+    for (PcfgBase *base = pcfg->base_structures; base != NULL; base = base->next) {
+        hash = hash_bytes(hash, &base->prob, sizeof(base->prob));
+        for (int i = 0; i < base->size; i++) {
+            int32_t item[2] = {base->value[i].type, base->value[i].id};
+            hash = hash_bytes(hash, item, sizeof(item));
+        }
+    }
+    
+    // The Markov groups make as many guesses as the keyspace of their level
+    if (pcfg->markov != NULL) {
+        hash = hash_bytes(hash, pcfg->markov->keyspace, sizeof(pcfg->markov->keyspace));
+        hash = hash_bytes(hash, pcfg->markov->group_level, sizeof(pcfg->markov->group_level));
+    }
+    
+    int32_t policy[4] = {program_info->min_length, program_info->max_length, program_info->require, program_info->use_lengths};
+    hash = hash_bytes(hash, policy, sizeof(policy));
+    if (program_info->use_lengths == 1) {
+        hash = hash_bytes(hash, program_info->lengths, sizeof(program_info->lengths));
+    }
+    return hash;
+}
+
 
+// Connects to a coordinator, (see --coordinate), and generates the guesses
+// for each lease it hands out until there is no more work
+//
+// Function returns 0 if it worked ok, 1 if an error occured
+//
+int worker_session(GuessContext *context, struct program_info *program_info, PolicyIndex *policy_index) {
+    
+    int fd = socket_connect(program_info->connect);
+    if (fd == -1) {
+        return 1;
+    }
+    FILE *fp = fdopen(fd, "rb");
+    if (fp == NULL) {
+        close(fd);
+        return 1;
+    }
+    PtStream *stream = open_pt_stream(fp, context->pcfg, program_info->rule_name);
+    if (stream == NULL) {
+        fclose(fp);
+        return 1;
+    }
+    fprintf(stderr, "Connected to the coordinator at %s\n", program_info->connect);
+    
+    time_t next_status = time(NULL) + CRACK_STATUS_INTERVAL;
+    unsigned long long num_leases = 0;
+    uint64_t done = 0;
+    LeaseHeader header;
+    int ret = 0;
+    while (session_done(context, &next_status) == 0) {
+        
+        if (request_lease(fd, fp, done, &header) != 0) {
+            ret = 1;
+            break;
+        }
+        if (header.flags & LEASE_FLAG_DONE) {
+            break;
+        }
+        
+        for (uint32_t i = 0; (i < header.num_records) && (ret == 0); i++) {
+            PQItem pq_item;
+            unsigned long long count;
+            unsigned long long first;
+            unsigned long long last;
+            if (read_pt_record(stream, &pq_item, &count, &first, &last) != PT_STREAM_OK) {
+                ret = 1;
+            }
+            else if (skip_pt_policy(context, policy_index, &pq_item) == 0) {
+                ret = generate_pt(context, &pq_item, first, last, count, program_info->threads);
+            }
+        }
+        if (ret != 0) {
+            break;
+        }
+        
+        // The guesses have to be out before the lease is reported as done
+        fflush(context->out);
+        done = header.id + 1;
+        num_leases++;
+    }
+    
+    fprintf(stderr, "Finished %llu leases\n", num_leases);
+    free_pt_stream(stream);
+    fclose(fp);
+    return ret;
 }
 
 
+// Sets up the priority queue, (and the index if there is one), and then
+// runs the session. With --coverage only the coverage curve is made
+//
+// Function returns 0 if it worked ok, 1 if an error occured
+//
+int queue_session(GuessContext *context, struct program_info *program_info, PolicyIndex *policy_index) {
+    
+    fprintf(stderr, "Initailizing the Priority Queue\n");
+    priority_queue_t* pq;
+
+    if (initialize_pcfg_pqueue(&pq, context->pcfg) != 0) {
+        fprintf(stderr, "Error initializing the Priority Queue. Exiting\n");
+        return 0;
+    }
+    
+    // Only walk the queue and measure how fast probability is covered
+    if (program_info->coverage != NULL) {
+        FILE *coverage_fp = fopen(program_info->coverage, "w");
+        if (coverage_fp == NULL) {
+            fprintf(stderr, "Error opening the coverage file %s. Exiting\n", program_info->coverage);
+            return 0;
+        }
+        fprintf(stderr, "Writing the coverage curve to %s\n", program_info->coverage);
+        int ret = coverage_curve(pq, context->pcfg, policy_index, program_info->limit, coverage_fp);
+        fclose(coverage_fp);
+        return ret;
+    }
+    
+    // Guesses are numbered from the start of the session, (see
+    // pt_guess_count()), so --skip and --limit line up between runs.
+    // num_guesses is the number of the first guess of the next pre-terminal
+    unsigned long long num_pops = 0;
+    unsigned long long num_guesses = 0;
+    // Use the index to find the pre-terminal to start from, and then replay
+    // the queue up to it without looking at any of the guesses
+    if ((program_info->load_index != NULL) && (program_info->skip != 0)) {
+        GuessIndex index;
+        if (load_guess_index(program_info->load_index, program_info->rule_name, guess_order_hash(context->pcfg, program_info), &index) != 0) {
+            fprintf(stderr, "Error loading the index. Exiting\n");
+            return 0;
+        }
+        unsigned long long target_pops;
+        find_index_record(&index, program_info->skip, &target_pops, &num_guesses);
+        free_guess_index(&index);
+        
+        while ((num_pops < target_pops) && (!priority_queue_empty(pq))) {
+            PQItem* pq_item = pcfg_pq_pop(pq);
+            if (pq_item == NULL) {
+                printf("Memory allocation error when popping item from pqueue\n");
+                return 1;
+            }
+            free(pq_item->pt);
+            free(pq_item);
+            num_pops++;
+        }
+    }
+    
+    FILE *index_fp = NULL;
+    if (program_info->save_index != NULL) {
+        index_fp = create_guess_index(program_info->save_index, program_info->rule_name, guess_order_hash(context->pcfg, program_info));
+        if (index_fp == NULL) {
+            return 0;
+        }
+    }
+    
+    fprintf(stderr, "Starting to generate guesses\n");
+    int ret = generate_session(context, pq, program_info, policy_index, index_fp, num_pops, num_guesses);
+    
+    if (index_fp != NULL) {
+        fclose(index_fp);
+    }
+    
+    return ret;
+}
+
 
 // The main program
+// Checks for options that can't be used together. This runs before
+// anything is created, so a bad command line doesn't leave a ring file
+// or a bound socket behind
+//
+// Function returns 0 if the options are ok, 1 if they conflict
+//
+int check_options(struct program_info *program_info) {
+    
+    if ((program_info->rules != NULL) && ((program_info->length_output != NULL) || (program_info->coverage != NULL))) {
+        fprintf(stderr, "Error, --rules can't be used with --length_output or --coverage. Exiting\n");
+        return 1;
+    }
+    
+    if ((program_info->evaluate != NULL) && (program_info->crack != NULL)) {
+        fprintf(stderr, "Error, --evaluate can't be used with --crack. Exiting\n");
+        return 1;
+    }
+    
+    if ((program_info->masks != NULL) && ((program_info->skip != 0) || (program_info->rules != NULL) || (program_info->dedupe != 0) || (program_info->exclude != NULL) || (program_info->crack != NULL) || (program_info->evaluate != NULL) || (program_info->length_output != NULL) || (program_info->coverage != NULL))) {
+        fprintf(stderr, "Error, --masks can't be used with --skip, --rules, --dedupe, --exclude, --crack, --evaluate, --length_output or --coverage. Exiting\n");
+        return 1;
+    }
+    
+    if (((program_info->pt_stream != NULL) || (program_info->debug == 1)) && (((program_info->pt_stream != NULL) && (program_info->debug == 1)) || (program_info->expand != NULL) || (program_info->masks != NULL) || (program_info->rules != NULL) || (program_info->dedupe != 0) || (program_info->exclude != NULL) || (program_info->crack != NULL) || (program_info->evaluate != NULL) || (program_info->length_output != NULL) || (program_info->coverage != NULL))) {
+        fprintf(stderr, "Error, --pt_stream and -d can't be used together, or with --expand, --masks, --rules, --dedupe, --exclude, --crack, --evaluate, --length_output or --coverage. Exiting\n");
+        return 1;
+    }
+    
+    if ((program_info->coordinate != NULL) && ((program_info->connect != NULL) || (program_info->expand != NULL) || (program_info->pt_stream != NULL) || (program_info->debug == 1) || (program_info->masks != NULL) || (program_info->rules != NULL) || (program_info->dedupe != 0) || (program_info->exclude != NULL) || (program_info->crack != NULL) || (program_info->evaluate != NULL) || (program_info->length_output != NULL) || (program_info->coverage != NULL))) {
+        fprintf(stderr, "Error, --coordinate can't be used with --connect, --expand, --pt_stream, -d, --masks, --rules, --dedupe, --exclude, --crack, --evaluate, --length_output or --coverage. Exiting\n");
+        return 1;
+    }
+    
+    if ((program_info->serve != NULL) && ((program_info->coordinate != NULL) || (program_info->pt_stream != NULL) || (program_info->debug == 1) || (program_info->masks != NULL) || (program_info->crack != NULL) || (program_info->evaluate != NULL) || (program_info->length_output != NULL) || (program_info->coverage != NULL))) {
+        fprintf(stderr, "Error, --serve can't be used with --coordinate, --pt_stream, -d, --masks, --crack, --evaluate, --length_output or --coverage. Exiting\n");
+        return 1;
+    }
+    
+    if ((program_info->ring != NULL) && ((program_info->serve != NULL) || (program_info->coordinate != NULL) || (program_info->pt_stream != NULL) || (program_info->debug == 1) || (program_info->masks != NULL) || (program_info->crack != NULL) || (program_info->evaluate != NULL) || (program_info->length_output != NULL) || (program_info->coverage != NULL))) {
+        fprintf(stderr, "Error, --ring can't be used with --serve, --coordinate, --pt_stream, -d, --masks, --crack, --evaluate, --length_output or --coverage. Exiting\n");
+        return 1;
+    }
+    
+    // A worker reports a lease as done once its guesses are written out.
+    // Guesses given to a ring or to --serve clients can still be lost after
+    // that, so those can't be used with --connect
+    if ((program_info->connect != NULL) && ((program_info->expand != NULL) || (program_info->pt_stream != NULL) || (program_info->debug == 1) || (program_info->evaluate != NULL) || (program_info->skip != 0) || (program_info->limit != 0) || (program_info->save_index != NULL) || (program_info->load_index != NULL) || (program_info->length_output != NULL) || (program_info->coverage != NULL) || (program_info->serve != NULL) || (program_info->ring != NULL))) {
+        fprintf(stderr, "Error, --connect can't be used with --expand, --pt_stream, -d, --evaluate, --skip, --limit, --save_index, --load_index, --length_output, --coverage, --serve or --ring. Exiting\n");
+        return 1;
+    }
+    
+    if ((program_info->expand != NULL) && ((program_info->skip != 0) || (program_info->limit != 0) || (program_info->save_index != NULL) || (program_info->load_index != NULL) || (program_info->length_output != NULL) || (program_info->coverage != NULL))) {
+        fprintf(stderr, "Error, --expand can't be used with --skip, --limit, --save_index, --load_index, --length_output or --coverage. Exiting\n");
+        return 1;
+    }
+    
+    if ((program_info->length_output != NULL) && ((program_info->use_lengths == 0) || (program_info->skip != 0) || (program_info->save_index != NULL) || (program_info->coverage != NULL) || (program_info->crack != NULL) || (program_info->evaluate != NULL))) {
+        fprintf(stderr, "Error, --length_output needs --length, and can't be used with --skip, --save_index, --coverage, --crack or --evaluate. Exiting\n");
+        return 1;
+    }
+    
+    return 0;
+}
+
+
 int main(int argc, char *argv[]) {
 	
 	// Holds the info from the command line
@@ -109,6 +1354,22 @@ int main(int argc, char *argv[]) {
     // Print the startup banner
     print_banner(program_info.version);
     
+    // Build an exclude file instead of making guesses
+    if (program_info.build_exclude != NULL) {
+        fprintf(stderr, "Reading words to exclude from stdin\n");
+        return build_exclude_file(stdin, program_info.build_exclude);
+    }
+    
+    // Write out the guesses from another guesser instead of making them
+    if (program_info.client != NULL) {
+        fprintf(stderr, "Reading guesses from the server at %s\n", program_info.client);
+        return read_guess_server(program_info.client, stdout);
+    }
+    
+    if (check_options(&program_info) != 0) {
+        return 0;
+    }
+    
     // Create the empty grammar
     PcfgGrammar pcfg;
     
@@ -119,27 +1380,342 @@ int main(int argc, char *argv[]) {
         return 0;
 	}
 
-    fprintf(stderr, "Initailizing the Priority Queue\n");
-    priority_queue_t* pq;
+    // Estimate guess numbers and/or score passwords instead of making
+    // guesses. This doesn't use the priority queue at all
+    if ((program_info.estimate != 0) || (program_info.score == 1)) {
+        GuessEstimator estimator;
+        if (program_info.estimate != 0) {
+            fprintf(stderr, "Taking %llu samples from the grammar\n", program_info.estimate);
+            if (create_estimator(&pcfg, program_info.estimate, program_info.threads, &estimator) != 0) {
+                free_estimator(&estimator);
+                fprintf(stderr, "Error sampling the grammar. Exiting\n");
+                return 0;
+            }
+        }
+        
+        int ret;
+        if (program_info.score == 1) {
+            ScoreIndex index;
+            fprintf(stderr, "Indexing the grammar\n");
+            if (create_score_index(&pcfg, &index) != 0) {
+                free_score_index(&index);
+                fprintf(stderr, "Error allocating memory to index the grammar. Exiting\n");
+                return 0;
+            }
+            fprintf(stderr, "Reading passwords from stdin\n");
+            ret = score_from_file(&index, (program_info.estimate != 0) ? &estimator : NULL, program_info.threads, stdin);
+            free_score_index(&index);
+        }
+        else {
+            fprintf(stderr, "Reading probabilities from stdin\n");
+            ret = estimate_from_file(&estimator, stdin);
+        }
+        
+        if (program_info.estimate != 0) {
+            free_estimator(&estimator);
+        }
+        return ret;
+    }
+    
+    // Drop the base structures that can't meet the password policy before
+    // anything is queued
+    //
+    // Rules can change a guess's length and character classes, so with
+    // --rules nothing is dropped up front, and each mangled guess is checked
+    // instead
+    PolicyIndex *policy_index = NULL;
+    int use_policy = ((program_info.min_length != 0) || (program_info.max_length != 0) || (program_info.require != 0) || (program_info.use_lengths == 1));
+    PasswordPolicy policy;
+    policy.min_len = program_info.min_length;
+    policy.max_len = program_info.max_length;
+    policy.required = program_info.require;
+    policy.use_lengths = program_info.use_lengths;
+    memcpy(policy.lengths, program_info.lengths, MAX_GUESS_SIZE);
+    
+    if ((use_policy == 1) && (program_info.rules == NULL)) {
+        policy_index = malloc(sizeof(PolicyIndex));
+        if ((policy_index == NULL) || (create_policy_index(&pcfg, &policy, policy_index) != 0)) {
+            fprintf(stderr, "Error allocating memory for the password policy. Exiting\n");
+            return 0;
+        }
+        apply_base_policy(policy_index);
+        fprintf(stderr, "Removed %ld base structures that can't meet the password policy\n", policy_index->removed_bases);
+    }
 
-    initialize_pcfg_pqueue(&pq, &pcfg);
+    GuessContext context;
+    context.pcfg = &pcfg;
+    context.cache = render_cache_create(program_info.render_cache);
+    context.out = stdout;
+    context.buffer = NULL;
+    context.index_range = NULL;
+    context.filter_output = 0;
+    context.too_long = 0;
+    context.policy = ((use_policy == 1) && (program_info.rules != NULL)) ? &policy : NULL;
     
-    fprintf(stderr, "Starting to generate guesses\n");
+    context.rules = NULL;
+    context.rule_batch = NULL;
+    if (program_info.rules != NULL) {
+        context.rules = load_rule_set(program_info.rules, program_info.rule_order);
+        context.rule_batch = calloc(1, sizeof(RuleBatch));
+        if ((context.rules == NULL) || (context.rule_batch == NULL)) {
+            fprintf(stderr, "Error loading the rules. Exiting\n");
+            return 0;
+        }
+        fprintf(stderr, "Applying %d rules from %s to every guess\n", context.rules->num_rules, program_info.rules);
+    }
+    
+    context.dedupe = NULL;
+    if (program_info.dedupe != 0) {
+        context.dedupe = dedupe_create(program_info.dedupe, program_info.dedupe_fp_rate);
+        if (context.dedupe == NULL) {
+            fprintf(stderr, "Error allocating memory for the duplicate filter. Exiting\n");
+            return 0;
+        }
+    }
+    
+    context.exclude = NULL;
+    context.exclude_batch = NULL;
+    if (program_info.exclude != NULL) {
+        context.exclude = load_exclude_set(program_info.exclude);
+        context.exclude_batch = calloc(1, sizeof(ExcludeBatch));
+        if ((context.exclude == NULL) || (context.exclude_batch == NULL)) {
+            fprintf(stderr, "Error loading the exclude file. Exiting\n");
+            return 0;
+        }
+        fprintf(stderr, "Excluding %zu fingerprints from %s\n", context.exclude->count, program_info.exclude);
+    }
+    
+    context.crack = NULL;
+    context.crack_batch = NULL;
+    if (program_info.crack != NULL) {
+        context.crack = load_crack_set(program_info.crack, program_info.hash_type, stdout);
+        context.crack_batch = calloc(1, sizeof(CrackBatch));
+        if ((context.crack == NULL) || (context.crack_batch == NULL)) {
+            fprintf(stderr, "Error loading the hash list. Exiting\n");
+            return 0;
+        }
+        fprintf(stderr, "Cracking %u hashes from %s\n", context.crack->count, program_info.crack);
+    }
+    
+    context.evaluate = NULL;
+    context.eval_hits = NULL;
+    if (program_info.evaluate != NULL) {
+        context.evaluate = load_eval_set(program_info.evaluate);
+        context.eval_hits = calloc(1, sizeof(EvalHits));
+        if ((context.evaluate == NULL) || (context.eval_hits == NULL)) {
+            fprintf(stderr, "Error loading the test set. Exiting\n");
+            return 0;
+        }
+        fprintf(stderr, "Evaluating against %llu test passwords, (%u unique), from %s\n", context.evaluate->total, context.evaluate->count, program_info.evaluate);
+    }
+    
+    context.masks = NULL;
+    context.mask_out = NULL;
+    context.mask_line = NULL;
+    if (program_info.masks != NULL) {
+        context.mask_out = fopen(program_info.masks, "w");
+        if (context.mask_out == NULL) {
+            fprintf(stderr, "Error opening the mask file %s. Exiting\n", program_info.masks);
+            return 0;
+        }
+        context.masks = malloc(sizeof(MaskIndex));
+        if ((context.masks == NULL) || (create_mask_index(&pcfg, program_info.mask_min, context.masks) != 0)) {
+            fprintf(stderr, "Error allocating memory for the mask index. Exiting\n");
+            return 0;
+        }
+        fprintf(stderr, "Writing masks that make at least %llu guesses to %s\n", program_info.mask_min, program_info.masks);
+    }
+    
+    // Write out the pre-terminals instead of their guesses. -d writes them
+    // as text to stdout
+    context.pt_stream = NULL;
+    FILE *pt_fp = NULL;
+    if ((program_info.pt_stream != NULL) || (program_info.debug == 1)) {
+        pt_fp = ((program_info.debug == 1) || (strcmp(program_info.pt_stream, "-") == 0)) ? stdout : fopen(program_info.pt_stream, "wb");
+        if (pt_fp == NULL) {
+            fprintf(stderr, "Error opening the pre-terminal stream %s. Exiting\n", program_info.pt_stream);
+            return 0;
+        }
+        context.pt_stream = create_pt_stream(pt_fp, &pcfg, program_info.rule_name, program_info.debug);
+        if (context.pt_stream == NULL) {
+            return 0;
+        }
+    }
+    
+    // Hand out the pre-terminals to workers instead of generating them
+    context.coordinator = NULL;
+    if (program_info.coordinate != NULL) {
+        // The leases also depend on where --skip and --limit cut the session
+        uint64_t order_hash = guess_order_hash(&pcfg, &program_info);
+        unsigned long long range[2] = {program_info.skip, program_info.limit};
+        order_hash = hash_bytes(order_hash, range, sizeof(range));
+        context.coordinator = create_coordinator(program_info.coordinate, &pcfg, program_info.rule_name, order_hash, program_info.lease_size, program_info.lease_timeout, program_info.progress);
+        if (context.coordinator == NULL) {
+            return 0;
+        }
+        fprintf(stderr, "Handing out leases of %llu guesses to workers on %s\n", program_info.lease_size, program_info.coordinate);
+    }
+    
+    // Send the guesses to clients instead of stdout
+    context.server = NULL;
+    if (program_info.serve != NULL) {
+        context.server = create_guess_server(program_info.serve);
+        if (context.server == NULL) {
+            return 0;
+        }
+        fprintf(stderr, "Sending guesses to clients on %s\n", program_info.serve);
+    }
+    
+    // Write the guesses to a shared memory ring instead of stdout
+    context.ring = NULL;
+    if (program_info.ring != NULL) {
+        context.ring = create_guess_ring(program_info.ring, program_info.ring_size);
+        if (context.ring == NULL) {
+            return 0;
+        }
+        fprintf(stderr, "Writing guesses to the %lu MB ring %s\n", program_info.ring_size, program_info.ring);
+    }
+    
+    // Run a separate session for each length
+    if (program_info.length_output != NULL) {
+        int ret = generate_by_length(&context, &program_info, policy_index);
+        print_too_long(&context);
+        render_cache_free(context.cache);
+        if (context.dedupe != NULL) {
+            fprintf(stderr, "Dropped %llu duplicate guesses. The duplicate filter was cleared %llu times\n", context.dedupe->suppressed, context.dedupe->resets);
+            dedupe_free(context.dedupe);
+        }
+        free_exclude_set(context.exclude);
+        free(context.exclude_batch);
+        return ret;
+    }
 
-    // Start generating guesses
-    while (!priority_queue_empty(pq)) {
-        PQItem* pq_item = pcfg_pq_pop(pq);
-        if (pq_item == NULL) {
-            printf("Memory allocation error when popping item from pqueue\n");
-            return 1;
+    // Generate the guesses for leases from a coordinator, or expand a
+    // pre-terminal stream, instead of running the queue
+    int ret;
+    if (program_info.connect != NULL) {
+        ret = worker_session(&context, &program_info, policy_index);
+    }
+    else if (program_info.expand != NULL) {
+        FILE *expand_fp = (strcmp(program_info.expand, "-") == 0) ? stdin : fopen(program_info.expand, "rb");
+        if (expand_fp == NULL) {
+            fprintf(stderr, "Error opening the pre-terminal stream %s. Exiting\n", program_info.expand);
+            return 0;
         }
-        
-        generate_guesses(pq_item);
-        
-        free(pq_item->pt);
-        free(pq_item);
+        PtStream *stream = open_pt_stream(expand_fp, &pcfg, program_info.rule_name);
+        if (stream == NULL) {
+            return 0;
+        }
+        fprintf(stderr, "Expanding the pre-terminals in %s\n", program_info.expand);
+        ret = expand_session(&context, stream, &program_info, policy_index);
+        free_pt_stream(stream);
+        if (expand_fp != stdin) {
+            fclose(expand_fp);
+        }
+    }
+    else {
+        ret = queue_session(&context, &program_info, policy_index);
+    }
+    
+    if (context.coordinator != NULL) {
+        if ((ret == 0) && (coordinator_finish(context.coordinator) != 0)) {
+            ret = 1;
+        }
+        Coordinator *coord = context.coordinator;
+        fprintf(stderr, "Handed out %llu leases, (%llu given out again), %llu finished, %llu skipped since they were finished in an earlier run\n", coord->issued, coord->reissued, coord->completed, coord->skipped);
+        free_coordinator(coord);
+    }
+    
+    if (context.server != NULL) {
+        if ((ret == 0) && (finish_guess_server(context.server) != 0)) {
+            ret = 1;
+        }
+        GuessServer *server = context.server;
+        fprintf(stderr, "Sent %llu guesses in %llu batches to %llu clients\n", server->guesses_sent, server->batches_sent, server->num_clients);
+        free_guess_server(server);
+    }
+    
+    if (context.ring != NULL) {
+        if ((ret == 0) && (finish_guess_ring(context.ring) != 0)) {
+            ret = 1;
+        }
+        GuessRing *ring = context.ring;
+        fprintf(stderr, "Wrote %llu guesses in %llu batches to the ring, waited for the consumer %llu times\n", ring->guesses_sent, ring->batches_sent, ring->waits);
+        free_guess_ring(ring);
+    }
+    
+    if (context.pt_stream != NULL) {
+        if (program_info.debug == 0) {
+            fprintf(stderr, "Wrote %llu pre-terminals to %s\n", context.pt_stream->records, program_info.pt_stream);
+        }
+        free_pt_stream(context.pt_stream);
+        if ((pt_fp != stdout) && (fclose(pt_fp) != 0)) {
+            fprintf(stderr, "Error writing the pre-terminal stream\n");
+            ret = 1;
+        }
+    }
+    
+    render_cache_free(context.cache);
+    free_rule_set(context.rules);
+    free(context.rule_batch);
+    
+    if (context.evaluate != NULL) {
+        EvalSet *eval_set = context.evaluate;
+        fprintf(stderr, "Cracked %llu of %llu test passwords (%.2f%%), (%u of %u unique), in %llu guesses\n", eval_set->num_cracked, eval_set->total, 100.0 * eval_set->num_cracked / eval_set->total, eval_set->num_found, eval_set->count, eval_set->guesses);
+        if (eval_set->failed) {
+            fprintf(stderr, "Error, stopped early since a test set hit couldn't be recorded. The results are incomplete\n");
+            ret = 1;
+        }
+        eval_write_curve(eval_set, stdout);
+        if (program_info.evaluate_hits != NULL) {
+            FILE *hits_fp = fopen(program_info.evaluate_hits, "w");
+            if (hits_fp == NULL) {
+                fprintf(stderr, "Error opening %s to save the test set hits\n", program_info.evaluate_hits);
+                ret = 1;
+            }
+            else {
+                eval_write_hits(eval_set, hits_fp);
+                fclose(hits_fp);
+            }
+        }
+        free_eval_set(eval_set);
+        free(context.eval_hits->hits);
+        free(context.eval_hits);
+    }
+    
+    if (context.masks != NULL) {
+        MaskIndex *masks = context.masks;
+        fprintf(stderr, "Wrote %llu mask lines covering %llu guesses from %llu pre-terminals\n", masks->mask_lines, masks->mask_guesses, masks->mask_pts);
+        free_mask_index(masks);
+        free(masks);
+        fclose(context.mask_out);
+    }
+    
+    if (context.crack != NULL) {
+        print_crack_status(context.crack);
+        free_crack_set(context.crack);
+        free(context.crack_batch);
+    }
+    
+    if (context.exclude != NULL) {
+        fprintf(stderr, "Excluded %llu guesses\n", context.exclude->excluded);
+        free_exclude_set(context.exclude);
+        free(context.exclude_batch);
+    }
+    
+    if (context.dedupe != NULL) {
+        fprintf(stderr, "Dropped %llu duplicate guesses. The duplicate filter was cleared %llu times\n", context.dedupe->suppressed, context.dedupe->resets);
+        dedupe_free(context.dedupe);
+    }
+    
+    print_too_long(&context);
+    
+    if (policy_index != NULL) {
+        fprintf(stderr, "Skipped %llu pre-terminals that couldn't meet the password policy\n", policy_index->skipped_pts);
+        free_policy_index(policy_index);
+        free(policy_index);
     }
 
 
-	return 0;
+	return ret;
 }
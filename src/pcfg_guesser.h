@@ -28,12 +28,147 @@
 #define _PCFG_GUESSER_H
 
 #include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include <pthread.h>
+#include <time.h>
 #include "command_line.h"
 #include "banner_info.h"
 #include "grammar_io.h"
 #include "grammar.h"
 #include "pqueue.h"
 #include "pcfg_pqueue.h"
+#include "markov_guess.h"
+#include "render_cache.h"
+#include "guess_index.h"
+#include "coverage.h"
+#include "guess_estimate.h"
+#include "password_score.h"
+#include "policy.h"
+#include "dedupe.h"
+#include "exclude.h"
+#include "crack.h"
+#include "evaluate.h"
+#include "rules.h"
+#include "masks.h"
+#include "pt_stream.h"
+#include "coordinator.h"
+#include "guess_server.h"
+#include "guess_ring.h"
+
+
+// When using multiple threads, pre-terminals that make at least this many
+// guesses are split up between the threads. Each thread generates
+// THREAD_CHUNK_SIZE guesses at a time
+#define THREAD_CHUNK_SIZE 262144
+#define THREAD_SPLIT_SIZE (2 * THREAD_CHUNK_SIZE)
+
+
+// Holds guesses in memory so they can be written out later
+typedef struct OutputBuffer {
+    char *data;
+    size_t len;
+    size_t size;
+} OutputBuffer;
+
+
+// A range of guesses to generate from a pre-terminal, from first up to but
+// not including last. See pt_guess_count() for how guesses are numbered
+typedef struct IndexRange {
+    unsigned long long first;
+    unsigned long long last;
+    
+    // The number of guesses made by the items after each position in the
+    // pre-terminal. Aka, how much the guess number goes up by when the value
+    // at that position changes
+    unsigned long long *subtree;
+} IndexRange;
+
+
+// Everything needed to generate guesses from a pre-terminal
+typedef struct GuessContext {
+    PcfgGrammar *pcfg;
+    
+    // Cache of rendered alpha/capitalization products. NULL if disabled
+    RenderCache *cache;
+    
+    // Where guesses are written to, (normally stdout)
+    FILE *out;
+    
+    // If not NULL, guesses are saved here instead of being written to out
+    OutputBuffer *buffer;
+    
+    // If not NULL, only the guesses in this range are generated
+    IndexRange *index_range;
+    
+    // Guesses that weren't made since they would be longer than
+    // MAX_GUESS_SIZE allows
+    unsigned long long too_long;
+    
+    // Used to output part of a pre-terminal that can't be indexed. If
+    // filter_output is 1, the first output_skip guesses are dropped and then
+    // at most output_left guesses are output
+    int filter_output;
+    unsigned long long output_skip;
+    unsigned long long output_left;
+    
+    // If not NULL, every rule is applied to each guess, and the mangled
+    // guesses are output instead. Guesses wait in rule_batch until it is
+    // full or flush_batches() is called
+    RuleSet *rules;
+    RuleBatch *rule_batch;
+    
+    // If not NULL, each guess is checked against this policy before it
+    // is output
+    PasswordPolicy *policy;
+    
+    // If not NULL, guesses that are already in this filter are dropped
+    DedupeFilter *dedupe;
+    
+    // If not NULL, guesses that are in this set are dropped. Guesses are
+    // checked in batches, so they wait in exclude_batch until it is full or
+    // flush_batches() is called
+    ExcludeSet *exclude;
+    ExcludeBatch *exclude_batch;
+    
+    // If not NULL, guesses are hashed and checked against this hash list
+    // instead of being output. Like exclude, they wait in crack_batch until
+    // it is full or flush_batches() is called
+    CrackSet *crack;
+    CrackBatch *crack_batch;
+    
+    // If not NULL, guesses are checked against this test set instead of
+    // being output. Hits wait in eval_hits until eval_resolve() gives them
+    // their guess numbers
+    EvalSet *evaluate;
+    EvalHits *eval_hits;
+    
+    // If not NULL, the end of each pre-terminal that can be a mask is
+    // written to mask_out as hashcat masks instead of being generated
+    MaskIndex *masks;
+    FILE *mask_out;
+    
+    // If not NULL, each guess is the prefix of this mask, and a mask line
+    // is written instead of the guess
+    MaskLine *mask_line;
+    
+    // If not NULL, pre-terminals are written to this stream instead of
+    // being generated
+    PtStream *pt_stream;
+    
+    // If not NULL, pre-terminals are added to leases for the workers instead
+    // of being generated
+    Coordinator *coordinator;
+    
+    // If not NULL, guesses are sent in batches to its clients instead of
+    // being written to out
+    GuessServer *server;
+    
+    // If not NULL, guesses are written to this shared memory ring instead
+    // of to out
+    GuessRing *ring;
+} GuessContext;
 
 #endif
 
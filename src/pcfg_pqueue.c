@@ -228,31 +228,17 @@ int initialize_pcfg_pqueue(priority_queue_t **pq, PcfgGrammar *pcfg) {
         for (int i = 0; i< cur_base->size; i++) {
             
             // Need to find the right pointer based on the type
-            char *type = cur_base->value[i].type;
-            if (strncmp(type,"A",10) == 0) {    
-                pq_item->pt[i] = pcfg->alpha[cur_base->value[i].id];
-            }
-            else if (strncmp(type,"C",10) == 0) {
-                pq_item->pt[i] = pcfg->capitalization[cur_base->value[i].id];
-            }
-            else if (strncmp(type,"D",10) == 0) {
-                pq_item->pt[i] = pcfg->digits[cur_base->value[i].id];
-            }
-            else if (strncmp(type,"Y",10) == 0) {
-                pq_item->pt[i] = pcfg->years[cur_base->value[i].id];
-            }
-            else if (strncmp(type,"O",10) == 0) {
-                pq_item->pt[i] = pcfg->other[cur_base->value[i].id];
-            }
-            else if (strncmp(type,"K",10) == 0) {
-                pq_item->pt[i] = pcfg->keyboard[cur_base->value[i].id];
-            }
-            else if (strncmp(type,"X",10) == 0) {
-                pq_item->pt[i] = pcfg->x[cur_base->value[i].id];
+            int type = cur_base->value[i].type;
+            int id = cur_base->value[i].id;
+            if ((type >= PCFG_NUM_TYPES) || (id < 0) || (id > MAX_TERM_LENGTH)) {
+                return 1;
             }
-            else {
+            pq_item->pt[i] = pcfg->terminals[type][id];
+            
+            // The base structure uses a terminal that isn't in the ruleset
+            if (pq_item->pt[i] == NULL) {
                 return 1;
-            }       
+            }
         }
 
         calculate_prob(pq_item);
@@ -265,4 +251,43 @@ int initialize_pcfg_pqueue(priority_queue_t **pq, PcfgGrammar *pcfg) {
     }
     
     return 0;
+}
+
+
+// Returns the number of values in a replacement group
+//
+// Markov groups can have more guesses than fit in their size, so the
+// keyspace of their level is used instead
+//
+unsigned long long group_guess_count(PcfgGrammar *pcfg, PcfgReplacements *group) {
+    
+    if ((group->type == PCFG_MARKOV) && (pcfg->markov != NULL)) {
+        return pcfg->markov->keyspace[markov_group_level(pcfg, group)];
+    }
+    return group->size;
+}
+
+
+// Returns the number of guesses a pre-terminal will generate
+//
+// This is the product of the sizes of its groups. Guesses are numbered in
+// the order they are generated, which makes the number a mixed radix number
+// with one digit per group, and the last group changing the fastest.
+//
+// Note: Values that don't fit in a guess, (aka it would be too long), are
+// still counted even though no guess is made for them
+//
+// Returns ULLONG_MAX if the count is too big to hold
+//
+unsigned long long pt_guess_count(PcfgGrammar *pcfg, PQItem *pq_item) {
+    
+    unsigned long long count = 1;
+    for (int i = 0; i < pq_item->size; i++) {
+        unsigned long long size = group_guess_count(pcfg, pq_item->pt[i]);
+        if ((size != 0) && (count > ULLONG_MAX / size)) {
+            return ULLONG_MAX;
+        }
+        count *= size;
+    }
+    return count;
 }
\ No newline at end of file
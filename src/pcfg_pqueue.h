@@ -27,8 +27,10 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <limits.h>
 #include "grammar.h"
 #include "pqueue.h"
+#include "markov_guess.h"
 
 
 // Parse Tree Item
@@ -59,5 +61,11 @@ void* pcfg_pq_pop(priority_queue_t *pq);
 // Intitialize a PCFG PQueue
 extern int initialize_pcfg_pqueue(priority_queue_t **pq, PcfgGrammar *pcfg);
 
+// Returns the number of values in a replacement group
+extern unsigned long long group_guess_count(PcfgGrammar *pcfg, PcfgReplacements *group);
+
+// Returns the number of guesses a pre-terminal will generate
+extern unsigned long long pt_guess_count(PcfgGrammar *pcfg, PQItem *pq_item);
+
 
 #endif
\ No newline at end of file
@@ -0,0 +1,266 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Pretty Cool Fuzzy Guesser (PCFG)
+//  --Probabilistic Context Free Grammar (PCFG) Password Guessing Program
+//
+//  Written by Matt Weir
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//
+
+
+
+// Shared memory ring that pcfg_guesser --ring writes guesses into
+//
+// This header is all a cracking tool needs to read the guesses. Only one
+// consumer can read a ring. For example:
+//
+//     PcfgRing ring;
+//     const char *guesses;
+//     uint32_t len, num_guesses;
+//     if (pcfg_ring_attach("/dev/shm/guesses", &ring) != 0) ...
+//     while (pcfg_ring_next(&ring, &guesses, &len, &num_guesses) == 1) {
+//         // guesses holds num_guesses newline terminated guesses, len bytes
+//         // in all, read straight out of the ring
+//         pcfg_ring_release(&ring);
+//     }
+//     pcfg_ring_detach(&ring);
+//
+// The ring is a file of a PcfgRingHeader followed by the data. The data is
+// a sequence of batches, each a PcfgRingBatch followed by the guesses,
+// padded to 8 bytes. A batch is never split by the end of the data. When
+// the next one won't fit, a batch with a len of PCFG_RING_WRAP says to go
+// back to the start.
+//
+// head and tail count all the bytes ever written and read, so the offset
+// into the data is the count % size. The producer and the consumer only
+// sleep, (on a futex on Linux), when the ring is full or empty
+
+#ifndef _PCFG_RING_H
+#define _PCFG_RING_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+
+#define PCFG_RING_MAGIC "PCFGRNG1"
+
+// The most bytes of guesses in one batch
+#define PCFG_RING_BATCH_SIZE 65536
+
+// Batch len that means the rest of the data is unused
+#define PCFG_RING_WRAP 0xFFFFFFFFu
+
+// How long to sleep before checking if the other side is still running
+#define PCFG_RING_WAIT_MS 100
+
+
+// The head and the tail are on separate cache lines so the producer and the
+// consumer don't slow each other down
+typedef struct PcfgRingHeader {
+    char magic[8];
+    uint64_t size;              // Bytes of data after the header
+    uint32_t producer_pid;
+    uint32_t consumer_pid;      // 0 until a consumer attaches
+    char pad0[40];
+    
+    // Written by the producer
+    uint64_t head;              // Bytes of batches ready to read
+    uint32_t head_seq;          // Bumped when head moves, for futex waits
+    uint32_t producer_waiting;  // 1 if the producer is waiting for room
+    uint32_t done;              // 1 once head won't move again
+    char pad1[44];
+    
+    // Written by the consumer
+    uint64_t tail;              // Bytes of batches that are read
+    uint32_t tail_seq;          // Bumped when tail moves, for futex waits
+    uint32_t consumer_waiting;  // 1 if the consumer is waiting for batches
+    char pad2[48];
+} PcfgRingHeader;
+
+
+typedef struct PcfgRingBatch {
+    uint32_t len;
+    uint32_t num_guesses;
+} PcfgRingBatch;
+
+
+// A consumer's view of the ring
+typedef struct PcfgRing {
+    PcfgRingHeader *header;
+    char *data;
+    size_t map_size;
+    uint64_t next;          // Where the batch after the current one starts
+} PcfgRing;
+
+
+// Sleeps until *word is no longer value, it is woken up, or
+// PCFG_RING_WAIT_MS passes
+//
+static inline void pcfg_ring_wait(uint32_t *word, uint32_t value) {
+#ifdef __linux__
+    struct timespec timeout = {0, PCFG_RING_WAIT_MS * 1000000L};
+    syscall(SYS_futex, word, FUTEX_WAIT, value, &timeout, NULL, 0);
+#else
+    struct timespec pause = {0, 100000L};
+    if (__atomic_load_n(word, __ATOMIC_ACQUIRE) == value) {
+        nanosleep(&pause, NULL);
+    }
+#endif
+}
+
+
+// Wakes up anything sleeping in pcfg_ring_wait() on word
+//
+static inline void pcfg_ring_wake(uint32_t *word) {
+#ifdef __linux__
+    syscall(SYS_futex, word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+#else
+    (void) word;
+#endif
+}
+
+
+// Returns 1 if the process is still running
+//
+static inline int pcfg_ring_alive(uint32_t pid) {
+    return (pid == 0) || (kill((pid_t) pid, 0) == 0) || (errno != ESRCH);
+}
+
+
+// Attaches to a ring as its only consumer
+//
+// Returns 0 if it worked ok, 1 if the ring doesn't exist yet, 2 if it isn't
+// a valid ring or already has a consumer
+//
+static inline int pcfg_ring_attach(const char *path, PcfgRing *ring) {
+    
+    int fd = open(path, O_RDWR);
+    if (fd == -1) {
+        return 1;
+    }
+    
+    struct stat file_stat;
+    if ((fstat(fd, &file_stat) != 0) || ((size_t) file_stat.st_size < sizeof(PcfgRingHeader))) {
+        close(fd);
+        return 2;
+    }
+    
+    void *map = mmap(NULL, file_stat.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return 2;
+    }
+    
+    PcfgRingHeader *header = map;
+    uint32_t no_consumer = 0;
+    if ((memcmp(header->magic, PCFG_RING_MAGIC, 8) != 0) || (header->size + sizeof(PcfgRingHeader) != (uint64_t) file_stat.st_size) ||
+        (!__atomic_compare_exchange_n(&header->consumer_pid, &no_consumer, (uint32_t) getpid(), 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))) {
+        munmap(map, file_stat.st_size);
+        return 2;
+    }
+    
+    ring->header = header;
+    ring->data = (char *) map + sizeof(PcfgRingHeader);
+    ring->map_size = file_stat.st_size;
+    ring->next = header->tail;
+    return 0;
+}
+
+
+// Waits for the next batch of guesses. guesses points into the ring, and
+// stays valid until pcfg_ring_release() is called
+//
+// Returns 1 if there is a batch, 0 if there are no more guesses, -1 if the
+// producer went away before it finished
+//
+static inline int pcfg_ring_next(PcfgRing *ring, const char **guesses, uint32_t *len, uint32_t *num_guesses) {
+    
+    PcfgRingHeader *header = ring->header;
+    uint64_t tail = header->tail;
+    
+    while (1) {
+        
+        if (__atomic_load_n(&header->head, __ATOMIC_ACQUIRE) != tail) {
+            PcfgRingBatch *batch = (PcfgRingBatch *) (ring->data + (tail % header->size));
+            if (batch->len == PCFG_RING_WRAP) {
+                tail += header->size - (tail % header->size);
+                continue;
+            }
+            *guesses = (const char *) (batch + 1);
+            *len = batch->len;
+            *num_guesses = batch->num_guesses;
+            ring->next = tail + sizeof(PcfgRingBatch) + ((batch->len + 7) & ~7u);
+            return 1;
+        }
+        
+        // Let the producer know it needs to wake us up, then check again
+        // before sleeping. done is read first since the last head is
+        // written before it
+        __atomic_store_n(&header->consumer_waiting, 1, __ATOMIC_SEQ_CST);
+        uint32_t seq = __atomic_load_n(&header->head_seq, __ATOMIC_SEQ_CST);
+        uint32_t done = __atomic_load_n(&header->done, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&header->head, __ATOMIC_SEQ_CST) == tail) {
+            if (done == 1) {
+                __atomic_store_n(&header->consumer_waiting, 0, __ATOMIC_SEQ_CST);
+                return 0;
+            }
+            if (!pcfg_ring_alive(header->producer_pid)) {
+                __atomic_store_n(&header->consumer_waiting, 0, __ATOMIC_SEQ_CST);
+                return -1;
+            }
+            pcfg_ring_wait(&header->head_seq, seq);
+        }
+        __atomic_store_n(&header->consumer_waiting, 0, __ATOMIC_SEQ_CST);
+    }
+}
+
+
+// Hands the space used by the last batch back to the producer
+//
+static inline void pcfg_ring_release(PcfgRing *ring) {
+    PcfgRingHeader *header = ring->header;
+    __atomic_store_n(&header->tail, ring->next, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&header->tail_seq, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&header->producer_waiting, __ATOMIC_SEQ_CST) == 1) {
+        pcfg_ring_wake(&header->tail_seq);
+    }
+}
+
+
+// Stops reading the ring
+//
+static inline void pcfg_ring_detach(PcfgRing *ring) {
+    munmap(ring->header, ring->map_size);
+    ring->header = NULL;
+}
+
+#endif
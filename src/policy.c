@@ -0,0 +1,441 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Pretty Cool Fuzzy Guesser (PCFG)
+//  --Probabilistic Context Free Grammar (PCFG) Password Guessing Program
+//
+//  Written by Matt Weir
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//
+
+
+
+#include "policy.h"
+
+
+// Parses a list of character classes, aka "lud" for lower, upper and digits
+//
+// Function returns 0 if it worked ok, 1 if there is an unknown class
+//
+int parse_policy_classes(char *arg, int *classes) {
+    (*classes) = 0;
+    for (int i = 0; arg[i] != '\0'; i++) {
+        char *found = strchr(POLICY_CLASS_NAMES, arg[i]);
+        if (found == NULL) {
+            return 1;
+        }
+        (*classes) |= 1 << (found - POLICY_CLASS_NAMES);
+    }
+    return 0;
+}
+
+
+// Parses a set of lengths, aka "8" or "8,10-12"
+//
+// lengths has MAX_GUESS_SIZE items, and lengths[n] is set to 1 for every
+// length n in the set
+//
+// Function returns 0 if it worked ok, 1 if the set is invalid
+//
+int parse_length_set(char *arg, unsigned char *lengths) {
+    
+    memset(lengths, 0, MAX_GUESS_SIZE);
+    
+    char *pos = arg;
+    while (1) {
+        char *end;
+        long first = strtol(pos, &end, 10);
+        if (end == pos) {
+            return 1;
+        }
+        long last = first;
+        pos = end;
+        if (*pos == '-') {
+            pos++;
+            last = strtol(pos, &end, 10);
+            if (end == pos) {
+                return 1;
+            }
+            pos = end;
+        }
+        if ((first < 1) || (last < first) || (last >= MAX_GUESS_SIZE)) {
+            return 1;
+        }
+        for (long i = first; i <= last; i++) {
+            lengths[i] = 1;
+        }
+        
+        if (*pos == '\0') {
+            return 0;
+        }
+        if (*pos != ',') {
+            return 1;
+        }
+        pos++;
+    }
+}
+
+
+// Returns the character class of a byte, or 0 if it is the middle of a
+// UTF-8 character
+//
+static inline int char_class(unsigned char c) {
+    if ((c >= 'a') && (c <= 'z')) {
+        return POLICY_LOWER;
+    }
+    if ((c >= 'A') && (c <= 'Z')) {
+        return POLICY_UPPER;
+    }
+    if ((c >= '0') && (c <= '9')) {
+        return POLICY_DIGIT;
+    }
+    if ((c & 0xC0) == 0x80) {
+        return 0;
+    }
+    return POLICY_SYMBOL;
+}
+
+
+// Finds the length in characters and the character classes of a value
+//
+// If letters is 0, ASCII letters don't count as any class. That is used for
+// alpha values since their case comes from the capitalization mask
+//
+void value_policy_info(char *value, int value_len, int letters, int *num_chars, int *classes) {
+    (*num_chars) = 0;
+    (*classes) = 0;
+    for (int i = 0; i < value_len; i++) {
+        int class = char_class(value[i]);
+        if (class == 0) {
+            continue;
+        }
+        (*num_chars)++;
+        if ((letters == 1) || ((class != POLICY_LOWER) && (class != POLICY_UPPER))) {
+            (*classes) |= class;
+        }
+    }
+}
+
+
+// Adds one value to the info for a group
+//
+static void add_policy_value(GroupPolicyInfo *info, int num_chars, int classes) {
+    if (num_chars < info->min_len) {
+        info->min_len = num_chars;
+    }
+    if (num_chars > info->max_len) {
+        info->max_len = num_chars;
+    }
+    info->may |= classes;
+    info->must &= classes;
+}
+
+
+// Finds what the values in a group can look like
+//
+void group_policy_info(PcfgGrammar *pcfg, PcfgReplacements *group, GroupPolicyInfo *info) {
+    
+    info->min_len = MAX_GUESS_SIZE;
+    info->max_len = 0;
+    info->may = 0;
+    info->must = POLICY_LOWER | POLICY_UPPER | POLICY_DIGIT | POLICY_SYMBOL;
+    info->all_letters = 1;
+    
+    if (group->type == PCFG_MARKOV) {
+        
+        // Any of the lengths up to the group's level can be made, from any
+        // character in the alphabet
+        MarkovGrammar *markov = pcfg->markov;
+        int level = markov_group_level(pcfg, group);
+        for (int length = markov->ngram - 1; length < MAX_GUESS_SIZE; length++) {
+            if ((markov->ln_level[length] >= 0) && (markov->ln_level[length] <= level)) {
+                add_policy_value(info, length, 0);
+            }
+        }
+        for (int c = 0; c < markov->alphabet_size; c++) {
+            info->may |= char_class(markov->alphabet[c][0]);
+        }
+        info->must = 0;
+    }
+    else if (group->range != NULL) {
+        add_policy_value(info, group->range->width, POLICY_DIGIT);
+    }
+    else if (group->type == PCFG_CAPITALIZATION) {
+        
+        // Masks don't add any characters, they just set the case of the
+        // alpha value before them
+        for (int i = 0; i < group->size; i++) {
+            char *mask = pcfg_value(group, i);
+            int classes = 0;
+            for (int j = 0; j < pcfg_value_len(group, i); j++) {
+                classes |= (mask[j] == 'L') ? POLICY_LOWER : POLICY_UPPER;
+            }
+            add_policy_value(info, 0, classes);
+        }
+    }
+    else {
+        int letters = (group->type != PCFG_ALPHA);
+        for (int i = 0; i < group->size; i++) {
+            char *value = pcfg_value(group, i);
+            int value_len = pcfg_value_len(group, i);
+            int num_chars, classes;
+            value_policy_info(value, value_len, letters, &num_chars, &classes);
+            add_policy_value(info, num_chars, classes);
+            
+            // Anything other than an ASCII letter means the mask might not
+            // change the case of every character
+            for (int j = 0; (j < value_len) && (info->all_letters == 1); j++) {
+                if ((char_class(value[j]) != POLICY_LOWER) && (char_class(value[j]) != POLICY_UPPER)) {
+                    info->all_letters = 0;
+                }
+            }
+        }
+    }
+    
+    // Empty group
+    if (info->min_len > info->max_len) {
+        info->min_len = 0;
+        info->must = 0;
+    }
+}
+
+
+// Finds what every group in the grammar can make
+//
+// Function returns 0 if it worked ok, 1 if there was a memory allocation error
+//
+int create_policy_index(PcfgGrammar *pcfg, PasswordPolicy *policy, PolicyIndex *index) {
+    
+    memset(index, 0, sizeof(PolicyIndex));
+    index->policy = (*policy);
+    index->pcfg = pcfg;
+    
+    for (int type = 0; type < PCFG_NUM_TYPES; type++) {
+        for (int id = 0; id <= MAX_TERM_LENGTH; id++) {
+            
+            int num_groups = 0;
+            for (PcfgReplacements *cur = pcfg->terminals[type][id]; cur != NULL; cur = cur->child) {
+                num_groups++;
+            }
+            if (num_groups == 0) {
+                continue;
+            }
+            index->groups[type][id] = malloc(num_groups * sizeof(GroupPolicyInfo));
+            if (index->groups[type][id] == NULL) {
+                return 1;
+            }
+            
+            GroupPolicyInfo *terminal = &index->terminals[type][id];
+            terminal->min_len = MAX_GUESS_SIZE;
+            terminal->max_len = 0;
+            terminal->may = 0;
+            terminal->must = POLICY_LOWER | POLICY_UPPER | POLICY_DIGIT | POLICY_SYMBOL;
+            terminal->all_letters = 1;
+            
+            int i = 0;
+            for (PcfgReplacements *cur = pcfg->terminals[type][id]; cur != NULL; cur = cur->child) {
+                GroupPolicyInfo *info = &index->groups[type][id][i];
+                group_policy_info(pcfg, cur, info);
+                
+                if (info->min_len < terminal->min_len) {
+                    terminal->min_len = info->min_len;
+                }
+                if (info->max_len > terminal->max_len) {
+                    terminal->max_len = info->max_len;
+                }
+                terminal->may |= info->may;
+                terminal->must &= info->must;
+                terminal->all_letters &= info->all_letters;
+                i++;
+            }
+        }
+    }
+    return 0;
+}
+
+
+// Checks a list of group infos against the policy
+//
+// infos[i] is the info for the group used for the i'th replacement
+//
+// Returns POLICY_FAIL, POLICY_PASS, or POLICY_CHECK
+//
+int check_policy_infos(PasswordPolicy *policy, GroupPolicyInfo **infos, int size) {
+    
+    int min_len = 0;
+    int max_len = 0;
+    int may = 0;
+    int must = 0;
+    
+    for (int i = 0; i < size; i++) {
+        min_len += infos[i]->min_len;
+        max_len += infos[i]->max_len;
+        may |= infos[i]->may;
+        must |= infos[i]->must;
+    }
+    
+    if ((max_len < policy->min_len) || ((policy->max_len != 0) && (min_len > policy->max_len)) || ((policy->required & ~may) != 0)) {
+        return POLICY_FAIL;
+    }
+    
+    // See if any, or all, of the lengths that can be made are in the set
+    int all_lengths = 1;
+    if (policy->use_lengths == 1) {
+        int any_lengths = 0;
+        for (int length = min_len; length <= max_len; length++) {
+            if ((length < MAX_GUESS_SIZE) && (policy->lengths[length] == 1)) {
+                any_lengths = 1;
+            }
+            else {
+                all_lengths = 0;
+            }
+        }
+        if (any_lengths == 0) {
+            return POLICY_FAIL;
+        }
+    }
+    
+    if ((all_lengths == 1) && (min_len >= policy->min_len) && ((policy->max_len == 0) || (max_len <= policy->max_len)) && ((policy->required & ~must) == 0)) {
+        return POLICY_PASS;
+    }
+    return POLICY_CHECK;
+}
+
+
+// Capitalization masks only set the case of every letter if the alpha
+// value before them is all letters. If it isn't, what the mask is sure to
+// make can't be counted on
+//
+static void fix_mask_info(GroupPolicyInfo **infos, GroupPolicyInfo *fixed, unsigned char *types, int size) {
+    for (int i = 1; i < size; i++) {
+        if ((types[i] == PCFG_CAPITALIZATION) && (types[i - 1] == PCFG_ALPHA) && (infos[i - 1]->all_letters == 0)) {
+            fixed[i] = (*infos[i]);
+            fixed[i].must = 0;
+            infos[i] = &fixed[i];
+        }
+    }
+}
+
+
+// Removes the base structures that can never meet the policy
+//
+// Each base structure is checked against what every group in its terminals
+// could make, so the ones that are removed could never make a guess that
+// meets the policy. Base structures that use a terminal that isn't loaded
+// are left alone
+//
+void apply_base_policy(PolicyIndex *index) {
+    
+    GroupPolicyInfo *infos[MAX_GUESS_SIZE];
+    GroupPolicyInfo fixed[MAX_GUESS_SIZE];
+    unsigned char types[MAX_GUESS_SIZE];
+    
+    PcfgBase *cur = index->pcfg->base_structures;
+    while (cur != NULL) {
+        
+        PcfgBase *next = cur->next;
+        int result = POLICY_CHECK;
+        
+        if (cur->size <= MAX_GUESS_SIZE) {
+            int loaded = 1;
+            for (int i = 0; i < cur->size; i++) {
+                int type = cur->value[i].type;
+                int id = cur->value[i].id;
+                if ((type >= PCFG_NUM_TYPES) || (id < 0) || (id > MAX_TERM_LENGTH) || (index->groups[type][id] == NULL)) {
+                    loaded = 0;
+                    break;
+                }
+                infos[i] = &index->terminals[type][id];
+                types[i] = type;
+            }
+            if (loaded == 1) {
+                fix_mask_info(infos, fixed, types, cur->size);
+                result = check_policy_infos(&index->policy, infos, cur->size);
+            }
+        }
+        
+        if (result == POLICY_FAIL) {
+            if (cur->prev != NULL) {
+                cur->prev->next = cur->next;
+            }
+            else {
+                index->pcfg->base_structures = cur->next;
+            }
+            if (cur->next != NULL) {
+                cur->next->prev = cur->prev;
+            }
+            index->removed_bases++;
+        }
+        cur = next;
+    }
+}
+
+
+// Checks if the guesses from a pre-terminal meet the policy
+//
+// Returns POLICY_FAIL if none of them do, POLICY_PASS if all of them do, and
+// POLICY_CHECK if each guess has to be checked with check_guess_policy()
+//
+int check_pt_policy(PolicyIndex *index, PQItem *pq_item) {
+    
+    GroupPolicyInfo *infos[MAX_GUESS_SIZE];
+    GroupPolicyInfo fixed[MAX_GUESS_SIZE];
+    unsigned char types[MAX_GUESS_SIZE];
+    
+    if (pq_item->size > MAX_GUESS_SIZE) {
+        return POLICY_CHECK;
+    }
+    for (int i = 0; i < pq_item->size; i++) {
+        PcfgReplacements *group = pq_item->pt[i];
+        PcfgReplacements *first = index->pcfg->terminals[group->type][group->id];
+        infos[i] = &index->groups[group->type][group->id][group - first];
+        types[i] = group->type;
+    }
+    fix_mask_info(infos, fixed, types, pq_item->size);
+    return check_policy_infos(&index->policy, infos, pq_item->size);
+}
+
+
+// Returns 1 if a guess meets the policy, 0 if it doesn't
+//
+// guess_len doesn't include the newline
+//
+int check_guess_policy(PasswordPolicy *policy, char *guess, int guess_len) {
+    
+    int num_chars = 0;
+    int classes = 0;
+    value_policy_info(guess, guess_len, 1, &num_chars, &classes);
+    
+    if ((num_chars < policy->min_len) || ((policy->max_len != 0) && (num_chars > policy->max_len))) {
+        return 0;
+    }
+    if ((policy->use_lengths == 1) && ((num_chars >= MAX_GUESS_SIZE) || (policy->lengths[num_chars] == 0))) {
+        return 0;
+    }
+    return ((policy->required & ~classes) == 0);
+}
+
+
+// Frees everything the index allocated
+//
+void free_policy_index(PolicyIndex *index) {
+    for (int type = 0; type < PCFG_NUM_TYPES; type++) {
+        for (int id = 0; id <= MAX_TERM_LENGTH; id++) {
+            free(index->groups[type][id]);
+            index->groups[type][id] = NULL;
+        }
+    }
+}
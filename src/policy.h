@@ -0,0 +1,132 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Pretty Cool Fuzzy Guesser (PCFG)
+//  --Probabilistic Context Free Grammar (PCFG) Password Guessing Program
+//
+//  Written by Matt Weir
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//
+
+
+
+#ifndef _POLICY_H
+#define _POLICY_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "global_def.h"
+#include "grammar.h"
+#include "pcfg_pqueue.h"
+
+
+// Character classes a policy can require. Symbols are anything that isn't
+// an ASCII letter or digit
+#define POLICY_LOWER 1
+#define POLICY_UPPER 2
+#define POLICY_DIGIT 4
+#define POLICY_SYMBOL 8
+
+// The characters used for each class with --require, in the same order as
+// the bits above
+#define POLICY_CLASS_NAMES "luds"
+
+// What a policy check found
+#define POLICY_FAIL 0       // Nothing it makes can meet the policy
+#define POLICY_PASS 1       // Everything it makes meets the policy
+#define POLICY_CHECK 2      // Some guesses do, so each guess must be checked
+
+
+// A password policy the guesses have to meet
+typedef struct PasswordPolicy {
+    
+    // Length bounds in characters. A max_len of 0 means no limit
+    int min_len;
+    int max_len;
+    
+    // The character classes every guess must have. POLICY_* bits
+    int required;
+    
+    // If use_lengths is 1, guesses must also be one of the lengths in
+    // characters where lengths[length] is 1
+    int use_lengths;
+    unsigned char lengths[MAX_GUESS_SIZE];
+    
+}PasswordPolicy;
+
+
+// What the values in a group can look like
+typedef struct GroupPolicyInfo {
+    
+    // Shortest and longest value in characters
+    int min_len;
+    int max_len;
+    
+    // Character classes at least one value has, and that every value has
+    unsigned char may;
+    unsigned char must;
+    
+    // For alpha groups, 1 if every value is all ASCII letters so the
+    // capitalization mask decides if it has upper or lower case letters
+    unsigned char all_letters;
+    
+}GroupPolicyInfo;
+
+
+// A policy along with what every group in the grammar can make
+typedef struct PolicyIndex {
+    
+    PasswordPolicy policy;
+    PcfgGrammar *pcfg;
+    
+    // Info for each group, indexed the same way as PcfgGrammar.terminals
+    // and then by the group's position in the terminal
+    GroupPolicyInfo *groups[PCFG_NUM_TYPES][MAX_TERM_LENGTH + 1];
+    
+    // Info covering every group in each terminal
+    GroupPolicyInfo terminals[PCFG_NUM_TYPES][MAX_TERM_LENGTH + 1];
+    
+    // Stats
+    long removed_bases;
+    unsigned long long skipped_pts;
+    
+}PolicyIndex;
+
+
+// Parses a list of character classes, aka "lud"
+extern int parse_policy_classes(char *arg, int *classes);
+
+// Parses a set of lengths, aka "8,10-12"
+extern int parse_length_set(char *arg, unsigned char *lengths);
+
+// Finds what every group in the grammar can make
+extern int create_policy_index(PcfgGrammar *pcfg, PasswordPolicy *policy, PolicyIndex *index);
+
+// Removes the base structures that can never meet the policy
+extern void apply_base_policy(PolicyIndex *index);
+
+// Checks if the guesses from a pre-terminal meet the policy
+extern int check_pt_policy(PolicyIndex *index, PQItem *pq_item);
+
+// Returns 1 if a guess meets the policy, 0 if it doesn't
+extern int check_guess_policy(PasswordPolicy *policy, char *guess, int guess_len);
+
+// Frees everything the index allocated
+extern void free_policy_index(PolicyIndex *index);
+
+#endif
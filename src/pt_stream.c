@@ -0,0 +1,261 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Pretty Cool Fuzzy Guesser (PCFG)
+//  --Probabilistic Context Free Grammar (PCFG) Password Guessing Program
+//
+//  Written by Matt Weir
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//
+
+
+
+#include "pt_stream.h"
+
+
+// Hashes the number and sizes of the groups in every terminal
+//
+// Group indexes in a stream are only valid if the grammar has exactly the
+// same groups, so this is saved in the header and checked on load
+//
+static uint64_t layout_hash(PcfgGrammar *pcfg, int num_groups[PCFG_NUM_TYPES][MAX_TERM_LENGTH + 1]) {
+    
+    // FNV-1a over 32 bit words
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (int type = 0; type < PCFG_NUM_TYPES; type++) {
+        for (int id = 0; id <= MAX_TERM_LENGTH; id++) {
+            int count = 0;
+            for (PcfgReplacements *cur = pcfg->terminals[type][id]; cur != NULL; cur = cur->child) {
+                hash = (hash ^ (uint32_t) cur->size) * 0x100000001b3ULL;
+                count++;
+            }
+            hash = (hash ^ (uint32_t) count) * 0x100000001b3ULL;
+            num_groups[type][id] = count;
+        }
+    }
+    return hash;
+}
+
+
+// Starts writing a pre-terminal stream to fp
+//
+// In text mode no header is written, and each record is one line that
+// lists the items as their type, id, and group, (aka D4:12)
+//
+// Returns NULL if the header couldn't be written
+//
+PtStream *create_pt_stream(FILE *fp, PcfgGrammar *pcfg, char *rule_name, int text) {
+    
+    PtStream *stream = calloc(1, sizeof(PtStream));
+    if (stream == NULL) {
+        fprintf(stderr, "Error allocating memory for the pre-terminal stream\n");
+        return NULL;
+    }
+    stream->fp = fp;
+    stream->pcfg = pcfg;
+    stream->text = text;
+    uint64_t hash = layout_hash(pcfg, stream->num_groups);
+    
+    if (text == 1) {
+        return stream;
+    }
+    
+    size_t name_len = strlen(rule_name);
+    uint16_t header_len = (name_len > UINT16_MAX) ? UINT16_MAX : name_len;
+    if ((fwrite(PT_STREAM_MAGIC, 1, 8, fp) != 8) ||
+        (fwrite(&hash, sizeof(uint64_t), 1, fp) != 1) ||
+        (fwrite(&header_len, sizeof(uint16_t), 1, fp) != 1) ||
+        (fwrite(rule_name, 1, header_len, fp) != header_len)) {
+        fprintf(stderr, "Error writing the pre-terminal stream\n");
+        free(stream);
+        return NULL;
+    }
+    return stream;
+}
+
+
+// Writes one pre-terminal to the stream
+//
+// If first and last aren't 0 and count, only those guesses of the
+// pre-terminal are in the record
+//
+// Function returns 0 if it worked ok, 1 if the record couldn't be written
+//
+int write_pt_record(PtStream *stream, PQItem *pq_item, unsigned long long count, unsigned long long first, unsigned long long last) {
+    
+    PcfgGrammar *pcfg = stream->pcfg;
+    int partial = ((first != 0) || (last != count));
+    stream->records++;
+    
+    if (stream->text == 1) {
+        fprintf(stream->fp, "%e\t%llu\t", pq_item->prob, count);
+        for (int i = 0; i < pq_item->size; i++) {
+            PcfgReplacements *group = pq_item->pt[i];
+            long index = group - pcfg->terminals[group->type][group->id];
+            fprintf(stream->fp, "%s%c%d:%ld", (i == 0) ? "" : " ", PCFG_TYPE_DESIGNATORS[group->type], group->id, index);
+        }
+        if (partial == 1) {
+            fprintf(stream->fp, "\t%llu-%llu", first, last);
+        }
+        fputc('\n', stream->fp);
+        return 0;
+    }
+    
+    if (pq_item->size > PT_STREAM_MAX_ITEMS) {
+        fprintf(stderr, "Error, a pre-terminal has too many items to stream\n");
+        return 1;
+    }
+    
+    unsigned char record[2 + (4 * sizeof(uint64_t)) + (PT_STREAM_MAX_ITEMS * 6)];
+    int len = 0;
+    record[len++] = pq_item->size;
+    record[len++] = (partial == 1) ? PT_RECORD_PARTIAL : 0;
+    
+    uint64_t fields[3] = {0, count, 0};
+    memcpy(&fields[0], &pq_item->prob, sizeof(double));
+    memcpy(record + len, fields, 2 * sizeof(uint64_t));
+    len += 2 * sizeof(uint64_t);
+    if (partial == 1) {
+        fields[1] = first;
+        fields[2] = last;
+        memcpy(record + len, &fields[1], 2 * sizeof(uint64_t));
+        len += 2 * sizeof(uint64_t);
+    }
+    
+    for (int i = 0; i < pq_item->size; i++) {
+        PcfgReplacements *group = pq_item->pt[i];
+        uint32_t index = group - pcfg->terminals[group->type][group->id];
+        record[len++] = group->type;
+        record[len++] = group->id;
+        memcpy(record + len, &index, sizeof(uint32_t));
+        len += sizeof(uint32_t);
+    }
+    
+    if (fwrite(record, 1, len, stream->fp) != (size_t) len) {
+        fprintf(stderr, "Error writing the pre-terminal stream\n");
+        return 1;
+    }
+    return 0;
+}
+
+
+// Opens a pre-terminal stream to read
+//
+// The stream has to have been made with the same ruleset, loaded with the
+// same pruning options, since the groups are saved by their position
+//
+// Returns NULL if the header is bad or doesn't match the grammar
+//
+PtStream *open_pt_stream(FILE *fp, PcfgGrammar *pcfg, char *rule_name) {
+    
+    PtStream *stream = calloc(1, sizeof(PtStream));
+    if (stream == NULL) {
+        fprintf(stderr, "Error allocating memory for the pre-terminal stream\n");
+        return NULL;
+    }
+    stream->fp = fp;
+    stream->pcfg = pcfg;
+    uint64_t expected_hash = layout_hash(pcfg, stream->num_groups);
+    
+    char magic[8];
+    uint64_t hash;
+    uint16_t name_len;
+    char name[UINT16_MAX + 1];
+    if ((fread(magic, 1, 8, fp) != 8) || (memcmp(magic, PT_STREAM_MAGIC, 8) != 0) ||
+        (fread(&hash, sizeof(uint64_t), 1, fp) != 1) ||
+        (fread(&name_len, sizeof(uint16_t), 1, fp) != 1) ||
+        (fread(name, 1, name_len, fp) != name_len)) {
+        fprintf(stderr, "Error, the input isn't a pre-terminal stream\n");
+        free(stream);
+        return NULL;
+    }
+    name[name_len] = '\0';
+    
+    if ((strcmp(name, rule_name) != 0) || (hash != expected_hash)) {
+        fprintf(stderr, "Error, the pre-terminal stream was made with the ruleset %s, or with different pruning options\n", name);
+        free(stream);
+        return NULL;
+    }
+    return stream;
+}
+
+
+// Reads the next record from a stream
+//
+// pq_item->pt points into the stream, so it is only valid until the next
+// record is read. The base structure's probability isn't saved, so
+// base_prob is set to 0
+//
+// Returns PT_STREAM_OK if a record was read, PT_STREAM_END at the end of
+// the stream, or PT_STREAM_ERROR if the record is malformed
+//
+int read_pt_record(PtStream *stream, PQItem *pq_item, unsigned long long *count, unsigned long long *first, unsigned long long *last) {
+    
+    unsigned char header[2];
+    size_t header_len = fread(header, 1, 2, stream->fp);
+    if (header_len == 0) {
+        return PT_STREAM_END;
+    }
+    
+    uint64_t fields[4];
+    int num_fields = ((header_len == 2) && (header[1] & PT_RECORD_PARTIAL)) ? 4 : 2;
+    if ((header_len != 2) || (header[0] == 0) || (fread(fields, sizeof(uint64_t), num_fields, stream->fp) != (size_t) num_fields)) {
+        fprintf(stderr, "Error, the pre-terminal stream is truncated\n");
+        return PT_STREAM_ERROR;
+    }
+    memcpy(&pq_item->prob, &fields[0], sizeof(double));
+    (*count) = fields[1];
+    (*first) = (num_fields == 4) ? fields[2] : 0;
+    (*last) = (num_fields == 4) ? fields[3] : fields[1];
+    
+    unsigned char items[PT_STREAM_MAX_ITEMS * 6];
+    int size = header[0];
+    if (fread(items, 6, size, stream->fp) != (size_t) size) {
+        fprintf(stderr, "Error, the pre-terminal stream is truncated\n");
+        return PT_STREAM_ERROR;
+    }
+    
+    PcfgGrammar *pcfg = stream->pcfg;
+    for (int i = 0; i < size; i++) {
+        int type = items[i * 6];
+        int id = items[(i * 6) + 1];
+        uint32_t index;
+        memcpy(&index, items + (i * 6) + 2, sizeof(uint32_t));
+        if ((type >= PCFG_NUM_TYPES) || (id > MAX_TERM_LENGTH) || (index >= (uint32_t) stream->num_groups[type][id])) {
+            fprintf(stderr, "Error, the pre-terminal stream has a group that isn't in the grammar\n");
+            return PT_STREAM_ERROR;
+        }
+        stream->pt[i] = pcfg->terminals[type][id] + index;
+    }
+    
+    if (((*first) > (*last)) || ((*last) > (*count))) {
+        fprintf(stderr, "Error, the pre-terminal stream has a bad guess range\n");
+        return PT_STREAM_ERROR;
+    }
+    
+    pq_item->base_prob = 0.0;
+    pq_item->size = size;
+    pq_item->pt = stream->pt;
+    stream->records++;
+    return PT_STREAM_OK;
+}
+
+
+// Frees a stream. The file is left open since the caller opened it
+//
+void free_pt_stream(PtStream *stream) {
+    free(stream);
+}
@@ -0,0 +1,107 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Pretty Cool Fuzzy Guesser (PCFG)
+//  --Probabilistic Context Free Grammar (PCFG) Password Guessing Program
+//
+//  Written by Matt Weir
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//
+
+
+
+#ifndef _PT_STREAM_H
+#define _PT_STREAM_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "grammar.h"
+#include "pcfg_pqueue.h"
+
+
+// First 8 bytes of a pre-terminal stream
+//
+// Followed by a 64 bit hash of the grammar's layout, a 16 bit length and
+// the name of the ruleset, and then the records. All numbers are little
+// endian
+#define PT_STREAM_MAGIC "PCFGPT01"
+
+// Set in a record's flags if only part of the pre-terminal is in the
+// stream. The record then has the first and last guess to generate
+#define PT_RECORD_PARTIAL 1
+
+// The most items a pre-terminal in a stream can have
+#define PT_STREAM_MAX_ITEMS 255
+
+// Return values of read_pt_record()
+#define PT_STREAM_OK 0
+#define PT_STREAM_END 1
+#define PT_STREAM_ERROR 2
+
+
+// A stream of pre-terminals in the order they were popped off the queue
+//
+// Each record is:
+//
+//     size        8 bits, number of items in the pre-terminal
+//     flags       8 bits, PT_RECORD_* bits
+//     prob        64 bit double
+//     count       64 bits, number of guesses the pre-terminal makes
+//     first/last  64 bits each, only if PT_RECORD_PARTIAL is set
+//     items       type (8 bits), id (8 bits), group (32 bits) for each item
+//
+// group is the position of the replacement group in its terminal, so the
+// stream is only valid for a grammar loaded the same way, (same ruleset and
+// pruning options). The layout hash in the header is used to check that
+//
+typedef struct PtStream {
+    
+    FILE *fp;
+    PcfgGrammar *pcfg;
+    
+    // If 1, records are written as one line of text each, for -d
+    int text;
+    
+    // Number of groups in each terminal, used to check group indexes
+    int num_groups[PCFG_NUM_TYPES][MAX_TERM_LENGTH + 1];
+    
+    // The parse tree of the last record read
+    PcfgReplacements *pt[PT_STREAM_MAX_ITEMS];
+    
+    unsigned long long records;
+    
+}PtStream;
+
+
+// Starts writing a pre-terminal stream
+extern PtStream *create_pt_stream(FILE *fp, PcfgGrammar *pcfg, char *rule_name, int text);
+
+// Writes one pre-terminal, (or part of one), to the stream
+extern int write_pt_record(PtStream *stream, PQItem *pq_item, unsigned long long count, unsigned long long first, unsigned long long last);
+
+// Opens a pre-terminal stream to read and checks it matches the grammar
+extern PtStream *open_pt_stream(FILE *fp, PcfgGrammar *pcfg, char *rule_name);
+
+// Reads the next record from a stream
+extern int read_pt_record(PtStream *stream, PQItem *pq_item, unsigned long long *count, unsigned long long *first, unsigned long long *last);
+
+// Frees a stream. Doesn't close the file
+extern void free_pt_stream(PtStream *stream);
+
+#endif
@@ -0,0 +1,273 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Pretty Cool Fuzzy Guesser (PCFG)
+//  --Probabilistic Context Free Grammar (PCFG) Password Guessing Program
+//
+//  Written by Matt Weir
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//
+
+
+
+#include "render_cache.h"
+
+
+// Finds the hash bucket for an alpha/capitalization pair
+//
+unsigned int render_cache_bucket(PcfgReplacements *alpha, PcfgReplacements *mask) {
+    uint64_t key = ((uint64_t) (uintptr_t) alpha * 31) ^ (uint64_t) (uintptr_t) mask;
+    key ^= key >> 29;
+    key *= 0xbf58476d1ce4e5b9ULL;
+    key ^= key >> 32;
+    return key % RENDER_CACHE_BUCKETS;
+}
+
+
+// Removes a block from the least recently used list
+//
+void render_cache_unlink(RenderCache *cache, RenderedBlock *block) {
+    if (block->prev != NULL) {
+        block->prev->next = block->next;
+    }
+    else {
+        cache->head = block->next;
+    }
+    if (block->next != NULL) {
+        block->next->prev = block->prev;
+    }
+    else {
+        cache->tail = block->prev;
+    }
+    block->prev = NULL;
+    block->next = NULL;
+}
+
+
+// Adds a block to the front of the least recently used list
+//
+void render_cache_push_front(RenderCache *cache, RenderedBlock *block) {
+    block->prev = NULL;
+    block->next = cache->head;
+    if (cache->head != NULL) {
+        cache->head->prev = block;
+    }
+    cache->head = block;
+    if (cache->tail == NULL) {
+        cache->tail = block;
+    }
+}
+
+
+// Frees a block. It needs to have already been removed from the cache
+//
+void render_block_free(RenderedBlock *block) {
+    free(block->rendered.values);
+    free(block->rendered.offsets);
+    free(block);
+}
+
+
+// Removes a block from the cache and frees it
+//
+void render_cache_evict(RenderCache *cache, RenderedBlock *block) {
+    
+    RenderedBlock **chain = &cache->buckets[render_cache_bucket(block->alpha, block->mask)];
+    while ((*chain) != block) {
+        chain = &(*chain)->hash_next;
+    }
+    (*chain) = block->hash_next;
+    
+    render_cache_unlink(cache, block);
+    cache->used_bytes -= block->bytes;
+    render_block_free(block);
+}
+
+
+// Renders every word in an alpha group with every mask in a capitalization
+// group applied to it
+//
+// Returns NULL if the product is too big to cache, or a mask is longer than
+// a word, (which recursive_guess() treats as an error so it is left to it)
+//
+RenderedBlock *render_block(RenderCache *cache, PcfgReplacements *alpha, PcfgReplacements *mask, RenderFunc render) {
+    
+    int min_alpha_len = pcfg_value_len(alpha, 0);
+    for (int i = 1; i < alpha->size; i++) {
+        if (pcfg_value_len(alpha, i) < min_alpha_len) {
+            min_alpha_len = pcfg_value_len(alpha, i);
+        }
+    }
+    for (int i = 0; i < mask->size; i++) {
+        if (pcfg_value_len(mask, i) > min_alpha_len) {
+            return NULL;
+        }
+    }
+    
+    size_t alpha_bytes = (alpha->offsets == NULL) ? (size_t) alpha->size * alpha->stride : alpha->offsets[alpha->size];
+    size_t num_values = (size_t) alpha->size * mask->size;
+    size_t bytes = sizeof(RenderedBlock) + (alpha_bytes * mask->size);
+    if (alpha->offsets != NULL) {
+        bytes += (num_values + 1) * sizeof(unsigned int);
+    }
+    if ((bytes > cache->max_bytes / RENDER_CACHE_MAX_FRACTION) || (num_values > INT32_MAX)) {
+        return NULL;
+    }
+    
+    RenderedBlock *block = calloc(1, sizeof(RenderedBlock));
+    if (block == NULL) {
+        return NULL;
+    }
+    block->alpha = alpha;
+    block->mask = mask;
+    block->rendered.size = num_values;
+    block->bytes = bytes;
+    block->rendered.stride = (alpha->offsets == NULL) ? alpha->stride : 0;
+    
+    // Adding 1 so an empty block doesn't cause a zero sized malloc
+    block->rendered.values = malloc((alpha_bytes * mask->size) + 1);
+    if (alpha->offsets != NULL) {
+        block->rendered.offsets = malloc((num_values + 1) * sizeof(unsigned int));
+    }
+    if ((block->rendered.values == NULL) || ((alpha->offsets != NULL) && (block->rendered.offsets == NULL))) {
+        render_block_free(block);
+        return NULL;
+    }
+    
+    size_t cur_pos = 0;
+    size_t cur_value = 0;
+    for (int i = 0; i < alpha->size; i++) {
+        
+        char *word = pcfg_value(alpha, i);
+        int word_len = pcfg_value_len(alpha, i);
+        
+        for (int y = 0; y < mask->size; y++) {
+            if (block->rendered.offsets != NULL) {
+                block->rendered.offsets[cur_value] = cur_pos;
+            }
+            memcpy(block->rendered.values + cur_pos, word, word_len);
+            render(block->rendered.values + cur_pos, word_len, pcfg_value(mask, y), pcfg_value_len(mask, y));
+            cur_pos += word_len;
+            cur_value++;
+        }
+    }
+    if (block->rendered.offsets != NULL) {
+        block->rendered.offsets[num_values] = cur_pos;
+    }
+    
+    return block;
+}
+
+
+// Creates a cache that uses up to max_bytes of memory
+//
+// Returns NULL if max_bytes is 0, (the cache is disabled), or memory
+// couldn't be allocated
+//
+RenderCache *render_cache_create(size_t max_bytes) {
+    
+    if (max_bytes == 0) {
+        return NULL;
+    }
+    RenderCache *cache = calloc(1, sizeof(RenderCache));
+    if (cache == NULL) {
+        return NULL;
+    }
+    cache->max_bytes = max_bytes;
+    return cache;
+}
+
+
+// Returns the rendered product of an alpha group and capitalization group
+//
+// If it isn't in the cache it is rendered and added to it, evicting the
+// least recently used blocks to make room. The block can't be evicted until
+// render_cache_release() is called on it, since guesses could be generated
+// from other blocks while it is still being used
+//
+// Returns NULL if the product couldn't be cached, in which case the caller
+// should render it itself
+//
+RenderedBlock *render_cache_get(RenderCache *cache, PcfgReplacements *alpha, PcfgReplacements *mask, RenderFunc render) {
+    
+    if (cache == NULL) {
+        return NULL;
+    }
+    
+    unsigned int bucket = render_cache_bucket(alpha, mask);
+    for (RenderedBlock *block = cache->buckets[bucket]; block != NULL; block = block->hash_next) {
+        if ((block->alpha == alpha) && (block->mask == mask)) {
+            render_cache_unlink(cache, block);
+            render_cache_push_front(cache, block);
+            block->in_use++;
+            return block;
+        }
+    }
+    
+    RenderedBlock *block = render_block(cache, alpha, mask, render);
+    if (block == NULL) {
+        return NULL;
+    }
+    
+    // Make room for it
+    while (cache->used_bytes + block->bytes > cache->max_bytes) {
+        RenderedBlock *victim = cache->tail;
+        while ((victim != NULL) && (victim->in_use != 0)) {
+            victim = victim->prev;
+        }
+        
+        // Everything left is being used
+        if (victim == NULL) {
+            render_block_free(block);
+            return NULL;
+        }
+        render_cache_evict(cache, victim);
+    }
+    
+    block->hash_next = cache->buckets[bucket];
+    cache->buckets[bucket] = block;
+    render_cache_push_front(cache, block);
+    cache->used_bytes += block->bytes;
+    block->in_use = 1;
+    
+    return block;
+}
+
+
+// Lets the cache know a block from render_cache_get() is no longer being used
+//
+void render_cache_release(RenderCache *cache, RenderedBlock *block) {
+    if ((cache != NULL) && (block != NULL)) {
+        block->in_use--;
+    }
+}
+
+
+// Frees the cache and everything in it
+//
+void render_cache_free(RenderCache *cache) {
+    
+    if (cache == NULL) {
+        return;
+    }
+    RenderedBlock *block = cache->head;
+    while (block != NULL) {
+        RenderedBlock *next = block->next;
+        render_block_free(block);
+        block = next;
+    }
+    free(cache);
+}
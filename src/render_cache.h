@@ -0,0 +1,107 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Pretty Cool Fuzzy Guesser (PCFG)
+//  --Probabilistic Context Free Grammar (PCFG) Password Guessing Program
+//
+//  Written by Matt Weir
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//
+
+
+
+#ifndef _RENDER_CACHE_H
+#define _RENDER_CACHE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "grammar.h"
+
+
+// The number of hash buckets in the cache
+#define RENDER_CACHE_BUCKETS 4096
+
+// Blocks bigger than this fraction of the cache, (aka 1/4), are not cached
+// so one big product can't push everything else out
+#define RENDER_CACHE_MAX_FRACTION 4
+
+
+// How a value is added to a guess. See render_funcs in pcfg_guesser.c
+//
+// Returns the new length of the guess, or -1 if the value couldn't be added
+typedef int (*RenderFunc)(char *cur_guess, int start_point, char *value, int value_len);
+
+
+// Every alpha word in a group with every capitalization mask in a group
+// applied to it, packed back to back
+//
+// The values are in the same order recursive_guess() would make them, so
+// all the masks for the first word, then all the masks for the second...
+//
+typedef struct RenderedBlock {
+    
+    // The groups this was rendered from
+    PcfgReplacements *alpha;
+    PcfgReplacements *mask;
+    
+    // The rendered values. Only size, values, offsets and stride are used,
+    // so it can be read with pcfg_value() like any other group
+    PcfgReplacements rendered;
+    
+    // How much memory this block takes up
+    size_t bytes;
+    
+    // Blocks that are being used to make guesses can't be evicted
+    int in_use;
+    
+    // Least recently used list, (most recent first), and the hash chain
+    struct RenderedBlock *prev;
+    struct RenderedBlock *next;
+    struct RenderedBlock *hash_next;
+    
+}RenderedBlock;
+
+
+// Least recently used cache of rendered alpha/capitalization products
+typedef struct RenderCache {
+    
+    size_t max_bytes;
+    size_t used_bytes;
+    
+    RenderedBlock *buckets[RENDER_CACHE_BUCKETS];
+    RenderedBlock *head;
+    RenderedBlock *tail;
+    
+}RenderCache;
+
+
+// Creates a cache that uses up to max_bytes of memory
+extern RenderCache *render_cache_create(size_t max_bytes);
+
+// Returns the rendered product of an alpha group and capitalization group,
+// rendering it if it isn't in the cache
+extern RenderedBlock *render_cache_get(RenderCache *cache, PcfgReplacements *alpha, PcfgReplacements *mask, RenderFunc render);
+
+// Lets the cache know a block from render_cache_get() is no longer being used
+extern void render_cache_release(RenderCache *cache, RenderedBlock *block);
+
+// Frees the cache and everything in it
+extern void render_cache_free(RenderCache *cache);
+
+#endif
@@ -0,0 +1,168 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Pretty Cool Fuzzy Guesser (PCFG)
+//  --Probabilistic Context Free Grammar (PCFG) Password Guessing Program
+//
+//  Written by Matt Weir
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//
+
+
+
+// Sample consumer for pcfg_guesser --ring, and a benchmark of it
+//
+// pcfg_ring_consumer FILE      Writes the guesses in the ring at FILE to stdout
+// pcfg_ring_consumer -c FILE   Only counts them, to time the ring itself
+// pcfg_ring_consumer -c -      Counts guesses piped in on stdin, to compare
+//
+// For example, to compare the ring with a pipe:
+//
+//     ./pcfg_guesser --ring /dev/shm/guesses & ./pcfg_ring_consumer -c /dev/shm/guesses
+//     ./pcfg_guesser | ./pcfg_ring_consumer -c -
+//
+// Build it with make pcfg_ring_consumer. Only pcfg_ring.h is needed to read
+// a ring
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "pcfg_ring.h"
+
+
+// Counts the newlines in a buffer
+//
+static unsigned long long count_lines(const char *buf, size_t len) {
+    unsigned long long count = 0;
+    const char *end = buf + len;
+    for (const char *pos = buf; (pos = memchr(pos, '\n', end - pos)) != NULL; pos++) {
+        count++;
+    }
+    return count;
+}
+
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+// Reads the guesses from stdin, for comparing the ring with a pipe
+//
+// Function returns 0 if it worked ok
+//
+static int read_pipe(unsigned long long *guesses, unsigned long long *batches, unsigned long long *bytes) {
+    
+    char *buf = malloc(PCFG_RING_BATCH_SIZE);
+    if (buf == NULL) {
+        return 1;
+    }
+    ssize_t len;
+    while ((len = read(STDIN_FILENO, buf, PCFG_RING_BATCH_SIZE)) > 0) {
+        *guesses += count_lines(buf, len);
+        *batches += 1;
+        *bytes += len;
+    }
+    free(buf);
+    return (len == 0) ? 0 : 1;
+}
+
+
+// Reads the guesses from a ring, writing them to stdout unless count_only
+// is set
+//
+// Function returns 0 if it worked ok
+//
+static int read_ring(char *path, int count_only, unsigned long long *guesses, unsigned long long *batches, unsigned long long *bytes) {
+    
+    // Wait for the guesser to create the ring
+    PcfgRing ring;
+    int ret;
+    while ((ret = pcfg_ring_attach(path, &ring)) == 1) {
+        usleep(10000);
+    }
+    if (ret != 0) {
+        fprintf(stderr, "Error, %s isn't a ring or already has a consumer\n", path);
+        return 1;
+    }
+    
+    const char *batch;
+    uint32_t len;
+    uint32_t num_guesses;
+    while ((ret = pcfg_ring_next(&ring, &batch, &len, &num_guesses)) == 1) {
+        if ((count_only == 0) && (fwrite(batch, 1, len, stdout) != len)) {
+            ret = -1;
+            break;
+        }
+        pcfg_ring_release(&ring);
+        *guesses += num_guesses;
+        *batches += 1;
+        *bytes += len;
+    }
+    pcfg_ring_detach(&ring);
+    
+    if (ret != 0) {
+        fprintf(stderr, "Error, lost the guesser writing to %s\n", path);
+        return 1;
+    }
+    return 0;
+}
+
+
+int main(int argc, char *argv[]) {
+    
+    int count_only = 0;
+    int arg = 1;
+    if ((arg < argc) && (strcmp(argv[arg], "-c") == 0)) {
+        count_only = 1;
+        arg++;
+    }
+    if (arg != argc - 1) {
+        fprintf(stderr, "Usage: %s [-c] FILE\n", argv[0]);
+        fprintf(stderr, "Writes the guesses from pcfg_guesser --ring FILE to stdout\n");
+        fprintf(stderr, "  -c  Only count the guesses. With a FILE of - they are read from stdin\n");
+        return 1;
+    }
+    
+    unsigned long long guesses = 0;
+    unsigned long long batches = 0;
+    unsigned long long bytes = 0;
+    double start = now();
+    int ret;
+    if (strcmp(argv[arg], "-") == 0) {
+        ret = read_pipe(&guesses, &batches, &bytes);
+    }
+    else {
+        ret = read_ring(argv[arg], count_only, &guesses, &batches, &bytes);
+    }
+    if (fflush(stdout) != 0) {
+        ret = 1;
+    }
+    double seconds = now() - start;
+    
+    if (ret == 0) {
+        fprintf(stderr, "Read %llu guesses, (%llu bytes in %llu batches), in %.3f seconds: %.0f guesses/s, %.1f MB/s\n",
+            guesses, bytes, batches, seconds, guesses / seconds, bytes / seconds / (1024 * 1024));
+    }
+    return ret;
+}
@@ -0,0 +1,644 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Pretty Cool Fuzzy Guesser (PCFG)
+//  --Probabilistic Context Free Grammar (PCFG) Password Guessing Program
+//
+//  Written by Matt Weir
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//
+
+
+
+#include "rules.h"
+
+
+// How each rule function is written. args lists what follows the function
+// character: N is a position, X is any character
+typedef struct RuleSyntax {
+    char name;
+    unsigned char code;
+    const char *args;
+}RuleSyntax;
+
+static const RuleSyntax rule_syntax[] = {
+    {':', RULE_NOOP, ""},
+    {'l', RULE_LOWER, ""},
+    {'u', RULE_UPPER, ""},
+    {'c', RULE_CAPITALIZE, ""},
+    {'C', RULE_INVERT_CAPITALIZE, ""},
+    {'t', RULE_TOGGLE_ALL, ""},
+    {'T', RULE_TOGGLE_AT, "N"},
+    {'r', RULE_REVERSE, ""},
+    {'d', RULE_DUPLICATE, ""},
+    {'p', RULE_DUPLICATE_N, "N"},
+    {'f', RULE_REFLECT, ""},
+    {'{', RULE_ROTATE_LEFT, ""},
+    {'}', RULE_ROTATE_RIGHT, ""},
+    {'$', RULE_APPEND, "X"},
+    {'^', RULE_PREPEND, "X"},
+    {'[', RULE_DELETE_FIRST, ""},
+    {']', RULE_DELETE_LAST, ""},
+    {'D', RULE_DELETE_AT, "N"},
+    {'x', RULE_EXTRACT, "NN"},
+    {'O', RULE_OMIT, "NN"},
+    {'i', RULE_INSERT, "NX"},
+    {'o', RULE_OVERWRITE, "NX"},
+    {'\'', RULE_TRUNCATE, "N"},
+    {'s', RULE_REPLACE, "XX"},
+    {'@', RULE_PURGE, "X"},
+    {'z', RULE_DUP_FIRST, "N"},
+    {'Z', RULE_DUP_LAST, "N"},
+    {'q', RULE_DUP_ALL, ""},
+    {'y', RULE_DUP_BLOCK_FIRST, "N"},
+    {'Y', RULE_DUP_BLOCK_LAST, "N"},
+    {'k', RULE_SWAP_FRONT, ""},
+    {'K', RULE_SWAP_BACK, ""},
+    {'*', RULE_SWAP_AT, "NN"},
+    {'L', RULE_SHIFT_LEFT, "N"},
+    {'R', RULE_SHIFT_RIGHT, "N"},
+    {'+', RULE_INCREMENT, "N"},
+    {'-', RULE_DECREMENT, "N"},
+    {'.', RULE_REPLACE_NEXT, "N"},
+    {',', RULE_REPLACE_PREV, "N"},
+    {'E', RULE_TITLE, ""},
+    {'e', RULE_TITLE_SEP, "X"},
+    {'<', RULE_REJECT_LESS, "N"},
+    {'>', RULE_REJECT_GREATER, "N"},
+    {'_', RULE_REJECT_EQUAL, "N"},
+    {'!', RULE_REJECT_CONTAIN, "X"},
+    {'/', RULE_REJECT_NOT_CONTAIN, "X"},
+    {'(', RULE_REJECT_FIRST, "X"},
+    {')', RULE_REJECT_LAST, "X"},
+    {'=', RULE_REJECT_AT, "NX"},
+    {'%', RULE_REJECT_COUNT, "NX"},
+};
+
+
+// Converts a rule position, (0-9 then A-Z), to a number. Returns -1 if it
+// isn't a position
+//
+static int rule_position(char c) {
+    if ((c >= '0') && (c <= '9')) {
+        return c - '0';
+    }
+    if ((c >= 'A') && (c <= 'Z')) {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+
+// Rules only change the case of ASCII letters, the same as hashcat
+static inline char ascii_lower(char c) {
+    return ((c >= 'A') && (c <= 'Z')) ? c + ('a' - 'A') : c;
+}
+
+static inline char ascii_upper(char c) {
+    return ((c >= 'a') && (c <= 'z')) ? c - ('a' - 'A') : c;
+}
+
+static inline char ascii_toggle(char c) {
+    return ((c >= 'a') && (c <= 'z')) ? ascii_upper(c) : ascii_lower(c);
+}
+
+
+// Compiles one rule into ops. ops needs room for line_len ops
+//
+// Spaces between functions are ignored, the same as hashcat
+//
+// Returns the number of ops, or -1 if the rule is invalid
+//
+int compile_rule(const char *line, int line_len, RuleOp *ops) {
+    
+    int num_ops = 0;
+    int pos = 0;
+    while (pos < line_len) {
+        
+        char name = line[pos++];
+        if (name == ' ') {
+            continue;
+        }
+        
+        const RuleSyntax *syntax = NULL;
+        for (size_t i = 0; i < sizeof(rule_syntax) / sizeof(RuleSyntax); i++) {
+            if (rule_syntax[i].name == name) {
+                syntax = &rule_syntax[i];
+                break;
+            }
+        }
+        if (syntax == NULL) {
+            return -1;
+        }
+        
+        RuleOp *op = &ops[num_ops++];
+        op->code = syntax->code;
+        op->arg1 = 0;
+        op->arg2 = 0;
+        for (int i = 0; syntax->args[i] != '\0'; i++) {
+            if (pos >= line_len) {
+                return -1;
+            }
+            int value = (unsigned char) line[pos++];
+            if (syntax->args[i] == 'N') {
+                value = rule_position(value);
+                if (value == -1) {
+                    return -1;
+                }
+            }
+            if (i == 0) {
+                op->arg1 = value;
+            }
+            else {
+                op->arg2 = value;
+            }
+        }
+    }
+    return num_ops;
+}
+
+
+// Loads a rule file and compiles every rule in it
+//
+// Empty lines and lines starting with # are skipped. Invalid rules are
+// skipped with a warning
+//
+// Returns NULL if the file can't be read, it has no valid rules, or memory
+// couldn't be allocated
+//
+RuleSet *load_rule_set(char *filename, int order) {
+    
+    FILE *fp = fopen(filename, "r");
+    if (fp == NULL) {
+        fprintf(stderr, "Error opening the rule file %s\n", filename);
+        return NULL;
+    }
+    
+    // Size everything for the worst case of one op per character
+    size_t num_lines = 0;
+    size_t num_chars = 0;
+    char *line = NULL;
+    size_t line_size = 0;
+    ssize_t line_len;
+    while ((line_len = getline(&line, &line_size, fp)) != -1) {
+        num_lines++;
+        num_chars += line_len;
+    }
+    rewind(fp);
+    
+    RuleSet *rules = calloc(1, sizeof(RuleSet));
+    if (rules != NULL) {
+        rules->ops = malloc((num_chars + 1) * sizeof(RuleOp));
+        rules->starts = malloc((num_lines + 1) * sizeof(int));
+    }
+    if ((rules == NULL) || (rules->ops == NULL) || (rules->starts == NULL)) {
+        fprintf(stderr, "Error allocating memory for the rules\n");
+        free(line);
+        fclose(fp);
+        free_rule_set(rules);
+        return NULL;
+    }
+    rules->order = order;
+    
+    int line_num = 0;
+    int num_ops = 0;
+    while ((line_len = getline(&line, &line_size, fp)) != -1) {
+        line_num++;
+        while ((line_len > 0) && ((line[line_len - 1] == '\n') || (line[line_len - 1] == '\r'))) {
+            line_len--;
+        }
+        if ((line_len == 0) || (line[0] == '#')) {
+            continue;
+        }
+        
+        int rule_ops = compile_rule(line, line_len, rules->ops + num_ops);
+        if (rule_ops == -1) {
+            fprintf(stderr, "Skipping the invalid rule on line %d of %s: %.*s\n", line_num, filename, (int) line_len, line);
+            continue;
+        }
+        rules->starts[rules->num_rules++] = num_ops;
+        num_ops += rule_ops;
+    }
+    rules->starts[rules->num_rules] = num_ops;
+    free(line);
+    fclose(fp);
+    
+    if (rules->num_rules == 0) {
+        fprintf(stderr, "Error, %s doesn't have any valid rules\n", filename);
+        free_rule_set(rules);
+        return NULL;
+    }
+    return rules;
+}
+
+
+// Applies a rule to a word, the same way hashcat does
+//
+// Functions that refer to a position past the end of the word leave the
+// word as it is. out needs room for MAX_GUESS_SIZE characters
+//
+// Returns the length of the new word, or -1 if the rule rejects the word or
+// it ends up too long to be a guess
+//
+int apply_rule(RuleSet *rules, int rule, const char *word, int len, char *out) {
+    
+    char buf[RULE_MAX_LEN];
+    if (len > RULE_MAX_LEN) {
+        return -1;
+    }
+    memcpy(buf, word, len);
+    
+    const RuleOp *op = rules->ops + rules->starts[rule];
+    const RuleOp *end = rules->ops + rules->starts[rule + 1];
+    for (; op < end; op++) {
+        
+        int n = op->arg1;
+        int m = op->arg2;
+        char x = op->arg1;
+        char y = op->arg2;
+        
+        switch (op->code) {
+            case RULE_NOOP:
+                break;
+            case RULE_LOWER:
+                for (int i = 0; i < len; i++) {
+                    buf[i] = ascii_lower(buf[i]);
+                }
+                break;
+            case RULE_UPPER:
+                for (int i = 0; i < len; i++) {
+                    buf[i] = ascii_upper(buf[i]);
+                }
+                break;
+            case RULE_CAPITALIZE:
+                for (int i = 0; i < len; i++) {
+                    buf[i] = (i == 0) ? ascii_upper(buf[i]) : ascii_lower(buf[i]);
+                }
+                break;
+            case RULE_INVERT_CAPITALIZE:
+                for (int i = 0; i < len; i++) {
+                    buf[i] = (i == 0) ? ascii_lower(buf[i]) : ascii_upper(buf[i]);
+                }
+                break;
+            case RULE_TOGGLE_ALL:
+                for (int i = 0; i < len; i++) {
+                    buf[i] = ascii_toggle(buf[i]);
+                }
+                break;
+            case RULE_TOGGLE_AT:
+                if (n < len) {
+                    buf[n] = ascii_toggle(buf[n]);
+                }
+                break;
+            case RULE_REVERSE:
+                for (int i = 0; i < len / 2; i++) {
+                    char c = buf[i];
+                    buf[i] = buf[len - 1 - i];
+                    buf[len - 1 - i] = c;
+                }
+                break;
+            case RULE_DUPLICATE:
+                if (len * 2 > RULE_MAX_LEN) {
+                    return -1;
+                }
+                memcpy(buf + len, buf, len);
+                len *= 2;
+                break;
+            case RULE_DUPLICATE_N:
+                if (len * (n + 1) > RULE_MAX_LEN) {
+                    return -1;
+                }
+                for (int i = 1; i <= n; i++) {
+                    memcpy(buf + len * i, buf, len);
+                }
+                len *= n + 1;
+                break;
+            case RULE_REFLECT:
+                if (len * 2 > RULE_MAX_LEN) {
+                    return -1;
+                }
+                for (int i = 0; i < len; i++) {
+                    buf[len + i] = buf[len - 1 - i];
+                }
+                len *= 2;
+                break;
+            case RULE_ROTATE_LEFT:
+                if (len > 1) {
+                    char c = buf[0];
+                    memmove(buf, buf + 1, len - 1);
+                    buf[len - 1] = c;
+                }
+                break;
+            case RULE_ROTATE_RIGHT:
+                if (len > 1) {
+                    char c = buf[len - 1];
+                    memmove(buf + 1, buf, len - 1);
+                    buf[0] = c;
+                }
+                break;
+            case RULE_APPEND:
+                if (len + 1 > RULE_MAX_LEN) {
+                    return -1;
+                }
+                buf[len++] = x;
+                break;
+            case RULE_PREPEND:
+                if (len + 1 > RULE_MAX_LEN) {
+                    return -1;
+                }
+                memmove(buf + 1, buf, len);
+                buf[0] = x;
+                len++;
+                break;
+            case RULE_DELETE_FIRST:
+                if (len > 0) {
+                    memmove(buf, buf + 1, len - 1);
+                    len--;
+                }
+                break;
+            case RULE_DELETE_LAST:
+                if (len > 0) {
+                    len--;
+                }
+                break;
+            case RULE_DELETE_AT:
+                if (n < len) {
+                    memmove(buf + n, buf + n + 1, len - n - 1);
+                    len--;
+                }
+                break;
+            case RULE_EXTRACT:
+                if (n + m <= len) {
+                    memmove(buf, buf + n, m);
+                    len = m;
+                }
+                break;
+            case RULE_OMIT:
+                if (n + m <= len) {
+                    memmove(buf + n, buf + n + m, len - n - m);
+                    len -= m;
+                }
+                break;
+            case RULE_INSERT:
+                if (n <= len) {
+                    if (len + 1 > RULE_MAX_LEN) {
+                        return -1;
+                    }
+                    memmove(buf + n + 1, buf + n, len - n);
+                    buf[n] = y;
+                    len++;
+                }
+                break;
+            case RULE_OVERWRITE:
+                if (n < len) {
+                    buf[n] = y;
+                }
+                break;
+            case RULE_TRUNCATE:
+                if (n < len) {
+                    len = n;
+                }
+                break;
+            case RULE_REPLACE:
+                for (int i = 0; i < len; i++) {
+                    if (buf[i] == x) {
+                        buf[i] = y;
+                    }
+                }
+                break;
+            case RULE_PURGE: {
+                int kept = 0;
+                for (int i = 0; i < len; i++) {
+                    if (buf[i] != x) {
+                        buf[kept++] = buf[i];
+                    }
+                }
+                len = kept;
+                break;
+            }
+            case RULE_DUP_FIRST:
+                if (len > 0) {
+                    if (len + n > RULE_MAX_LEN) {
+                        return -1;
+                    }
+                    memmove(buf + n, buf, len);
+                    memset(buf, buf[n], n);
+                    len += n;
+                }
+                break;
+            case RULE_DUP_LAST:
+                if (len > 0) {
+                    if (len + n > RULE_MAX_LEN) {
+                        return -1;
+                    }
+                    memset(buf + len, buf[len - 1], n);
+                    len += n;
+                }
+                break;
+            case RULE_DUP_ALL:
+                if (len * 2 > RULE_MAX_LEN) {
+                    return -1;
+                }
+                for (int i = len - 1; i >= 0; i--) {
+                    buf[i * 2] = buf[i];
+                    buf[i * 2 + 1] = buf[i];
+                }
+                len *= 2;
+                break;
+            case RULE_DUP_BLOCK_FIRST:
+                if (n <= len) {
+                    if (len + n > RULE_MAX_LEN) {
+                        return -1;
+                    }
+                    memmove(buf + n, buf, len);
+                    len += n;
+                }
+                break;
+            case RULE_DUP_BLOCK_LAST:
+                if (n <= len) {
+                    if (len + n > RULE_MAX_LEN) {
+                        return -1;
+                    }
+                    memcpy(buf + len, buf + len - n, n);
+                    len += n;
+                }
+                break;
+            case RULE_SWAP_FRONT:
+                if (len > 1) {
+                    char c = buf[0];
+                    buf[0] = buf[1];
+                    buf[1] = c;
+                }
+                break;
+            case RULE_SWAP_BACK:
+                if (len > 1) {
+                    char c = buf[len - 1];
+                    buf[len - 1] = buf[len - 2];
+                    buf[len - 2] = c;
+                }
+                break;
+            case RULE_SWAP_AT:
+                if ((n < len) && (m < len)) {
+                    char c = buf[n];
+                    buf[n] = buf[m];
+                    buf[m] = c;
+                }
+                break;
+            case RULE_SHIFT_LEFT:
+                if (n < len) {
+                    buf[n] = (unsigned char) buf[n] << 1;
+                }
+                break;
+            case RULE_SHIFT_RIGHT:
+                if (n < len) {
+                    buf[n] = (unsigned char) buf[n] >> 1;
+                }
+                break;
+            case RULE_INCREMENT:
+                if (n < len) {
+                    buf[n]++;
+                }
+                break;
+            case RULE_DECREMENT:
+                if (n < len) {
+                    buf[n]--;
+                }
+                break;
+            case RULE_REPLACE_NEXT:
+                if (n + 1 < len) {
+                    buf[n] = buf[n + 1];
+                }
+                break;
+            case RULE_REPLACE_PREV:
+                if ((n >= 1) && (n < len)) {
+                    buf[n] = buf[n - 1];
+                }
+                break;
+            case RULE_TITLE:
+            case RULE_TITLE_SEP: {
+                char sep = (op->code == RULE_TITLE) ? ' ' : x;
+                for (int i = 0; i < len; i++) {
+                    buf[i] = ((i == 0) || (buf[i - 1] == sep)) ? ascii_upper(buf[i]) : ascii_lower(buf[i]);
+                }
+                break;
+            }
+            case RULE_REJECT_LESS:
+                if (len >= n) {
+                    return -1;
+                }
+                break;
+            case RULE_REJECT_GREATER:
+                if (len <= n) {
+                    return -1;
+                }
+                break;
+            case RULE_REJECT_EQUAL:
+                if (len != n) {
+                    return -1;
+                }
+                break;
+            case RULE_REJECT_CONTAIN:
+                if (memchr(buf, x, len) != NULL) {
+                    return -1;
+                }
+                break;
+            case RULE_REJECT_NOT_CONTAIN:
+                if (memchr(buf, x, len) == NULL) {
+                    return -1;
+                }
+                break;
+            case RULE_REJECT_FIRST:
+                if ((len == 0) || (buf[0] != x)) {
+                    return -1;
+                }
+                break;
+            case RULE_REJECT_LAST:
+                if ((len == 0) || (buf[len - 1] != x)) {
+                    return -1;
+                }
+                break;
+            case RULE_REJECT_AT:
+                if ((n >= len) || (buf[n] != y)) {
+                    return -1;
+                }
+                break;
+            case RULE_REJECT_COUNT: {
+                int count = 0;
+                for (int i = 0; i < len; i++) {
+                    count += (buf[i] == y);
+                }
+                if (count < n) {
+                    return -1;
+                }
+                break;
+            }
+        }
+    }
+    
+    if (len > MAX_GUESS_SIZE - 1) {
+        return -1;
+    }
+    memcpy(out, buf, len);
+    return len;
+}
+
+
+// Adds a guess to a batch. guess_len includes the trailing newline
+//
+// Returns 1 if the batch is now full and should be run
+//
+int rule_batch_add(RuleBatch *batch, char *guess, int guess_len) {
+    int i = batch->count++;
+    memcpy(batch->guesses[i], guess, guess_len - 1);
+    batch->lens[i] = guess_len - 1;
+    return (batch->count == RULE_BATCH_SIZE);
+}
+
+
+// Applies every rule to every guess in a batch, in the rule set's order,
+// and calls callback with each guess that isn't rejected
+//
+void rule_batch_run(RuleSet *rules, RuleBatch *batch, RuleCallback callback, void *context) {
+    
+    char out[MAX_GUESS_SIZE + 1];
+    int outer = (rules->order == RULE_ORDER_RULE) ? rules->num_rules : batch->count;
+    int inner = (rules->order == RULE_ORDER_RULE) ? batch->count : rules->num_rules;
+    
+    for (int i = 0; i < outer; i++) {
+        for (int j = 0; j < inner; j++) {
+            int rule = (rules->order == RULE_ORDER_RULE) ? i : j;
+            int guess = (rules->order == RULE_ORDER_RULE) ? j : i;
+            int len = apply_rule(rules, rule, batch->guesses[guess], batch->lens[guess], out);
+            if (len != -1) {
+                out[len] = '\n';
+                callback(context, out, len + 1);
+            }
+        }
+    }
+    batch->count = 0;
+}
+
+
+// Frees the rule set
+//
+void free_rule_set(RuleSet *rules) {
+    if (rules == NULL) {
+        return;
+    }
+    free(rules->ops);
+    free(rules->starts);
+    free(rules);
+}
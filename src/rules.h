@@ -0,0 +1,158 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Pretty Cool Fuzzy Guesser (PCFG)
+//  --Probabilistic Context Free Grammar (PCFG) Password Guessing Program
+//
+//  Written by Matt Weir
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//
+
+
+
+#ifndef _RULES_H
+#define _RULES_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "global_def.h"
+
+
+// Longest a word can get while a rule is being applied. Words that end up
+// too long to be a guess are rejected
+#define RULE_MAX_LEN 256
+
+// The number of guesses the rules are applied to at once
+#define RULE_BATCH_SIZE 128
+
+// Orders the mangled guesses can be output in. Guess-major applies every
+// rule to a guess before moving on to the next guess. Rule-major applies
+// one rule to every guess in a batch before moving on to the next rule
+#define RULE_ORDER_GUESS 0
+#define RULE_ORDER_RULE 1
+
+
+// Rule functions. These follow the hashcat rule syntax
+typedef enum RuleCode {
+    RULE_NOOP,              // :
+    RULE_LOWER,             // l
+    RULE_UPPER,             // u
+    RULE_CAPITALIZE,        // c
+    RULE_INVERT_CAPITALIZE, // C
+    RULE_TOGGLE_ALL,        // t
+    RULE_TOGGLE_AT,         // TN
+    RULE_REVERSE,           // r
+    RULE_DUPLICATE,         // d
+    RULE_DUPLICATE_N,       // pN
+    RULE_REFLECT,           // f
+    RULE_ROTATE_LEFT,       // {
+    RULE_ROTATE_RIGHT,      // }
+    RULE_APPEND,            // $X
+    RULE_PREPEND,           // ^X
+    RULE_DELETE_FIRST,      // [
+    RULE_DELETE_LAST,       // ]
+    RULE_DELETE_AT,         // DN
+    RULE_EXTRACT,           // xNM
+    RULE_OMIT,              // ONM
+    RULE_INSERT,            // iNX
+    RULE_OVERWRITE,         // oNX
+    RULE_TRUNCATE,          // 'N
+    RULE_REPLACE,           // sXY
+    RULE_PURGE,             // @X
+    RULE_DUP_FIRST,         // zN
+    RULE_DUP_LAST,          // ZN
+    RULE_DUP_ALL,           // q
+    RULE_DUP_BLOCK_FIRST,   // yN
+    RULE_DUP_BLOCK_LAST,    // YN
+    RULE_SWAP_FRONT,        // k
+    RULE_SWAP_BACK,         // K
+    RULE_SWAP_AT,           // *NM
+    RULE_SHIFT_LEFT,        // LN
+    RULE_SHIFT_RIGHT,       // RN
+    RULE_INCREMENT,         // +N
+    RULE_DECREMENT,         // -N
+    RULE_REPLACE_NEXT,      // .N
+    RULE_REPLACE_PREV,      // ,N
+    RULE_TITLE,             // E
+    RULE_TITLE_SEP,         // eX
+    RULE_REJECT_LESS,       // <N
+    RULE_REJECT_GREATER,    // >N
+    RULE_REJECT_EQUAL,      // _N
+    RULE_REJECT_CONTAIN,    // !X
+    RULE_REJECT_NOT_CONTAIN,// /X
+    RULE_REJECT_FIRST,      // (X
+    RULE_REJECT_LAST,       // )X
+    RULE_REJECT_AT,         // =NX
+    RULE_REJECT_COUNT,      // %NX
+} RuleCode;
+
+
+// One rule function with its arguments
+typedef struct RuleOp {
+    unsigned char code;
+    unsigned char arg1;
+    unsigned char arg2;
+}RuleOp;
+
+
+// A rule file compiled to bytecode
+//
+// The ops of every rule are stored back to back. Rule r is
+// ops[starts[r]] up to ops[starts[r + 1]]
+//
+typedef struct RuleSet {
+    RuleOp *ops;
+    int *starts;
+    int num_rules;
+    
+    // RULE_ORDER_GUESS or RULE_ORDER_RULE
+    int order;
+}RuleSet;
+
+
+// Guesses waiting to have the rules applied to them
+typedef struct RuleBatch {
+    int count;
+    int lens[RULE_BATCH_SIZE];
+    char guesses[RULE_BATCH_SIZE][MAX_GUESS_SIZE + 1];
+}RuleBatch;
+
+
+// Called for each mangled guess. guess_len includes the trailing newline
+typedef void (*RuleCallback)(void *context, char *guess, int guess_len);
+
+
+// Loads and compiles a rule file
+extern RuleSet *load_rule_set(char *filename, int order);
+
+// Compiles one rule. Returns the number of ops, or -1 if it is invalid
+extern int compile_rule(const char *line, int line_len, RuleOp *ops);
+
+// Applies a rule to a word
+extern int apply_rule(RuleSet *rules, int rule, const char *word, int len, char *out);
+
+// Adds a guess to a batch. Returns 1 if the batch is now full
+extern int rule_batch_add(RuleBatch *batch, char *guess, int guess_len);
+
+// Applies every rule to every guess in a batch
+extern void rule_batch_run(RuleSet *rules, RuleBatch *batch, RuleCallback callback, void *context);
+
+// Frees the rule set
+extern void free_rule_set(RuleSet *rules);
+
+#endif
@@ -0,0 +1,241 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Pretty Cool Fuzzy Guesser (PCFG)
+//  --Probabilistic Context Free Grammar (PCFG) Password Guessing Program
+//
+//  Written by Matt Weir
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//
+
+
+
+#include "socket_io.h"
+
+
+// Parses an address to listen on or connect to
+//
+// Function returns 0 if it worked ok, 1 if the address is bad
+//
+static int parse_address(char *address, struct sockaddr_storage *addr, socklen_t *addr_len, int *is_unix) {
+    
+    memset(addr, 0, sizeof(struct sockaddr_storage));
+    char *colon = strrchr(address, ':');
+    
+    if ((colon == NULL) || (strchr(address, '/') != NULL)) {
+        struct sockaddr_un *unix_addr = (struct sockaddr_un *) addr;
+        if (strlen(address) >= sizeof(unix_addr->sun_path)) {
+            fprintf(stderr, "Error, the socket path %s is too long\n", address);
+            return 1;
+        }
+        unix_addr->sun_family = AF_UNIX;
+        strcpy(unix_addr->sun_path, address);
+        (*addr_len) = sizeof(struct sockaddr_un);
+        (*is_unix) = 1;
+        return 0;
+    }
+    
+    char host[256];
+    size_t host_len = colon - address;
+    if (host_len >= sizeof(host)) {
+        fprintf(stderr, "Error, the host name in %s is too long\n", address);
+        return 1;
+    }
+    memcpy(host, address, host_len);
+    host[host_len] = '\0';
+    
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo *result;
+    if (getaddrinfo((host_len == 0) ? "127.0.0.1" : host, colon + 1, &hints, &result) != 0) {
+        fprintf(stderr, "Error, could not look up the address %s\n", address);
+        return 1;
+    }
+    memcpy(addr, result->ai_addr, result->ai_addrlen);
+    (*addr_len) = result->ai_addrlen;
+    (*is_unix) = 0;
+    freeaddrinfo(result);
+    return 0;
+}
+
+
+// Sends all of a buffer. Returns 0 if it worked ok, 1 if the connection
+// was lost
+//
+int send_all(int fd, const void *buf, size_t len) {
+    const char *pos = buf;
+    while (len > 0) {
+        ssize_t sent = send(fd, pos, len, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return 1;
+        }
+        pos += sent;
+        len -= sent;
+    }
+    return 0;
+}
+
+
+// Fills a buffer from a socket. Returns 0 if it worked ok, 1 if the
+// connection was closed or lost
+//
+int recv_all(int fd, void *buf, size_t len) {
+    char *pos = buf;
+    while (len > 0) {
+        ssize_t got = recv(fd, pos, len, 0);
+        if (got < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return 1;
+        }
+        if (got == 0) {
+            return 1;
+        }
+        pos += got;
+        len -= got;
+    }
+    return 0;
+}
+
+
+// Makes a socket non-blocking
+//
+// Function returns 0 if it worked ok, 1 if an error occured
+//
+int socket_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if ((flags == -1) || (fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1)) {
+        return 1;
+    }
+    return 0;
+}
+
+
+// Sends as much of a buffer as the socket has room for, without waiting.
+// sent is how much of the buffer has been sent so far, and is updated
+//
+// Function returns 0 if it worked ok, (even if there wasn't room for all
+// of it), 1 if the connection was lost
+//
+int send_some(int fd, const void *buf, size_t len, size_t *sent) {
+    while ((*sent) < len) {
+        ssize_t got = send(fd, (const char *) buf + (*sent), len - (*sent), MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (got < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+                return 0;
+            }
+            return 1;
+        }
+        (*sent) += got;
+    }
+    return 0;
+}
+
+
+// Reads as much of a buffer as has arrived, without waiting. have is how
+// much of the buffer has been filled so far, and is updated
+//
+// Function returns 0 if it worked ok, (even if the buffer isn't full yet),
+// 1 if the connection was closed or lost
+//
+int recv_some(int fd, void *buf, size_t len, size_t *have) {
+    while ((*have) < len) {
+        ssize_t got = recv(fd, (char *) buf + (*have), len - (*have), MSG_DONTWAIT);
+        if (got < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+                return 0;
+            }
+            return 1;
+        }
+        if (got == 0) {
+            return 1;
+        }
+        (*have) += got;
+    }
+    return 0;
+}
+
+
+// Starts listening on an address
+//
+// A Unix socket left over from an earlier run is removed first, but
+// nothing that isn't a socket is
+//
+// Returns the socket, or -1 if an error occured
+//
+int socket_listen(char *address, int *is_unix) {
+    
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+    if (parse_address(address, &addr, &addr_len, is_unix) != 0) {
+        return -1;
+    }
+    
+    struct stat file_stat;
+    if (((*is_unix) == 1) && (stat(address, &file_stat) == 0) && (S_ISSOCK(file_stat.st_mode))) {
+        unlink(address);
+    }
+    
+    int fd = socket(addr.ss_family, SOCK_STREAM, 0);
+    int reuse = 1;
+    if ((fd == -1) ||
+        (((*is_unix) == 0) && (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) != 0)) ||
+        (bind(fd, (struct sockaddr *) &addr, addr_len) != 0) ||
+        (listen(fd, SOMAXCONN) != 0)) {
+        fprintf(stderr, "Error listening on %s: %s\n", address, strerror(errno));
+        if (fd != -1) {
+            close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+
+// Connects to an address
+//
+// Returns the socket, or -1 if it couldn't connect
+//
+int socket_connect(char *address) {
+    
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+    int is_unix;
+    if (parse_address(address, &addr, &addr_len, &is_unix) != 0) {
+        return -1;
+    }
+    int fd = socket(addr.ss_family, SOCK_STREAM, 0);
+    if ((fd == -1) || (connect(fd, (struct sockaddr *) &addr, addr_len) != 0)) {
+        fprintf(stderr, "Error connecting to %s: %s\n", address, strerror(errno));
+        if (fd != -1) {
+            close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
@@ -0,0 +1,68 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Pretty Cool Fuzzy Guesser (PCFG)
+//  --Probabilistic Context Free Grammar (PCFG) Password Guessing Program
+//
+//  Written by Matt Weir
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//
+
+
+
+#ifndef _SOCKET_IO_H
+#define _SOCKET_IO_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+
+// Addresses with a ':' and no '/' are TCP, (aka 127.0.0.1:9000, or :9000
+// for the loopback address). Anything else is the path of a Unix socket
+
+
+// Starts listening on an address. Returns the socket, or -1 on error
+extern int socket_listen(char *address, int *is_unix);
+
+// Connects to an address. Returns the socket, or -1 on error
+extern int socket_connect(char *address);
+
+// Sends all of a buffer. Returns 0 if it worked ok, 1 if the connection was lost
+extern int send_all(int fd, const void *buf, size_t len);
+
+// Fills a buffer. Returns 0 if it worked ok, 1 if the connection was lost
+extern int recv_all(int fd, void *buf, size_t len);
+
+// Makes a socket non-blocking. Returns 0 if it worked ok, 1 on error
+extern int socket_nonblocking(int fd);
+
+// Sends as much of a buffer as there is room for without waiting. Returns 0
+// if it worked ok, 1 if the connection was lost
+extern int send_some(int fd, const void *buf, size_t len, size_t *sent);
+
+// Reads as much of a buffer as has arrived without waiting. Returns 0 if it
+// worked ok, 1 if the connection was lost
+extern int recv_some(int fd, void *buf, size_t len, size_t *have);
+
+#endif